@@ -46,7 +46,7 @@ struct BRTree {
  * @return BRNode* : pointer to created node. (NULL if memory error has occured)
  */
 static BRNode *init_node(bool *memory_error, BRNode *guard, char *value) {
-  BRNode *node = wrap_malloc(sizeof(struct BRNode));
+  BRNode *node = wrap_malloc(sizeof(struct BRNode), MEMORY_TAG_BRTREE);
   if (node == NULL) {
     *memory_error = true;
     return NULL;
@@ -240,13 +240,13 @@ static void rbtree_restore_order(BRTree *tree, BRNode *node) {
 }
 
 BRTree *init_tree(bool *memory_error) {
-  BRTree *tree = wrap_malloc(sizeof(struct BRTree));
+  BRTree *tree = wrap_malloc(sizeof(struct BRTree), MEMORY_TAG_BRTREE);
   if (tree == NULL) {
     *memory_error = true;
     return NULL;
   }
 
-  tree->guard = wrap_calloc(1u, sizeof(struct BRNode));
+  tree->guard = wrap_calloc(1u, sizeof(struct BRNode), MEMORY_TAG_BRTREE);
   if (tree->guard == NULL) {
     *memory_error = true;
     wrap_free(tree);
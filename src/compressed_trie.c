@@ -9,6 +9,7 @@
 #include "memory.h"
 #include "string_lib.h"
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 /**
@@ -22,38 +23,73 @@
  */
 #define INIT_BUFFER_SIZE 10
 
-struct TrieChild;
 /**
- * @brief Typedef shortens TrieChild name to make code more readable.
+ * @brief Distance in bytes, above which blocks are counted as scattered in
+ * statistics of the trie.
  */
-typedef struct TrieChild TrieChild;
+#define LAYOUT_PAGE_SIZE 4096
 
 /**
- * @brief Represents children reference of given node.
+ * @brief Number of buckets of heat histogram used to pick hot nodes (one for
+ * nodes never entered and one per bit of the counter).
  */
-struct TrieChild {
-  struct TrieNode *child; ///< Pointer to children node.
-  char *edge_etiquette;   ///< Etiquetee of parent-children edge.
-};
+#define TRIE_HEAT_BUCKETS 17
 
 /**
- * @brief Represents node of compressed trie.
+ * @brief Number of low bits of node id, which select node in its chunk.
  */
-struct TrieNode {
-  struct TrieNode *father;                    ///< Pointer to father of node.
-  TrieChild children[MAX_NUMBER_OF_CHILDREN]; ///< Array which stores
-                                              ///< references to children.
+#define POOL_CHUNK_BITS 6
+
+/**
+ * @brief Number of nodes in one chunk of the pool.
+ */
+#define POOL_CHUNK_SIZE ((uint32_t)1 << POOL_CHUNK_BITS)
+
+/**
+ * @brief Id meaning no node. The first node of every pool is never used.
+ */
+#define NO_NODE 0
 
+/**
+ * @brief Represents node of compressed trie. Nodes refer to each other by
+ * ids in the pool of their trie.
+ */
+struct TrieNode {
+  char *edge_etiquette; ///< Etiquette of edge from father (NULL for root).
   void *value; ///< Value of given node (with key which is determined by path
                ///< from root).
+  uint32_t id; ///< Id of the node in its pool.
+  uint32_t father; ///< Id of father of node (next free node, if node is free).
+  uint32_t children[MAX_NUMBER_OF_CHILDREN]; ///< Ids of children (NO_NODE if
+                                             ///< there is no child).
+  uint16_t heat; ///< Saturating count of sampled searches entering the node.
+};
+
+/**
+ * @brief Pool of nodes of one or more tries. Nodes are allocated in chunks,
+ * which never move, so pointers to nodes stay valid until nodes are freed.
+ */
+struct TriePool {
+  DynamicArray *chunks; ///< Chunks of POOL_CHUNK_SIZE nodes.
+  TrieNode **table;     ///< Lookup into @p chunks, refreshed when it grows.
+  size_t chunk_count;   ///< Number of allocated chunks.
+  uint32_t next;        ///< Id of the first node never allocated.
+  uint32_t free;        ///< Id of the last freed node (or NO_NODE).
+  size_t references;    ///< Number of tries using the pool.
 };
 
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct TriePool TriePool;
+
 /**
  * @brief Structure to be used by the Trie library user.
  *  Provides a trie for strings which consists of digits.
  */
 struct Trie {
   struct TrieNode *root; ///< Pointer to the root of the trie.
+  TriePool *pool;        ///< Pool of nodes of the trie.
   void (*value_free_function)(
       void *value, const char *key,
       void *configuration);  ///< Function to be called at values at
@@ -61,37 +97,206 @@ struct Trie {
   size_t longest_key;        ///< Length of the longest key in trie.
   char *longest_key_buffer;  ///< Buffer to store strings of size longest_key+1.
   void *free_wrapper_config; ///< Pointer which is passed to value_free_function
+  bool deferred;             ///< True if balancing is postponed.
+  size_t candidates;         ///< Number of postponed balancings.
+  bool sampled;              ///< True if searches count visited nodes.
 };
 
+/**
+ * @brief Returns node of given id.
+ *
+ * @param[in] pool : pool of the node.
+ * @param id : id of allocated node.
+ * @return TrieNode* : node of @p id.
+ */
+static inline TrieNode *pool_node(const TriePool *pool, uint32_t id) {
+  return &pool->table[id >> POOL_CHUNK_BITS][id & (POOL_CHUNK_SIZE - 1)];
+}
+
+/**
+ * @brief Returns child of the node.
+ *
+ * @param[in] pool : pool of the node.
+ * @param[in] node : father of the child.
+ * @param digit : index of the child.
+ * @return TrieNode* : child (NULL if there is none).
+ */
+static inline TrieNode *trienode_child(const TriePool *pool,
+                                       const TrieNode *node, size_t digit) {
+  uint32_t id = node->children[digit];
+  return id == NO_NODE ? NULL : pool_node(pool, id);
+}
+
+/**
+ * @brief Returns father of the node.
+ *
+ * @param[in] pool : pool of the node.
+ * @param[in] node : child of the father.
+ * @return TrieNode* : father (NULL for root).
+ */
+static inline TrieNode *trienode_father(const TriePool *pool,
+                                        const TrieNode *node) {
+  return node->father == NO_NODE ? NULL : pool_node(pool, node->father);
+}
+
+/**
+ * @brief Makes node child of given index of the father.
+ *
+ * @param[in, out] father : new father of @p child.
+ * @param digit : index of @p child at @p father.
+ * @param[in, out] child : linked node.
+ */
+static inline void trienode_link(TrieNode *father, size_t digit,
+                                 TrieNode *child) {
+  father->children[digit] = child->id;
+  child->father = father->id;
+}
+
+/**
+ * @brief Creates empty pool, used by one trie.
+ *
+ * @return TriePool* : created pool (NULL if memory error has occured).
+ */
+static TriePool *pool_new(void) {
+  TriePool *pool = wrap_malloc(sizeof(struct TriePool), MEMORY_TAG_TRIE_NODE);
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  bool memory_error = false;
+  pool->chunks = init_darray(&memory_error);
+  if (memory_error) {
+    wrap_free(pool);
+    return NULL;
+  }
+
+  pool->table = NULL;
+  pool->chunk_count = 0;
+  pool->next = NO_NODE + 1;
+  pool->free = NO_NODE;
+  pool->references = 1;
+
+  return pool;
+}
+
+/**
+ * @brief Appends chunk of nodes to the pool.
+ *
+ * @param[in, out] pool : pool to grow.
+ * @return true : if chunk was appended.
+ * @return false : if memory error has occured (nothing changes).
+ */
+static bool pool_grow(TriePool *pool) {
+  TrieNode *chunk = wrap_malloc(POOL_CHUNK_SIZE * sizeof(struct TrieNode),
+                                MEMORY_TAG_TRIE_NODE);
+  if (chunk == NULL) {
+    return false;
+  }
+
+  bool memory_error = false;
+  darray_push(pool->chunks, chunk, &memory_error);
+  if (memory_error) {
+    wrap_free(chunk);
+    return false;
+  }
+
+  pool->table = (TrieNode **)darray_temporary_lookup(pool->chunks);
+  pool->chunk_count++;
+  return true;
+}
+
+/**
+ * @brief Allocates node from the pool. Only its id is set.
+ *
+ * @param[in, out] pool : pool to allocate from.
+ * @param fresh : true if node should be taken from the end of the pool
+ * instead of reusing freed nodes, so consecutive nodes lie next to each
+ * other.
+ * @return TrieNode* : allocated node (NULL if memory error has occured).
+ */
+static TrieNode *pool_alloc(TriePool *pool, bool fresh) {
+  uint32_t id = pool->free;
+
+  if (!fresh && id != NO_NODE) {
+    pool->free = pool_node(pool, id)->father;
+    return pool_node(pool, id);
+  }
+
+  id = pool->next;
+  if (id == UINT32_MAX ||
+      ((id >> POOL_CHUNK_BITS) == pool->chunk_count && !pool_grow(pool))) {
+    return NULL;
+  }
+
+  pool->next++;
+  TrieNode *node = pool_node(pool, id);
+  node->id = id;
+  return node;
+}
+
+/**
+ * @brief Returns node to the pool.
+ *
+ * @param[in, out] pool : pool of the node.
+ * @param[in] node : freed node.
+ */
+static inline void pool_release(TriePool *pool, TrieNode *node) {
+  node->father = pool->free;
+  pool->free = node->id;
+}
+
+/**
+ * @brief Drops reference to the pool, freeing it if no trie uses it.
+ *
+ * @param[in] pool : pool to release.
+ */
+static void pool_drop(TriePool *pool) {
+  if (--pool->references > 0) {
+    return;
+  }
+
+  for (size_t index = 0; index < pool->chunk_count; index++) {
+    wrap_free(pool->table[index]);
+  }
+
+  wrap_free(darray_convert(pool->chunks));
+  wrap_free(pool);
+}
+
 /**
  * @brief Inits empry trienode with all values be either NULL or zero.
  *
+ * @param[in, out] pool : pool to allocate node from.
+ * @param fresh : true if node should be taken from the end of the pool.
  * @param[out] memory_error_occured : setted to true if allocation error occurs.
  * @return TrieNode* : created node. (NULL if error occured).
  */
-static TrieNode *init_empty_trienode(bool *memory_error_occured) {
-  TrieNode *node = wrap_malloc(sizeof(struct TrieNode));
+static TrieNode *init_empty_trienode(TriePool *pool, bool fresh,
+                                     bool *memory_error_occured) {
+  TrieNode *node = pool_alloc(pool, fresh);
 
   if (node == NULL) {
     *memory_error_occured = true;
     return NULL;
   }
 
-  node->father = NULL;
+  node->edge_etiquette = NULL;
+  node->father = NO_NODE;
 
   for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
-    node->children[index].child = NULL;
-    node->children[index].edge_etiquette = NULL;
+    node->children[index] = NO_NODE;
   }
 
   node->value = NULL;
+  node->heat = 0;
 
   return node;
 }
 
 /**
  * @brief Drops one trienode without modifying anything else.
- *  Also perform deletion operation on node's value.
+ *  Also perform deletion operation on node's value and frees etiquette of
+ *  edge leading to it.
  *
  * @param[in] node : TrieNode to drop.
  * @param[in] tree : @p node 's Trie.
@@ -101,7 +306,8 @@ static inline void trie_drop_one_node(TrieNode *node, const Trie *tree) {
     tree->value_free_function(node->value, NULL, tree->free_wrapper_config);
   }
 
-  wrap_free(node);
+  wrap_free(node->edge_etiquette);
+  pool_release(tree->pool, node);
 }
 
 /**
@@ -125,76 +331,58 @@ static bool trie_conflict(Trie *tree, TrieNode *node, const char *key,
   bool error_occured = false;
 
   size_t next_int = char_digitize(key[char_no]);
-  TrieNode *child = init_empty_trienode(&error_occured);
+  TrieNode *old_child = trienode_child(tree->pool, node, next_int);
+  TrieNode *child = init_empty_trienode(tree->pool, false, &error_occured);
 
   if (error_occured) {
     return false;
   }
 
-  char *old_str = node->children[next_int].edge_etiquette;
-  TrieNode *old_child = node->children[next_int].child;
-
-  size_t old_ind = char_digitize(old_str[prefix_size]);
-  if (char_no + prefix_size == strlen(key)) {
-    child->children[old_ind].edge_etiquette =
-        string_clone_from_index(old_str, prefix_size);
-    if (child->children[old_ind].edge_etiquette == NULL) {
-      trie_drop_one_node(child, tree);
-      return false;
-    }
-
-    string_cut_at_char(&node->children[next_int].edge_etiquette, prefix_size);
-    node->children[next_int].child = child;
-    child->children[old_ind].child = old_child;
-    old_child->father = child;
-    child->father = node;
-    *new_node = child;
-
-    return true;
-  }
-
-  size_t key_ind = char_digitize(key[char_no + prefix_size]);
-
-  child->children[key_ind].edge_etiquette =
-      string_clone_from_index(key, char_no + prefix_size);
-  if (child->children[key_ind].edge_etiquette == NULL) {
+  size_t old_ind = char_digitize(old_child->edge_etiquette[prefix_size]);
+  char *old_rest = string_clone_from_index(old_child->edge_etiquette,
+                                           prefix_size);
+  if (old_rest == NULL) {
     trie_drop_one_node(child, tree);
     return false;
   }
 
-  child->children[key_ind].child = init_empty_trienode(&error_occured);
-  if (error_occured) {
-    wrap_free(child->children[key_ind].edge_etiquette);
-    trie_drop_one_node(child, tree);
-    return false;
-  }
+  *new_node = child;
+  if (char_no + prefix_size != strlen(key)) {
+    size_t key_ind = char_digitize(key[char_no + prefix_size]);
+    TrieNode *new_child =
+        init_empty_trienode(tree->pool, false, &error_occured);
+    if (error_occured) {
+      wrap_free(old_rest);
+      trie_drop_one_node(child, tree);
+      return false;
+    }
 
-  TrieNode *new_child = child->children[key_ind].child;
-  new_child->father = child;
+    new_child->edge_etiquette =
+        string_clone_from_index(key, char_no + prefix_size);
+    if (new_child->edge_etiquette == NULL) {
+      trie_drop_one_node(new_child, tree);
+      wrap_free(old_rest);
+      trie_drop_one_node(child, tree);
+      return false;
+    }
 
-  child->children[old_ind].edge_etiquette =
-      string_clone_from_index(old_str, prefix_size);
-  if (child->children[old_ind].edge_etiquette == NULL) {
-    wrap_free(child->children[old_ind].edge_etiquette);
-    wrap_free(child->children[key_ind].edge_etiquette);
-    trie_drop_one_node(child, tree);
-    return false;
+    trienode_link(child, key_ind, new_child);
+    *new_node = new_child;
   }
 
-  child->children[old_ind].child = old_child;
-  old_child->father = child;
-  string_cut_at_char(&node->children[next_int].edge_etiquette, prefix_size);
-
-  node->children[next_int].child = child;
-  child->father = node;
+  string_cut_at_char(&old_child->edge_etiquette, prefix_size);
+  child->edge_etiquette = old_child->edge_etiquette;
+  old_child->edge_etiquette = old_rest;
 
-  *new_node = new_child;
+  trienode_link(child, old_ind, old_child);
+  trienode_link(node, next_int, child);
   return true;
 }
 
 /**
  * @brief Perform search of node of given key corresponding to @p key.
  *
+ * @param[in] pool : pool of nodes of the trie.
  * @param[in] beggining : pointer to node from which search must begin.
  * @param[out] result : place to save result of the succesful search.
  * @param[in] key : key of node for which function perform searching.
@@ -203,7 +391,8 @@ static bool trie_conflict(Trie *tree, TrieNode *node, const char *key,
  * @return true : if node was found.
  * @return false : if node was not found.
  */
-static bool search_node(TrieNode *beggining, TrieNode **result, const char *key,
+static bool search_node(const TriePool *pool, TrieNode *beggining,
+                        TrieNode **result, const char *key,
                         size_t *father_result_index) {
   size_t actual_char = 0;
   size_t key_length = strlen(key);
@@ -216,12 +405,13 @@ static bool search_node(TrieNode *beggining, TrieNode **result, const char *key,
 
     size_t digit = char_digitize(key[actual_char]);
     size_t pref_len = 0;
-    const char *etiq = beggining->children[digit].edge_etiquette;
+    TrieNode *child = trienode_child(pool, beggining, digit);
 
-    if (etiq == NULL) {
+    if (child == NULL) {
       return false;
-    } else if (string_check_prefixes(key, actual_char, etiq, &pref_len)) {
-      beggining = beggining->children[digit].child;
+    } else if (string_check_prefixes(key, actual_char, child->edge_etiquette,
+                                     &pref_len)) {
+      beggining = child;
       actual_char += pref_len;
       *father_result_index = digit;
     } else {
@@ -238,14 +428,19 @@ static bool search_node(TrieNode *beggining, TrieNode **result, const char *key,
  * Result of search is value of node K which satisfies following conditions:
  * 1) forall (Node M in tree) Key(M) is prefix of @p key -> Key(M) is prefix of
  * Key(K).
+ * 2) Key(K) is shorter than @p limit.
  *
+ * @param[in] pool : pool of nodes of the trie.
  * @param[in] beggining : pointer to node from which search begins.
  * @param[in] key : string of digits for search for.
+ * @param limit : bound of length of matched prefixes.
+ * @param sampled : true if heat of entered nodes should be counted.
  * @param[out] longest_pref_size : saves length of longest matched prefix.
  * @return const char* : value of node with key which is longest prefix.
  */
-static void *search_longest_prefix(TrieNode *beggining, const char *key,
-                                   size_t *longest_pref_size) {
+static void *search_longest_prefix(const TriePool *pool, TrieNode *beggining,
+                                   const char *key, size_t limit,
+                                   bool sampled, size_t *longest_pref_size) {
   size_t actual_char = 0;
   size_t key_length = strlen(key);
   void *result = NULL;
@@ -257,14 +452,23 @@ static void *search_longest_prefix(TrieNode *beggining, const char *key,
 
     size_t digit = char_digitize(key[actual_char]);
     size_t pref_len = 0;
-    const char *etiq = beggining->children[digit].edge_etiquette;
+    TrieNode *child = trienode_child(pool, beggining, digit);
 
-    if (etiq == NULL) {
+    if (child == NULL) {
       return result;
-    } else if (string_check_prefixes(key, actual_char, etiq, &pref_len)) {
-      beggining = beggining->children[digit].child;
+    } else if (string_check_prefixes(key, actual_char, child->edge_etiquette,
+                                     &pref_len)) {
+      if (actual_char + pref_len >= limit) {
+        return result;
+      }
+
+      beggining = child;
       actual_char += pref_len;
 
+      if (sampled && beggining->heat < UINT16_MAX) {
+        beggining->heat++;
+      }
+
       if (beggining->value != NULL) {
         *longest_pref_size = actual_char;
         result = beggining->value;
@@ -303,33 +507,29 @@ static bool trie_check_add_node(Trie *tree, const char *key,
     }
 
     size_t next_digit = char_digitize(key[char_no]);
+    TrieNode *child = trienode_child(tree->pool, node, next_digit);
 
-    if (node->children[next_digit].child == NULL) {
-      TrieNode *child = node->children[next_digit].child =
-          init_empty_trienode(&error_occured);
+    if (child == NULL) {
+      child = init_empty_trienode(tree->pool, false, &error_occured);
       if (error_occured) {
         return false;
       }
 
-      child->father = node;
-
-      node->children[next_digit].edge_etiquette =
-          string_clone_from_index(key, char_no);
-      if (node->children[next_digit].edge_etiquette == NULL) {
+      child->edge_etiquette = string_clone_from_index(key, char_no);
+      if (child->edge_etiquette == NULL) {
         trie_drop_one_node(child, tree);
-        node->children[next_digit].child = NULL;
         return false;
       }
 
-      *check_result = node->children[next_digit].child;
+      trienode_link(node, next_digit, child);
+      *check_result = child;
       return true;
     }
 
-    char *edge_label = node->children[next_digit].edge_etiquette;
-
     size_t common_prefix_size = 0;
-    if (string_check_prefixes(key, char_no, edge_label, &common_prefix_size)) {
-      node = node->children[next_digit].child;
+    if (string_check_prefixes(key, char_no, child->edge_etiquette,
+                              &common_prefix_size)) {
+      node = child;
       char_no += common_prefix_size;
     } else {
       return trie_conflict(tree, node, key, char_no, common_prefix_size,
@@ -362,27 +562,52 @@ static void trienode_drop(Trie *tree, TrieNode *node,
   }
 
   for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
-    if (node->children[index].child != NULL) {
-      size_t etiq_size = strlen(node->children[index].edge_etiquette);
+    TrieNode *child = trienode_child(tree->pool, node, index);
+    if (child != NULL) {
+      size_t etiq_size = strlen(child->edge_etiquette);
 
       if (tree->longest_key_buffer != NULL) {
         for (size_t ind = buf_first_free_index;
              ind < buf_first_free_index + etiq_size; ind++) {
           tree->longest_key_buffer[ind] =
-              node->children[index].edge_etiquette[ind - buf_first_free_index];
+              child->edge_etiquette[ind - buf_first_free_index];
         }
       }
 
-      trienode_drop(tree, node->children[index].child,
-                    buf_first_free_index + etiq_size);
-      wrap_free(node->children[index].edge_etiquette);
-
-      node->children[index].edge_etiquette = NULL;
-      node->children[index].child = NULL;
+      trienode_drop(tree, child, buf_first_free_index + etiq_size);
+      node->children[index] = NO_NODE;
     }
   }
 
-  wrap_free(node);
+  wrap_free(node->edge_etiquette);
+  pool_release(tree->pool, node);
+}
+
+/**
+ * @brief Merges node without value into the father of the node, leaving only
+ * child of the node below the father.
+ *
+ * @param[in, out] pool : pool of nodes of the trie.
+ * @param[in, out] father : father of @p node.
+ * @param index : index of @p node at @p father.
+ * @param[in] node : merged node with one child.
+ * @param child_index : index of the child of @p node.
+ * @return true : if node was merged and freed.
+ * @return false : if memory error has occured (nothing changes).
+ */
+static bool trienode_merge(TriePool *pool, TrieNode *father, size_t index,
+                           TrieNode *node, size_t child_index) {
+  TrieNode *child = pool_node(pool, node->children[child_index]);
+
+  if (!string_concat(&node->edge_etiquette, child->edge_etiquette)) {
+    return false;
+  }
+
+  wrap_free(child->edge_etiquette);
+  child->edge_etiquette = node->edge_etiquette;
+  trienode_link(father, index, child);
+  pool_release(pool, node);
+  return true;
 }
 
 /**
@@ -392,11 +617,12 @@ static void trienode_drop(Trie *tree, TrieNode *node,
  * If memory error occured (string concating requires mem allocation) then
  * balancing is terminated, but Trie structure remains consistent and working.
  *
+ * @param[in, out] pool : pool of nodes of the trie.
  * @param[in, out] node : pointer to node, from which balancing process should
  * start.
  */
-static void trie_balance(TrieNode *node) {
-  if (node == NULL || node->father == NULL) {
+static void trie_balance(TriePool *pool, TrieNode *node) {
+  if (node == NULL || node->father == NO_NODE) {
     return;
   }
 
@@ -404,29 +630,30 @@ static void trie_balance(TrieNode *node) {
   size_t child_index = 11;
 
   for (size_t digit = 0; digit < MAX_NUMBER_OF_CHILDREN; digit++) {
-    if (node->children[digit].child != NULL) {
+    if (node->children[digit] != NO_NODE) {
       node_children++;
       child_index = digit;
     }
   }
 
   while (true) {
-    if (node->father == NULL) {
+    if (node->father == NO_NODE) {
       return;
     }
-    TrieNode *father = node->father;
+    TrieNode *father = pool_node(pool, node->father);
     size_t old_child_count = node_children;
     size_t old_child_index = child_index;
     size_t my_index_at_father = 11;
     node_children = 0;
 
+    // If the father is left with one child, it is the node merged below, so
+    // the node's own index has to be remembered as well.
     for (size_t digit = 0; digit < MAX_NUMBER_OF_CHILDREN; digit++) {
-      if (father->children[digit].child != NULL) {
+      if (father->children[digit] != NO_NODE) {
         node_children++;
-        if (father->children[digit].child == node) {
+        child_index = digit;
+        if (father->children[digit] == node->id) {
           my_index_at_father = digit;
-        } else {
-          child_index = digit;
         }
       }
     }
@@ -434,23 +661,16 @@ static void trie_balance(TrieNode *node) {
     if (old_child_count == 0 && node->value != NULL) {
       return;
     } else if (old_child_count == 0 && node->value == NULL) {
-      wrap_free(node);
-
-      father->children[my_index_at_father].child = NULL;
-      wrap_free(father->children[my_index_at_father].edge_etiquette);
+      father->children[my_index_at_father] = NO_NODE;
+      wrap_free(node->edge_etiquette);
+      pool_release(pool, node);
 
       node_children -= 1;
       node = father;
     }
     if (old_child_count == 1 && node->value == NULL) {
-      if (string_concat(&father->children[my_index_at_father].edge_etiquette,
-                        node->children[old_child_index].edge_etiquette)) {
-        father->children[my_index_at_father].child =
-            node->children[old_child_index].child;
-        father->children[my_index_at_father].child->father = father;
-        wrap_free(node->children[old_child_index].edge_etiquette);
-        wrap_free(node);
-
+      if (trienode_merge(pool, father, my_index_at_father, node,
+                         old_child_index)) {
         node = father;
       } else {
         // No further simplification of the tree can be done without
@@ -464,6 +684,21 @@ static void trie_balance(TrieNode *node) {
   }
 }
 
+/**
+ * @brief Balances tree from the node, unless compaction of the tree is
+ * deferred, in which case node is only counted as a candidate.
+ *
+ * @param[in, out] tree : Trie of @p node.
+ * @param[in, out] node : node to start balancing from (may be NULL).
+ */
+static void trie_rebalance(Trie *tree, TrieNode *node) {
+  if (tree->deferred) {
+    tree->candidates++;
+  } else {
+    trie_balance(tree->pool, node);
+  }
+}
+
 /**
  * @brief Performs cleaning and deletion of single node @p node.
  *
@@ -472,40 +707,75 @@ static void trie_balance(TrieNode *node) {
  * from
  * @p node father. 2) @p node has 1 child, then it connects this child to @p
  * node father and drops @p node.
+ * If compaction of the tree is deferred, node is only counted as a candidate.
  *
+ * @param[in, out] tree : Trie of @p node.
  * @param[in] node : Node to delete from the tree.
  * @param index : index of @p in father's children array.
  */
-static void trie_node_purge(TrieNode *node, size_t index) {
-  TrieNode *father = node->father;
+static void trie_node_purge(Trie *tree, TrieNode *node, size_t index) {
+  TrieNode *father = trienode_father(tree->pool, node);
+
+  if (tree->deferred) {
+    tree->candidates++;
+    return;
+  }
+
   size_t node_children = 0;
   size_t child_index = 11;
 
   for (size_t digit = 0; digit < MAX_NUMBER_OF_CHILDREN; digit++) {
-    if (node->children[digit].child != NULL) {
+    if (node->children[digit] != NO_NODE) {
       node_children++;
       child_index = digit;
     }
   }
 
   if (node_children == 0) {
-    wrap_free(node);
-
-    wrap_free(father->children[index].edge_etiquette);
-    father->children[index].edge_etiquette = NULL;
-    father->children[index].child = NULL;
-    trie_balance(father);
+    father->children[index] = NO_NODE;
+    wrap_free(node->edge_etiquette);
+    pool_release(tree->pool, node);
+    trie_balance(tree->pool, father);
   } else if (node_children == 1) {
-    string_concat(&father->children[index].edge_etiquette,
-                  node->children[child_index].edge_etiquette);
-
-    wrap_free(node->children[child_index].edge_etiquette);
+    // If labels can't be joined, node without value is kept, like in
+    // trie_balance().
+    trienode_merge(tree->pool, father, index, node, child_index);
+  }
+}
 
-    node->children[child_index].child->father = father;
-    father->children[index].child = node->children[child_index].child;
+/**
+ * @brief Makes key buffer of the trie long enough for keys of given length.
+ *
+ * @param[in, out] tree : Trie to grow buffer of.
+ * @param key_length : length of the longest key to fit.
+ * @return true : if buffer is long enough.
+ * @return false : if memory error has occured (nothing changes).
+ */
+static bool trie_reserve_buffer(Trie *tree, size_t key_length) {
+  if (tree->longest_key >= key_length) {
+    return true;
+  }
 
-    wrap_free(node);
+  char *new_buffer =
+      wrap_realloc(tree->longest_key_buffer, sizeof(char) * (key_length + 1));
+  if (new_buffer == NULL) {
+    return false;
   }
+
+  tree->longest_key_buffer = new_buffer;
+  tree->longest_key = key_length;
+  return true;
+}
+
+/**
+ * @brief Finds index of the node in children array of its father, which is
+ * given by the first digit of edge leading to it.
+ *
+ * @param[in] node : node which isn't root.
+ * @return size_t : index of @p node at its father.
+ */
+static inline size_t trienode_index(const TrieNode *node) {
+  return char_digitize(node->edge_etiquette[0]);
 }
 
 // ============================================================
@@ -515,32 +785,58 @@ Trie *init_trie(bool *memory_error,
                 void (*value_free_function)(void *value, const char *key,
                                             void *configuration),
                 void *free_wrapper_configuration) {
+  return init_trie_sibling(memory_error, value_free_function,
+                           free_wrapper_configuration, NULL);
+}
+
+Trie *init_trie_sibling(bool *memory_error,
+                        void (*value_free_function)(void *value,
+                                                    const char *key,
+                                                    void *configuration),
+                        void *free_wrapper_configuration, Trie *sibling) {
   bool error_occured = false;
 
-  TrieNode *root = init_empty_trienode(&error_occured);
+  TriePool *pool = sibling == NULL ? pool_new() : sibling->pool;
+  if (pool == NULL) {
+    *memory_error = true;
+    return NULL;
+  }
+  if (sibling != NULL) {
+    pool->references++;
+  }
+
+  TrieNode *root = init_empty_trienode(pool, false, &error_occured);
   if (error_occured) {
+    pool_drop(pool);
     *memory_error = true;
     return NULL;
   }
 
-  Trie *tree = wrap_malloc(sizeof(struct Trie));
+  Trie *tree = wrap_malloc(sizeof(struct Trie), MEMORY_TAG_TRIE_NODE);
   if (tree == NULL) {
-    wrap_free(root);
+    pool_release(pool, root);
+    pool_drop(pool);
     *memory_error = true;
     return NULL;
   }
 
-  tree->longest_key_buffer = wrap_malloc(sizeof(char) * (INIT_BUFFER_SIZE + 1));
+  tree->longest_key_buffer = wrap_malloc(sizeof(char) * (INIT_BUFFER_SIZE + 1),
+                                         MEMORY_TAG_TRIE_NODE);
   if (tree->longest_key_buffer == NULL) {
     wrap_free(tree);
-    wrap_free(root);
+    pool_release(pool, root);
+    pool_drop(pool);
     *memory_error = true;
     return NULL;
   }
 
   tree->free_wrapper_config = free_wrapper_configuration;
+  tree->deferred = false;
+  tree->candidates = 0;
+  tree->sampled = false;
   tree->longest_key = INIT_BUFFER_SIZE;
   tree->root = root;
+  tree->pool = pool;
   tree->value_free_function = value_free_function;
 
   return tree;
@@ -550,32 +846,20 @@ void trie_remove(Trie *tree, const char *key) {
   TrieNode *node = NULL;
   size_t index_k = 0;
 
-  if (search_node(tree->root, &node, key, &index_k)) {
+  if (search_node(tree->pool, tree->root, &node, key, &index_k)) {
     tree->value_free_function(node->value, key, tree->free_wrapper_config);
     node->value = NULL;
-    trie_node_purge(node, index_k);
+    trie_node_purge(tree, node, index_k);
   }
 }
 
 void trie_remove_from_ptr(Trie *tree, TrieNode *node, const char *key) {
-  TrieNode *father = node->father;
-
-  size_t child_index = 0;
-  bool found_child = false;
-  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN && !found_child;
-       index++) {
-    if (father->children[index].child == node) {
-      child_index = index;
-      found_child = true;
-    }
-  }
-
-  assert(found_child);
+  assert(node->father != NO_NODE);
 
   tree->value_free_function(node->value, key, tree->free_wrapper_config);
   node->value = NULL;
 
-  trie_node_purge(node, child_index);
+  trie_node_purge(tree, node, trienode_index(node));
 }
 
 TrieNode *trie_insert(Trie *tree, const char *key, void *value) {
@@ -583,17 +867,8 @@ TrieNode *trie_insert(Trie *tree, const char *key, void *value) {
     return NULL;
   }
 
-  size_t key_length = strlen(key);
-  if (tree->longest_key < key_length) {
-    char *new_buffer =
-        wrap_realloc(tree->longest_key_buffer, sizeof(char) * (key_length + 1));
-
-    if (new_buffer == NULL) {
-      return NULL;
-    } else {
-      tree->longest_key_buffer = new_buffer;
-      tree->longest_key = key_length;
-    }
+  if (!trie_reserve_buffer(tree, strlen(key))) {
+    return NULL;
   }
 
   TrieNode *node = NULL;
@@ -617,7 +892,8 @@ TrieNode *trie_insert(Trie *tree, const char *key, void *value) {
 
 void *trie_match_longest_prefix(const Trie *tree, const char *key,
                                 size_t *matched_length) {
-  return search_longest_prefix(tree->root, key, matched_length);
+  return search_longest_prefix(tree->pool, tree->root, key, SIZE_MAX,
+                               tree->sampled, matched_length);
   // TODO: Na wyższym poziomie trzeba będzie obsłużyć to co niżej. (Wygląda
   // jakby było obsłużone.)
   /**
@@ -625,7 +901,7 @@ void *trie_match_longest_prefix(const Trie *tree, const char *key,
 
   size_t res_len = val_len + (strlen(key) - pref_len);
 
-  char *res = wrap_malloc(sizeof(char) * (res_len + 1));
+  char *res = wrap_malloc(sizeof(char) * (res_len + 1), MEMORY_TAG_RESULTS);
   if (res == NULL) {
     *memory_error = true;
     return NULL;
@@ -636,6 +912,12 @@ void *trie_match_longest_prefix(const Trie *tree, const char *key,
   return res; */
 }
 
+void *trie_match_bounded_prefix(const Trie *tree, const char *key,
+                                size_t limit, size_t *matched_length) {
+  return search_longest_prefix(tree->pool, tree->root, key, limit,
+                               tree->sampled, matched_length);
+}
+
 void trie_remove_subtree(Trie *tree, const char *prefix) {
   size_t input_len = strlen(prefix);
   size_t actual_char = 0;
@@ -648,17 +930,18 @@ void trie_remove_subtree(Trie *tree, const char *prefix) {
 
     size_t node_ind = char_digitize(prefix[actual_char]);
 
-    char *to_check = actual->children[node_ind].edge_etiquette;
-    if (to_check == NULL) {
+    TrieNode *child = trienode_child(tree->pool, actual, node_ind);
+    if (child == NULL) {
       return;
     }
 
-    if (!string_check_prefixes(prefix, actual_char, to_check, &pref_len) &&
+    if (!string_check_prefixes(prefix, actual_char, child->edge_etiquette,
+                               &pref_len) &&
         actual_char + pref_len != input_len) {
       return;
     }
 
-    char *etiq = actual->children[node_ind].edge_etiquette;
+    char *etiq = child->edge_etiquette;
     while (*etiq != '\0') {
       tree->longest_key_buffer[buffer_free_index] = *etiq;
       buffer_free_index++;
@@ -666,83 +949,321 @@ void trie_remove_subtree(Trie *tree, const char *prefix) {
       etiq += 1;
     }
 
-    actual = actual->children[node_ind].child;
+    actual = child;
 
     father_child_index = node_ind;
     actual_char += pref_len;
   }
 
-  TrieNode *actual_father = actual->father;
+  TrieNode *actual_father = trienode_father(tree->pool, actual);
 
   trienode_drop(tree, actual, buffer_free_index);
 
   if (actual_father != NULL) {
-    actual_father->children[father_child_index].child = NULL;
-
-    wrap_free(actual_father->children[father_child_index].edge_etiquette);
-    actual_father->children[father_child_index].edge_etiquette = NULL;
+    actual_father->children[father_child_index] = NO_NODE;
   }
 
-  trie_balance(actual_father);
+  trie_rebalance(tree, actual_father);
 }
 
-void trie_drop(Trie *tree) {
-  if (tree == NULL) {
-    return;
+/**
+ * @brief Frees nodes and edge labels of the subtree, without values.
+ *
+ * @param[in, out] pool : pool of the subtree.
+ * @param[in] node : root of freed subtree.
+ */
+static void trienode_free_layout(TriePool *pool, TrieNode *node) {
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    TrieNode *child = trienode_child(pool, node, index);
+    if (child != NULL) {
+      trienode_free_layout(pool, child);
+    }
   }
 
-  trienode_drop(tree, tree->root, 0);
-
-  wrap_free(tree->longest_key_buffer);
-  wrap_free(tree);
+  wrap_free(node->edge_etiquette);
+  pool_release(pool, node);
 }
 
-void *trie_locate_node(Trie *tree, const char *key, void *value,
-                       TrieNode **located_node) {
-  TrieNode *search_result;
+/**
+ * @brief Copies subtree of the node: the node first, with label of edge
+ * leading to it, then subtrees of its children in key order.
+ *
+ * Copy within the same pool is taken from the end of the pool, so it isn't
+ * scattered over freed nodes. Copy to other pool reuses its freed nodes.
+ *
+ * @param[in, out] to : pool to allocate the copy from.
+ * @param[in] from : pool of @p node.
+ * @param[in] node : root of copied subtree.
+ * @return TrieNode* : copy sharing values with @p node (NULL if memory error
+ * has occured).
+ */
+static TrieNode *trienode_relayout(TriePool *to, const TriePool *from,
+                                   const TrieNode *node) {
+  bool memory_error = false;
+  TrieNode *copy = init_empty_trienode(to, to == from, &memory_error);
+  if (memory_error) {
+    return NULL;
+  }
 
-  if (trie_check_add_node(tree, key, &search_result)) {
-    if (search_result->value == NULL) {
-      search_result->value = value;
-      *located_node = search_result;
-      return value;
-    } else {
-      *located_node = search_result;
-      return search_result->value;
+  copy->value = node->value;
+  copy->heat = node->heat;
+
+  if (node->edge_etiquette != NULL) {
+    copy->edge_etiquette = string_clone(node->edge_etiquette);
+    memory_error = copy->edge_etiquette == NULL;
+  }
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN && !memory_error;
+       index++) {
+    const TrieNode *child = trienode_child(from, node, index);
+    if (child != NULL) {
+      TrieNode *child_copy = trienode_relayout(to, from, child);
+      if (child_copy == NULL) {
+        memory_error = true;
+      } else {
+        trienode_link(copy, index, child_copy);
+      }
     }
-  } else {
+  }
+
+  if (memory_error) {
+    trienode_free_layout(to, copy);
     return NULL;
   }
+
+  return copy;
 }
 
 /**
- * @brief Frees every value (strings) from given dynamic array.
+ * @brief Exchanges subtrees of tries with different pools by copying each of
+ * them to the pool of the other trie.
  *
- * @param array : dynamic array to clean.
+ * @param[in, out] tree : first Trie.
+ * @param[in, out] node : node of @p tree, which isn't root.
+ * @param[in, out] other : second Trie.
+ * @param[in, out] other_node : node of @p other of the same key, which isn't
+ * root.
+ * @return true : if subtrees were exchanged.
+ * @return false : if memory error has occured (nothing changes).
  */
-static void darray_string_drop(DynamicArray *array) {
-  size_t array_size = darray_size(array);
-  char **array_chars = (char **)darray_convert(array);
+static bool trie_copy_subtrees(Trie *tree, TrieNode *node, Trie *other,
+                               TrieNode *other_node) {
+  TrieNode *copy = trienode_relayout(tree->pool, other->pool, other_node);
+  if (copy == NULL) {
+    return false;
+  }
 
-  for (size_t ind = 0; ind < array_size; ind++) {
-    wrap_free(array_chars[ind]);
+  TrieNode *other_copy = trienode_relayout(other->pool, tree->pool, node);
+  if (other_copy == NULL) {
+    trienode_free_layout(tree->pool, copy);
+    return false;
   }
 
-  wrap_free(array_chars);
+  TrieNode *father = pool_node(tree->pool, node->father);
+  TrieNode *other_father = pool_node(other->pool, other_node->father);
+  size_t index = trienode_index(node);
+  size_t other_index = trienode_index(other_node);
+
+  trienode_free_layout(tree->pool, node);
+  trienode_free_layout(other->pool, other_node);
+
+  // Copies take places of each other, so they exchange labels too.
+  char *etiquette = copy->edge_etiquette;
+  copy->edge_etiquette = other_copy->edge_etiquette;
+  other_copy->edge_etiquette = etiquette;
+
+  trienode_link(father, index, copy);
+  trienode_link(other_father, other_index, other_copy);
+
+  trie_rebalance(other, other_copy);
+  trie_rebalance(tree, copy);
+  return true;
 }
 
-#include "double_linked_list.h"
-// TODO: MEMORY ERROR MANAGEMENT. (DONE - TESTING)
-DynamicArray *trie_traverse_down(const Trie *tree, const char *key) {
-  if (key == NULL || tree == NULL) {
-    return NULL;
+bool trie_swap_subtree(Trie *tree, Trie *other, const char *prefix) {
+  size_t longest_key = tree->longest_key > other->longest_key
+                           ? tree->longest_key
+                           : other->longest_key;
+  if (!trie_reserve_buffer(tree, longest_key) ||
+      !trie_reserve_buffer(other, longest_key)) {
+    return false;
   }
 
-  bool memory_error = false;
-
-  DynamicArray *array = init_darray(&memory_error);
-  if (memory_error) {
-    return NULL;
+  TrieNode *node = NULL;
+  TrieNode *other_node = NULL;
+  if (!trie_check_add_node(tree, prefix, &node)) {
+    return false;
+  }
+  if (!trie_check_add_node(other, prefix, &other_node)) {
+    trie_rebalance(tree, node);
+    return false;
+  }
+
+  if (tree->pool != other->pool) {
+    if (!trie_copy_subtrees(tree, node, other, other_node)) {
+      trie_rebalance(other, other_node);
+      trie_rebalance(tree, node);
+      return false;
+    }
+    return true;
+  }
+
+  // Edges leading to both nodes spell the same key, so nodes exchange places
+  // and labels.
+  TrieNode *father = pool_node(tree->pool, node->father);
+  TrieNode *other_father = pool_node(other->pool, other_node->father);
+  size_t index = trienode_index(node);
+  size_t other_index = trienode_index(other_node);
+
+  char *etiquette = node->edge_etiquette;
+  node->edge_etiquette = other_node->edge_etiquette;
+  other_node->edge_etiquette = etiquette;
+
+  trienode_link(father, index, other_node);
+  trienode_link(other_father, other_index, node);
+
+  trie_rebalance(other, node);
+  trie_rebalance(tree, other_node);
+  return true;
+}
+
+void trie_set_free_function(Trie *tree,
+                            void (*value_free_function)(void *value,
+                                                        const char *key,
+                                                        void *configuration),
+                            void *free_wrapper_configuration) {
+  tree->value_free_function = value_free_function;
+  tree->free_wrapper_config = free_wrapper_configuration;
+}
+
+size_t trie_drop_step(Trie *tree, size_t limit) {
+  size_t dropped = 0;
+
+  while (true) {
+    TrieNode *node = tree->root;
+    size_t key_length = 0;
+
+    // Leftmost leaf is found, so key of every dropped value is at hand.
+    while (true) {
+      size_t index = 0;
+      while (index < MAX_NUMBER_OF_CHILDREN &&
+             node->children[index] == NO_NODE) {
+        index++;
+      }
+
+      if (index == MAX_NUMBER_OF_CHILDREN) {
+        break;
+      }
+
+      node = pool_node(tree->pool, node->children[index]);
+      size_t etiq_size = strlen(node->edge_etiquette);
+
+      memcpy(tree->longest_key_buffer + key_length, node->edge_etiquette,
+             etiq_size);
+      key_length += etiq_size;
+    }
+
+    if (node->value != NULL && dropped == limit) {
+      return dropped;
+    }
+
+    if (node->value != NULL) {
+      tree->longest_key_buffer[key_length] = '\0';
+      tree->value_free_function(node->value, tree->longest_key_buffer,
+                                tree->free_wrapper_config);
+      node->value = NULL;
+      dropped++;
+    }
+
+    if (node == tree->root) {
+      return dropped;
+    }
+
+    TrieNode *father = pool_node(tree->pool, node->father);
+    father->children[trienode_index(node)] = NO_NODE;
+    wrap_free(node->edge_etiquette);
+    pool_release(tree->pool, node);
+  }
+}
+
+void trie_drop(Trie *tree) {
+  if (tree == NULL) {
+    return;
+  }
+
+  trienode_drop(tree, tree->root, 0);
+  pool_drop(tree->pool);
+
+  wrap_free(tree->longest_key_buffer);
+  wrap_free(tree);
+}
+
+bool trie_is_empty(const Trie *tree) {
+  if (tree->root->value != NULL) {
+    return false;
+  }
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    if (tree->root->children[index] != NO_NODE) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void *trie_locate_node(Trie *tree, const char *key, void *value,
+                       TrieNode **located_node) {
+  TrieNode *search_result;
+
+  if (!trie_reserve_buffer(tree, strlen(key))) {
+    return NULL;
+  }
+
+  if (trie_check_add_node(tree, key, &search_result)) {
+    if (search_result->value == NULL) {
+      search_result->value = value;
+      *located_node = search_result;
+      return value;
+    } else {
+      *located_node = search_result;
+      return search_result->value;
+    }
+  } else {
+    return NULL;
+  }
+}
+
+/**
+ * @brief Frees every value (strings) from given dynamic array.
+ *
+ * @param array : dynamic array to clean.
+ */
+static void darray_string_drop(DynamicArray *array) {
+  size_t array_size = darray_size(array);
+  char **array_chars = (char **)darray_convert(array);
+
+  for (size_t ind = 0; ind < array_size; ind++) {
+    wrap_free(array_chars[ind]);
+  }
+
+  wrap_free(array_chars);
+}
+
+#include "double_linked_list.h"
+// TODO: MEMORY ERROR MANAGEMENT. (DONE - TESTING)
+DynamicArray *trie_traverse_down(const Trie *tree, const char *key,
+                                 TrieTraverseFilter filter,
+                                 void *configuration) {
+  if (key == NULL || tree == NULL) {
+    return NULL;
+  }
+
+  bool memory_error = false;
+
+  DynamicArray *array = init_darray(&memory_error);
+  if (memory_error) {
+    return NULL;
   }
 
   size_t actual_char = 0;
@@ -759,10 +1280,14 @@ DynamicArray *trie_traverse_down(const Trie *tree, const char *key) {
 
       while (listiterator_has_next(iterator)) {
         const char *value = listiterator_next(iterator);
+        if (filter != NULL && !filter(value, key, actual_char, configuration)) {
+          continue;
+        }
 
         size_t val_len = strlen(value);
         char *element =
-            wrap_malloc(sizeof(char) * (key_len - actual_char + val_len + 1));
+            wrap_malloc(sizeof(char) * (key_len - actual_char + val_len + 1),
+                        MEMORY_TAG_RESULTS);
         if (element == NULL) {
           listiterator_drop(iterator);
           darray_string_drop(array);
@@ -784,12 +1309,13 @@ DynamicArray *trie_traverse_down(const Trie *tree, const char *key) {
 
     size_t digit = char_digitize(key[actual_char]);
     size_t pref_len = 0;
-    const char *etiq = node->children[digit].edge_etiquette;
+    TrieNode *child = trienode_child(tree->pool, node, digit);
 
-    if (etiq == NULL) {
+    if (child == NULL) {
       return array;
-    } else if (string_check_prefixes(key, actual_char, etiq, &pref_len)) {
-      node = node->children[digit].child;
+    } else if (string_check_prefixes(key, actual_char, child->edge_etiquette,
+                                     &pref_len)) {
+      node = child;
       actual_char += pref_len;
     } else {
       return array;
@@ -799,4 +1325,829 @@ DynamicArray *trie_traverse_down(const Trie *tree, const char *key) {
   return array;
 }
 
-void *trienode_get_value(TrieNode *node) { return node->value; }
\ No newline at end of file
+void *trienode_get_value(TrieNode *node) { return node->value; }
+
+/**
+ * @brief Returns histogram bucket of @p value (values bigger than last bucket
+ * are saved in the last bucket).
+ *
+ * @param value : value to find bucket of.
+ * @return size_t : index of the bucket.
+ */
+static inline size_t stats_bucket(size_t value) {
+  return value < TRIE_STATS_BUCKETS ? value : TRIE_STATS_BUCKETS - 1;
+}
+
+/**
+ * @brief Checks if two blocks lie within a page from each other.
+ *
+ * @param[in] first : first block.
+ * @param[in] second : second block.
+ * @return true : if blocks are close.
+ * @return false : if blocks are scattered.
+ */
+static inline bool layout_close(const void *first, const void *second) {
+  uintptr_t from = (uintptr_t)first;
+  uintptr_t to = (uintptr_t)second;
+
+  return (from < to ? to - from : from - to) < LAYOUT_PAGE_SIZE;
+}
+
+/**
+ * @brief Recursively gathers statistics of subtree of @p node.
+ *
+ * @param[in] pool : pool of nodes of the trie.
+ * @param[in] node : root of subtree to describe.
+ * @param level : level of @p node.
+ * @param key_length : length of @p node 's key.
+ * @param[out] stats : statistics to update.
+ * @param[in] value_visitor : function called on every stored value.
+ * @param[in, out] configuration : pointer passed to @p value_visitor.
+ * @param[in, out] previous : node visited before @p node (NULL for the
+ * first one).
+ */
+static void trienode_statistics(const TriePool *pool, const TrieNode *node,
+                                size_t level, size_t key_length,
+                                TrieStatistics *stats,
+                                void (*value_visitor)(const void *value,
+                                                      void *configuration),
+                                void *configuration,
+                                const TrieNode **previous) {
+  size_t children = 0;
+
+  if (*previous != NULL &&
+      !layout_close(*previous, node)) {
+    stats->scattered_nodes++;
+  }
+  *previous = node;
+
+  stats->nodes++;
+  stats->depth_histogram[stats_bucket(level)]++;
+
+  if (node->value != NULL) {
+    stats->values++;
+    stats->values_per_depth[stats_bucket(level)]++;
+    if (key_length > stats->deepest_key) {
+      stats->deepest_key = key_length;
+    }
+
+    if (value_visitor != NULL) {
+      value_visitor(node->value, configuration);
+    }
+  }
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    const TrieNode *child = trienode_child(pool, node, index);
+    if (child != NULL) {
+      size_t etiq_size = strlen(child->edge_etiquette);
+
+      children++;
+      stats->label_length_histogram[stats_bucket(etiq_size)]++;
+      if (!layout_close(child, child->edge_etiquette)) {
+        stats->scattered_labels++;
+      }
+
+      trienode_statistics(pool, child, level + 1, key_length + etiq_size,
+                          stats, value_visitor, configuration, previous);
+    }
+  }
+
+  stats->fanout_histogram[children]++;
+}
+
+void trie_statistics(const Trie *tree, TrieStatistics *stats,
+                     void (*value_visitor)(const void *value,
+                                           void *configuration),
+                     void *configuration) {
+  memset(stats, 0, sizeof(struct TrieStatistics));
+  stats->longest_key = tree->longest_key;
+
+  const TrieNode *previous = NULL;
+  trienode_statistics(tree->pool, tree->root, 0, 0, stats, value_visitor,
+                      configuration, &previous);
+}
+
+/**
+ * @brief State of iteration over the trie.
+ */
+struct TrieIteration {
+  const TriePool *pool; ///< Pool of nodes of the trie.
+  const char *after;    ///< Key to start after.
+  size_t after_length;  ///< Length of @p after.
+  size_t limit;         ///< Maximal number of visited values.
+  size_t visited;       ///< Number of visited values.
+  char *key;            ///< Buffer with key of visited node.
+  void (*visitor)(const char *key, void *value,
+                  void *configuration); ///< Function called on values.
+  void *configuration;                  ///< Pointer passed to visitor.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct TrieIteration TrieIteration;
+
+/**
+ * @brief Compares edge leading to a child with the rest of starting key.
+ *
+ * @param[in] etiq : etiquette of the edge.
+ * @param[in] rest : part of starting key below the father.
+ * @return int : negative if all keys of the subtree are smaller than the
+ * starting key, zero if subtree key is prefix of starting key (or equals it)
+ * and positive if all keys of the subtree are bigger.
+ */
+static int compare_edge(const char *etiq, const char *rest) {
+  size_t index = 0;
+
+  while (etiq[index] != '\0' && etiq[index] == rest[index]) {
+    index++;
+  }
+
+  if (etiq[index] == '\0') {
+    return 0;
+  } else if (rest[index] == '\0') {
+    return 1;
+  }
+
+  return char_digitize(etiq[index]) > char_digitize(rest[index]) ? 1 : -1;
+}
+
+/**
+ * @brief Recursively visits values of subtree in key order.
+ *
+ * @param[in] node : root of visited subtree.
+ * @param key_length : length of key of @p node.
+ * @param bounded : true if key of @p node is prefix of starting key (only
+ * bigger keys are visited then).
+ * @param[in, out] state : state of iteration.
+ */
+static void trienode_iterate(const TrieNode *node, size_t key_length,
+                             bool bounded, TrieIteration *state) {
+  if (!bounded && node->value != NULL) {
+    state->key[key_length] = '\0';
+    state->visitor(state->key, node->value, state->configuration);
+    state->visited++;
+  }
+
+  size_t first_child = 0;
+  if (bounded && key_length == state->after_length) {
+    bounded = false;
+  } else if (bounded) {
+    first_child = char_digitize(state->after[key_length]);
+  }
+
+  for (size_t index = first_child;
+       index < MAX_NUMBER_OF_CHILDREN && state->visited < state->limit;
+       index++) {
+    const TrieNode *child = trienode_child(state->pool, node, index);
+    if (child == NULL) {
+      continue;
+    }
+
+    bool child_bounded = false;
+    if (bounded && index == first_child) {
+      int comparison =
+          compare_edge(child->edge_etiquette, state->after + key_length);
+
+      if (comparison < 0) {
+        continue;
+      }
+      child_bounded = comparison == 0;
+    }
+
+    size_t etiq_size = strlen(child->edge_etiquette);
+    memcpy(state->key + key_length, child->edge_etiquette, etiq_size);
+
+    trienode_iterate(child, key_length + etiq_size, child_bounded, state);
+  }
+}
+
+size_t trie_iterate(const Trie *tree, const char *after, size_t limit,
+                    void (*visitor)(const char *key, void *value,
+                                    void *configuration),
+                    void *configuration, bool *memory_error) {
+  TrieIteration state = {tree->pool, after,   strlen(after), limit, 0,
+                         NULL,       visitor, configuration};
+
+  if (limit == 0) {
+    return 0;
+  }
+
+  state.key = wrap_malloc(tree->longest_key + 1, MEMORY_TAG_TRIE_NODE);
+  if (state.key == NULL) {
+    *memory_error = true;
+    return 0;
+  }
+
+  trienode_iterate(tree->root, 0, state.after_length > 0, &state);
+
+  wrap_free(state.key);
+  return state.visited;
+}
+
+size_t trie_iterate_prefix(const Trie *tree, const char *prefix,
+                           void (*visitor)(const char *key, void *value,
+                                           void *configuration),
+                           void *configuration, bool *memory_error) {
+  TrieIteration state = {tree->pool, prefix,  0, SIZE_MAX, 0,
+                         NULL,       visitor, configuration};
+
+  state.key = wrap_malloc(tree->longest_key + 1, MEMORY_TAG_TRIE_NODE);
+  if (state.key == NULL) {
+    *memory_error = true;
+    return 0;
+  }
+
+  const TrieNode *node = tree->root;
+  size_t key_length = 0;
+  size_t prefix_length = strlen(prefix);
+
+  // Prefix can end inside an edge, then whole subtree below it is visited.
+  while (node != NULL && key_length < prefix_length) {
+    const TrieNode *child = trienode_child(
+        tree->pool, node, char_digitize(prefix[key_length]));
+    if (child == NULL) {
+      node = NULL;
+      break;
+    }
+
+    size_t etiq_size = strlen(child->edge_etiquette);
+    size_t common = 0;
+    while (common < etiq_size && key_length + common < prefix_length &&
+           child->edge_etiquette[common] == prefix[key_length + common]) {
+      common++;
+    }
+
+    if (common < etiq_size && key_length + common < prefix_length) {
+      node = NULL;
+      break;
+    }
+
+    memcpy(state.key + key_length, child->edge_etiquette, etiq_size);
+    key_length += etiq_size;
+    node = child;
+  }
+
+  if (node != NULL) {
+    trienode_iterate(node, key_length, false, &state);
+  }
+
+  wrap_free(state.key);
+  return state.visited;
+}
+
+/**
+ * @brief State of trie_remove_subtrees().
+ */
+struct SubtreesRemoval {
+  Trie *tree;                  ///< Trie to remove subtrees from.
+  Trie *detached;              ///< Trie to move subtrees to (or NULL).
+  const char *const *prefixes; ///< Sorted keys of removed subtrees.
+};
+
+/**
+ * @brief Moves subtree to the same key of detached trie or drops it, if there
+ * is no detached trie sharing pool with removed trie or memory error has
+ * occured.
+ *
+ * @param[in, out] removal : state of removal.
+ * @param[in] node : root of removed subtree, already unlinked from its father.
+ * @param key_length : length of key of @p node, which is stored in key buffer
+ * of removed trie.
+ */
+static void trienode_detach(struct SubtreesRemoval *removal, TrieNode *node,
+                            size_t key_length) {
+  Trie *tree = removal->tree;
+  Trie *detached = removal->detached;
+  TrieNode *slot = NULL;
+
+  tree->longest_key_buffer[key_length] = '\0';
+  if (detached != NULL && detached->pool == tree->pool &&
+      trie_check_add_node(detached, tree->longest_key_buffer, &slot)) {
+    bool empty = slot->value == NULL;
+    for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+      empty = empty && slot->children[index] == NO_NODE;
+    }
+
+    if (empty && slot->father != NO_NODE) {
+      // Node takes place and label of the slot.
+      char *etiquette = slot->edge_etiquette;
+      slot->edge_etiquette = node->edge_etiquette;
+      node->edge_etiquette = etiquette;
+
+      trienode_link(pool_node(tree->pool, slot->father), trienode_index(node),
+                    node);
+      trie_drop_one_node(slot, detached);
+      return;
+    }
+  }
+
+  trienode_drop(tree, node, key_length);
+}
+
+/**
+ * @brief Merges node without value and with at most one child into its
+ * father, like trie_balance(), but without going up.
+ *
+ * @param[in, out] pool : pool of nodes of the trie.
+ * @param[in, out] father : father of compacted node.
+ * @param index : index of compacted node at @p father.
+ * @return true : if node was freed.
+ * @return false : if node is needed or memory error has occured.
+ */
+static bool trienode_compact(TriePool *pool, TrieNode *father, size_t index) {
+  TrieNode *node = pool_node(pool, father->children[index]);
+  size_t children = 0;
+  size_t child_index = 0;
+
+  for (size_t digit = 0; digit < MAX_NUMBER_OF_CHILDREN; digit++) {
+    if (node->children[digit] != NO_NODE) {
+      children++;
+      child_index = digit;
+    }
+  }
+
+  if (node->value != NULL || children > 1) {
+    return false;
+  }
+
+  if (children == 0) {
+    father->children[index] = NO_NODE;
+    wrap_free(node->edge_etiquette);
+    pool_release(pool, node);
+    return true;
+  }
+
+  return trienode_merge(pool, father, index, node, child_index);
+}
+
+/**
+ * @brief Removes subtrees below the node in one walk.
+ *
+ * @param[in, out] removal : state of removal.
+ * @param[in, out] node : visited node.
+ * @param key_length : length of key of @p node, which is stored in key buffer
+ * of removed trie.
+ * @param begin : index of the first prefix longer than key of @p node, which
+ * it is prefix of.
+ * @param end : index after the last such prefix.
+ */
+static void trienode_remove_subtrees(struct SubtreesRemoval *removal,
+                                     TrieNode *node, size_t key_length,
+                                     size_t begin, size_t end) {
+  char *buffer = removal->tree->longest_key_buffer;
+  TriePool *pool = removal->tree->pool;
+
+  while (begin < end) {
+    const char *rest = removal->prefixes[begin] + key_length;
+    size_t digit = char_digitize(*rest);
+    TrieNode *child = trienode_child(pool, node, digit);
+    size_t range_end = begin + 1;
+
+    while (range_end < end &&
+           removal->prefixes[range_end][key_length] == *rest) {
+      range_end++;
+    }
+
+    if (child == NULL) {
+      begin = range_end;
+      continue;
+    }
+
+    size_t etiq_size = strlen(child->edge_etiquette);
+    memcpy(buffer + key_length, child->edge_etiquette, etiq_size);
+
+    // Prefixes aren't prefixes of each other, so at most one covers whole
+    // child, and if some covers it, none continues below it.
+    size_t below = range_end;
+    size_t below_end = range_end;
+    bool covered = false;
+
+    for (size_t index = begin; index < range_end && !covered; index++) {
+      const char *prefix_rest = removal->prefixes[index] + key_length;
+      size_t common = 0;
+      while (common < etiq_size &&
+             prefix_rest[common] == child->edge_etiquette[common]) {
+        common++;
+      }
+
+      if (prefix_rest[common] == '\0') {
+        covered = true;
+      } else if (common == etiq_size) {
+        below = below < range_end ? below : index;
+        below_end = index + 1;
+      }
+    }
+
+    if (covered) {
+      node->children[digit] = NO_NODE;
+      trienode_detach(removal, child, key_length + etiq_size);
+    } else if (below < below_end) {
+      trienode_remove_subtrees(removal, child, key_length + etiq_size, below,
+                               below_end);
+      if (removal->tree->deferred) {
+        removal->tree->candidates++;
+      } else {
+        trienode_compact(pool, node, digit);
+      }
+    }
+
+    begin = range_end;
+  }
+}
+
+void trie_remove_subtrees(Trie *tree, Trie *detached,
+                          const char *const *prefixes, size_t count) {
+  struct SubtreesRemoval removal = {tree, detached, prefixes};
+
+  if (detached != NULL && !trie_reserve_buffer(detached, tree->longest_key)) {
+    removal.detached = NULL;
+  }
+
+  trienode_remove_subtrees(&removal, tree->root, 0, 0, count);
+}
+
+TrieNode *trie_add_node(Trie *tree, const char *key) {
+  TrieNode *node = NULL;
+
+  if (!trie_reserve_buffer(tree, strlen(key)) ||
+      !trie_check_add_node(tree, key, &node)) {
+    return NULL;
+  }
+
+  return node;
+}
+
+void trienode_set_value(TrieNode *node, void *value) { node->value = value; }
+
+bool trie_reserve_keys(Trie *tree, const Trie *other) {
+  return trie_reserve_buffer(tree, other->longest_key);
+}
+
+TrieNode *trie_cut_subtree(Trie *tree, const char *prefix) {
+  TrieNode *node = trie_add_node(tree, prefix);
+  if (node == NULL) {
+    return NULL;
+  }
+
+  pool_node(tree->pool, node->father)->children[trienode_index(node)] =
+      NO_NODE;
+  return node;
+}
+
+void trie_restore_subtree(Trie *tree, TrieNode *node) {
+  TrieNode *father = pool_node(tree->pool, node->father);
+  size_t index = trienode_index(node);
+  TrieNode *slot = trienode_child(tree->pool, father, index);
+
+  if (slot != NULL) {
+    trienode_drop(tree, slot, 0);
+  }
+
+  trienode_link(father, index, node);
+}
+
+void trie_graft_subtree(Trie *tree, TrieNode *slot, TrieNode *node) {
+  TrieNode *father = pool_node(tree->pool, slot->father);
+
+  // Label of cut subtree may be split differently in the other trie.
+  char *etiquette = slot->edge_etiquette;
+  slot->edge_etiquette = node->edge_etiquette;
+  node->edge_etiquette = etiquette;
+
+  trienode_link(father, trienode_index(node), node);
+  wrap_free(slot->edge_etiquette);
+  pool_release(tree->pool, slot);
+}
+
+void trie_compact_path(Trie *tree, const char *key) {
+  TrieNode *node = tree->root;
+  size_t key_length = 0;
+
+  if (tree->deferred) {
+    tree->candidates++;
+    return;
+  }
+
+  while (key[key_length] != '\0') {
+    TrieNode *child =
+        trienode_child(tree->pool, node, char_digitize(key[key_length]));
+    if (child == NULL) {
+      break;
+    }
+
+    size_t etiq_size = strlen(child->edge_etiquette);
+    if (strncmp(child->edge_etiquette, key + key_length, etiq_size) != 0) {
+      break;
+    }
+
+    node = child;
+    key_length += etiq_size;
+  }
+
+  while (node->father != NO_NODE) {
+    TrieNode *father = pool_node(tree->pool, node->father);
+    if (!trienode_compact(tree->pool, father, trienode_index(node))) {
+      return;
+    }
+    node = father;
+  }
+}
+
+void trie_defer_compaction(Trie *tree, bool deferred) {
+  tree->deferred = deferred;
+}
+
+size_t trie_compaction_candidates(const Trie *tree) {
+  return tree->candidates;
+}
+
+/**
+ * @brief Compacts subtree of the node, children first.
+ *
+ * @param[in, out] pool : pool of nodes of the trie.
+ * @param[in, out] node : root of compacted subtree (it isn't compacted
+ * itself).
+ * @return size_t : number of freed nodes.
+ */
+static size_t trienode_compact_subtree(TriePool *pool, TrieNode *node) {
+  size_t freed = 0;
+
+  for (size_t digit = 0; digit < MAX_NUMBER_OF_CHILDREN; digit++) {
+    TrieNode *child = trienode_child(pool, node, digit);
+    if (child != NULL) {
+      freed += trienode_compact_subtree(pool, child);
+      freed += trienode_compact(pool, node, digit) ? 1 : 0;
+    }
+  }
+
+  return freed;
+}
+
+size_t trie_compact(Trie *tree) {
+  tree->candidates = 0;
+  return trienode_compact_subtree(tree->pool, tree->root);
+}
+
+/**
+ * @brief Reports new nodes of all values of the subtree.
+ *
+ * @param[in] pool : pool of nodes of the trie.
+ * @param[in] node : root of the subtree.
+ * @param[in] moved : function called with every value and its node.
+ * @param[in, out] configuration : pointer passed to @p moved.
+ */
+static void trienode_report_moved(const TriePool *pool, TrieNode *node,
+                                  void (*moved)(void *value, TrieNode *node,
+                                                void *configuration),
+                                  void *configuration) {
+  if (node->value != NULL) {
+    moved(node->value, node, configuration);
+  }
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    TrieNode *child = trienode_child(pool, node, index);
+    if (child != NULL) {
+      trienode_report_moved(pool, child, moved, configuration);
+    }
+  }
+}
+
+/**
+ * @brief Chooses pool for new layout of the trie: a new one, if no other trie
+ * uses pool of the trie, so the old pool is freed as a whole afterwards.
+ *
+ * @param[in] tree : Trie to lay out.
+ * @return TriePool* : pool for the copy (NULL if memory error has occured).
+ */
+static TriePool *trie_layout_pool(const Trie *tree) {
+  return tree->pool->references == 1 ? pool_new() : tree->pool;
+}
+
+/**
+ * @brief Replaces nodes of the trie with their copy.
+ *
+ * @param[in, out] tree : laid out Trie.
+ * @param[in, out] pool : pool of @p root.
+ * @param[in] root : copy of the root.
+ * @param[in] moved : function called with every value and its new node (may
+ * be NULL).
+ * @param[in, out] configuration : pointer passed to @p moved.
+ */
+static void trie_replace_layout(Trie *tree, TriePool *pool, TrieNode *root,
+                                void (*moved)(void *value, TrieNode *node,
+                                              void *configuration),
+                                void *configuration) {
+  trienode_free_layout(tree->pool, tree->root);
+  if (pool != tree->pool) {
+    pool_drop(tree->pool);
+    tree->pool = pool;
+  }
+  tree->root = root;
+
+  if (moved != NULL) {
+    trienode_report_moved(pool, root, moved, configuration);
+  }
+}
+
+bool trie_relayout(Trie *tree,
+                   void (*moved)(void *value, TrieNode *node,
+                                 void *configuration),
+                   void *configuration) {
+  TriePool *pool = trie_layout_pool(tree);
+  if (pool == NULL) {
+    return false;
+  }
+
+  TrieNode *root = trienode_relayout(pool, tree->pool, tree->root);
+  if (root == NULL) {
+    if (pool != tree->pool) {
+      pool_drop(pool);
+    }
+    return false;
+  }
+
+  trie_replace_layout(tree, pool, root, moved, configuration);
+  return true;
+}
+
+void trie_sample_visits(Trie *tree, bool sampled) {
+  tree->sampled = sampled;
+}
+
+/**
+ * @brief Counts nodes of the subtree (without its root) per bucket of heat.
+ * Bucket 0 holds nodes never entered, bucket b > 0 nodes with heat in
+ * [2^(b-1), 2^b).
+ *
+ * @param[in] pool : pool of nodes of the trie.
+ * @param[in] node : root of the subtree.
+ * @param[in, out] histogram : array of TRIE_HEAT_BUCKETS counters.
+ */
+static void trienode_heat_histogram(const TriePool *pool, const TrieNode *node,
+                                    size_t *histogram) {
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    const TrieNode *child = trienode_child(pool, node, index);
+    if (child != NULL) {
+      size_t bucket = 0;
+      for (uint16_t heat = child->heat; heat > 0; heat >>= 1) {
+        bucket++;
+      }
+
+      histogram[bucket]++;
+      trienode_heat_histogram(pool, child, histogram);
+    }
+  }
+}
+
+/**
+ * @brief Copies the node with label of edge leading to it, then hot subtrees
+ * of its children in key order. Child is hot if it was entered at least
+ * @p threshold times and @p budget isn't used up, so hot nodes form paths
+ * from the root. Cold children are left out.
+ *
+ * @param[in, out] to : pool to allocate the copy from.
+ * @param[in] from : pool of @p node.
+ * @param[in] node : root of copied subtree.
+ * @param threshold : lowest heat of hot nodes.
+ * @param[in, out] budget : number of hot nodes which can still be copied.
+ * @return TrieNode* : copy sharing values with @p node (NULL if memory error
+ * has occured).
+ */
+static TrieNode *trienode_relayout_hot(TriePool *to, const TriePool *from,
+                                       const TrieNode *node, uint16_t threshold,
+                                       size_t *budget) {
+  bool memory_error = false;
+  TrieNode *copy = init_empty_trienode(to, to == from, &memory_error);
+  if (memory_error) {
+    return NULL;
+  }
+
+  copy->value = node->value;
+  copy->heat = node->heat;
+
+  if (node->edge_etiquette != NULL) {
+    copy->edge_etiquette = string_clone(node->edge_etiquette);
+    memory_error = copy->edge_etiquette == NULL;
+  }
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN && !memory_error;
+       index++) {
+    const TrieNode *child = trienode_child(from, node, index);
+    if (child != NULL && child->heat >= threshold && *budget > 0) {
+      (*budget)--;
+      TrieNode *hot =
+          trienode_relayout_hot(to, from, child, threshold, budget);
+      if (hot == NULL) {
+        memory_error = true;
+      } else {
+        trienode_link(copy, index, hot);
+      }
+    }
+  }
+
+  if (memory_error) {
+    trienode_free_layout(to, copy);
+    return NULL;
+  }
+
+  return copy;
+}
+
+/**
+ * @brief Copies cold subtrees left out by trienode_relayout_hot(), in key
+ * order.
+ *
+ * @param[in, out] to : pool of @p copy.
+ * @param[in] from : pool of @p node.
+ * @param[in] node : root of the original subtree.
+ * @param[in, out] copy : hot copy of @p node.
+ * @return true : if all cold subtrees were copied.
+ * @return false : if memory error has occured (copied subtrees stay in
+ * @p copy).
+ */
+static bool trienode_relayout_cold(TriePool *to, const TriePool *from,
+                                   const TrieNode *node, TrieNode *copy) {
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    const TrieNode *child = trienode_child(from, node, index);
+    if (child == NULL) {
+      continue;
+    }
+
+    TrieNode *hot = trienode_child(to, copy, index);
+    if (hot != NULL) {
+      if (!trienode_relayout_cold(to, from, child, hot)) {
+        return false;
+      }
+    } else {
+      TrieNode *cold = trienode_relayout(to, from, child);
+      if (cold == NULL) {
+        return false;
+      }
+
+      trienode_link(copy, index, cold);
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Halves heat of all nodes of the subtree, so old searches count less
+ * than recent ones.
+ *
+ * @param[in] pool : pool of nodes of the trie.
+ * @param[in, out] node : root of the subtree.
+ */
+static void trienode_cool(const TriePool *pool, TrieNode *node) {
+  node->heat /= 2;
+
+  for (size_t index = 0; index < MAX_NUMBER_OF_CHILDREN; index++) {
+    TrieNode *child = trienode_child(pool, node, index);
+    if (child != NULL) {
+      trienode_cool(pool, child);
+    }
+  }
+}
+
+bool trie_relayout_hot(Trie *tree, size_t hot_nodes,
+                       void (*moved)(void *value, TrieNode *node,
+                                     void *configuration),
+                       void *configuration) {
+  size_t histogram[TRIE_HEAT_BUCKETS] = {0};
+  trienode_heat_histogram(tree->pool, tree->root, histogram);
+
+  // Lowest power of two, such that nodes at least that hot fit in budget.
+  size_t bucket = TRIE_HEAT_BUCKETS - 1;
+  size_t hot = histogram[bucket];
+  while (bucket > 1 && hot + histogram[bucket - 1] <= hot_nodes) {
+    bucket--;
+    hot += histogram[bucket];
+  }
+
+  TriePool *pool = trie_layout_pool(tree);
+  if (pool == NULL) {
+    return false;
+  }
+
+  uint16_t threshold = (uint16_t)(1u << (bucket - 1));
+  size_t budget = hot_nodes;
+  TrieNode *root =
+      trienode_relayout_hot(pool, tree->pool, tree->root, threshold, &budget);
+  if (root != NULL &&
+      !trienode_relayout_cold(pool, tree->pool, tree->root, root)) {
+    trienode_free_layout(pool, root);
+    root = NULL;
+  }
+
+  if (root == NULL) {
+    if (pool != tree->pool) {
+      pool_drop(pool);
+    }
+    return false;
+  }
+
+  trienode_cool(pool, root);
+  trie_replace_layout(tree, pool, root, moved, configuration);
+  return true;
+}
@@ -7,6 +7,10 @@
  * Tries store key <-> value pairs and allows to perform match longest prefix
  * operation and key <-> value pair deletion and insertion.
  *
+ * Nodes are allocated from a pool of the trie and refer to each other by
+ * 32-bit ids in it, with label of every edge stored in the node it leads to.
+ * Pointers to nodes stay valid until the nodes are freed.
+ *
  * @date 2022-05-07
  */
 #ifndef __COMPRESSED_TRIE_H__
@@ -37,6 +41,41 @@ struct Trie;
  */
 typedef struct Trie Trie;
 
+/**
+ * @brief Number of buckets in histograms of trie statistics. Last bucket
+ * gathers all bigger values.
+ */
+#define TRIE_STATS_BUCKETS 32
+
+/**
+ * @brief Number of buckets in fan-out histogram (node has 0 to 12 children).
+ */
+#define TRIE_STATS_FANOUTS 13
+
+/**
+ * @brief Structure describing shape of the trie.
+ */
+struct TrieStatistics {
+  size_t nodes;       ///< Number of nodes (including root).
+  size_t values;      ///< Number of nodes with value.
+  size_t longest_key; ///< Length of longest key buffer of the Trie.
+  size_t deepest_key; ///< Length of the longest key stored in the Trie.
+  size_t depth_histogram[TRIE_STATS_BUCKETS]; ///< Number of nodes per level.
+  size_t fanout_histogram[TRIE_STATS_FANOUTS]; ///< Nodes per children count.
+  size_t label_length_histogram[TRIE_STATS_BUCKETS]; ///< Edges per label
+                                                     ///< length.
+  size_t values_per_depth[TRIE_STATS_BUCKETS]; ///< Number of values per level.
+  size_t scattered_nodes;  ///< Nodes lying farther than a page from the node
+                           ///< visited before them in key order.
+  size_t scattered_labels; ///< Edge labels lying farther than a page from the
+                           ///< node they lead to.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct TrieStatistics TrieStatistics;
+
 /**
  * @brief Function inits compressed trie data structre.
  *
@@ -54,6 +93,28 @@ Trie *init_trie(bool *memory_error,
                                             void *configuration),
                 void *free_wrapper_configuration);
 
+/**
+ * @brief Function inits compressed trie which allocates nodes from the pool
+ * of @p sibling, so subtrees can be moved between them without copying (see
+ * trie_swap_subtree(), trie_remove_subtrees() and trie_graft_subtree()).
+ *
+ * Pool is freed with the last trie using it. Tries sharing pool must be used
+ * by one thread at a time.
+ *
+ * @param[out] memory_error : indicates if the was a memory error.
+ * @param value_free_function : function used to free node's value (see
+ * init_trie()).
+ * @param[in] free_wrapper_configuration : pointer to configuration which is
+ * passed to @p value_free_function.
+ * @param[in, out] sibling : Trie to share pool with (NULL for a new pool).
+ * @return Trie* : created data structure.
+ */
+Trie *init_trie_sibling(bool *memory_error,
+                        void (*value_free_function)(void *value,
+                                                    const char *key,
+                                                    void *configuration),
+                        void *free_wrapper_configuration, Trie *sibling);
+
 /**
  * @brief Function inserts key - value pair to the trie structure.
  *  If trie has already a value conntected to given key, it becomes overwritten.
@@ -82,6 +143,19 @@ TrieNode *trie_insert(Trie *tree, const char *key, void *value);
 void *trie_match_longest_prefix(const Trie *tree, const char *key,
                                 size_t *matched_length);
 
+/**
+ * @brief Returns value of the longest prefix of @p key that occurs in trie
+ * and is shorter than @p limit.
+ *
+ * @param[in] tree : trie to perform search in.
+ * @param[in] key : key to match.
+ * @param limit : bound of length of matched prefixes.
+ * @param[out] matched_length : place to save length of matched prefix.
+ * @return void* : found value (NULL if there is no such prefix).
+ */
+void *trie_match_bounded_prefix(const Trie *tree, const char *key,
+                                size_t limit, size_t *matched_length);
+
 /**
  * @brief Removes all (key, value) pairs such that key has prefix which equals
  * @p prefix.
@@ -98,6 +172,15 @@ void trie_remove_subtree(Trie *tree, const char *prefix);
  */
 void trie_drop(Trie *tree);
 
+/**
+ * @brief Checks if Trie has no values.
+ *
+ * @param[in] tree : Trie to check.
+ * @return true : if @p tree is empty.
+ * @return false : otherwise.
+ */
+bool trie_is_empty(const Trie *tree);
+
 /**
  * @brief Searches for node of given key and add if it wasn't in the tree.
  *
@@ -134,15 +217,311 @@ void trie_remove(Trie *tree, const char *key);
  */
 void trie_remove_from_ptr(Trie *tree, TrieNode *node, const char *key);
 
+/**
+ * @brief Function deciding if string of list stored in trie is collected by
+ * trie_traverse_down().
+ *
+ * @param[in] value : string of the list.
+ * @param[in] key : key passed to trie_traverse_down().
+ * @param prefix_length : length of key of the list, which is prefix of @p key.
+ * @param[in, out] configuration : pointer passed to trie_traverse_down().
+ * @return true : if @p value should be collected.
+ * @return false : if @p value should be skipped.
+ */
+typedef bool (*TrieTraverseFilter)(const char *value, const char *key,
+                                   size_t prefix_length, void *configuration);
+
 /**
  * @brief Function collects values from all prefixes (keys) of @p key.
  *
  * @param[in] tree : Trie to collect values from.
  * @param[in] key : key to collect all prefixes of.
+ * @param[in] filter : function selecting collected values (NULL to collect
+ * all of them).
+ * @param[in, out] configuration : pointer passed to @p filter.
  * @return DynamicArray* : array of collected values (Trie doesn't transfer
  * pointer ownership ; return NULL if memory error has occured)
  */
-DynamicArray *trie_traverse_down(const Trie *tree, const char *key);
+DynamicArray *trie_traverse_down(const Trie *tree, const char *key,
+                                 TrieTraverseFilter filter,
+                                 void *configuration);
+
+/**
+ * @brief Function exchanges subtrees of two tries rooted at @p prefix,
+ * together with value of @p prefix itself.
+ *
+ * If tries share pool of nodes (see init_trie_sibling()), only roots of
+ * subtrees are exchanged, so time doesn't depend on sizes of the subtrees.
+ * Otherwise subtrees are copied to pools of each other, so values of their
+ * nodes must not keep pointers to the nodes.
+ *
+ * @param[in, out] tree : first Trie.
+ * @param[in, out] other : second Trie (with the same value free function).
+ * @param[in] prefix : non-empty key of roots of exchanged subtrees.
+ * @return true : if subtrees were exchanged.
+ * @return false : if memory error has occured (nothing changes).
+ */
+bool trie_swap_subtree(Trie *tree, Trie *other, const char *prefix);
+
+/**
+ * @brief Function changes function called at values removed from the trie.
+ *
+ * @param[in, out] tree : Trie to change.
+ * @param[in] value_free_function : new free function.
+ * @param[in] free_wrapper_configuration : new configuration of
+ * @p value_free_function.
+ */
+void trie_set_free_function(Trie *tree,
+                            void (*value_free_function)(void *value,
+                                                        const char *key,
+                                                        void *configuration),
+                            void *free_wrapper_configuration);
+
+/**
+ * @brief Function frees at most @p limit values of the trie (and nodes left
+ * without values), calling free function with their keys.
+ *
+ * Trie isn't balanced, so it should be only dropped further.
+ *
+ * @param[in, out] tree : Trie being dropped.
+ * @param limit : maximal number of freed values.
+ * @return size_t : number of freed values (smaller than @p limit only if the
+ * trie is empty now).
+ */
+size_t trie_drop_step(Trie *tree, size_t limit);
+
+/**
+ * @brief Function removes subtrees of many prefixes in one walk of the trie.
+ *
+ * Upper levels shared by prefixes are visited once and nodes left without
+ * values are compacted while the walk returns, instead of balancing the trie
+ * after every subtree.
+ *
+ * @param[in, out] tree : Trie to remove subtrees from.
+ * @param[in, out] detached : Trie to move removed subtrees to, at the same
+ * keys (NULL to drop them; subtree is dropped also if memory error occurs or
+ * @p detached doesn't share pool with @p tree).
+ * @param[in] prefixes : non-empty prefixes sorted in key order, none of which
+ * is prefix of another one.
+ * @param count : number of prefixes.
+ */
+void trie_remove_subtrees(Trie *tree, Trie *detached,
+                          const char *const *prefixes, size_t count);
+
+/**
+ * @brief Function returns node of the key, creating it if needed.
+ *
+ * Created node has no value. Nodes aren't freed until the trie is balanced,
+ * so trie_compact_path() should be called for the key if node is left
+ * without value.
+ *
+ * @param[in, out] tree : Trie to search in.
+ * @param[in] key : key of the node.
+ * @return TrieNode* : node of @p key (NULL if memory error has occured).
+ */
+TrieNode *trie_add_node(Trie *tree, const char *key);
+
+/**
+ * @brief Function sets value of the node, without freeing previous one.
+ *
+ * @param[in, out] node : node to set value of.
+ * @param[in] value : new value (may be NULL).
+ */
+void trienode_set_value(TrieNode *node, void *value);
+
+/**
+ * @brief Function makes key buffer of the trie as long as key buffer of the
+ * other one, so it can hold subtrees grafted from it.
+ *
+ * @param[in, out] tree : Trie to grow buffer of.
+ * @param[in] other : Trie of grafted subtrees.
+ * @return true : if buffer is long enough.
+ * @return false : if memory error has occured.
+ */
+bool trie_reserve_keys(Trie *tree, const Trie *other);
+
+/**
+ * @brief Function unlinks subtree of the prefix from the trie, without
+ * freeing it.
+ *
+ * Cut subtree keeps its former father and label of edge leading to it, so it
+ * can be restored by trie_restore_subtree() or moved by trie_graft_subtree().
+ * Until then nodes of the trie must not be freed.
+ *
+ * @param[in, out] tree : Trie to cut subtree from.
+ * @param[in] prefix : non-empty key of root of the subtree (node is created if
+ * needed).
+ * @return TrieNode* : root of cut subtree (NULL if memory error has occured).
+ */
+TrieNode *trie_cut_subtree(Trie *tree, const char *prefix);
+
+/**
+ * @brief Function links cut subtree back to its father.
+ *
+ * Subtree created meanwhile at the same place is dropped, so it must not have
+ * values.
+ *
+ * @param[in, out] tree : Trie the subtree was cut from.
+ * @param[in] node : root of cut subtree.
+ */
+void trie_restore_subtree(Trie *tree, TrieNode *node);
+
+/**
+ * @brief Function replaces node without value and children by cut subtree
+ * of the same key.
+ *
+ * @param[in, out] tree : Trie of @p slot, sharing pool with trie of @p node.
+ * @param[in] slot : replaced node (freed by the function), which isn't root.
+ * @param[in] node : root of cut subtree.
+ */
+void trie_graft_subtree(Trie *tree, TrieNode *slot, TrieNode *node);
+
+/**
+ * @brief Function frees nodes without values left on path of the key and
+ * merges edges around them.
+ *
+ * @param[in, out] tree : Trie to compact.
+ * @param[in] key : key, whose path is compacted from the deepest node up.
+ */
+void trie_compact_path(Trie *tree, const char *key);
+
+/**
+ * @brief Function turns deferred compaction of the trie on or off.
+ *
+ * While compaction is deferred, removals leave nodes without values in place
+ * instead of freeing them and merging edges around them, and only count
+ * places which need compaction. Nodes aren't remembered, as they can be freed
+ * with their subtrees before compaction. Trie stays correct, but it isn't
+ * compressed until trie_compact() is called.
+ *
+ * @param[in, out] tree : Trie to set mode of.
+ * @param deferred : true if compaction should be deferred.
+ */
+void trie_defer_compaction(Trie *tree, bool deferred);
+
+/**
+ * @brief Function returns number of compactions deferred since the last
+ * trie_compact().
+ *
+ * @param[in] tree : checked Trie.
+ * @return size_t : number of deferred compactions.
+ */
+size_t trie_compaction_candidates(const Trie *tree);
+
+/**
+ * @brief Function frees all nodes without values and with at most one child
+ * and merges edges around them, in one walk of whole trie.
+ *
+ * If memory error occurs, some nodes stay uncompacted, but trie is correct.
+ *
+ * @param[in, out] tree : Trie to compact.
+ * @return size_t : number of freed nodes.
+ */
+size_t trie_compact(Trie *tree);
+
+/**
+ * @brief Function moves all nodes and edge labels of the trie into fresh
+ * memory, in key order, with label of edge leading to every node allocated
+ * right after it. Nodes are taken from a new pool (or from the end of pool
+ * shared with other tries), so subtrees lie in consecutive ids. Old nodes are
+ * freed after the copy is complete, so they don't break up the new layout.
+ *
+ * @param[in, out] tree : Trie to lay out.
+ * @param[in] moved : function called with every value and its new node (may
+ * be NULL).
+ * @param[in, out] configuration : pointer passed to @p moved.
+ * @return true : if trie was laid out.
+ * @return false : if memory error has occured (nothing changes).
+ */
+bool trie_relayout(Trie *tree,
+                   void (*moved)(void *value, TrieNode *node,
+                                 void *configuration),
+                   void *configuration);
+
+/**
+ * @brief Function turns counting of visited nodes on or off.
+ *
+ * While it is on, trie_match_longest_prefix() and trie_match_bounded_prefix()
+ * increase saturating counter of every node they enter. Counters are kept
+ * while it is off and are used by trie_relayout_hot().
+ *
+ * @param[in, out] tree : Trie to set mode of.
+ * @param sampled : true if visited nodes should be counted.
+ */
+void trie_sample_visits(Trie *tree, bool sampled);
+
+/**
+ * @brief Function works like trie_relayout(), but first copies at most
+ * @p hot_nodes of the most often entered nodes (with labels of their edges),
+ * which form paths from the root, so they are allocated next to each other.
+ * Cold subtrees are copied after them in key order. Counters of all nodes are
+ * halved afterwards, so the next relayout prefers recent searches.
+ *
+ * @param[in, out] tree : Trie to lay out.
+ * @param hot_nodes : maximal number of nodes (without root) copied first.
+ * @param[in] moved : function called with every value and its new node (may
+ * be NULL).
+ * @param[in, out] configuration : pointer passed to @p moved.
+ * @return true : if trie was laid out.
+ * @return false : if memory error has occured (nothing changes).
+ */
+bool trie_relayout_hot(Trie *tree, size_t hot_nodes,
+                       void (*moved)(void *value, TrieNode *node,
+                                     void *configuration),
+                       void *configuration);
+
+/**
+ * @brief Function walks whole trie and gathers statistics of its shape.
+ *
+ * Levels are counted in edges from the root, so root lies at level 0.
+ *
+ * @param[in] tree : Trie to describe.
+ * @param[out] stats : place to save gathered statistics.
+ * @param[in] value_visitor : function called on every stored value (may be
+ * NULL).
+ * @param[in, out] configuration : pointer passed to @p value_visitor.
+ */
+void trie_statistics(const Trie *tree, TrieStatistics *stats,
+                     void (*value_visitor)(const void *value,
+                                           void *configuration),
+                     void *configuration);
+
+/**
+ * @brief Function visits values of keys greater than @p after in key order.
+ *
+ * Keys are ordered lexicographically by digit values, so key is visited
+ * before keys it is prefix of. Iteration can be resumed later from the last
+ * visited key, even if the trie was modified meanwhile.
+ *
+ * @param[in] tree : Trie to iterate.
+ * @param[in] after : key to start after ("" to start from the smallest key;
+ * must not be modified by @p visitor).
+ * @param limit : maximal number of visited values.
+ * @param[in] visitor : function called on every visited key and value.
+ * @param[in, out] configuration : pointer passed to @p visitor.
+ * @param[out] memory_error : set to true if memory error has occured.
+ * @return size_t : number of visited values (smaller than @p limit if
+ * iteration has reached the end).
+ */
+size_t trie_iterate(const Trie *tree, const char *after, size_t limit,
+                    void (*visitor)(const char *key, void *value,
+                                    void *configuration),
+                    void *configuration, bool *memory_error);
+
+/**
+ * @brief Function visits values of keys starting with @p prefix in key order.
+ *
+ * @param[in] tree : Trie to iterate.
+ * @param[in] prefix : common prefix of visited keys.
+ * @param[in] visitor : function called on every visited key and value.
+ * @param[in, out] configuration : pointer passed to @p visitor.
+ * @param[out] memory_error : set to true if memory error has occured.
+ * @return size_t : number of visited values.
+ */
+size_t trie_iterate_prefix(const Trie *tree, const char *prefix,
+                           void (*visitor)(const char *key, void *value,
+                                           void *configuration),
+                           void *configuration, bool *memory_error);
 
 /**
  * @brief Function to collect value from Trie node given by the pointer.
@@ -8,15 +8,19 @@
  */
 struct List {
   ListElement *guard; ///< Pointer to the guard of the list.
+  char *target;       ///< Target shared by users of the list (or NULL).
 };
 
 /**
  * @brief Structure to represent element of the list.
+ *
+ * Value is stored right after the element, so the element and its value are
+ * one allocation. Guard of the list has empty value.
  */
 struct ListElement {
-  char *value;           ///< Value of the element as a pointer to string.
   ListElement *previous; ///< Pointer to the previous element in the list.
   ListElement *next;     ///< Pointer to the next element in the list.
+  char value[];          ///< Value of the element.
 };
 
 /**
@@ -28,13 +32,14 @@ struct ListIterator {
 };
 
 List *init_list(bool *memory_error) {
-  List *list = wrap_malloc(sizeof(struct List));
+  List *list = wrap_malloc(sizeof(struct List), MEMORY_TAG_REVERSE_LIST);
   if (list == NULL) {
     *memory_error = true;
     return NULL;
   }
 
-  ListElement *guard = wrap_malloc(sizeof(struct ListElement));
+  ListElement *guard =
+      wrap_malloc(sizeof(struct ListElement) + 1, MEMORY_TAG_REVERSE_LIST);
   if (guard == NULL) {
     wrap_free(list);
     *memory_error = true;
@@ -43,30 +48,26 @@ List *init_list(bool *memory_error) {
 
   guard->next = NULL;
   guard->previous = NULL;
-  guard->value = NULL;
+  guard->value[0] = '\0';
 
   list->guard = guard;
+  list->target = NULL;
 
   return list;
 }
 
 ListElement *list_insert(List *list, const char *to_insert) {
-  ListElement *element = wrap_malloc(sizeof(struct ListElement));
+  size_t length = strlen(to_insert) + 1;
+  ListElement *element = wrap_malloc(sizeof(struct ListElement) + length,
+                                     MEMORY_TAG_REVERSE_LIST);
   if (element == NULL) {
     return NULL;
   }
-
-  char *new_string = wrap_malloc(sizeof(char) * (strlen(to_insert) + 1));
-  if (new_string == NULL) {
-    wrap_free(element);
-    return NULL;
-  }
-  strcpy(new_string, to_insert);
+  memcpy(element->value, to_insert, length);
 
   ListElement *list_first_element = list->guard->next;
 
   element->previous = list->guard;
-  element->value = new_string;
   element->next = list_first_element;
 
   if (list_first_element != NULL) {
@@ -91,7 +92,6 @@ void list_remove_ptr(ListElement *element_to_remove) {
     next_element->previous = prev_element;
   }
 
-  wrap_free(element_to_remove->value);
   wrap_free(element_to_remove);
 }
 
@@ -106,15 +106,16 @@ void list_drop(List *to_drop) {
     ListElement *to_delete = node;
     node = node->next;
 
-    wrap_free(to_delete->value);
     wrap_free(to_delete);
   }
 
+  wrap_free(to_drop->target);
   wrap_free(to_drop);
 }
 
 ListIterator *list_iterator(const List *list, bool *memory_error) {
-  ListIterator *iter = wrap_malloc(sizeof(struct ListIterator));
+  ListIterator *iter =
+      wrap_malloc(sizeof(struct ListIterator), MEMORY_TAG_RESULTS);
   if (iter == NULL) {
     *memory_error = true;
     return NULL;
@@ -140,12 +141,23 @@ void listiterator_drop(ListIterator *iterator) { wrap_free(iterator); }
 
 bool list_isempty(const List *list) { return list->guard->next == NULL; }
 
+size_t list_size(const List *list) {
+  size_t elements = 0;
+
+  for (const ListElement *element = list->guard->next; element != NULL;
+       element = element->next) {
+    elements++;
+  }
+
+  return elements;
+}
+
 bool listelement_is_last(const ListElement *element) {
   if (element == NULL) {
     return false;
   }
 
-  return (element->previous->value == NULL) && (element->next == NULL);
+  return (element->previous->value[0] == '\0') && (element->next == NULL);
 }
 
 void list_set_node(List *list, TrieNode *connected_node) {
@@ -154,4 +166,23 @@ void list_set_node(List *list, TrieNode *connected_node) {
 
 TrieNode *listelement_get_node(ListElement *last_element) {
   return (TrieNode *)last_element->previous->previous;
-}
\ No newline at end of file
+}
+
+const char *listelement_get_value(const ListElement *element) {
+  return element->value;
+}
+
+bool list_set_target(List *list, const char *target) {
+  size_t length = strlen(target) + 1;
+  char *copy = wrap_malloc(length, MEMORY_TAG_FORWARD_RECORD);
+  if (copy == NULL) {
+    return false;
+  }
+  memcpy(copy, target, length);
+
+  wrap_free(list->target);
+  list->target = copy;
+  return true;
+}
+
+const char *list_get_target(const List *list) { return list->target; }
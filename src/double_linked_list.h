@@ -51,6 +51,7 @@ List *init_list(bool *memory_error);
  * the list or the list is dropped.
  *
  * Function makes copy of @p to_insert so no ownership is transferred.
+ * @p to_insert must not be empty, as empty value marks guard of the list.
  *
  * @param[in, out] list : pointer to list at which element @p to_insert is
  * inserted.
@@ -84,6 +85,14 @@ void list_drop(List *to_drop);
  */
 TrieNode *listelement_get_node(ListElement *last_element);
 
+/**
+ * @brief Returns value of given element.
+ *
+ * @param[in] element : element to read value of.
+ * @return const char* : value of @p element (owned by the list).
+ */
+const char *listelement_get_value(const ListElement *element);
+
 /**
  * @brief Creates iterator over given @p list.
  *
@@ -113,6 +122,14 @@ bool listiterator_has_next(const ListIterator *iterator);
  */
 bool list_isempty(const List *list);
 
+/**
+ * @brief Counts elements of given list.
+ *
+ * @param[in] list : list to count elements of.
+ * @return size_t : number of elements in @p list.
+ */
+size_t list_size(const List *list);
+
 /**
  * @brief Reads next element from the @p iterator.
  *
@@ -146,4 +163,24 @@ bool listelement_is_last(const ListElement *element);
  * @param[in] connected_node : pointer to corresponding node.
  */
 void list_set_node(List *list, TrieNode *connected_node);
+
+/**
+ * @brief Saves copy of @p target in the list, so everyone who uses the list
+ * can share one copy of it.
+ *
+ * @param[in, out] list : list to set target of.
+ * @param[in] target : string to save.
+ * @return true : if target was saved.
+ * @return false : if memory error has occured (nothing changes).
+ */
+bool list_set_target(List *list, const char *target);
+
+/**
+ * @brief Returns target saved in the list.
+ *
+ * @param[in] list : list to read target of.
+ * @return const char* : target of @p list (owned by the list, NULL if it
+ * wasn't set).
+ */
+const char *list_get_target(const List *list);
 #endif /* __DOUBLE_LINKED_LIST_H__ */
\ No newline at end of file
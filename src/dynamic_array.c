@@ -45,13 +45,14 @@ static bool darray_extend(DynamicArray *to_extend) {
 }
 
 DynamicArray *init_darray(bool *memory_error) {
-  DynamicArray *created = wrap_malloc(sizeof(struct DynamicArray));
+  DynamicArray *created =
+      wrap_malloc(sizeof(struct DynamicArray), MEMORY_TAG_RESULTS);
   if (created == NULL) {
     *memory_error = true;
     return NULL;
   }
 
-  created->array = wrap_malloc(sizeof(void *) * BASE_SIZE);
+  created->array = wrap_malloc(sizeof(void *) * BASE_SIZE, MEMORY_TAG_RESULTS);
   if (created->array == NULL) {
     *memory_error = true;
 
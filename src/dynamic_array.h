@@ -48,7 +48,7 @@ size_t darray_size(const DynamicArray *dynamic_array);
  * @brief Performs conversion of structre to the array of inserted items.
  *
  * Structure pointed by @p dynamic_array is dropped and can't be used later on.
- * User should perform stdlib's free on returned value.
+ * User should perform wrap_free() on returned value.
  *
  * @param[in] dynamic_array : array to convert.
  * @return void** : result of conversion.
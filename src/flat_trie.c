@@ -0,0 +1,310 @@
+/**
+ * @file flat_trie.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in flat_trie.h.
+ * @date 2022-06-26
+ */
+#include "flat_trie.h"
+#include "memory.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Marks node without value.
+ */
+#define NO_VALUE UINT32_MAX
+
+/**
+ * @brief Node of the trie. Offsets point into text of the trie.
+ */
+struct FlatNode {
+  uint32_t label;        ///< Offset of label of edge leading to the node.
+  uint32_t label_length; ///< Length of the label.
+  uint32_t value;        ///< Offset of value (NO_VALUE if there is none).
+  uint32_t first_child;  ///< Index of the first child.
+  uint32_t children;     ///< Number of children.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct FlatNode FlatNode;
+
+/**
+ * @brief Pairs of the subtree of node which isn't laid out yet.
+ */
+struct FlatRange {
+  uint32_t begin; ///< Index of the first pair.
+  uint32_t end;   ///< Index after the last pair.
+  uint32_t depth; ///< Length of key of the node.
+};
+
+/**
+ * @brief Pair of the trie. Offsets point into text of the trie.
+ */
+struct FlatEntry {
+  uint32_t key;   ///< Offset of the key.
+  uint32_t value; ///< Offset of the value.
+};
+
+/**
+ * @brief Immutable trie stored in flat arrays.
+ */
+struct FlatTrie {
+  char *text;                ///< Keys and values, separated by '\0'.
+  size_t text_length;        ///< Number of used bytes of @p text.
+  size_t text_capacity;      ///< Capacity of @p text.
+  struct FlatEntry *entries; ///< Pairs in key order.
+  size_t count;              ///< Number of pairs.
+  size_t entries_capacity;   ///< Capacity of @p entries.
+  FlatNode *nodes;           ///< Nodes in breadth-first order, root first.
+  size_t node_count;         ///< Number of created nodes.
+  size_t nodes_capacity;     ///< Capacity of @p nodes.
+  struct FlatRange *ranges;  ///< Pairs of created nodes (NULL once built).
+  size_t ranges_capacity;    ///< Capacity of @p ranges.
+  size_t laid_out;           ///< Number of nodes whose children are created.
+};
+
+/**
+ * @brief Makes room for @p wanted elements in the array.
+ *
+ * @param[in, out] array : pointer to the array.
+ * @param[in, out] capacity : capacity of the array in elements.
+ * @param wanted : needed capacity.
+ * @param element_size : size of one element.
+ * @return true : if array has the capacity.
+ * @return false : if memory error has occured.
+ */
+static bool reserve(void **array, size_t *capacity, size_t wanted,
+                    size_t element_size) {
+  if (wanted <= *capacity) {
+    return true;
+  }
+
+  size_t new_capacity = *capacity == 0 ? 16 : *capacity;
+  while (new_capacity < wanted) {
+    new_capacity *= 2;
+  }
+
+  void *new_array = wrap_realloc(*array, new_capacity * element_size);
+  if (new_array == NULL) {
+    return false;
+  }
+
+  *array = new_array;
+  *capacity = new_capacity;
+  return true;
+}
+
+/**
+ * @brief Appends string to the text of the trie.
+ *
+ * @param[in, out] trie : trie to append to.
+ * @param[in] string : appended string.
+ * @param[out] offset : place to save offset of the string.
+ * @return true : if string was appended.
+ * @return false : if memory error has occured or text is too long.
+ */
+static bool push_text(FlatTrie *trie, const char *string, uint32_t *offset) {
+  size_t length = strlen(string) + 1;
+
+  if (trie->text_length + length >= NO_VALUE ||
+      !reserve((void **)&trie->text, &trie->text_capacity,
+               trie->text_length + length, sizeof(char))) {
+    return false;
+  }
+
+  memcpy(trie->text + trie->text_length, string, length);
+  *offset = (uint32_t)trie->text_length;
+  trie->text_length += length;
+  return true;
+}
+
+FlatTrie *flat_trie_new(void) {
+  return wrap_calloc(1u, sizeof(struct FlatTrie), MEMORY_TAG_OTHER);
+}
+
+bool flat_trie_push(FlatTrie *trie, const char *key, const char *value) {
+  struct FlatEntry entry;
+  size_t text_length = trie->text_length;
+
+  // Every pair adds at most two nodes.
+  if (trie->count >= NO_VALUE / 2 ||
+      !reserve((void **)&trie->entries, &trie->entries_capacity,
+               trie->count + 1, sizeof(struct FlatEntry)) ||
+      !push_text(trie, key, &entry.key) ||
+      !push_text(trie, value, &entry.value)) {
+    trie->text_length = text_length;
+    return false;
+  }
+
+  trie->entries[trie->count++] = entry;
+  return true;
+}
+
+/**
+ * @brief Appends node to the trie.
+ *
+ * @param[in, out] trie : trie being built.
+ * @param begin : index of the first pair of subtree of the node.
+ * @param end : index after the last pair of subtree of the node.
+ * @param parent_depth : length of key of parent of the node.
+ * @param depth : length of key of the node.
+ * @return true : if node was appended.
+ * @return false : if memory error has occured.
+ */
+static bool push_node(FlatTrie *trie, size_t begin, size_t end,
+                      size_t parent_depth, size_t depth) {
+  if (!reserve((void **)&trie->nodes, &trie->nodes_capacity,
+               trie->node_count + 1, sizeof(FlatNode)) ||
+      !reserve((void **)&trie->ranges, &trie->ranges_capacity,
+               trie->node_count + 1, sizeof(struct FlatRange))) {
+    return false;
+  }
+
+  const struct FlatEntry *first = trie->entries + begin;
+  const char *key = trie->text + first->key;
+  FlatNode *node = trie->nodes + trie->node_count;
+
+  node->label = first->key + (uint32_t)parent_depth;
+  node->label_length = (uint32_t)(depth - parent_depth);
+  node->value = key[depth] == '\0' ? first->value : NO_VALUE;
+  node->first_child = 0;
+  node->children = 0;
+
+  trie->ranges[trie->node_count] = (struct FlatRange){
+      (uint32_t)(begin + (key[depth] == '\0')), (uint32_t)end,
+      (uint32_t)depth};
+  trie->node_count++;
+  return true;
+}
+
+/**
+ * @brief Creates children of the node.
+ *
+ * Pairs of the node are sorted, so pairs of every child are adjacent and the
+ * common prefix of all of them is the common prefix of the first and the last.
+ *
+ * @param[in, out] trie : trie being built.
+ * @param index : index of the node.
+ * @return true : if children were created.
+ * @return false : if memory error has occured.
+ */
+static bool lay_out_node(FlatTrie *trie, size_t index) {
+  struct FlatRange range = trie->ranges[index];
+  size_t first_child = trie->node_count;
+  size_t begin = range.begin;
+
+  while (begin < range.end) {
+    const char *first = trie->text + trie->entries[begin].key;
+    size_t end = begin + 1;
+
+    while (end < range.end &&
+           trie->text[trie->entries[end].key + range.depth] ==
+               first[range.depth]) {
+      end++;
+    }
+
+    const char *last = trie->text + trie->entries[end - 1].key;
+    size_t depth = range.depth + 1;
+    while (first[depth] != '\0' && first[depth] == last[depth]) {
+      depth++;
+    }
+
+    if (!push_node(trie, begin, end, range.depth, depth)) {
+      return false;
+    }
+    begin = end;
+  }
+
+  trie->nodes[index].first_child = (uint32_t)first_child;
+  trie->nodes[index].children = (uint32_t)(trie->node_count - first_child);
+  return true;
+}
+
+bool flat_trie_build(FlatTrie *trie, size_t budget, bool *done) {
+  *done = false;
+
+  if (trie->node_count == 0) {
+    if (!reserve((void **)&trie->nodes, &trie->nodes_capacity, 1,
+                 sizeof(FlatNode)) ||
+        !reserve((void **)&trie->ranges, &trie->ranges_capacity, 1,
+                 sizeof(struct FlatRange))) {
+      return false;
+    }
+
+    trie->nodes[0] = (FlatNode){0, 0, NO_VALUE, 0, 0};
+    trie->ranges[0] = (struct FlatRange){0, (uint32_t)trie->count, 0};
+    trie->node_count = 1;
+  }
+
+  for (; budget > 0 && trie->laid_out < trie->node_count; budget--) {
+    if (!lay_out_node(trie, trie->laid_out)) {
+      return false;
+    }
+    trie->laid_out++;
+  }
+
+  if (trie->laid_out == trie->node_count) {
+    wrap_free(trie->ranges);
+    trie->ranges = NULL;
+    trie->ranges_capacity = 0;
+    *done = true;
+  }
+
+  return true;
+}
+
+const char *flat_trie_match(const FlatTrie *trie, const char *key,
+                            size_t limit, size_t *matched_length) {
+  const FlatNode *node = trie->nodes;
+  const char *result = NULL;
+  size_t depth = 0;
+
+  while (key[depth] != '\0' && node->children > 0) {
+    const FlatNode *child = trie->nodes + node->first_child;
+    const FlatNode *end = child + node->children;
+
+    while (child < end && trie->text[child->label] != key[depth]) {
+      child++;
+    }
+
+    if (child == end || depth + child->label_length >= limit ||
+        strncmp(trie->text + child->label, key + depth,
+                child->label_length) != 0) {
+      break;
+    }
+
+    node = child;
+    depth += child->label_length;
+
+    if (node->value != NO_VALUE) {
+      result = trie->text + node->value;
+      *matched_length = depth;
+    }
+  }
+
+  return result;
+}
+
+size_t flat_trie_size(const FlatTrie *trie) {
+  return trie->count;
+}
+
+void flat_trie_entry(const FlatTrie *trie, size_t index, const char **key,
+                     const char **value) {
+  *key = trie->text + trie->entries[index].key;
+  *value = trie->text + trie->entries[index].value;
+}
+
+void flat_trie_drop(FlatTrie *trie) {
+  if (trie == NULL) {
+    return;
+  }
+
+  wrap_free(trie->text);
+  wrap_free(trie->entries);
+  wrap_free(trie->nodes);
+  wrap_free(trie->ranges);
+  wrap_free(trie);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file flat_trie.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Interface of immutable trie stored in flat arrays.
+ *
+ * Trie is built from (key, value) pairs pushed in key order (as visited by
+ * trie_iterate()). Then nodes are laid out in breadth-first order, children of
+ * every node being adjacent, with edge labels and values pointing into one
+ * text buffer. Layout is done in bounded steps, so it can be spread over other
+ * work. Built trie can't be modified.
+ *
+ * @date 2022-06-26
+ */
+#ifndef __FLAT_TRIE_H__
+#define __FLAT_TRIE_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Immutable trie stored in flat arrays.
+ */
+struct FlatTrie;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct FlatTrie FlatTrie;
+
+/**
+ * @brief Creates empty trie, which accepts pairs.
+ *
+ * @return FlatTrie* : created trie (NULL if memory error has occured).
+ */
+FlatTrie *flat_trie_new(void);
+
+/**
+ * @brief Appends pair to the trie being built.
+ *
+ * @param[in, out] trie : trie which accepts pairs.
+ * @param[in] key : non-empty key, bigger than keys pushed before.
+ * @param[in] value : value of the key.
+ * @return true : if pair was appended.
+ * @return false : if memory error has occured or trie is too big.
+ */
+bool flat_trie_push(FlatTrie *trie, const char *key, const char *value);
+
+/**
+ * @brief Lays out at most @p budget nodes of the trie. No pair can be pushed
+ * after the first call.
+ *
+ * @param[in, out] trie : trie being built.
+ * @param budget : maximal number of laid out nodes.
+ * @param[out] done : set to true if trie is built.
+ * @return true : if step was made.
+ * @return false : if memory error has occured.
+ */
+bool flat_trie_build(FlatTrie *trie, size_t budget, bool *done);
+
+/**
+ * @brief Returns value of the longest key, which is prefix of @p key and is
+ * shorter than @p limit.
+ *
+ * @param[in] trie : built trie.
+ * @param[in] key : key to match.
+ * @param limit : bound of length of matched keys (SIZE_MAX for no bound).
+ * @param[out] matched_length : place to save length of matched key.
+ * @return const char* : found value (NULL if no key matches).
+ */
+const char *flat_trie_match(const FlatTrie *trie, const char *key,
+                            size_t limit, size_t *matched_length);
+
+/**
+ * @brief Returns number of pairs of the trie.
+ *
+ * @param[in] trie : checked trie.
+ * @return size_t : number of pairs.
+ */
+size_t flat_trie_size(const FlatTrie *trie);
+
+/**
+ * @brief Reads pair of given index in key order.
+ *
+ * @param[in] trie : read trie.
+ * @param index : index of the pair (smaller than flat_trie_size()).
+ * @param[out] key : place to save key of the pair.
+ * @param[out] value : place to save value of the pair.
+ */
+void flat_trie_entry(const FlatTrie *trie, size_t index, const char **key,
+                     const char **value);
+
+/**
+ * @brief Frees the trie.
+ *
+ * @param[in] trie : trie to free (may be NULL).
+ */
+void flat_trie_drop(FlatTrie *trie);
+
+#endif /* __FLAT_TRIE_H__ */
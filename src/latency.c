@@ -0,0 +1,251 @@
+/**
+ * @file latency.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements latency histograms declared in latency.h.
+ *
+ * Every thread records into its own block of counters, which is registered
+ * in a lock-free list at first use. Only the owning thread writes to a block,
+ * so counters are updated with relaxed loads and stores without atomic
+ * read-modify-write instructions. Blocks are never freed, so values recorded
+ * by finished threads stay visible in snapshots.
+ *
+ * @date 2022-06-12
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "memory.h"
+#include <string.h>
+#include <time.h>
+
+#ifdef PHFWD_LATENCY_STATS
+#include <stdatomic.h>
+#endif
+
+uint64_t latency_bucket_value(size_t index) {
+  if (index < LATENCY_SUB_BUCKETS) {
+    return (uint64_t)index;
+  }
+
+  size_t shift = index / LATENCY_SUB_BUCKETS - 1u;
+  uint64_t sub_bucket = index % LATENCY_SUB_BUCKETS;
+
+  return (LATENCY_SUB_BUCKETS + sub_bucket) << shift;
+}
+
+void latency_histogram_init(LatencyHistogram *histogram) {
+  memset(histogram, 0, sizeof(struct LatencyHistogram));
+  histogram->min = UINT64_MAX;
+}
+
+void latency_histogram_record(LatencyHistogram *histogram, uint64_t value) {
+  histogram->count++;
+  histogram->total += value;
+  histogram->buckets[latency_bucket_index(value)]++;
+
+  if (value < histogram->min) {
+    histogram->min = value;
+  }
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+}
+
+void latency_histogram_merge(LatencyHistogram *destination,
+                             const LatencyHistogram *source) {
+  destination->count += source->count;
+  destination->total += source->total;
+
+  if (source->min < destination->min) {
+    destination->min = source->min;
+  }
+  if (source->max > destination->max) {
+    destination->max = source->max;
+  }
+
+  for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+    destination->buckets[index] += source->buckets[index];
+  }
+}
+
+uint64_t latency_histogram_percentile(const LatencyHistogram *histogram,
+                                      double percentile) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+
+  uint64_t wanted = (uint64_t)((double)histogram->count * percentile / 100.0);
+  if (wanted >= histogram->count) {
+    wanted = histogram->count - 1;
+  }
+
+  uint64_t seen = 0;
+  for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+    seen += histogram->buckets[index];
+    if (seen > wanted) {
+      return latency_bucket_value(index);
+    }
+  }
+
+  return histogram->max;
+}
+
+uint64_t latency_clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+#ifdef PHFWD_LATENCY_STATS
+
+/**
+ * @brief Histogram updated only by its owning thread and read by others.
+ */
+struct SharedHistogram {
+  _Atomic uint64_t count;                    ///< Number of recorded values.
+  _Atomic uint64_t total;                    ///< Sum of recorded values.
+  _Atomic uint64_t min;                      ///< Smallest recorded value.
+  _Atomic uint64_t max;                      ///< Biggest recorded value.
+  _Atomic uint64_t buckets[LATENCY_BUCKETS]; ///< Values in every bucket.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct SharedHistogram SharedHistogram;
+
+struct ThreadLatency;
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct ThreadLatency ThreadLatency;
+
+/**
+ * @brief Block of histograms of one thread.
+ */
+struct ThreadLatency {
+  SharedHistogram operations[LATENCY_OPERATIONS]; ///< Histogram per operation.
+  ThreadLatency *next; ///< Next registered block.
+};
+
+/**
+ * @brief Head of the list of registered blocks.
+ */
+static _Atomic(ThreadLatency *) latency_threads = NULL;
+
+/**
+ * @brief Block of the calling thread (NULL before first use).
+ */
+static _Thread_local ThreadLatency *latency_own = NULL;
+
+/**
+ * @brief Increases counter owned by the calling thread.
+ *
+ * @param[in, out] counter : counter to increase.
+ * @param value : value to add.
+ */
+static inline void owned_add(_Atomic uint64_t *counter, uint64_t value) {
+  uint64_t old = atomic_load_explicit(counter, memory_order_relaxed);
+  atomic_store_explicit(counter, old + value, memory_order_relaxed);
+}
+
+/**
+ * @brief Allocates and registers block of the calling thread.
+ *
+ * @return ThreadLatency* : registered block (NULL if memory error occured).
+ */
+static ThreadLatency *latency_register(void) {
+  ThreadLatency *block =
+      wrap_calloc(1u, sizeof(struct ThreadLatency), MEMORY_TAG_OTHER);
+  if (block == NULL) {
+    return NULL;
+  }
+
+  for (size_t operation = 0; operation < LATENCY_OPERATIONS; operation++) {
+    atomic_init(&block->operations[operation].min, UINT64_MAX);
+  }
+
+  ThreadLatency *head =
+      atomic_load_explicit(&latency_threads, memory_order_relaxed);
+  do {
+    block->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &latency_threads, &head, block, memory_order_release,
+      memory_order_relaxed));
+
+  latency_own = block;
+  return block;
+}
+
+void latency_record(LatencyOperation operation, uint64_t ticks) {
+  ThreadLatency *block = latency_own;
+  if (block == NULL) {
+    block = latency_register();
+    if (block == NULL) {
+      return;
+    }
+  }
+
+  SharedHistogram *histogram = &block->operations[operation];
+
+  owned_add(&histogram->count, 1u);
+  owned_add(&histogram->total, ticks);
+  owned_add(&histogram->buckets[latency_bucket_index(ticks)], 1u);
+
+  if (ticks < atomic_load_explicit(&histogram->min, memory_order_relaxed)) {
+    atomic_store_explicit(&histogram->min, ticks, memory_order_relaxed);
+  }
+  if (ticks > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+    atomic_store_explicit(&histogram->max, ticks, memory_order_relaxed);
+  }
+}
+
+bool latency_snapshot(LatencyHistogram *histograms) {
+  for (size_t operation = 0; operation < LATENCY_OPERATIONS; operation++) {
+    latency_histogram_init(&histograms[operation]);
+  }
+
+  ThreadLatency *block =
+      atomic_load_explicit(&latency_threads, memory_order_acquire);
+
+  while (block != NULL) {
+    for (size_t operation = 0; operation < LATENCY_OPERATIONS; operation++) {
+      SharedHistogram *source = &block->operations[operation];
+      LatencyHistogram *destination = &histograms[operation];
+      uint64_t min = atomic_load_explicit(&source->min, memory_order_relaxed);
+      uint64_t max = atomic_load_explicit(&source->max, memory_order_relaxed);
+
+      destination->count +=
+          atomic_load_explicit(&source->count, memory_order_relaxed);
+      destination->total +=
+          atomic_load_explicit(&source->total, memory_order_relaxed);
+      if (min < destination->min) {
+        destination->min = min;
+      }
+      if (max > destination->max) {
+        destination->max = max;
+      }
+
+      for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+        destination->buckets[index] +=
+            atomic_load_explicit(&source->buckets[index], memory_order_relaxed);
+      }
+    }
+
+    block = block->next;
+  }
+
+  return true;
+}
+
+#else
+
+bool latency_snapshot(LatencyHistogram *histograms) {
+  for (size_t operation = 0; operation < LATENCY_OPERATIONS; operation++) {
+    latency_histogram_init(&histograms[operation]);
+  }
+
+  return false;
+}
+
+#endif /* PHFWD_LATENCY_STATS */
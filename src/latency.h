@@ -0,0 +1,201 @@
+/**
+ * @file latency.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module provides log-linear latency histograms and optional timing of
+ * library operations.
+ *
+ * Histogram stores values exactly up to LATENCY_SUB_BUCKETS and above that
+ * with relative error not bigger than 1 / LATENCY_SUB_BUCKETS.
+ *
+ * If library is built with PHFWD_LATENCY_STATS defined, LATENCY_START and
+ * LATENCY_STOP macros record duration of operations into per-thread
+ * histograms, which are merged on demand by latency_snapshot(). Otherwise
+ * macros expand to nothing.
+ *
+ * @date 2022-06-12
+ */
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Number of bits of value kept exactly in every bucket.
+ */
+#define LATENCY_SUB_BUCKET_BITS 4
+
+/**
+ * @brief Number of linear buckets inside one power of two.
+ */
+#define LATENCY_SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+
+/**
+ * @brief Number of buckets which cover all 64-bit values.
+ */
+#define LATENCY_BUCKETS                                                        \
+  ((64u - LATENCY_SUB_BUCKET_BITS + 1u) * LATENCY_SUB_BUCKETS)
+
+/**
+ * @brief Operations which duration is measured.
+ */
+enum LatencyOperation {
+  LATENCY_ADD,       ///< phfwdAdd calls.
+  LATENCY_GET,       ///< phfwdGet calls.
+  LATENCY_REMOVE,    ///< phfwdRemove calls.
+  LATENCY_REVERSE,   ///< phfwdReverse calls.
+  LATENCY_OPERATIONS ///< Number of measured operations.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum LatencyOperation LatencyOperation;
+
+/**
+ * @brief Log-linear histogram of measured values.
+ */
+struct LatencyHistogram {
+  uint64_t count;                    ///< Number of recorded values.
+  uint64_t total;                    ///< Sum of recorded values.
+  uint64_t min;                      ///< Smallest recorded value.
+  uint64_t max;                      ///< Biggest recorded value.
+  uint64_t buckets[LATENCY_BUCKETS]; ///< Number of values in every bucket.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct LatencyHistogram LatencyHistogram;
+
+/**
+ * @brief Returns index of the bucket which @p value belongs to.
+ *
+ * @param value : value to find bucket of.
+ * @return size_t : index of the bucket.
+ */
+static inline size_t latency_bucket_index(uint64_t value) {
+  if (value < LATENCY_SUB_BUCKETS) {
+    return (size_t)value;
+  }
+
+  size_t magnitude = 63u - (size_t)__builtin_clzll(value);
+  size_t shift = magnitude - LATENCY_SUB_BUCKET_BITS;
+
+  return (shift + 1u) * LATENCY_SUB_BUCKETS +
+         (size_t)((value >> shift) & (LATENCY_SUB_BUCKETS - 1u));
+}
+
+/**
+ * @brief Returns smallest value which belongs to bucket @p index.
+ *
+ * @param index : index of the bucket.
+ * @return uint64_t : lower bound of the bucket.
+ */
+uint64_t latency_bucket_value(size_t index);
+
+/**
+ * @brief Clears histogram.
+ *
+ * @param[out] histogram : histogram to clear.
+ */
+void latency_histogram_init(LatencyHistogram *histogram);
+
+/**
+ * @brief Adds @p value to the histogram.
+ *
+ * @param[in, out] histogram : histogram to add value to.
+ * @param value : value to add.
+ */
+void latency_histogram_record(LatencyHistogram *histogram, uint64_t value);
+
+/**
+ * @brief Adds all values of @p source to @p destination.
+ *
+ * @param[in, out] destination : histogram to add values to.
+ * @param[in] source : histogram to read values from.
+ */
+void latency_histogram_merge(LatencyHistogram *destination,
+                             const LatencyHistogram *source);
+
+/**
+ * @brief Returns value below which lies given part of recorded values.
+ *
+ * @param[in] histogram : histogram to read.
+ * @param percentile : wanted percentile (from 0 to 100).
+ * @return uint64_t : lower bound of bucket holding the percentile (0 if
+ * histogram is empty).
+ */
+uint64_t latency_histogram_percentile(const LatencyHistogram *histogram,
+                                      double percentile);
+
+/**
+ * @brief Reads monotonic clock.
+ *
+ * @return uint64_t : time in nanoseconds.
+ */
+uint64_t latency_clock_ns(void);
+
+/**
+ * @brief Reads cheapest available timer (time stamp counter on x86, monotonic
+ * clock in nanoseconds elsewhere).
+ *
+ * @return uint64_t : timer value.
+ */
+static inline uint64_t latency_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return latency_clock_ns();
+#endif
+}
+
+/**
+ * @brief Merges histograms of all threads which have recorded any operation.
+ *
+ * @param[out] histograms : array of LATENCY_OPERATIONS histograms to fill.
+ * @return true : if library was built with timing enabled.
+ * @return false : if timing is disabled (histograms are cleared).
+ */
+bool latency_snapshot(LatencyHistogram *histograms);
+
+#ifdef PHFWD_LATENCY_STATS
+
+/**
+ * @brief Records duration of one operation in histogram of calling thread.
+ *
+ * @param operation : measured operation.
+ * @param ticks : duration of the operation.
+ */
+void latency_record(LatencyOperation operation, uint64_t ticks);
+
+/**
+ * @brief Starts measurement of operation by saving timer value to @p NAME.
+ */
+#define LATENCY_START(NAME) uint64_t NAME = latency_ticks();
+
+/**
+ * @brief Ends measurement started by LATENCY_START(NAME) and records it.
+ */
+#define LATENCY_STOP(OPERATION, NAME)                                          \
+  latency_record(OPERATION, latency_ticks() - NAME);
+
+#else
+
+/**
+ * @brief Timing is disabled, macro expands to nothing.
+ */
+#define LATENCY_START(NAME)
+
+/**
+ * @brief Timing is disabled, macro expands to nothing.
+ */
+#define LATENCY_STOP(OPERATION, NAME)
+
+#endif /* PHFWD_LATENCY_STATS */
+
+#endif /* __LATENCY_H__ */
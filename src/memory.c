@@ -0,0 +1,196 @@
+/**
+ * @file memory.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements allocation accounting declared in memory.h.
+ * @date 2022-05-07
+ */
+#include "memory.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#ifdef PHFWD_MEMORY_STATS
+
+/**
+ * @brief Counters of one tag, updated by threads using separate structures.
+ * Relaxed order is enough, as no other memory is published through them.
+ */
+struct AtomicCounters {
+  _Atomic size_t live_bytes;  ///< Bytes allocated and not yet freed.
+  _Atomic size_t peak_bytes;  ///< Maximal value of live_bytes ever reached.
+  _Atomic size_t allocations; ///< Number of performed allocations.
+  _Atomic size_t releases;    ///< Number of performed releases.
+};
+
+/**
+ * @brief Counters of every tag, last element stores total values.
+ */
+static struct AtomicCounters memory_tag_counters[MEMORY_TAG_COUNT + 1];
+
+/**
+ * @brief Header placed before every accounted memory block.
+ */
+union MemoryHeader {
+  struct {
+    size_t bytes;  ///< Size of the block requested by the user.
+    MemoryTag tag; ///< Tag the block is accounted to.
+  } info;                ///< Accounting information.
+  max_align_t alignment; ///< Keeps user's block properly aligned.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef union MemoryHeader MemoryHeader;
+
+/**
+ * @brief Adds @p bytes to counters of @p tag.
+ *
+ * @param tag : tag to account allocation to.
+ * @param bytes : size of allocated block.
+ */
+static void memory_account_allocation(MemoryTag tag, size_t bytes) {
+  struct AtomicCounters *counters[2] = {
+      &memory_tag_counters[tag], &memory_tag_counters[MEMORY_TAG_COUNT]};
+
+  for (size_t index = 0; index < 2; index++) {
+    size_t live = atomic_fetch_add_explicit(&counters[index]->live_bytes,
+                                            bytes, memory_order_relaxed) +
+                  bytes;
+    atomic_fetch_add_explicit(&counters[index]->allocations, 1u,
+                              memory_order_relaxed);
+
+    size_t peak = atomic_load_explicit(&counters[index]->peak_bytes,
+                                       memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(
+                              &counters[index]->peak_bytes, &peak, live,
+                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+  }
+}
+
+/**
+ * @brief Subtracts @p bytes from counters of @p tag.
+ *
+ * @param tag : tag to account release to.
+ * @param bytes : size of released block.
+ */
+static void memory_account_release(MemoryTag tag, size_t bytes) {
+  struct AtomicCounters *counters[2] = {
+      &memory_tag_counters[tag], &memory_tag_counters[MEMORY_TAG_COUNT]};
+
+  for (size_t index = 0; index < 2; index++) {
+    atomic_fetch_sub_explicit(&counters[index]->live_bytes, bytes,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&counters[index]->releases, 1u,
+                              memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Reads counters of one tag.
+ *
+ * @param[in] counters : counters to read.
+ * @param[out] result : place to save their values.
+ */
+static void memory_counters_load(struct AtomicCounters *counters,
+                                 MemoryCounters *result) {
+  result->live_bytes =
+      atomic_load_explicit(&counters->live_bytes, memory_order_relaxed);
+  result->peak_bytes =
+      atomic_load_explicit(&counters->peak_bytes, memory_order_relaxed);
+  result->allocations =
+      atomic_load_explicit(&counters->allocations, memory_order_relaxed);
+  result->releases =
+      atomic_load_explicit(&counters->releases, memory_order_relaxed);
+}
+
+void *wrap_malloc(size_t wanted_bytes, MemoryTag tag) {
+  if (wanted_bytes > SIZE_MAX - sizeof(MemoryHeader)) {
+    return NULL;
+  }
+
+  MemoryHeader *header = malloc(sizeof(MemoryHeader) + wanted_bytes);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->info.bytes = wanted_bytes;
+  header->info.tag = tag;
+  memory_account_allocation(tag, wanted_bytes);
+
+  return header + 1;
+}
+
+void *wrap_calloc(size_t members, size_t size_of_member, MemoryTag tag) {
+  if (size_of_member != 0 &&
+      members > (SIZE_MAX - sizeof(MemoryHeader)) / size_of_member) {
+    return NULL;
+  }
+
+  size_t wanted_bytes = members * size_of_member;
+  MemoryHeader *header = calloc(1u, sizeof(MemoryHeader) + wanted_bytes);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->info.bytes = wanted_bytes;
+  header->info.tag = tag;
+  memory_account_allocation(tag, wanted_bytes);
+
+  return header + 1;
+}
+
+void *wrap_realloc(void *memory_chunk, size_t wanted_bytes) {
+  if (memory_chunk == NULL) {
+    return wrap_malloc(wanted_bytes, MEMORY_TAG_OTHER);
+  }
+
+  if (wanted_bytes > SIZE_MAX - sizeof(MemoryHeader)) {
+    return NULL;
+  }
+
+  MemoryHeader *header = (MemoryHeader *)memory_chunk - 1;
+  size_t old_bytes = header->info.bytes;
+  MemoryTag tag = header->info.tag;
+
+  MemoryHeader *new_header =
+      realloc(header, sizeof(MemoryHeader) + wanted_bytes);
+  if (new_header == NULL) {
+    return NULL;
+  }
+
+  memory_account_release(tag, old_bytes);
+  memory_account_allocation(tag, wanted_bytes);
+  new_header->info.bytes = wanted_bytes;
+
+  return new_header + 1;
+}
+
+void wrap_free(void *memory_chunk) {
+  if (memory_chunk == NULL) {
+    return;
+  }
+
+  MemoryHeader *header = (MemoryHeader *)memory_chunk - 1;
+  memory_account_release(header->info.tag, header->info.bytes);
+
+  free(header);
+}
+
+#endif /* PHFWD_MEMORY_STATS */
+
+bool memory_counters_read(MemoryCounters *per_tag, MemoryCounters *total) {
+#ifdef PHFWD_MEMORY_STATS
+  for (size_t tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    memory_counters_load(&memory_tag_counters[tag], &per_tag[tag]);
+  }
+  memory_counters_load(&memory_tag_counters[MEMORY_TAG_COUNT], total);
+
+  return true;
+#else
+  memset(per_tag, 0, sizeof(struct MemoryCounters) * MEMORY_TAG_COUNT);
+  memset(total, 0, sizeof(struct MemoryCounters));
+
+  return false;
+#endif
+}
@@ -2,19 +2,120 @@
  * @file memory.h
  * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
  * @brief Module provides memory allocation wrappers which are used in program.
+ *
+ * Every allocation is tagged with subsystem it belongs to. If library is built
+ * with PHFWD_MEMORY_STATS defined, wrappers keep per-tag counters of live
+ * bytes, peak bytes and number of allocations. Otherwise tags are ignored and
+ * wrappers compile to plain calls of stdlib functions.
+ *
  * @date 2022-05-07
  */
 #ifndef __MEMORY_H__
 #define __MEMORY_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * @brief Subsystems to which allocated memory is accounted.
+ */
+enum MemoryTag {
+  MEMORY_TAG_TRIE_NODE,      ///< Trie nodes and trie bookkeeping.
+  MEMORY_TAG_EDGE_LABEL,     ///< Etiquettes of trie edges.
+  MEMORY_TAG_FORWARD_RECORD, ///< Forward records and forwarding strings.
+  MEMORY_TAG_REVERSE_LIST,   ///< Lists (and their elements) of reverses.
+  MEMORY_TAG_BRTREE,         ///< Nodes of Black-Red trees.
+  MEMORY_TAG_RESULTS,        ///< Query results and temporary arrays.
+  MEMORY_TAG_OTHER,          ///< Everything else.
+  MEMORY_TAG_COUNT           ///< Number of tags.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum MemoryTag MemoryTag;
+
+/**
+ * @brief Counters of allocations accounted to one tag.
+ */
+struct MemoryCounters {
+  size_t live_bytes;  ///< Bytes allocated and not yet freed.
+  size_t peak_bytes;  ///< Maximal value of live_bytes ever reached.
+  size_t allocations; ///< Number of performed allocations.
+  size_t releases;    ///< Number of performed releases.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct MemoryCounters MemoryCounters;
+
+/**
+ * @brief Reads current values of allocation counters. Counters are shared by
+ * all threads, so values read while other threads allocate needn't agree
+ * with each other.
+ *
+ * @param[out] per_tag : array of MEMORY_TAG_COUNT counters to fill.
+ * @param[out] total : place to save counters summed over all tags.
+ * @return true : if library was built with accounting enabled.
+ * @return false : if accounting is disabled (counters are zeroed).
+ */
+bool memory_counters_read(MemoryCounters *per_tag, MemoryCounters *total);
+
+#ifdef PHFWD_MEMORY_STATS
+
+/**
+ * @brief Function to wrap allocation by malloc.
+ *
+ * Block is preceded by a header with its size and tag. Accounted wrappers are
+ * defined in memory.c, so callers see them as opaque allocators.
+ *
+ * @param wanted_bytes : bytes of block to allocate.
+ * @param tag : subsystem to account allocation to.
+ * @return void* : pointer to beggining of the block, allocated by malloc.
+ */
+void *wrap_malloc(size_t wanted_bytes, MemoryTag tag);
+
+/**
+ * @brief Function to wrap allocation by calloc.
+ *
+ * @param members : number of objects to allocate.
+ * @param size_of_member : size of one object in bytes.
+ * @param tag : subsystem to account allocation to.
+ * @return void* : pointer to beggining of allocated memory block.
+ */
+void *wrap_calloc(size_t members, size_t size_of_member, MemoryTag tag);
+
+/**
+ * @brief Function to wrap reallocation by realloc.
+ *
+ * Reallocated block stays accounted to the tag it was allocated with.
+ *
+ * @param[in] memory_chunk : pointer to beggining of memory chunk to reallocate.
+ * @param wanted_bytes : wanted size of new memory chunk.
+ * @return void* : result of realloc() function.
+ */
+void *wrap_realloc(void *memory_chunk, size_t wanted_bytes);
+
+/**
+ * @brief Function to wrap memory release by free.
+ *
+ * @param[in] memory_chunk : pointer to beggining of memory chunk to free.
+ */
+void wrap_free(void *memory_chunk);
+
+#else
+
 /**
  * @brief Function to wrap allocation by malloc.
  *
  * @param wanted_bytes : bytes of block to allocate.
+ * @param tag : subsystem to account allocation to (ignored).
  * @return void* : pointer to beggining of the block, allocated by malloc.
  */
-static inline void *wrap_malloc(size_t wanted_bytes) {
+static inline void *wrap_malloc(size_t wanted_bytes, MemoryTag tag) {
+  (void)tag;
   return malloc(wanted_bytes);
 }
 
@@ -23,9 +124,12 @@ static inline void *wrap_malloc(size_t wanted_bytes) {
  *
  * @param members : number of objects to allocate.
  * @param size_of_member : size of one object in bytes.
+ * @param tag : subsystem to account allocation to (ignored).
  * @return void* : pointer to beggining of allocated memory block.
  */
-static inline void *wrap_calloc(size_t members, size_t size_of_member) {
+static inline void *wrap_calloc(size_t members, size_t size_of_member,
+                                MemoryTag tag) {
+  (void)tag;
   return calloc(members, size_of_member);
 }
 
@@ -47,4 +151,6 @@ static inline void *wrap_realloc(void *memory_chunk, size_t wanted_bytes) {
  */
 static inline void wrap_free(void *memory_chunk) { free(memory_chunk); }
 
-#endif /* __MEMORY_H__ */
\ No newline at end of file
+#endif /* PHFWD_MEMORY_STATS */
+
+#endif /* __MEMORY_H__ */
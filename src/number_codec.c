@@ -0,0 +1,291 @@
+/**
+ * @file number_codec.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in number_codec.h.
+ * @date 2022-06-19
+ */
+#include "number_codec.h"
+#include "memory.h"
+#include "string_lib.h"
+#include <string.h>
+
+/**
+ * @brief CRC-32 of every nibble value, for computing checksum 4 bits at once.
+ */
+static const uint32_t crc32_nibbles[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+/**
+ * @brief Checks if @p number consists only of digits.
+ *
+ * @param[in] number : string to check.
+ * @param length : length of @p number.
+ * @return true : if @p number can be packed.
+ * @return false : if @p number must be saved raw.
+ */
+static bool is_packable(const char *number, size_t length) {
+  for (size_t index = 0; index < length; index++) {
+    char symbol = number[index];
+
+    if (!((symbol >= '0' && symbol <= '9') || symbol == '*' ||
+          symbol == '#')) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Returns number of bytes of encoded number payload.
+ *
+ * @param length : length of the number.
+ * @param raw : true if number is saved raw.
+ * @return size_t : size of payload.
+ */
+static inline size_t payload_size(size_t length, bool raw) {
+  return raw ? length : (length + 1) / 2;
+}
+
+/**
+ * @brief Makes sure that @p buffer can store @p wanted bytes.
+ *
+ * @param[in, out] buffer : address of growable buffer.
+ * @param[in, out] capacity : capacity of @p buffer.
+ * @param wanted : wanted capacity.
+ * @return true : if buffer is big enough.
+ * @return false : if memory error has occured.
+ */
+static bool ensure_capacity(char **buffer, size_t *capacity, size_t wanted) {
+  if (*buffer != NULL && *capacity >= wanted) {
+    return true;
+  }
+
+  char *new_buffer = *buffer == NULL
+                         ? wrap_malloc(wanted, MEMORY_TAG_OTHER)
+                         : wrap_realloc(*buffer, wanted);
+  if (new_buffer == NULL) {
+    return false;
+  }
+
+  *buffer = new_buffer;
+  *capacity = wanted;
+  return true;
+}
+
+/**
+ * @brief Decodes payload of a number.
+ *
+ * @param[in] payload : encoded payload.
+ * @param length : length of the number.
+ * @param raw : true if number was saved raw.
+ * @param[out] output : place to save decoded string (length + 1 bytes).
+ */
+static void unpack_number(const uint8_t *payload, size_t length, bool raw,
+                          char *output) {
+  if (raw) {
+    memcpy(output, payload, length);
+  } else {
+    for (size_t index = 0; index < length; index++) {
+      uint8_t packed = payload[index / 2];
+      size_t digit = index % 2 == 0 ? (size_t)(packed >> 4)
+                                    : (size_t)(packed & 0x0F);
+
+      output[index] = char_undigitize(digit);
+    }
+  }
+
+  output[length] = '\0';
+}
+
+size_t codec_put_varint(uint8_t *output, uint64_t value) {
+  size_t written = 0;
+
+  while (value >= 0x80) {
+    output[written++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  output[written++] = (uint8_t)value;
+
+  return written;
+}
+
+size_t codec_number_size(const char *number) {
+  uint8_t header[CODEC_MAX_VARINT];
+  size_t length = strlen(number);
+  bool raw = !is_packable(number, length);
+
+  return codec_put_varint(header, ((uint64_t)length << 1) | raw) +
+         payload_size(length, raw);
+}
+
+size_t codec_put_number(uint8_t *output, const char *number) {
+  size_t length = strlen(number);
+  bool raw = !is_packable(number, length);
+  size_t written = codec_put_varint(output, ((uint64_t)length << 1) | raw);
+
+  if (raw) {
+    memcpy(output + written, number, length);
+    return written + length;
+  }
+
+  for (size_t index = 0; index < length; index += 2) {
+    uint8_t packed = (uint8_t)(char_digitize(number[index]) << 4);
+
+    if (index + 1 < length) {
+      packed |= (uint8_t)char_digitize(number[index + 1]);
+    }
+
+    output[written++] = packed;
+  }
+
+  return written;
+}
+
+size_t codec_get_varint(const uint8_t *input, size_t available,
+                        uint64_t *value) {
+  uint64_t result = 0;
+
+  for (size_t index = 0; index < available && index < CODEC_MAX_VARINT;
+       index++) {
+    result |= (uint64_t)(input[index] & 0x7F) << (7 * index);
+
+    if ((input[index] & 0x80) == 0) {
+      *value = result;
+      return index + 1;
+    }
+  }
+
+  return 0;
+}
+
+size_t codec_get_number(const uint8_t *input, size_t available, char **buffer,
+                        size_t *capacity) {
+  uint64_t header;
+  size_t read = codec_get_varint(input, available, &header);
+  if (read == 0) {
+    return 0;
+  }
+
+  size_t length = (size_t)(header >> 1);
+  bool raw = (header & 1) != 0;
+  size_t payload = payload_size(length, raw);
+
+  if (available - read < payload ||
+      !ensure_capacity(buffer, capacity, length + 1)) {
+    return 0;
+  }
+
+  unpack_number(input + read, length, raw, *buffer);
+  return read + payload;
+}
+
+bool codec_write_varint(FILE *stream, uint64_t value) {
+  uint8_t encoded[CODEC_MAX_VARINT];
+  size_t size = codec_put_varint(encoded, value);
+
+  return fwrite(encoded, 1, size, stream) == size;
+}
+
+bool codec_write_number(FILE *stream, const char *number) {
+  uint8_t header[CODEC_MAX_VARINT];
+  size_t length = strlen(number);
+  bool raw = !is_packable(number, length);
+  size_t header_size =
+      codec_put_varint(header, ((uint64_t)length << 1) | raw);
+
+  if (fwrite(header, 1, header_size, stream) != header_size) {
+    return false;
+  }
+
+  if (raw) {
+    return fwrite(number, 1, length, stream) == length;
+  }
+
+  for (size_t index = 0; index < length; index += 2) {
+    int packed = (int)(char_digitize(number[index]) << 4);
+
+    if (index + 1 < length) {
+      packed |= (int)char_digitize(number[index + 1]);
+    }
+
+    if (putc(packed, stream) == EOF) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool codec_read_varint(FILE *stream, uint64_t *value) {
+  uint64_t result = 0;
+
+  for (size_t index = 0; index < CODEC_MAX_VARINT; index++) {
+    int byte = getc(stream);
+    if (byte == EOF) {
+      return false;
+    }
+
+    result |= (uint64_t)(byte & 0x7F) << (7 * index);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool codec_read_number(FILE *stream, char **buffer, size_t *capacity) {
+  uint64_t header;
+  if (!codec_read_varint(stream, &header)) {
+    return false;
+  }
+
+  size_t length = (size_t)(header >> 1);
+  bool raw = (header & 1) != 0;
+  size_t payload = payload_size(length, raw);
+
+  // Payload is read to the end of buffer, which is big enough for it.
+  if (!ensure_capacity(buffer, capacity, length + 1 + payload)) {
+    return false;
+  }
+
+  uint8_t *payload_place = (uint8_t *)*buffer + length + 1;
+  if (fread(payload_place, 1, payload, stream) != payload) {
+    return false;
+  }
+
+  unpack_number(payload_place, length, raw, *buffer);
+  return true;
+}
+
+void codec_put_u32(uint8_t *output, uint32_t value) {
+  for (size_t index = 0; index < 4; index++) {
+    output[index] = (uint8_t)(value >> (8 * index));
+  }
+}
+
+uint32_t codec_get_u32(const uint8_t *input) {
+  uint32_t value = 0;
+
+  for (size_t index = 0; index < 4; index++) {
+    value |= (uint32_t)input[index] << (8 * index);
+  }
+
+  return value;
+}
+
+uint32_t codec_crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  crc = ~crc;
+
+  for (size_t index = 0; index < size; index++) {
+    crc ^= data[index];
+    crc = (crc >> 4) ^ crc32_nibbles[crc & 0x0F];
+    crc = (crc >> 4) ^ crc32_nibbles[crc & 0x0F];
+  }
+
+  return ~crc;
+}
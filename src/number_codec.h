@@ -0,0 +1,148 @@
+/**
+ * @file number_codec.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module provides compact binary encoding of numbers and integers.
+ *
+ * Integers are encoded as LEB128 varints. Phone numbers are encoded as varint
+ * header (length << 1 | raw flag) followed by digits packed two per byte
+ * (values of char_digitize(), high nibble first). Strings which are not
+ * numbers are saved byte by byte with raw flag set, so every string can be
+ * encoded. Fixed-size integers are little endian and checksums are CRC-32
+ * (polynomial of zlib).
+ *
+ * @date 2022-06-19
+ */
+#ifndef __NUMBER_CODEC_H__
+#define __NUMBER_CODEC_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Maximal size of encoded varint in bytes.
+ */
+#define CODEC_MAX_VARINT 10
+
+/**
+ * @brief Encodes @p value as varint.
+ *
+ * @param[out] output : place to write encoding to (CODEC_MAX_VARINT bytes).
+ * @param value : value to encode.
+ * @return size_t : number of written bytes.
+ */
+size_t codec_put_varint(uint8_t *output, uint64_t value);
+
+/**
+ * @brief Returns size of encoding of @p number.
+ *
+ * @param[in] number : string to encode.
+ * @return size_t : number of bytes written by codec_put_number().
+ */
+size_t codec_number_size(const char *number);
+
+/**
+ * @brief Encodes @p number.
+ *
+ * @param[out] output : place to write encoding to (codec_number_size() bytes).
+ * @param[in] number : string to encode.
+ * @return size_t : number of written bytes.
+ */
+size_t codec_put_number(uint8_t *output, const char *number);
+
+/**
+ * @brief Decodes varint from buffer.
+ *
+ * @param[in] input : encoded bytes.
+ * @param available : number of bytes in @p input.
+ * @param[out] value : place to save decoded value.
+ * @return size_t : number of read bytes (0 if encoding is incomplete or
+ * invalid).
+ */
+size_t codec_get_varint(const uint8_t *input, size_t available,
+                        uint64_t *value);
+
+/**
+ * @brief Decodes number from buffer.
+ *
+ * @param[in] input : encoded bytes.
+ * @param available : number of bytes in @p input.
+ * @param[in, out] buffer : address of growable buffer (allocated by
+ * wrap_malloc, may point to NULL) to save decoded string to.
+ * @param[in, out] capacity : capacity of @p buffer.
+ * @return size_t : number of read bytes (0 if encoding is incomplete or
+ * memory error has occured).
+ */
+size_t codec_get_number(const uint8_t *input, size_t available, char **buffer,
+                        size_t *capacity);
+
+/**
+ * @brief Writes varint to the stream.
+ *
+ * @param[in, out] stream : stream to write to.
+ * @param value : value to write.
+ * @return true : if value was written.
+ * @return false : if writing has failed.
+ */
+bool codec_write_varint(FILE *stream, uint64_t value);
+
+/**
+ * @brief Writes encoded number to the stream.
+ *
+ * @param[in, out] stream : stream to write to.
+ * @param[in] number : string to write.
+ * @return true : if number was written.
+ * @return false : if writing has failed.
+ */
+bool codec_write_number(FILE *stream, const char *number);
+
+/**
+ * @brief Reads varint from the stream.
+ *
+ * @param[in, out] stream : stream to read from.
+ * @param[out] value : place to save read value.
+ * @return true : if value was read.
+ * @return false : if stream has ended or encoding is invalid.
+ */
+bool codec_read_varint(FILE *stream, uint64_t *value);
+
+/**
+ * @brief Reads encoded number from the stream.
+ *
+ * @param[in, out] stream : stream to read from.
+ * @param[in, out] buffer : address of growable buffer (allocated by
+ * wrap_malloc, may point to NULL) to save decoded string to.
+ * @param[in, out] capacity : capacity of @p buffer.
+ * @return true : if number was read.
+ * @return false : if stream has ended, encoding is invalid or memory error
+ * has occured.
+ */
+bool codec_read_number(FILE *stream, char **buffer, size_t *capacity);
+
+/**
+ * @brief Writes @p value as 4 little endian bytes.
+ *
+ * @param[out] output : place to write value to.
+ * @param value : value to write.
+ */
+void codec_put_u32(uint8_t *output, uint32_t value);
+
+/**
+ * @brief Reads 4 little endian bytes.
+ *
+ * @param[in] input : bytes to read.
+ * @return uint32_t : read value.
+ */
+uint32_t codec_get_u32(const uint8_t *input);
+
+/**
+ * @brief Updates CRC-32 checksum with @p size bytes of @p data.
+ *
+ * @param crc : checksum of previous data (0 at the beginning).
+ * @param[in] data : checksummed bytes.
+ * @param size : number of bytes.
+ * @return uint32_t : checksum of previous data followed by @p data.
+ */
+uint32_t codec_crc32(uint32_t crc, const uint8_t *data, size_t size);
+
+#endif /* __NUMBER_CODEC_H__ */
@@ -0,0 +1,191 @@
+/**
+ * @file operation_log.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in operation_log.h.
+ * @date 2022-06-19
+ */
+#include "operation_log.h"
+#include "latency.h"
+#include "memory.h"
+#include "number_codec.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Size of stream buffers used by logs.
+ */
+#define LOG_BUFFER_SIZE (1u << 20)
+
+/**
+ * @brief Length of magic bytes.
+ */
+#define MAGIC_LENGTH (sizeof(OPERATION_LOG_MAGIC) - 1)
+
+/**
+ * @brief Struct to manage log opened for writing.
+ */
+struct OperationLog {
+  FILE *stream;            ///< Stream of the log file.
+  char *stream_buffer;     ///< Buffer of @p stream.
+  uint64_t last_timestamp; ///< Time of previous record (0 before first).
+  bool failed;             ///< True if any write has failed.
+};
+
+/**
+ * @brief Struct to manage log opened for reading.
+ */
+struct OperationLogReader {
+  FILE *stream;         ///< Stream of the log file.
+  char *stream_buffer;  ///< Buffer of @p stream.
+  uint64_t timestamp;   ///< Time of previously read record.
+  char *first;          ///< Buffer for first argument.
+  size_t first_size;    ///< Capacity of @p first.
+  char *second;         ///< Buffer for second argument.
+  size_t second_size;   ///< Capacity of @p second.
+};
+
+OperationLog *operation_log_open(const char *path) {
+  OperationLog *log =
+      wrap_malloc(sizeof(struct OperationLog), MEMORY_TAG_OTHER);
+  if (log == NULL) {
+    return NULL;
+  }
+
+  log->stream_buffer = wrap_malloc(LOG_BUFFER_SIZE, MEMORY_TAG_OTHER);
+  if (log->stream_buffer == NULL) {
+    wrap_free(log);
+    return NULL;
+  }
+
+  log->stream = fopen(path, "wb");
+  if (log->stream == NULL) {
+    wrap_free(log->stream_buffer);
+    wrap_free(log);
+    return NULL;
+  }
+
+  setvbuf(log->stream, log->stream_buffer, _IOFBF, LOG_BUFFER_SIZE);
+  log->last_timestamp = 0;
+  log->failed = fwrite(OPERATION_LOG_MAGIC, 1, MAGIC_LENGTH, log->stream) !=
+                    MAGIC_LENGTH ||
+                putc(OPERATION_LOG_VERSION, log->stream) == EOF;
+
+  return log;
+}
+
+void operation_log_append(OperationLog *log, LogOperation operation,
+                          const char *first, const char *second) {
+  if (log->failed) {
+    return;
+  }
+
+  uint64_t now = latency_clock_ns();
+  uint64_t delta = log->last_timestamp == 0 ? 0 : now - log->last_timestamp;
+  log->last_timestamp = now;
+
+  if (putc((int)operation, log->stream) == EOF ||
+      !codec_write_varint(log->stream, delta) ||
+      !codec_write_number(log->stream, first) ||
+      (second != NULL && !codec_write_number(log->stream, second))) {
+    log->failed = true;
+  }
+}
+
+bool operation_log_close(OperationLog *log) {
+  if (log == NULL) {
+    return true;
+  }
+
+  bool success = !log->failed;
+  if (fclose(log->stream) != 0) {
+    success = false;
+  }
+
+  wrap_free(log->stream_buffer);
+  wrap_free(log);
+
+  return success;
+}
+
+OperationLogReader *operation_log_reader_open(const char *path) {
+  OperationLogReader *reader =
+      wrap_calloc(1u, sizeof(struct OperationLogReader), MEMORY_TAG_OTHER);
+  if (reader == NULL) {
+    return NULL;
+  }
+
+  reader->stream_buffer = wrap_malloc(LOG_BUFFER_SIZE, MEMORY_TAG_OTHER);
+  if (reader->stream_buffer == NULL) {
+    wrap_free(reader);
+    return NULL;
+  }
+
+  reader->stream = fopen(path, "rb");
+  if (reader->stream == NULL) {
+    wrap_free(reader->stream_buffer);
+    wrap_free(reader);
+    return NULL;
+  }
+
+  setvbuf(reader->stream, reader->stream_buffer, _IOFBF, LOG_BUFFER_SIZE);
+
+  char magic[MAGIC_LENGTH];
+  if (fread(magic, 1, MAGIC_LENGTH, reader->stream) != MAGIC_LENGTH ||
+      memcmp(magic, OPERATION_LOG_MAGIC, MAGIC_LENGTH) != 0 ||
+      getc(reader->stream) != OPERATION_LOG_VERSION) {
+    operation_log_reader_close(reader);
+    return NULL;
+  }
+
+  return reader;
+}
+
+bool operation_log_read(OperationLogReader *reader, LogRecord *record,
+                        bool *error) {
+  int operation = getc(reader->stream);
+  uint64_t delta;
+
+  // Only end of file in place of the next record is a clean end of the log.
+  if (operation == EOF && !ferror(reader->stream)) {
+    return false;
+  }
+
+  if (operation < LOG_ADD || operation > LOG_REVERSE ||
+      !codec_read_varint(reader->stream, &delta) ||
+      !codec_read_number(reader->stream, &reader->first,
+                         &reader->first_size)) {
+    *error = true;
+    return false;
+  }
+
+  record->operation = (LogOperation)operation;
+  record->first = reader->first;
+  record->second = NULL;
+
+  if (operation == LOG_ADD) {
+    if (!codec_read_number(reader->stream, &reader->second,
+                           &reader->second_size)) {
+      *error = true;
+      return false;
+    }
+
+    record->second = reader->second;
+  }
+
+  reader->timestamp += delta;
+  record->timestamp = reader->timestamp;
+
+  return true;
+}
+
+void operation_log_reader_close(OperationLogReader *reader) {
+  if (reader == NULL) {
+    return;
+  }
+
+  fclose(reader->stream);
+  wrap_free(reader->stream_buffer);
+  wrap_free(reader->first);
+  wrap_free(reader->second);
+  wrap_free(reader);
+}
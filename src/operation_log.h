@@ -0,0 +1,141 @@
+/**
+ * @file operation_log.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Interface of module writing and reading binary logs of library calls.
+ *
+ * Log starts with OPERATION_LOG_MAGIC and version byte. Every record consists
+ * of operation byte, varint time since previous record (in nanoseconds) and
+ * arguments of the call encoded by number_codec.h (two for additions, one
+ * otherwise).
+ *
+ * @date 2022-06-19
+ */
+#ifndef __OPERATION_LOG_H__
+#define __OPERATION_LOG_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Magic bytes at the beggining of every log.
+ */
+#define OPERATION_LOG_MAGIC "PHFWDLOG"
+
+/**
+ * @brief Version of log format.
+ */
+#define OPERATION_LOG_VERSION 1
+
+/**
+ * @brief Logged operations.
+ */
+enum LogOperation {
+  LOG_ADD = 1,     ///< phfwdAdd call.
+  LOG_REMOVE = 2,  ///< phfwdRemove call.
+  LOG_GET = 3,     ///< phfwdGet call.
+  LOG_REVERSE = 4, ///< phfwdReverse call.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum LogOperation LogOperation;
+
+/**
+ * @brief Structure representing log opened for writing.
+ */
+struct OperationLog;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct OperationLog OperationLog;
+
+/**
+ * @brief Structure representing log opened for reading.
+ */
+struct OperationLogReader;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct OperationLogReader OperationLogReader;
+
+/**
+ * @brief One record read from the log.
+ *
+ * Strings are owned by the reader and are valid until next read.
+ */
+struct LogRecord {
+  LogOperation operation; ///< Logged operation.
+  uint64_t timestamp;     ///< Nanoseconds since the first record.
+  const char *first;      ///< First argument of the call.
+  const char *second;     ///< Second argument (NULL if call had one).
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct LogRecord LogRecord;
+
+/**
+ * @brief Creates (or truncates) log file and writes its header.
+ *
+ * @param[in] path : path of the log file.
+ * @return OperationLog* : opened log (NULL if file could not be created or
+ * memory error has occured).
+ */
+OperationLog *operation_log_open(const char *path);
+
+/**
+ * @brief Appends record of one call to the log.
+ *
+ * After first failed write log stops recording and operation_log_close()
+ * reports the failure.
+ *
+ * @param[in, out] log : log to append record to.
+ * @param operation : logged operation.
+ * @param[in] first : first argument of the call.
+ * @param[in] second : second argument of the call (NULL if call has one).
+ */
+void operation_log_append(OperationLog *log, LogOperation operation,
+                          const char *first, const char *second);
+
+/**
+ * @brief Flushes and closes the log.
+ *
+ * @param[in] log : log to close (may be NULL).
+ * @return true : if every record was written.
+ * @return false : if any write has failed.
+ */
+bool operation_log_close(OperationLog *log);
+
+/**
+ * @brief Opens log for reading and checks its header.
+ *
+ * @param[in] path : path of the log file.
+ * @return OperationLogReader* : opened log (NULL if file can't be read, isn't
+ * a log or memory error has occured).
+ */
+OperationLogReader *operation_log_reader_open(const char *path);
+
+/**
+ * @brief Reads next record of the log.
+ *
+ * @param[in, out] reader : log to read from.
+ * @param[out] record : place to save read record.
+ * @param[out] error : set to true if next record is truncated, invalid or
+ * can't be read (unchanged otherwise).
+ * @return true : if record was read.
+ * @return false : if log has ended or @p error was set.
+ */
+bool operation_log_read(OperationLogReader *reader, LogRecord *record,
+                        bool *error);
+
+/**
+ * @brief Closes log opened for reading.
+ *
+ * @param[in] reader : log to close (may be NULL).
+ */
+void operation_log_reader_close(OperationLogReader *reader);
+
+#endif /* __OPERATION_LOG_H__ */
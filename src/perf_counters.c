@@ -0,0 +1,197 @@
+/**
+ * @file perf_counters.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in perf_counters.h.
+ * @date 2022-06-12
+ */
+#define _GNU_SOURCE
+#include "perf_counters.h"
+#include "memory.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Struct to store descriptors of opened counters.
+ */
+struct PerfCounters {
+  int descriptors[PERF_EVENTS]; ///< Descriptor of every event (-1 if event is
+                                ///< unavailable).
+};
+
+/**
+ * @brief Names of events, in order of PerfEvent.
+ */
+static const char *const perf_event_names[PERF_EVENTS] = {
+    "cycles",
+    "instructions",
+    "L1d-misses",
+    "LLC-misses",
+    "branch-misses",
+    "dTLB-misses",
+};
+
+#ifdef __linux__
+
+/**
+ * @brief Builds config of cache event for perf_event_open.
+ *
+ * @param cache : cache identifier.
+ * @return uint64_t : config of read miss event of the cache.
+ */
+static inline uint64_t cache_read_miss(uint64_t cache) {
+  return cache | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+/**
+ * @brief Opens counter of one event for the calling thread.
+ *
+ * @param event : event to open counter of.
+ * @return int : descriptor of the counter (-1 if event is unavailable).
+ */
+static int open_event(PerfEvent event) {
+  struct perf_event_attr attributes = {0};
+
+  attributes.size = sizeof(struct perf_event_attr);
+  attributes.disabled = 1;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  attributes.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  switch (event) {
+  case PERF_CYCLES:
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PERF_INSTRUCTIONS:
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PERF_L1D_MISSES:
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = cache_read_miss(PERF_COUNT_HW_CACHE_L1D);
+    break;
+  case PERF_LLC_MISSES:
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  case PERF_BRANCH_MISSES:
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  case PERF_DTLB_MISSES:
+    attributes.type = PERF_TYPE_HW_CACHE;
+    attributes.config = cache_read_miss(PERF_COUNT_HW_CACHE_DTLB);
+    break;
+  default:
+    return -1;
+  }
+
+  long descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+  return descriptor < 0 ? -1 : (int)descriptor;
+}
+
+#endif /* __linux__ */
+
+PerfCounters *init_perf_counters(bool *memory_error) {
+  PerfCounters *counters =
+      wrap_malloc(sizeof(struct PerfCounters), MEMORY_TAG_OTHER);
+  if (counters == NULL) {
+    *memory_error = true;
+    return NULL;
+  }
+
+  for (size_t event = 0; event < PERF_EVENTS; event++) {
+#ifdef __linux__
+    counters->descriptors[event] = open_event((PerfEvent)event);
+#else
+    counters->descriptors[event] = -1;
+#endif
+  }
+
+  return counters;
+}
+
+bool perf_counters_available(const PerfCounters *counters, PerfEvent event) {
+  return counters->descriptors[event] >= 0;
+}
+
+bool perf_counters_any_available(const PerfCounters *counters) {
+  for (size_t event = 0; event < PERF_EVENTS; event++) {
+    if (counters->descriptors[event] >= 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void perf_counters_start(PerfCounters *counters) {
+#ifdef __linux__
+  for (size_t event = 0; event < PERF_EVENTS; event++) {
+    if (counters->descriptors[event] >= 0) {
+      ioctl(counters->descriptors[event], PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters->descriptors[event], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#else
+  (void)counters;
+#endif
+}
+
+void perf_counters_stop(PerfCounters *counters, uint64_t *values) {
+  for (size_t event = 0; event < PERF_EVENTS; event++) {
+    values[event] = 0;
+
+#ifdef __linux__
+    if (counters->descriptors[event] < 0) {
+      continue;
+    }
+
+    // Value, time enabled and time running (see PERF_FORMAT_TOTAL_TIME_*).
+    uint64_t read_values[3];
+
+    ioctl(counters->descriptors[event], PERF_EVENT_IOC_DISABLE, 0);
+    if (read(counters->descriptors[event], read_values, sizeof(read_values)) !=
+        (ssize_t)sizeof(read_values)) {
+      continue;
+    }
+
+    if (read_values[2] != 0 && read_values[2] < read_values[1]) {
+      values[event] = (uint64_t)((double)read_values[0] *
+                                 (double)read_values[1] /
+                                 (double)read_values[2]);
+    } else {
+      values[event] = read_values[0];
+    }
+#else
+    (void)counters;
+#endif
+  }
+}
+
+const char *perf_event_name(PerfEvent event) {
+  return perf_event_names[event];
+}
+
+void perf_counters_drop(PerfCounters *counters) {
+  if (counters == NULL) {
+    return;
+  }
+
+#ifdef __linux__
+  for (size_t event = 0; event < PERF_EVENTS; event++) {
+    if (counters->descriptors[event] >= 0) {
+      close(counters->descriptors[event]);
+    }
+  }
+#endif
+
+  wrap_free(counters);
+}
@@ -0,0 +1,107 @@
+/**
+ * @file perf_counters.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Interface of module reading hardware performance counters.
+ *
+ * Counters are read by perf_event_open(2) on Linux. Every event is opened
+ * separately, so events unsupported by processor, kernel or container do not
+ * disable the others. On other systems all events are unavailable.
+ *
+ * @date 2022-06-12
+ */
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Hardware events which are counted.
+ */
+enum PerfEvent {
+  PERF_CYCLES,        ///< CPU cycles.
+  PERF_INSTRUCTIONS,  ///< Retired instructions.
+  PERF_L1D_MISSES,    ///< Level 1 data cache read misses.
+  PERF_LLC_MISSES,    ///< Last level cache misses.
+  PERF_BRANCH_MISSES, ///< Mispredicted branches.
+  PERF_DTLB_MISSES,   ///< Data TLB read misses.
+  PERF_EVENTS         ///< Number of events.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum PerfEvent PerfEvent;
+
+/**
+ * @brief Structure holding opened counters.
+ */
+struct PerfCounters;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct PerfCounters PerfCounters;
+
+/**
+ * @brief Opens counters of all events for the calling thread.
+ *
+ * Events which can't be opened are marked as unavailable.
+ *
+ * @param[out] memory_error : set to true if memory error has occured.
+ * @return PerfCounters* : opened counters (NULL if memory error).
+ */
+PerfCounters *init_perf_counters(bool *memory_error);
+
+/**
+ * @brief Checks if given event is counted.
+ *
+ * @param[in] counters : counters to check.
+ * @param event : event to check.
+ * @return true : if @p event is counted.
+ * @return false : if @p event could not be opened.
+ */
+bool perf_counters_available(const PerfCounters *counters, PerfEvent event);
+
+/**
+ * @brief Checks if at least one event is counted.
+ *
+ * @param[in] counters : counters to check.
+ * @return true : if any event is counted.
+ * @return false : if no event could be opened.
+ */
+bool perf_counters_any_available(const PerfCounters *counters);
+
+/**
+ * @brief Resets and starts all available counters.
+ *
+ * @param[in, out] counters : counters to start.
+ */
+void perf_counters_start(PerfCounters *counters);
+
+/**
+ * @brief Stops all available counters and reads their values.
+ *
+ * Values are scaled if kernel was multiplexing counters. Values of unavailable
+ * events are set to 0.
+ *
+ * @param[in, out] counters : counters to stop.
+ * @param[out] values : array of PERF_EVENTS values to fill.
+ */
+void perf_counters_stop(PerfCounters *counters, uint64_t *values);
+
+/**
+ * @brief Returns short name of the event.
+ *
+ * @param event : event to name.
+ * @return const char* : name of the event.
+ */
+const char *perf_event_name(PerfEvent event);
+
+/**
+ * @brief Closes counters and frees the structure.
+ *
+ * @param[in] counters : counters to drop.
+ */
+void perf_counters_drop(PerfCounters *counters);
+
+#endif /* __PERF_COUNTERS_H__ */
@@ -0,0 +1,394 @@
+/**
+ * @file phfwd_batch.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Program executing stream of commands on one structure.
+ *
+ * Every line of input holds one command:
+ *   ADD num1 num2  – adds forward (prints nothing),
+ *   REMOVE num     – removes forwards (prints nothing),
+ *   GET num        – prints forward of the number,
+ *   REVERSE num    – prints reverses of the number separated by spaces.
+ * Empty lines are skipped, malformed lines are reported on standard error.
+ *
+ * Regular files are mapped into memory, other inputs are read in big chunks.
+ * Lines are tokenized in place and results are collected in one output
+ * buffer, so no data is copied per token.
+ *
+ * Usage: phfwd_batch [file]
+ *
+ * @date 2022-06-19
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "phone_forward.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of input chunk read from streams.
+ */
+#define INPUT_CHUNK (1u << 20)
+
+/**
+ * @brief Size of output buffer.
+ */
+#define OUTPUT_BUFFER (1u << 20)
+
+/**
+ * @brief Maximal number of tokens in a command.
+ */
+#define MAX_TOKENS 3
+
+/**
+ * @brief Buffered writer of the standard output.
+ */
+struct Output {
+  char *buffer;  ///< Collected output.
+  size_t length; ///< Number of bytes in @p buffer.
+  bool failed;   ///< True if any write has failed.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct Output Output;
+
+/**
+ * @brief State of command processing.
+ */
+struct Batch {
+  PhoneForward *pf;    ///< Structure commands are executed at.
+  Output output;       ///< Writer of results.
+  size_t line;         ///< Number of processed lines.
+  size_t errors;       ///< Number of malformed lines.
+  bool memory_error;   ///< True if library has run out of memory.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct Batch Batch;
+
+/**
+ * @brief Writes whole buffer to the standard output.
+ *
+ * @param[in, out] output : writer to flush.
+ */
+static void output_flush(Output *output) {
+  size_t written = 0;
+
+  while (written < output->length && !output->failed) {
+    ssize_t result = write(STDOUT_FILENO, output->buffer + written,
+                           output->length - written);
+
+    if (result < 0 && errno != EINTR) {
+      output->failed = true;
+    } else if (result > 0) {
+      written += (size_t)result;
+    }
+  }
+
+  output->length = 0;
+}
+
+/**
+ * @brief Appends bytes to the output.
+ *
+ * @param[in, out] output : writer to append to.
+ * @param[in] data : appended bytes.
+ * @param length : number of appended bytes.
+ */
+static void output_append(Output *output, const char *data, size_t length) {
+  if (OUTPUT_BUFFER - output->length < length) {
+    output_flush(output);
+  }
+
+  if (length > OUTPUT_BUFFER) {
+    // Data which doesn't fit is written directly.
+    Output direct = {(char *)data, length, output->failed};
+
+    output_flush(&direct);
+    output->failed = direct.failed;
+    return;
+  }
+
+  memcpy(output->buffer + output->length, data, length);
+  output->length += length;
+}
+
+/**
+ * @brief Checks if @p symbol separates tokens.
+ *
+ * @param symbol : checked character.
+ * @return true : if @p symbol is a blank.
+ * @return false : otherwise.
+ */
+static inline bool is_blank(char symbol) {
+  return symbol == ' ' || symbol == '\t' || symbol == '\r' || symbol == '\0';
+}
+
+/**
+ * @brief Prints numbers on one line separated by spaces.
+ *
+ * @param[in, out] batch : state of processing.
+ * @param[in] numbers : numbers to print (NULL on memory error).
+ */
+static void print_numbers(Batch *batch, PhoneNumbers *numbers) {
+  if (numbers == NULL) {
+    batch->memory_error = true;
+    return;
+  }
+
+  const char *number;
+  for (size_t index = 0; (number = phnumGet(numbers, index)) != NULL;
+       index++) {
+    if (index > 0) {
+      output_append(&batch->output, " ", 1);
+    }
+    output_append(&batch->output, number, strlen(number));
+  }
+  output_append(&batch->output, "\n", 1);
+
+  phnumDelete(numbers);
+}
+
+/**
+ * @brief Tokenizes line in place and executes its command.
+ *
+ * @param[in, out] batch : state of processing.
+ * @param[in, out] line : processed line (without newline).
+ * @param length : length of @p line.
+ */
+static void process_line(Batch *batch, char *line, size_t length) {
+  char *tokens[MAX_TOKENS + 1];
+  size_t count = 0;
+  size_t index = 0;
+
+  batch->line++;
+
+  while (index < length) {
+    while (index < length && is_blank(line[index])) {
+      index++;
+    }
+    if (index == length) {
+      break;
+    }
+
+    if (count == MAX_TOKENS) {
+      count++;
+      break;
+    }
+
+    tokens[count++] = line + index;
+    while (index < length && !is_blank(line[index])) {
+      index++;
+    }
+    line[index++] = '\0';
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  if (count == 3 && strcmp(tokens[0], "ADD") == 0) {
+    phfwdAdd(batch->pf, tokens[1], tokens[2]);
+  } else if (count == 2 && strcmp(tokens[0], "REMOVE") == 0) {
+    phfwdRemove(batch->pf, tokens[1]);
+  } else if (count == 2 && strcmp(tokens[0], "GET") == 0) {
+    print_numbers(batch, phfwdGet(batch->pf, tokens[1]));
+  } else if (count == 2 && strcmp(tokens[0], "REVERSE") == 0) {
+    print_numbers(batch, phfwdReverse(batch->pf, tokens[1]));
+  } else {
+    batch->errors++;
+    fprintf(stderr, "Malformed command in line %zu.\n", batch->line);
+  }
+}
+
+/**
+ * @brief Processes all complete lines of the buffer.
+ *
+ * @param[in, out] batch : state of processing.
+ * @param[in, out] data : buffer with lines.
+ * @param length : number of bytes in @p data.
+ * @return size_t : number of processed bytes (beginning of incomplete line).
+ */
+static size_t process_lines(Batch *batch, char *data, size_t length) {
+  size_t begin = 0;
+  char *end;
+
+  while (begin < length &&
+         (end = memchr(data + begin, '\n', length - begin)) != NULL) {
+    size_t line_length = (size_t)(end - (data + begin));
+
+    process_line(batch, data + begin, line_length);
+    begin += line_length + 1;
+  }
+
+  return begin;
+}
+
+/**
+ * @brief Processes input mapped into memory.
+ *
+ * Mapping is private, so tokenizing in place doesn't change the file. Last
+ * line without newline is copied, because it can't be terminated in place.
+ *
+ * @param[in, out] batch : state of processing.
+ * @param descriptor : descriptor of regular file.
+ * @param size : size of the file.
+ * @return true : if input was processed.
+ * @return false : if input couldn't be mapped or memory error has occured.
+ */
+static bool process_mapped(Batch *batch, int descriptor, size_t size) {
+  if (size == 0) {
+    return true;
+  }
+
+  char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    descriptor, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+  size_t processed = process_lines(batch, data, size);
+  bool success = true;
+
+  if (processed < size) {
+    size_t rest = size - processed;
+    char *last = malloc(rest + 1);
+
+    if (last == NULL) {
+      success = false;
+    } else {
+      memcpy(last, data + processed, rest);
+      last[rest] = '\0';
+      process_line(batch, last, rest);
+      free(last);
+    }
+  }
+
+  munmap(data, size);
+  return success;
+}
+
+/**
+ * @brief Processes input read in chunks.
+ *
+ * Incomplete line at the end of a chunk is moved to the beginning of the
+ * buffer, which grows if a single line doesn't fit.
+ *
+ * @param[in, out] batch : state of processing.
+ * @param descriptor : descriptor of the input.
+ * @return true : if input was processed.
+ * @return false : if reading has failed or memory error has occured.
+ */
+static bool process_stream(Batch *batch, int descriptor) {
+  size_t capacity = INPUT_CHUNK;
+  size_t length = 0;
+  char *data = malloc(capacity + 1);
+
+  if (data == NULL) {
+    return false;
+  }
+
+  while (true) {
+    if (length == capacity) {
+      char *bigger = realloc(data, 2 * capacity + 1);
+      if (bigger == NULL) {
+        free(data);
+        return false;
+      }
+
+      data = bigger;
+      capacity *= 2;
+    }
+
+    ssize_t result = read(descriptor, data + length, capacity - length);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      free(data);
+      return false;
+    }
+
+    if (result == 0) {
+      break;
+    }
+
+    length += (size_t)result;
+    size_t processed = process_lines(batch, data, length);
+
+    memmove(data, data + processed, length - processed);
+    length -= processed;
+  }
+
+  if (length > 0) {
+    data[length] = '\0';
+    process_line(batch, data, length);
+  }
+
+  free(data);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: %s [file]\n", argv[0]);
+    return 1;
+  }
+
+  int descriptor = STDIN_FILENO;
+  if (argc == 2 && strcmp(argv[1], "-") != 0) {
+    descriptor = open(argv[1], O_RDONLY);
+    if (descriptor < 0) {
+      fprintf(stderr, "Can't open %s.\n", argv[1]);
+      return 1;
+    }
+  }
+
+  Batch batch = {phfwdNew(), {malloc(OUTPUT_BUFFER), 0, false}, 0, 0, false};
+  if (batch.pf == NULL || batch.output.buffer == NULL) {
+    phfwdDelete(batch.pf);
+    free(batch.output.buffer);
+    fprintf(stderr, "Memory error while creating structure.\n");
+    return 1;
+  }
+
+  struct stat status;
+  bool processed = false;
+
+  if (fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode)) {
+    processed = process_mapped(&batch, descriptor, (size_t)status.st_size);
+  }
+  if (!processed && batch.line == 0) {
+    processed = process_stream(&batch, descriptor);
+  }
+
+  output_flush(&batch.output);
+
+  if (!processed) {
+    fprintf(stderr, "Error while reading input.\n");
+  }
+  if (batch.memory_error) {
+    fprintf(stderr, "Memory error while executing commands.\n");
+  }
+
+  if (descriptor != STDIN_FILENO) {
+    close(descriptor);
+  }
+  phfwdDelete(batch.pf);
+  free(batch.output.buffer);
+
+  return processed && !batch.memory_error && batch.errors == 0 &&
+                 !batch.output.failed
+             ? 0
+             : 1;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file phfwd_client.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in phfwd_client.h.
+ * @date 2022-06-20
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "phfwd_client.h"
+#include "memory.h"
+#include "phfwd_protocol.h"
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief Struct to manage connection to the server.
+ */
+struct PhfwdClient {
+  int socket;                ///< Connected socket.
+  ProtocolBuffer output;     ///< Requests which weren't sent yet.
+  ProtocolBuffer input;      ///< Received bytes which weren't decoded yet.
+  ProtocolBuffer operations; ///< Operations of pending requests, one byte
+                             ///< per request.
+  ProtocolResponse response; ///< Last decoded response.
+};
+
+/**
+ * @brief Queues request.
+ *
+ * @param[in, out] client : client to queue request at.
+ * @param operation : requested operation.
+ * @param[in] first : first argument.
+ * @param[in] second : second argument (used only by PROTOCOL_ADD).
+ * @return true : if request was queued.
+ * @return false : if arguments are invalid or memory error has occured.
+ */
+static bool queue_request(PhfwdClient *client, ProtocolOperation operation,
+                          const char *first, const char *second) {
+  if (client == NULL || first == NULL ||
+      (operation == PROTOCOL_ADD && second == NULL)) {
+    return false;
+  }
+
+  // Server rejects longer numbers by closing the connection.
+  if (strlen(first) > PROTOCOL_MAX_NUMBER ||
+      (operation == PROTOCOL_ADD && strlen(second) > PROTOCOL_MAX_NUMBER)) {
+    return false;
+  }
+
+  if (!protocol_buffer_reserve(&client->operations, 1) ||
+      !protocol_put_request(&client->output, operation, first, second)) {
+    return false;
+  }
+
+  client->operations.data[client->operations.end++] = (uint8_t)operation;
+  return true;
+}
+
+PhfwdClient *phfwd_client_connect(const char *path) {
+  struct sockaddr_un address;
+
+  if (path == NULL || strlen(path) >= sizeof(address.sun_path)) {
+    return NULL;
+  }
+
+  PhfwdClient *client =
+      wrap_calloc(1u, sizeof(struct PhfwdClient), MEMORY_TAG_OTHER);
+  if (client == NULL) {
+    return NULL;
+  }
+
+  client->socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (client->socket < 0) {
+    wrap_free(client);
+    return NULL;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  if (connect(client->socket, (struct sockaddr *)&address, sizeof(address)) !=
+      0) {
+    close(client->socket);
+    wrap_free(client);
+    return NULL;
+  }
+
+  return client;
+}
+
+bool phfwd_client_add(PhfwdClient *client, const char *num1,
+                      const char *num2) {
+  return queue_request(client, PROTOCOL_ADD, num1, num2);
+}
+
+bool phfwd_client_remove(PhfwdClient *client, const char *num) {
+  return queue_request(client, PROTOCOL_REMOVE, num, NULL);
+}
+
+bool phfwd_client_get(PhfwdClient *client, const char *num) {
+  return queue_request(client, PROTOCOL_GET, num, NULL);
+}
+
+bool phfwd_client_reverse(PhfwdClient *client, const char *num) {
+  return queue_request(client, PROTOCOL_REVERSE, num, NULL);
+}
+
+/**
+ * @brief Reads available bytes from the socket.
+ *
+ * @param[in, out] client : client to read at.
+ * @return true : if bytes were read.
+ * @return false : if connection was closed or has failed.
+ */
+static bool receive_bytes(PhfwdClient *client) {
+  ProtocolBuffer *input = &client->input;
+
+  if (!protocol_buffer_reserve(input, PROTOCOL_READ_CHUNK)) {
+    return false;
+  }
+
+  ssize_t received;
+  do {
+    received = read(client->socket, input->data + input->end,
+                    input->capacity - input->end);
+  } while (received < 0 && errno == EINTR);
+
+  if (received <= 0) {
+    return false;
+  }
+
+  input->end += (size_t)received;
+  return true;
+}
+
+bool phfwd_client_flush(PhfwdClient *client) {
+  if (client == NULL) {
+    return false;
+  }
+
+  ProtocolBuffer *output = &client->output;
+  while (protocol_buffer_size(output) > 0) {
+    // Responses are read meanwhile, so server never waits for the client.
+    struct pollfd descriptor = {client->socket, POLLIN | POLLOUT, 0};
+
+    if (poll(&descriptor, 1, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    if ((descriptor.revents & POLLIN) != 0 && !receive_bytes(client)) {
+      return false;
+    }
+
+    if ((descriptor.revents & POLLOUT) != 0) {
+      ssize_t written = send(client->socket, output->data + output->begin,
+                             protocol_buffer_size(output), MSG_NOSIGNAL);
+
+      if (written < 0 && errno != EINTR && errno != EAGAIN) {
+        return false;
+      }
+      if (written > 0) {
+        protocol_buffer_consume(output, (size_t)written);
+      }
+    } else if ((descriptor.revents & (POLLERR | POLLHUP)) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t phfwd_client_pending(const PhfwdClient *client) {
+  return client == NULL ? 0 : protocol_buffer_size(&client->operations);
+}
+
+bool phfwd_client_receive(PhfwdClient *client, PhfwdResponse *response) {
+  if (client == NULL || response == NULL ||
+      protocol_buffer_size(&client->operations) == 0) {
+    return false;
+  }
+
+  if (!phfwd_client_flush(client)) {
+    return false;
+  }
+
+  ProtocolBuffer *input = &client->input;
+  ProtocolOperation operation =
+      (ProtocolOperation)client->operations.data[client->operations.begin];
+
+  while (true) {
+    bool invalid = false;
+    size_t decoded = protocol_get_response(
+        input->data + input->begin, protocol_buffer_size(input), operation,
+        &client->response, &invalid);
+
+    if (invalid) {
+      return false;
+    }
+
+    if (decoded > 0) {
+      protocol_buffer_consume(input, decoded);
+      protocol_buffer_consume(&client->operations, 1);
+      break;
+    }
+
+    if (!receive_bytes(client)) {
+      return false;
+    }
+  }
+
+  response->operation = (int)operation;
+  response->success = client->response.status == PROTOCOL_OK;
+  response->count = client->response.count;
+  response->numbers = (const char *const *)client->response.numbers;
+
+  return true;
+}
+
+void phfwd_client_close(PhfwdClient *client) {
+  if (client == NULL) {
+    return;
+  }
+
+  close(client->socket);
+  protocol_buffer_drop(&client->output);
+  protocol_buffer_drop(&client->input);
+  protocol_buffer_drop(&client->operations);
+  protocol_response_drop(&client->response);
+  wrap_free(client);
+}
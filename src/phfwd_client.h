@@ -0,0 +1,136 @@
+/**
+ * @file phfwd_client.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Interface of client library of phfwd_server.
+ *
+ * Requests are queued by phfwd_client_add(), phfwd_client_remove(),
+ * phfwd_client_get() and phfwd_client_reverse() and sent together by
+ * phfwd_client_flush() (or automatically, when phfwd_client_receive() waits
+ * for a response to a request which wasn't sent yet). Responses are received
+ * in order of requests, so many requests can be pipelined.
+ *
+ * @date 2022-06-20
+ */
+#ifndef __PHFWD_CLIENT_H__
+#define __PHFWD_CLIENT_H__
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Structure representing connection to the server.
+ */
+struct PhfwdClient;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct PhfwdClient PhfwdClient;
+
+/**
+ * @brief Response of the server. Numbers are owned by the client and are
+ * valid until next call to phfwd_client_receive().
+ */
+struct PhfwdResponse {
+  int operation;               ///< Operation of answered request
+                               ///< (ProtocolOperation value).
+  bool success;                ///< False if call has failed on the server.
+  size_t count;                ///< Number of results.
+  const char *const *numbers;  ///< Results of PROTOCOL_GET and
+                               ///< PROTOCOL_REVERSE requests.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct PhfwdResponse PhfwdResponse;
+
+/**
+ * @brief Connects to the server listening at Unix socket @p path.
+ *
+ * @param[in] path : path of the socket.
+ * @return PhfwdClient* : connected client (NULL if connection has failed or
+ * memory error has occured).
+ */
+PhfwdClient *phfwd_client_connect(const char *path);
+
+/**
+ * @brief Queues addition of forward.
+ *
+ * @param[in, out] client : client to queue request at.
+ * @param[in] num1 : prefix of forwarded numbers.
+ * @param[in] num2 : prefix which @p num1 is replaced with.
+ * @return true : if request was queued.
+ * @return false : if a number is longer than PROTOCOL_MAX_NUMBER or memory
+ * error has occured.
+ */
+bool phfwd_client_add(PhfwdClient *client, const char *num1, const char *num2);
+
+/**
+ * @brief Queues removal of forwards.
+ *
+ * @param[in, out] client : client to queue request at.
+ * @param[in] num : prefix of removed forwards.
+ * @return true : if request was queued.
+ * @return false : if @p num is longer than PROTOCOL_MAX_NUMBER or memory
+ * error has occured.
+ */
+bool phfwd_client_remove(PhfwdClient *client, const char *num);
+
+/**
+ * @brief Queues forward lookup.
+ *
+ * @param[in, out] client : client to queue request at.
+ * @param[in] num : number to forward.
+ * @return true : if request was queued.
+ * @return false : if @p num is longer than PROTOCOL_MAX_NUMBER or memory
+ * error has occured.
+ */
+bool phfwd_client_get(PhfwdClient *client, const char *num);
+
+/**
+ * @brief Queues reverse lookup.
+ *
+ * @param[in, out] client : client to queue request at.
+ * @param[in] num : number to find reverses of.
+ * @return true : if request was queued.
+ * @return false : if @p num is longer than PROTOCOL_MAX_NUMBER or memory
+ * error has occured.
+ */
+bool phfwd_client_reverse(PhfwdClient *client, const char *num);
+
+/**
+ * @brief Sends all queued requests.
+ *
+ * @param[in, out] client : client to send requests of.
+ * @return true : if requests were sent.
+ * @return false : if connection has failed.
+ */
+bool phfwd_client_flush(PhfwdClient *client);
+
+/**
+ * @brief Returns number of requests which weren't answered yet.
+ *
+ * @param[in] client : checked client.
+ * @return size_t : number of pending requests.
+ */
+size_t phfwd_client_pending(const PhfwdClient *client);
+
+/**
+ * @brief Waits for response to the oldest pending request.
+ *
+ * @param[in, out] client : client to receive response at.
+ * @param[out] response : place to save response.
+ * @return true : if response was received.
+ * @return false : if there is no pending request, connection has failed or
+ * memory error has occured.
+ */
+bool phfwd_client_receive(PhfwdClient *client, PhfwdResponse *response);
+
+/**
+ * @brief Closes connection and frees the client.
+ *
+ * @param[in] client : client to close (may be NULL).
+ */
+void phfwd_client_close(PhfwdClient *client);
+
+#endif /* __PHFWD_CLIENT_H__ */
@@ -0,0 +1,322 @@
+/**
+ * @file phfwd_protocol.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in phfwd_protocol.h.
+ * @date 2022-06-20
+ */
+#include "phfwd_protocol.h"
+#include "memory.h"
+#include "number_codec.h"
+#include <string.h>
+
+/**
+ * @brief Returns size of encoded number at the beginning of @p input.
+ *
+ * @param[in] input : received bytes.
+ * @param available : number of bytes in @p input.
+ * @param max_length : maximal accepted length of the number.
+ * @param[out] invalid : set to true if number is longer than @p max_length.
+ * @return size_t : size of encoding (0 if it is incomplete or too long).
+ */
+static size_t encoded_number_size(const uint8_t *input, size_t available,
+                                  uint64_t max_length, bool *invalid) {
+  uint64_t header;
+  size_t read = codec_get_varint(input, available, &header);
+  if (read == 0) {
+    return 0;
+  }
+
+  uint64_t length = header >> 1;
+  if (length > max_length) {
+    *invalid = true;
+    return 0;
+  }
+  uint64_t payload = (header & 1) != 0 ? length : (length + 1) / 2;
+
+  return available - read < payload ? 0 : read + (size_t)payload;
+}
+
+/**
+ * @brief Decodes one number of a message.
+ *
+ * @param[in] input : received bytes.
+ * @param available : number of bytes in @p input.
+ * @param[in, out] buffer : address of buffer to save number to.
+ * @param[in, out] capacity : capacity of @p buffer.
+ * @param max_length : maximal accepted length of the number.
+ * @param[out] invalid : set to true if number is too long or memory error has
+ * occured.
+ * @return size_t : number of read bytes (0 if number is incomplete).
+ */
+static size_t get_number(const uint8_t *input, size_t available,
+                         char **buffer, size_t *capacity, uint64_t max_length,
+                         bool *invalid) {
+  size_t size = encoded_number_size(input, available, max_length, invalid);
+  if (size == 0) {
+    return 0;
+  }
+
+  if (codec_get_number(input, available, buffer, capacity) == 0) {
+    *invalid = true;
+    return 0;
+  }
+
+  return size;
+}
+
+bool protocol_buffer_reserve(ProtocolBuffer *buffer, size_t extra) {
+  size_t size = protocol_buffer_size(buffer);
+
+  if (buffer->begin > 0) {
+    memmove(buffer->data, buffer->data + buffer->begin, size);
+    buffer->begin = 0;
+    buffer->end = size;
+  }
+
+  if (buffer->capacity - size >= extra) {
+    return true;
+  }
+
+  size_t capacity = buffer->capacity == 0 ? PROTOCOL_READ_CHUNK
+                                          : 2 * buffer->capacity;
+  while (capacity - size < extra) {
+    capacity *= 2;
+  }
+
+  uint8_t *data = buffer->data == NULL
+                      ? wrap_malloc(capacity, MEMORY_TAG_OTHER)
+                      : wrap_realloc(buffer->data, capacity);
+  if (data == NULL) {
+    return false;
+  }
+
+  buffer->data = data;
+  buffer->capacity = capacity;
+  return true;
+}
+
+void protocol_buffer_consume(ProtocolBuffer *buffer, size_t size) {
+  buffer->begin += size;
+
+  if (buffer->begin == buffer->end) {
+    buffer->begin = 0;
+    buffer->end = 0;
+  }
+}
+
+void protocol_buffer_drop(ProtocolBuffer *buffer) {
+  wrap_free(buffer->data);
+  buffer->data = NULL;
+  buffer->begin = 0;
+  buffer->end = 0;
+  buffer->capacity = 0;
+}
+
+bool protocol_put_request(ProtocolBuffer *buffer, ProtocolOperation operation,
+                          const char *first, const char *second) {
+  size_t size = 1 + codec_number_size(first);
+  if (operation == PROTOCOL_ADD) {
+    size += codec_number_size(second);
+  }
+
+  if (!protocol_buffer_reserve(buffer, size)) {
+    return false;
+  }
+
+  uint8_t *output = buffer->data + buffer->end;
+  *output++ = (uint8_t)operation;
+  output += codec_put_number(output, first);
+  if (operation == PROTOCOL_ADD) {
+    codec_put_number(output, second);
+  }
+
+  buffer->end += size;
+  return true;
+}
+
+size_t protocol_get_request(const uint8_t *input, size_t available,
+                            ProtocolRequest *request, bool *invalid) {
+  if (available == 0) {
+    return 0;
+  }
+
+  if (input[0] < PROTOCOL_ADD || input[0] > PROTOCOL_REVERSE) {
+    *invalid = true;
+    return 0;
+  }
+
+  size_t read = 1;
+  size_t size = get_number(input + read, available - read, &request->first,
+                           &request->first_size, PROTOCOL_MAX_NUMBER, invalid);
+  if (size == 0) {
+    return 0;
+  }
+  read += size;
+
+  if (input[0] == PROTOCOL_ADD) {
+    size = get_number(input + read, available - read, &request->second,
+                      &request->second_size, PROTOCOL_MAX_NUMBER, invalid);
+    if (size == 0) {
+      return 0;
+    }
+    read += size;
+  }
+
+  request->operation = (ProtocolOperation)input[0];
+  return read;
+}
+
+void protocol_request_drop(ProtocolRequest *request) {
+  wrap_free(request->first);
+  wrap_free(request->second);
+  request->first = NULL;
+  request->second = NULL;
+  request->first_size = 0;
+  request->second_size = 0;
+}
+
+/**
+ * @brief Makes sure that response has at least @p count result buffers.
+ *
+ * @param[in, out] response : response to grow.
+ * @param count : wanted number of buffers.
+ * @return true : if response has enough buffers.
+ * @return false : if memory error has occured.
+ */
+static bool reserve_numbers(ProtocolResponse *response, size_t count) {
+  if (response->capacity >= count) {
+    return true;
+  }
+
+  size_t capacity = response->capacity == 0 ? 16 : response->capacity;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  char **numbers = response->numbers == NULL
+                       ? wrap_malloc(capacity * sizeof(char *),
+                                     MEMORY_TAG_OTHER)
+                       : wrap_realloc(response->numbers,
+                                      capacity * sizeof(char *));
+  if (numbers == NULL) {
+    return false;
+  }
+  response->numbers = numbers;
+
+  size_t *sizes = response->sizes == NULL
+                      ? wrap_malloc(capacity * sizeof(size_t),
+                                    MEMORY_TAG_OTHER)
+                      : wrap_realloc(response->sizes,
+                                     capacity * sizeof(size_t));
+  if (sizes == NULL) {
+    return false;
+  }
+  response->sizes = sizes;
+
+  for (size_t index = response->capacity; index < capacity; index++) {
+    numbers[index] = NULL;
+    sizes[index] = 0;
+  }
+  response->capacity = capacity;
+
+  return true;
+}
+
+size_t protocol_get_response(const uint8_t *input, size_t available,
+                             ProtocolOperation operation,
+                             ProtocolResponse *response, bool *invalid) {
+  if (available == 0) {
+    return 0;
+  }
+
+  response->status = (ProtocolStatus)input[0];
+  response->count = 0;
+
+  if (input[0] != PROTOCOL_OK ||
+      (operation != PROTOCOL_GET && operation != PROTOCOL_REVERSE)) {
+    return 1;
+  }
+
+  uint64_t count;
+  size_t read = codec_get_varint(input + 1, available - 1, &count);
+  if (read == 0) {
+    return 0;
+  }
+  read++;
+
+  // Every result takes at least one byte, so bigger count is incomplete.
+  if (count > available - read) {
+    return 0;
+  }
+
+  if (!reserve_numbers(response, (size_t)count)) {
+    *invalid = true;
+    return 0;
+  }
+
+  for (size_t index = 0; index < count; index++) {
+    size_t size =
+        get_number(input + read, available - read, &response->numbers[index],
+                   &response->sizes[index], UINT64_MAX, invalid);
+    if (size == 0) {
+      return 0;
+    }
+    read += size;
+  }
+
+  response->count = (size_t)count;
+  return read;
+}
+
+void protocol_response_drop(ProtocolResponse *response) {
+  for (size_t index = 0; index < response->capacity; index++) {
+    wrap_free(response->numbers[index]);
+  }
+
+  wrap_free(response->numbers);
+  wrap_free(response->sizes);
+  response->numbers = NULL;
+  response->sizes = NULL;
+  response->capacity = 0;
+  response->count = 0;
+}
+
+bool protocol_put_status(ProtocolBuffer *buffer, ProtocolStatus status) {
+  if (!protocol_buffer_reserve(buffer, 1)) {
+    return false;
+  }
+
+  buffer->data[buffer->end++] = (uint8_t)status;
+  return true;
+}
+
+bool protocol_put_numbers(ProtocolBuffer *buffer, const PhoneNumbers *numbers) {
+  size_t count = 0;
+  size_t size = 1;
+  const char *number;
+
+  while ((number = phnumGet(numbers, count)) != NULL) {
+    size += codec_number_size(number);
+    count++;
+  }
+
+  uint8_t header[CODEC_MAX_VARINT];
+  size_t header_size = codec_put_varint(header, count);
+  size += header_size;
+
+  if (!protocol_buffer_reserve(buffer, size)) {
+    return false;
+  }
+
+  uint8_t *output = buffer->data + buffer->end;
+  *output++ = PROTOCOL_OK;
+  memcpy(output, header, header_size);
+  output += header_size;
+
+  for (size_t index = 0; index < count; index++) {
+    output += codec_put_number(output, phnumGet(numbers, index));
+  }
+
+  buffer->end += size;
+  return true;
+}
@@ -0,0 +1,224 @@
+/**
+ * @file phfwd_protocol.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Binary protocol spoken by phfwd_server and its clients.
+ *
+ * Request consists of operation byte followed by its arguments encoded by
+ * number_codec.h (two for PROTOCOL_ADD, one otherwise). Response consists of
+ * status byte and, for successful PROTOCOL_GET and PROTOCOL_REVERSE, varint
+ * number of results followed by encoded results. Clients may send many
+ * requests without waiting; server answers them in order and writes
+ * responses to all requests read at once together.
+ *
+ * @date 2022-06-20
+ */
+#ifndef __PHFWD_PROTOCOL_H__
+#define __PHFWD_PROTOCOL_H__
+#include "phone_forward.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Minimal free space reserved before every read from a socket.
+ */
+#define PROTOCOL_READ_CHUNK (1u << 16)
+
+/**
+ * @brief Maximal length of a number in a request. Request with a longer
+ * number is invalid.
+ */
+#define PROTOCOL_MAX_NUMBER 512u
+
+/**
+ * @brief Operations of the protocol.
+ */
+enum ProtocolOperation {
+  PROTOCOL_ADD = 1,     ///< phfwdAdd call.
+  PROTOCOL_REMOVE = 2,  ///< phfwdRemove call.
+  PROTOCOL_GET = 3,     ///< phfwdGet call.
+  PROTOCOL_REVERSE = 4, ///< phfwdReverse call.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum ProtocolOperation ProtocolOperation;
+
+/**
+ * @brief Statuses of responses.
+ */
+enum ProtocolStatus {
+  PROTOCOL_OK = 0,     ///< Call has succeeded.
+  PROTOCOL_FAILED = 1, ///< Call has failed (phfwdAdd returned false or server
+                       ///< has run out of memory).
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum ProtocolStatus ProtocolStatus;
+
+/**
+ * @brief Growable byte queue: bytes are appended at the end and consumed from
+ * the beginning.
+ */
+struct ProtocolBuffer {
+  uint8_t *data;   ///< Stored bytes.
+  size_t begin;    ///< Index of first unconsumed byte.
+  size_t end;      ///< Index after last stored byte.
+  size_t capacity; ///< Capacity of @p data.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct ProtocolBuffer ProtocolBuffer;
+
+/**
+ * @brief Decoded request. Buffers are reused by consecutive requests.
+ */
+struct ProtocolRequest {
+  ProtocolOperation operation; ///< Requested operation.
+  char *first;                 ///< First argument.
+  size_t first_size;           ///< Capacity of @p first.
+  char *second;                ///< Second argument (valid for PROTOCOL_ADD).
+  size_t second_size;          ///< Capacity of @p second.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct ProtocolRequest ProtocolRequest;
+
+/**
+ * @brief Decoded response. Buffers are reused by consecutive responses.
+ */
+struct ProtocolResponse {
+  ProtocolStatus status; ///< Status of the response.
+  size_t count;          ///< Number of results.
+  char **numbers;        ///< Buffers of results.
+  size_t *sizes;         ///< Capacities of buffers of results.
+  size_t capacity;       ///< Number of allocated buffers.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct ProtocolResponse ProtocolResponse;
+
+/**
+ * @brief Returns number of unconsumed bytes.
+ *
+ * @param[in] buffer : checked buffer.
+ * @return size_t : number of bytes.
+ */
+static inline size_t protocol_buffer_size(const ProtocolBuffer *buffer) {
+  return buffer->end - buffer->begin;
+}
+
+/**
+ * @brief Makes sure that @p extra bytes can be appended to the buffer.
+ *
+ * Unconsumed bytes are moved to the beginning, so reserved space is always
+ * placed at data + end.
+ *
+ * @param[in, out] buffer : buffer to reserve space in.
+ * @param extra : number of bytes to reserve.
+ * @return true : if space was reserved.
+ * @return false : if memory error has occured.
+ */
+bool protocol_buffer_reserve(ProtocolBuffer *buffer, size_t extra);
+
+/**
+ * @brief Consumes bytes from the beginning of the buffer.
+ *
+ * @param[in, out] buffer : buffer to consume from.
+ * @param size : number of consumed bytes.
+ */
+void protocol_buffer_consume(ProtocolBuffer *buffer, size_t size);
+
+/**
+ * @brief Frees memory used by the buffer.
+ *
+ * @param[in, out] buffer : buffer to clear.
+ */
+void protocol_buffer_drop(ProtocolBuffer *buffer);
+
+/**
+ * @brief Appends request to the buffer.
+ *
+ * @param[in, out] buffer : buffer to append to.
+ * @param operation : requested operation.
+ * @param[in] first : first argument.
+ * @param[in] second : second argument (used only by PROTOCOL_ADD).
+ * @return true : if request was appended.
+ * @return false : if memory error has occured.
+ */
+bool protocol_put_request(ProtocolBuffer *buffer, ProtocolOperation operation,
+                          const char *first, const char *second);
+
+/**
+ * @brief Decodes request from the beginning of @p input.
+ *
+ * @param[in] input : received bytes.
+ * @param available : number of bytes in @p input.
+ * @param[in, out] request : place to save decoded request.
+ * @param[out] invalid : set to true if request is invalid (also if one of
+ * its numbers is longer than PROTOCOL_MAX_NUMBER) or memory error has occured.
+ * @return size_t : number of read bytes (0 if request is incomplete or
+ * invalid).
+ */
+size_t protocol_get_request(const uint8_t *input, size_t available,
+                            ProtocolRequest *request, bool *invalid);
+
+/**
+ * @brief Frees buffers of the request.
+ *
+ * @param[in, out] request : request to clear.
+ */
+void protocol_request_drop(ProtocolRequest *request);
+
+/**
+ * @brief Decodes response from the beginning of @p input.
+ *
+ * @param[in] input : received bytes.
+ * @param available : number of bytes in @p input.
+ * @param operation : operation of answered request.
+ * @param[in, out] response : place to save decoded response.
+ * @param[out] invalid : set to true if memory error has occured.
+ * @return size_t : number of read bytes (0 if response is incomplete or
+ * memory error has occured).
+ */
+size_t protocol_get_response(const uint8_t *input, size_t available,
+                             ProtocolOperation operation,
+                             ProtocolResponse *response, bool *invalid);
+
+/**
+ * @brief Frees buffers of the response.
+ *
+ * @param[in, out] response : response to clear.
+ */
+void protocol_response_drop(ProtocolResponse *response);
+
+/**
+ * @brief Appends response without results to the buffer.
+ *
+ * @param[in, out] buffer : buffer to append to.
+ * @param status : status of the response.
+ * @return true : if response was appended.
+ * @return false : if memory error has occured.
+ */
+bool protocol_put_status(ProtocolBuffer *buffer, ProtocolStatus status);
+
+/**
+ * @brief Appends successful response with results to the buffer.
+ *
+ * @param[in, out] buffer : buffer to append to.
+ * @param[in] numbers : results of the call.
+ * @return true : if response was appended.
+ * @return false : if memory error has occured.
+ */
+bool protocol_put_numbers(ProtocolBuffer *buffer, const PhoneNumbers *numbers);
+
+#endif /* __PHFWD_PROTOCOL_H__ */
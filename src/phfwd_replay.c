@@ -0,0 +1,204 @@
+/**
+ * @file phfwd_replay.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Program replaying logs recorded by phfwdRecordStart.
+ *
+ * Program performs every recorded call on a fresh structure and reports
+ * throughput and latency distribution of every operation. By default calls
+ * are replayed as fast as possible, with -p they are paced like in the
+ * recording. Log which ends with truncated or invalid record is reported as
+ * an error.
+ *
+ * Usage: phfwd_replay [-p] log
+ *
+ * @date 2022-06-19
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "operation_log.h"
+#include "phone_forward.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Number of replayed operations.
+ */
+#define REPLAYED_OPERATIONS 4
+
+/**
+ * @brief Names of operations, in order of LogOperation.
+ */
+static const char *const operation_names[REPLAYED_OPERATIONS] = {
+    "add", "remove", "get", "reverse"};
+
+/**
+ * @brief Reported percentiles.
+ */
+static const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+/**
+ * @brief Number of reported percentiles.
+ */
+#define PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+/**
+ * @brief Sleeps until recorded time of the call.
+ *
+ * @param start : time when replay has started.
+ * @param timestamp : recorded time of the call since the first call.
+ */
+static void wait_until(uint64_t start, uint64_t timestamp) {
+  uint64_t now = latency_clock_ns();
+
+  if (now - start >= timestamp) {
+    return;
+  }
+
+  uint64_t remaining = timestamp - (now - start);
+  struct timespec pause = {.tv_sec = (time_t)(remaining / 1000000000u),
+                           .tv_nsec = (long)(remaining % 1000000000u)};
+
+  nanosleep(&pause, NULL);
+}
+
+/**
+ * @brief Performs recorded call.
+ *
+ * @param[in, out] pf : structure to perform call at.
+ * @param[in] record : recorded call.
+ */
+static void replay_record(PhoneForward *pf, const LogRecord *record) {
+  switch (record->operation) {
+  case LOG_ADD:
+    phfwdAdd(pf, record->first, record->second);
+    break;
+  case LOG_REMOVE:
+    phfwdRemove(pf, record->first);
+    break;
+  case LOG_GET:
+    phnumDelete(phfwdGet(pf, record->first));
+    break;
+  case LOG_REVERSE:
+    phnumDelete(phfwdReverse(pf, record->first));
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Prints row of the results table.
+ *
+ * @param[in] name : name of the row.
+ * @param[in] histogram : measured latencies.
+ */
+static void print_row(const char *name, const LatencyHistogram *histogram) {
+  printf("%-8s %10llu", name, (unsigned long long)histogram->count);
+
+  for (size_t index = 0; index < PERCENTILES; index++) {
+    printf(" %10llu", (unsigned long long)latency_histogram_percentile(
+                          histogram, percentiles[index]));
+  }
+
+  printf(" %10llu\n", (unsigned long long)histogram->max);
+}
+
+int main(int argc, char **argv) {
+  bool paced = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "p")) != -1) {
+    if (option == 'p') {
+      paced = true;
+    } else {
+      optind = argc + 1;
+      break;
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-p] log\n", argv[0]);
+    return 1;
+  }
+
+  OperationLogReader *reader = operation_log_reader_open(argv[optind]);
+  if (reader == NULL) {
+    fprintf(stderr, "Can't read log %s.\n", argv[optind]);
+    return 1;
+  }
+
+  LatencyHistogram *histograms =
+      malloc(sizeof(LatencyHistogram) * (REPLAYED_OPERATIONS + 1));
+  PhoneForward *pf = phfwdNew();
+  if (histograms == NULL || pf == NULL) {
+    phfwdDelete(pf);
+    free(histograms);
+    operation_log_reader_close(reader);
+    fprintf(stderr, "Memory error while creating structure.\n");
+    return 1;
+  }
+
+  for (size_t index = 0; index <= REPLAYED_OPERATIONS; index++) {
+    latency_histogram_init(&histograms[index]);
+  }
+
+  LogRecord record;
+  bool corrupted = false;
+  uint64_t start = latency_clock_ns();
+
+  while (operation_log_read(reader, &record, &corrupted)) {
+    if (paced) {
+      wait_until(start, record.timestamp);
+    }
+
+    uint64_t before = latency_clock_ns();
+    replay_record(pf, &record);
+    uint64_t elapsed = latency_clock_ns() - before;
+
+    latency_histogram_record(&histograms[record.operation - LOG_ADD],
+                             elapsed);
+  }
+
+  uint64_t wall = latency_clock_ns() - start;
+
+  if (corrupted) {
+    uint64_t replayed = 0;
+    for (size_t index = 0; index < REPLAYED_OPERATIONS; index++) {
+      replayed += histograms[index].count;
+    }
+
+    fprintf(stderr, "Log %s is truncated or corrupted after %llu calls.\n",
+            argv[optind], (unsigned long long)replayed);
+    phfwdDelete(pf);
+    free(histograms);
+    operation_log_reader_close(reader);
+    return 1;
+  }
+
+  for (size_t index = 0; index < REPLAYED_OPERATIONS; index++) {
+    latency_histogram_merge(&histograms[REPLAYED_OPERATIONS],
+                            &histograms[index]);
+  }
+
+  const LatencyHistogram *all = &histograms[REPLAYED_OPERATIONS];
+  double seconds = (double)wall / 1e9;
+
+  printf("replayed %llu calls in %.3f s (%.0f ops/s)\n",
+         (unsigned long long)all->count, seconds,
+         seconds > 0.0 ? (double)all->count / seconds : 0.0);
+  printf("%-8s %10s %10s %10s %10s %10s %10s\n", "op", "count", "p50 ns",
+         "p90 ns", "p99 ns", "p99.9 ns", "max ns");
+
+  for (size_t index = 0; index < REPLAYED_OPERATIONS; index++) {
+    print_row(operation_names[index], &histograms[index]);
+  }
+  print_row("all", all);
+
+  phfwdDelete(pf);
+  free(histograms);
+  operation_log_reader_close(reader);
+
+  return 0;
+}
@@ -0,0 +1,438 @@
+/**
+ * @file phfwd_server.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Server sharing one structure between many local clients.
+ *
+ * Server listens on Unix domain socket and serves all connections in one
+ * epoll event loop, speaking protocol described in phfwd_protocol.h. All
+ * complete requests read at once are executed and their responses are sent
+ * together. Connection which doesn't read its responses stops being read
+ * when OUTPUT_LIMIT bytes are waiting for it. Connection which sends a number
+ * longer than PROTOCOL_MAX_NUMBER, or INPUT_LIMIT bytes without a complete
+ * request, is closed. SIGINT and SIGTERM stop the server.
+ *
+ * Usage: phfwd_server socket
+ *
+ * @date 2022-06-20
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "memory.h"
+#include "phfwd_protocol.h"
+#include "phone_forward.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximal number of events handled by one epoll_wait call.
+ */
+#define MAX_EVENTS 64
+
+/**
+ * @brief Number of waiting output bytes which stops reading of a connection.
+ */
+#define OUTPUT_LIMIT (1u << 24)
+
+/**
+ * @brief Number of unread input bytes which makes a connection invalid. It is
+ * far above the size of the longest valid request.
+ */
+#define INPUT_LIMIT (1u << 16)
+
+/**
+ * @brief Struct to manage one client connection.
+ */
+struct Connection {
+  int socket;                ///< Socket of the connection.
+  uint32_t events;           ///< Events currently watched by epoll.
+  ProtocolBuffer input;      ///< Received bytes which weren't decoded yet.
+  ProtocolBuffer output;     ///< Responses which weren't sent yet.
+  struct Connection *next;   ///< Next open connection.
+  struct Connection *previous; ///< Previous open connection.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct Connection Connection;
+
+/**
+ * @brief State of the server.
+ */
+struct Server {
+  PhoneForward *pf;        ///< Served structure.
+  int epoll;               ///< Descriptor of epoll instance.
+  int listener;            ///< Listening socket.
+  Connection *connections; ///< List of open connections.
+  ProtocolRequest request; ///< Buffers of decoded request.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct Server Server;
+
+/**
+ * @brief Set by signal handler when server should stop.
+ */
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ * @brief Handler of SIGINT and SIGTERM.
+ *
+ * @param signal_number : received signal.
+ */
+static void stop_handler(int signal_number) {
+  (void)signal_number;
+  stopping = 1;
+}
+
+/**
+ * @brief Switches descriptor to non-blocking mode.
+ *
+ * @param descriptor : descriptor to switch.
+ * @return true : if mode was changed.
+ * @return false : otherwise.
+ */
+static bool set_nonblocking(int descriptor) {
+  int flags = fcntl(descriptor, F_GETFL, 0);
+
+  return flags >= 0 && fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+/**
+ * @brief Closes connection and frees its buffers.
+ *
+ * @param[in, out] server : state of the server.
+ * @param[in] connection : connection to close.
+ */
+static void close_connection(Server *server, Connection *connection) {
+  epoll_ctl(server->epoll, EPOLL_CTL_DEL, connection->socket, NULL);
+  close(connection->socket);
+
+  if (connection->previous != NULL) {
+    connection->previous->next = connection->next;
+  } else {
+    server->connections = connection->next;
+  }
+  if (connection->next != NULL) {
+    connection->next->previous = connection->previous;
+  }
+
+  protocol_buffer_drop(&connection->input);
+  protocol_buffer_drop(&connection->output);
+  wrap_free(connection);
+}
+
+/**
+ * @brief Accepts all waiting connections.
+ *
+ * @param[in, out] server : state of the server.
+ */
+static void accept_connections(Server *server) {
+  while (true) {
+    int descriptor = accept(server->listener, NULL, NULL);
+    if (descriptor < 0) {
+      return;
+    }
+
+    Connection *connection =
+        wrap_calloc(1u, sizeof(struct Connection), MEMORY_TAG_OTHER);
+    if (connection == NULL || !set_nonblocking(descriptor)) {
+      wrap_free(connection);
+      close(descriptor);
+      continue;
+    }
+
+    connection->socket = descriptor;
+    connection->events = EPOLLIN;
+
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+    if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+      wrap_free(connection);
+      close(descriptor);
+      continue;
+    }
+
+    connection->next = server->connections;
+    if (server->connections != NULL) {
+      server->connections->previous = connection;
+    }
+    server->connections = connection;
+  }
+}
+
+/**
+ * @brief Executes request and appends its response.
+ *
+ * @param[in, out] server : state of the server.
+ * @param[in, out] output : buffer to append response to.
+ * @return true : if response was appended.
+ * @return false : if memory error has occured.
+ */
+static bool execute_request(Server *server, ProtocolBuffer *output) {
+  ProtocolRequest *request = &server->request;
+  PhoneNumbers *numbers = NULL;
+  bool success;
+
+  switch (request->operation) {
+  case PROTOCOL_ADD:
+    return protocol_put_status(output,
+                               phfwdAdd(server->pf, request->first,
+                                        request->second)
+                                   ? PROTOCOL_OK
+                                   : PROTOCOL_FAILED);
+  case PROTOCOL_REMOVE:
+    phfwdRemove(server->pf, request->first);
+    return protocol_put_status(output, PROTOCOL_OK);
+  case PROTOCOL_GET:
+    numbers = phfwdGet(server->pf, request->first);
+    break;
+  case PROTOCOL_REVERSE:
+    numbers = phfwdReverse(server->pf, request->first);
+    break;
+  default:
+    break;
+  }
+
+  if (numbers == NULL) {
+    return protocol_put_status(output, PROTOCOL_FAILED);
+  }
+
+  success = protocol_put_numbers(output, numbers);
+  phnumDelete(numbers);
+
+  return success;
+}
+
+/**
+ * @brief Sends as much of waiting output as socket accepts and updates
+ * watched events.
+ *
+ * @param[in, out] server : state of the server.
+ * @param[in, out] connection : connection to send output of.
+ * @return true : if connection is still valid.
+ * @return false : if connection has failed.
+ */
+static bool send_output(Server *server, Connection *connection) {
+  ProtocolBuffer *output = &connection->output;
+
+  while (protocol_buffer_size(output) > 0) {
+    ssize_t written = send(connection->socket, output->data + output->begin,
+                           protocol_buffer_size(output), MSG_NOSIGNAL);
+
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      return false;
+    }
+
+    protocol_buffer_consume(output, (size_t)written);
+  }
+
+  size_t waiting = protocol_buffer_size(output);
+  uint32_t events = (waiting < OUTPUT_LIMIT ? EPOLLIN : 0u) |
+                    (waiting > 0 ? EPOLLOUT : 0u);
+
+  if (events != connection->events) {
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+
+    if (epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->socket, &event) !=
+        0) {
+      return false;
+    }
+    connection->events = events;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Reads available requests, executes them and sends responses.
+ *
+ * @param[in, out] server : state of the server.
+ * @param[in, out] connection : readable connection.
+ * @return true : if connection is still valid.
+ * @return false : if connection was closed, has failed or sent invalid
+ * request (or too much input without a complete request).
+ */
+static bool serve_input(Server *server, Connection *connection) {
+  ProtocolBuffer *input = &connection->input;
+
+  if (!protocol_buffer_reserve(input, PROTOCOL_READ_CHUNK)) {
+    return false;
+  }
+
+  ssize_t received = read(connection->socket, input->data + input->end,
+                          input->capacity - input->end);
+  if (received < 0) {
+    return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+  }
+  if (received == 0) {
+    return false;
+  }
+  input->end += (size_t)received;
+
+  while (true) {
+    bool invalid = false;
+    size_t decoded =
+        protocol_get_request(input->data + input->begin,
+                             protocol_buffer_size(input), &server->request,
+                             &invalid);
+
+    if (invalid) {
+      return false;
+    }
+    if (decoded == 0) {
+      break;
+    }
+
+    protocol_buffer_consume(input, decoded);
+    if (!execute_request(server, &connection->output)) {
+      return false;
+    }
+  }
+
+  if (protocol_buffer_size(input) >= INPUT_LIMIT) {
+    return false;
+  }
+
+  return send_output(server, connection);
+}
+
+/**
+ * @brief Creates listening socket at @p path and epoll instance.
+ *
+ * @param[out] server : state of the server.
+ * @param[in] path : path of the socket.
+ * @return true : if server is ready.
+ * @return false : otherwise.
+ */
+static bool init_server(Server *server, const char *path) {
+  struct sockaddr_un address;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    return false;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  unlink(path);
+
+  server->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server->listener < 0) {
+    return false;
+  }
+
+  if (!set_nonblocking(server->listener) ||
+      bind(server->listener, (struct sockaddr *)&address, sizeof(address)) !=
+          0 ||
+      listen(server->listener, SOMAXCONN) != 0) {
+    close(server->listener);
+    return false;
+  }
+
+  server->epoll = epoll_create1(0);
+  struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+
+  if (server->epoll < 0 || epoll_ctl(server->epoll, EPOLL_CTL_ADD,
+                                     server->listener, &event) != 0) {
+    if (server->epoll >= 0) {
+      close(server->epoll);
+    }
+    close(server->listener);
+    unlink(path);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Serves connections until a stopping signal arrives.
+ *
+ * @param[in, out] server : state of the server.
+ */
+static void run_server(Server *server) {
+  struct epoll_event events[MAX_EVENTS];
+
+  while (!stopping) {
+    int ready = epoll_wait(server->epoll, events, MAX_EVENTS, -1);
+
+    for (int index = 0; index < ready; index++) {
+      Connection *connection = events[index].data.ptr;
+
+      if (connection == NULL) {
+        accept_connections(server);
+        continue;
+      }
+
+      bool valid = true;
+      if ((events[index].events & EPOLLOUT) != 0) {
+        valid = send_output(server, connection);
+      }
+      if (valid && (events[index].events & (EPOLLIN | EPOLLHUP)) != 0 &&
+          (connection->events & EPOLLIN) != 0) {
+        valid = serve_input(server, connection);
+      }
+      if (valid && (events[index].events & EPOLLERR) != 0) {
+        valid = false;
+      }
+
+      if (!valid) {
+        close_connection(server, connection);
+      }
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s socket\n", argv[0]);
+    return 1;
+  }
+
+  Server server = {.pf = phfwdNew(), .connections = NULL};
+  if (server.pf == NULL) {
+    fprintf(stderr, "Memory error while creating structure.\n");
+    return 1;
+  }
+
+  if (!init_server(&server, argv[1])) {
+    phfwdDelete(server.pf);
+    fprintf(stderr, "Can't listen on %s.\n", argv[1]);
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop_handler;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  run_server(&server);
+
+  while (server.connections != NULL) {
+    close_connection(&server, server.connections);
+  }
+
+  close(server.epoll);
+  close(server.listener);
+  unlink(argv[1]);
+  protocol_request_drop(&server.request);
+  phfwdDelete(server.pf);
+
+  return 0;
+}
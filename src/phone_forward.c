@@ -4,14 +4,26 @@
  * @brief Module implements interface specified in phone_forward.h
  * @date 2022-05-07
  */
+#define _POSIX_C_SOURCE 200809L
 #include "phone_forward.h"
 #include "blackred_tree.h"
 #include "compressed_trie.h"
 #include "double_linked_list.h"
+#include "flat_trie.h"
+#include "latency.h"
 #include "memory.h"
+#include "operation_log.h"
+#include "string_lib.h"
+#include "write_ahead_log.h"
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 /**
  * @brief Preprocessor macro to make some parameter marked as intentionally
@@ -19,6 +31,21 @@
  */
 #define UNUSED(X) (void)X;
 
+/**
+ * @brief Number of checkpoint image forwards inserted at once by recovery.
+ */
+#define RECOVERY_BATCH (1u << 16)
+
+/**
+ * @brief Initial size of buffer for numbers of RECOVERY_BATCH forwards.
+ */
+#define RECOVERY_TEXT (1u << 20)
+
+/**
+ * @brief Number of detached forwards freed per modification.
+ */
+#define RECLAIM_STEP 64
+
 /**
  * @brief Struct visible to library user which is wrapper for trie structure.
  */
@@ -26,6 +53,110 @@ struct PhoneForward {
   Trie *database_forward; ///< Trie to store forwards in.
   Trie *database_reverse; ///< Trie to store reverses in.
   List *fresh_list; ///< Fresh list to use in functions in case of memory error.
+  size_t forwards;  ///< Number of forwards stored in database_forward.
+  OperationLog *recorder; ///< Log of calls (NULL if calls aren't recorded).
+  WriteAheadLog *wal; ///< Log of modifications (NULL if it isn't kept).
+  char *wal_path;     ///< Path of @p wal.
+  size_t checkpoint_bytes;       ///< Size of @p wal which starts checkpoint.
+  size_t checkpoint_step;        ///< Forwards written per modification.
+  struct Checkpoint *checkpoint; ///< Checkpoint in progress (or NULL).
+  pid_t snapshot_process; ///< Process writing snapshot (0 if none).
+  char *snapshot_path;    ///< Path of snapshot being written.
+  PhoneForwardVersion *newest_version; ///< Newest unreleased version.
+  PhoneForwardVersion *base; ///< Version the clone was created from (NULL
+                             ///< if structure isn't a clone).
+  Trie *masks; ///< Prefixes removed from @p base (NULL if structure isn't a
+               ///< clone).
+  bool clone_failed; ///< True if some removal couldn't be applied to base.
+  bool deleted; ///< True if structure was deleted, but its forwards are
+                ///< still read by versions.
+  struct Hybrid *hybrid; ///< Hybrid layout read by phfwdGet (or NULL).
+  struct Reclaim *reclaim; ///< Detached forward tries being freed.
+  size_t reclaim_step;     ///< Detached forwards freed per modification.
+  size_t compaction_threshold; ///< Deferred compactions of both tries which
+                               ///< start compaction (0 if only phfwdCompact
+                               ///< compacts).
+  DynamicArray *reverse_emptied; ///< Reverse nodes whose lists were emptied
+                                 ///< by dropping forwards (NULL if reverses
+                                 ///< are removed at once).
+};
+
+/**
+ * @brief Read-only version of the structure.
+ *
+ * Version doesn't copy forwards. Before a forward of the structure is
+ * modified, its value is saved in the newest version, so a version sees
+ * values saved in it and in newer versions and current values of keys which
+ * weren't modified since.
+ */
+struct PhoneForwardVersion {
+  PhoneForward *pf; ///< Structure of the version (kept after its deletion
+                    ///< until the last version is released).
+  Trie *before;     ///< Values of keys modified after creation of the
+                    ///< version and before creation of the newer one
+                    ///< (copies of forwardings or version_tombstone).
+  Trie *targets;    ///< Keys of @p before by their saved forwardings
+                    ///< (tries of keys with version_tombstone values).
+  PhoneForwardVersion *older; ///< Older unreleased version.
+  PhoneForwardVersion *newer; ///< Newer unreleased version.
+  size_t references; ///< Number of users of the version.
+  bool failed;       ///< True if some value couldn't be saved.
+};
+
+/**
+ * @brief Checkpoint in progress: image of forward trie being written in key
+ * order.
+ */
+struct Checkpoint {
+  WriteAheadLog *image;   ///< Image being written.
+  char *cursor;           ///< Last written key.
+  size_t cursor_capacity; ///< Capacity of @p cursor.
+  char *next;             ///< Buffer for new value of @p cursor.
+  size_t next_capacity;   ///< Capacity of @p next.
+  bool failed;            ///< True if any write has failed.
+};
+
+/**
+ * @brief Phases of merging of hybrid layout.
+ */
+enum HybridPhase {
+  HYBRID_IDLE,    ///< Merging doesn't run.
+  HYBRID_COLLECT, ///< Frozen changes are collected in key order.
+  HYBRID_MERGE,   ///< Collected changes are merged with the base.
+  HYBRID_BUILD,   ///< Nodes of the next base are laid out.
+};
+
+/**
+ * @brief Hybrid layout of forwards read by phfwdGet: immutable flat base and
+ * small tries of changes made since the base was built. Merging, which builds
+ * the next base from the base and frozen changes, is spread over
+ * modifications.
+ */
+struct Hybrid {
+  FlatTrie *base;      ///< Forwards from before the changes.
+  Trie *delta;         ///< Copies of targets of added forwards.
+  Trie *delta_masks;   ///< Removed prefixes (version_tombstone values).
+  Trie *merged;        ///< Frozen @p delta being merged (or NULL).
+  Trie *merged_masks;  ///< Frozen @p delta_masks being merged (or NULL).
+  FlatTrie *changes;   ///< Pairs of @p merged in key order (or NULL).
+  FlatTrie *next;      ///< Base being built (or NULL).
+  size_t base_index;   ///< Index of next merged pair of @p base.
+  size_t changes_index; ///< Index of next merged pair of @p changes.
+  enum HybridPhase phase; ///< Phase of merging.
+  size_t changes_count; ///< Number of changes since merging has started.
+  size_t delta_limit;  ///< Number of changes which starts merging.
+  size_t merge_step;   ///< Pairs or nodes merged per change.
+  bool failed;         ///< True if some change couldn't be saved.
+};
+
+/**
+ * @brief Forward trie detached from the structure, whose forwards are freed in
+ * steps. Reverses of its forwards stay in reverse trie until they are freed,
+ * so reverses are checked against forward trie while any trie is detached.
+ */
+struct Reclaim {
+  Trie *forwards;       ///< Detached forwards.
+  struct Reclaim *next; ///< Next detached trie (or NULL).
 };
 
 /**
@@ -38,11 +169,15 @@ struct PhoneNumbers {
 
 /**
  * @brief Struct to store pair of values about number foward.
+ *
+ * Number is interned: it is stored once, in the list of reverses of the
+ * number, and shared by all forwards to it. The list lives as long as it has
+ * elements, so as long as the record has its reverse.
  */
 struct ForwardRecord {
-  char *forwarding; ///< Number as value of forwarding.
   ListElement
-      *reverse_record; ///< Pointer to element representing reverse forward.
+      *reverse_record;    ///< Pointer to element representing reverse forward.
+  const char *forwarding; ///< Number as value of forwarding.
 };
 
 /**
@@ -50,6 +185,19 @@ struct ForwardRecord {
  */
 typedef struct ForwardRecord ForwardRecord;
 
+_Static_assert((int)PHFWD_MEMORY_TAGS == (int)MEMORY_TAG_COUNT,
+               "Public memory tags must match tags of memory.h");
+_Static_assert(PHFWD_STATS_BUCKETS == TRIE_STATS_BUCKETS &&
+                   PHFWD_STATS_FANOUTS == TRIE_STATS_FANOUTS,
+               "Public histograms must match histograms of compressed_trie.h");
+_Static_assert(PHFWD_LATENCY_BUCKETS == LATENCY_BUCKETS &&
+                   (int)PHFWD_OPERATIONS == (int)LATENCY_OPERATIONS,
+               "Public latency histograms must match histograms of latency.h");
+_Static_assert((int)PHFWD_DURABILITY_BUFFERED == (int)WAL_BUFFERED &&
+                   (int)PHFWD_DURABILITY_GROUP == (int)WAL_GROUP &&
+                   (int)PHFWD_DURABILITY_SYNC == (int)WAL_SYNC,
+               "Public durability levels must match write_ahead_log.h");
+
 /**
  * @brief Checks if given char is digit (defined as in the given documentation).
  *
@@ -85,6 +233,261 @@ static bool verify_number(const char *num) {
   return true;
 }
 
+/**
+ * @brief Removes reverse record of a forward from its list. The list is
+ * removed with its node if the record was its only element.
+ *
+ * @param[in, out] pf : structure which owns the reverse.
+ * @param[in] element : reverse record to remove.
+ * @param[in] key : key of the forward.
+ */
+static void reverse_unlink(PhoneForward *pf, ListElement *element,
+                          const char *key) {
+  // Reverse trie is dropped at once, when whole structure is freed.
+  if (pf->database_reverse == NULL) {
+    return;
+  }
+
+  if (!listelement_is_last(element)) {
+    list_remove_ptr(element);
+    return;
+  }
+
+  TrieNode *node = listelement_get_node(element);
+  bool memory_error = true;
+
+  if (pf->reverse_emptied != NULL) {
+    memory_error = false;
+    darray_push(pf->reverse_emptied, node, &memory_error);
+  }
+
+  if (memory_error) {
+    trie_remove_from_ptr(pf->database_reverse, node, key);
+  } else {
+    list_remove_ptr(element);
+  }
+}
+
+/**
+ * @brief Starts dropping many forwards: reverse nodes whose lists get empty
+ * are removed together by reverse_batch_finish().
+ *
+ * If memory error occurs, reverses are removed at once.
+ *
+ * @param[in, out] pf : structure to drop forwards of.
+ */
+static void reverse_batch_start(PhoneForward *pf) {
+  bool memory_error = false;
+
+  pf->reverse_emptied = init_darray(&memory_error);
+  if (memory_error) {
+    pf->reverse_emptied = NULL;
+  }
+}
+
+/**
+ * @brief Removes reverse nodes emptied since reverse_batch_start(). Every
+ * node is removed once, after all forwards were dropped, so removals don't
+ * interleave with dropping.
+ *
+ * @param[in, out] pf : structure which dropped forwards.
+ */
+static void reverse_batch_finish(PhoneForward *pf) {
+  DynamicArray *emptied = pf->reverse_emptied;
+  if (emptied == NULL) {
+    return;
+  }
+
+  pf->reverse_emptied = NULL;
+  size_t count = darray_size(emptied);
+  TrieNode **nodes = (TrieNode **)darray_convert(emptied);
+
+  // Nodes with values aren't freed by balancing, so all pointers stay valid.
+  for (size_t index = 0; index < count; index++) {
+    trie_remove_from_ptr(pf->database_reverse, nodes[index], "");
+  }
+
+  wrap_free(nodes);
+}
+
+/**
+ * @brief Value saved in version for key which had no forward.
+ */
+static char version_tombstone[] = "";
+
+/**
+ * @brief Searches for value of exactly given key.
+ *
+ * @param[in] tree : trie to search in.
+ * @param[in] key : searched key.
+ * @return void* : value of @p key (NULL if it has no value).
+ */
+static void *trie_find(const Trie *tree, const char *key) {
+  size_t matched_length = 0;
+  void *value = trie_match_longest_prefix(tree, key, &matched_length);
+
+  return matched_length == strlen(key) ? value : NULL;
+}
+
+/**
+ * @brief Free function of Trie of values saved in version.
+ *
+ * @param[in] value : saved value.
+ * @param[in] key : unused.
+ * @param[in] configuration : unused.
+ */
+static void version_value_free(void *value, const char *key,
+                               void *configuration) {
+  UNUSED(key)
+  UNUSED(configuration)
+
+  if (value != version_tombstone) {
+    wrap_free(value);
+  }
+}
+
+/**
+ * @brief Free function of Trie of keys of saved values by their forwardings.
+ *
+ * @param[in] value : Trie of keys saved with the forwarding.
+ * @param[in] key : unused.
+ * @param[in] configuration : unused.
+ */
+static void version_keys_free(void *value, const char *key,
+                              void *configuration) {
+  UNUSED(key)
+  UNUSED(configuration)
+
+  trie_drop(value);
+}
+
+/**
+ * @brief Marks version and all older versions as failed.
+ *
+ * @param[in, out] version : first failed version.
+ */
+static void version_fail(PhoneForwardVersion *version) {
+  for (; version != NULL; version = version->older) {
+    version->failed = true;
+  }
+}
+
+/**
+ * @brief Adds key of saved value to keys saved with its forwarding.
+ *
+ * @param[in, out] version : version the value is saved in.
+ * @param[in] key : saved key.
+ * @param[in] forwarding : saved forwarding.
+ * @return true : if key was added.
+ * @return false : if memory error has occured.
+ */
+static bool version_index(PhoneForwardVersion *version, const char *key,
+                          const char *forwarding) {
+  Trie *keys = trie_find(version->targets, forwarding);
+
+  if (keys == NULL) {
+    bool memory_error = false;
+    keys = init_trie(&memory_error, version_value_free, NULL);
+    if (memory_error) {
+      return false;
+    }
+
+    if (trie_insert(version->targets, forwarding, keys) == NULL) {
+      trie_drop(keys);
+      return false;
+    }
+  }
+
+  return trie_insert(keys, key, version_tombstone) != NULL;
+}
+
+/**
+ * @brief Saves value of key, which isn't saved in the version yet.
+ *
+ * @param[in, out] version : version to save value in.
+ * @param[in] key : saved key.
+ * @param[in] forwarding : saved forwarding (NULL if key had no forward).
+ */
+static void version_save(PhoneForwardVersion *version, const char *key,
+                         const char *forwarding) {
+  char *value = version_tombstone;
+  if (forwarding != NULL) {
+    size_t length = strlen(forwarding) + 1;
+
+    value = wrap_malloc(length, MEMORY_TAG_OTHER);
+    if (value == NULL) {
+      version_fail(version);
+      return;
+    }
+    memcpy(value, forwarding, length);
+  }
+
+  if (trie_insert(version->before, key, value) == NULL) {
+    version_value_free(value, NULL, NULL);
+    version_fail(version);
+    return;
+  }
+
+  if (forwarding != NULL && !version_index(version, key, forwarding)) {
+    version_fail(version);
+  }
+}
+
+/**
+ * @brief Saves value of key in the newest version, before it is modified.
+ * Does nothing if there are no versions or the value was already saved.
+ *
+ * @param[in, out] pf : modified structure.
+ * @param[in] key : modified key.
+ * @param[in] record : current value of @p key (NULL if it has no forward).
+ */
+static void version_preserve(PhoneForward *pf, const char *key,
+                             const ForwardRecord *record) {
+  PhoneForwardVersion *version = pf->newest_version;
+
+  if (version == NULL || version->failed ||
+      trie_find(version->before, key) != NULL) {
+    return;
+  }
+
+  version_save(version, key, record == NULL ? NULL : record->forwarding);
+}
+
+/**
+ * @brief Visitor of removed forwards, which saves them in versions.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to the PhoneForward structure.
+ */
+static void version_preserve_visitor(const char *key, void *value,
+                                     void *configuration) {
+  version_preserve(configuration, key, value);
+}
+
+/**
+ * @brief Searches for forward of exactly given key in the version.
+ *
+ * @param[in] version : searched version.
+ * @param[in] key : searched key.
+ * @return const char* : target of the forward (NULL if key has no forward).
+ */
+static const char *version_find(const PhoneForwardVersion *version,
+                                const char *key) {
+  const PhoneForward *pf = version->pf;
+
+  for (; version != NULL; version = version->newer) {
+    const char *value = trie_find(version->before, key);
+
+    if (value != NULL) {
+      return value == version_tombstone ? NULL : value;
+    }
+  }
+
+  const ForwardRecord *record = trie_find(pf->database_forward, key);
+  return record == NULL ? NULL : record->forwarding;
+}
+
 /**
  * @brief Function serves as free_function to init Trie data structure with
  * values as ForwardRecord representing forwarding.
@@ -97,26 +500,25 @@ static bool verify_number(const char *num) {
  *
  * @param[in] value : value of the node being deleted.
  * @param[in] key : key corresponding to the @p value.
- * @param[out] other_configuration : pointer to the Trie representing
- * reverse-forwarding database.
+ * @param[out] other_configuration : pointer to the PhoneForward structure
+ * which owns the Trie.
  */
 static void string_free_wrapper(void *value, const char *key,
                                 void *other_configuration) {
+  PhoneForward *pf = (PhoneForward *)other_configuration;
+
   if (key != NULL && value != NULL) {
-    Trie *database_reverse = (Trie *)other_configuration;
-    ListElement *rev_element = ((ForwardRecord *)value)->reverse_record;
+    version_preserve(pf, key, value);
 
-    if (listelement_is_last(rev_element)) {
-      TrieNode *node = listelement_get_node(rev_element);
-      trie_remove_from_ptr(database_reverse, node, key);
-    } else {
-      list_remove_ptr(rev_element);
+    // Recovery inserts forwards before their reverses.
+    if (((ForwardRecord *)value)->reverse_record != NULL) {
+      reverse_unlink(pf, ((ForwardRecord *)value)->reverse_record, key);
     }
   }
 
   if (value != NULL) {
-    wrap_free(((ForwardRecord *)value)->forwarding);
     wrap_free(value);
+    pf->forwards--;
   }
 }
 
@@ -136,33 +538,28 @@ static void linkedlist_free_wrapper(void *value, const char *key,
 }
 
 /**
- * @brief Function inserts reverse record to the database.
+ * @brief Function locates reverse list of given number, creating it if it
+ * doesn't exist.
  *
- * @param[in, out] pf : structure to insert reversion into.
- * @param[in] key : @p num1 used at phfwdAdd.
- * @param[in] value : @p num2 used at phfwdAdd.
- * @param[out] save_list : ForwardRecord to save pointer to inserted List
- * element.
- * @return true : if insertion was successful.
- * @return false : if insertion has failed (nothing changes).
+ * @param[in, out] pf : structure to locate list in.
+ * @param[in] value : number which list is located.
+ * @param[out] located_node : place to save node of the list.
+ * @return List* : located list (NULL if memory error has occured).
  */
-static bool reverse_insert(PhoneForward *pf, const char *key, const char *value,
-                           ForwardRecord *save_list) {
+static List *reverse_locate(PhoneForward *pf, const char *value,
+                            TrieNode **located_node) {
   bool memory_error = false;
   if (pf->fresh_list == NULL) {
     pf->fresh_list = init_list(&memory_error);
     if (memory_error) {
-      return false;
+      return NULL;
     }
   }
 
-  TrieNode *located_node;
   List *reverse_list = (List *)trie_locate_node(pf->database_reverse, value,
-                                                pf->fresh_list, &located_node);
-  if (reverse_list == NULL) {
-    return false;
-  } else if (reverse_list == pf->fresh_list) {
-    list_set_node(reverse_list, located_node);
+                                                pf->fresh_list, located_node);
+  if (reverse_list == pf->fresh_list) {
+    list_set_node(reverse_list, *located_node);
 
     pf->fresh_list = init_list(&memory_error);
     if (memory_error) {
@@ -170,7 +567,122 @@ static bool reverse_insert(PhoneForward *pf, const char *key, const char *value,
     }
   }
 
-  ListElement *inserted_element = list_insert(reverse_list, key);
+  return reverse_list;
+}
+
+/**
+ * @brief Free function of detached forward trie. Works like
+ * string_free_wrapper(), but doesn't save values in versions, as they were
+ * saved at detaching, and doesn't change number of forwards.
+ *
+ * @param[in] value : ForwardRecord being freed.
+ * @param[in] key : key of @p value (NULL if only value should be freed).
+ * @param[in, out] configuration : pointer to the PhoneForward structure.
+ */
+static void reclaim_free_wrapper(void *value, const char *key,
+                                 void *configuration) {
+  PhoneForward *pf = configuration;
+
+  if (value == NULL) {
+    return;
+  }
+
+  if (key != NULL) {
+    reverse_unlink(pf, ((ForwardRecord *)value)->reverse_record, key);
+  }
+
+  wrap_free(value);
+}
+
+/**
+ * @brief Frees forwards of detached tries.
+ *
+ * @param[in, out] pf : structure to free detached forwards of.
+ * @param limit : maximal number of freed forwards.
+ */
+static void reclaim_step(PhoneForward *pf, size_t limit) {
+  if (pf->reclaim == NULL) {
+    return;
+  }
+
+  reverse_batch_start(pf);
+  while (pf->reclaim != NULL) {
+    struct Reclaim *reclaim = pf->reclaim;
+    size_t dropped = trie_drop_step(reclaim->forwards, limit);
+
+    pf->forwards -= dropped;
+    limit -= dropped;
+    if (!trie_is_empty(reclaim->forwards)) {
+      break;
+    }
+
+    pf->reclaim = reclaim->next;
+    trie_drop(reclaim->forwards);
+    wrap_free(reclaim);
+  }
+  reverse_batch_finish(pf);
+}
+
+/**
+ * @brief Compacts both tries if enough compactions were deferred.
+ *
+ * @param[in, out] pf : structure to compact.
+ */
+static void compaction_step(PhoneForward *pf) {
+  if (pf->compaction_threshold > 0 &&
+      trie_compaction_candidates(pf->database_forward) +
+              trie_compaction_candidates(pf->database_reverse) >=
+          pf->compaction_threshold) {
+    trie_compact(pf->database_forward);
+    trie_compact(pf->database_reverse);
+  }
+}
+
+/**
+ * @brief Filter of reverses, which skips forwards of detached tries.
+ *
+ * @param[in] value : forwarded prefix.
+ * @param[in] key : number to find reverses of.
+ * @param prefix_length : length of target of the forward.
+ * @param[in] configuration : pointer to the PhoneForward structure.
+ * @return true : if forward of @p value is stored in forward trie.
+ * @return false : if forward of @p value is detached.
+ */
+static bool reclaim_filter(const char *value, const char *key,
+                           size_t prefix_length, void *configuration) {
+  const PhoneForward *pf = configuration;
+  const ForwardRecord *record = trie_find(pf->database_forward, value);
+
+  return record != NULL && strlen(record->forwarding) == prefix_length &&
+         strncmp(record->forwarding, key, prefix_length) == 0;
+}
+
+/**
+ * @brief Function inserts reverse record to the database.
+ *
+ * @param[in, out] pf : structure to insert reversion into.
+ * @param[in] key : @p num1 used at phfwdAdd.
+ * @param[in] value : @p num2 used at phfwdAdd.
+ * @param[out] save_list : ForwardRecord to save pointer to inserted List
+ * element and shared copy of @p value to.
+ * @return true : if insertion was successful.
+ * @return false : if insertion has failed (nothing changes).
+ */
+static bool reverse_insert(PhoneForward *pf, const char *key, const char *value,
+                           ForwardRecord *save_list) {
+  TrieNode *located_node;
+  List *reverse_list = reverse_locate(pf, value, &located_node);
+  if (reverse_list == NULL) {
+    return false;
+  }
+
+  // Target is saved once, in a new list, and shared by all forwards to it.
+  ListElement *inserted_element = NULL;
+  if (list_get_target(reverse_list) != NULL ||
+      list_set_target(reverse_list, value)) {
+    inserted_element = list_insert(reverse_list, key);
+  }
+
   if (inserted_element == NULL) {
     if (list_isempty(reverse_list)) {
       trie_remove_from_ptr(pf->database_reverse, located_node, key);
@@ -179,6 +691,7 @@ static bool reverse_insert(PhoneForward *pf, const char *key, const char *value,
   }
 
   save_list->reverse_record = inserted_element;
+  save_list->forwarding = list_get_target(reverse_list);
   return true;
 
   /*StringTable *reverse_table = (StringTable *)
@@ -198,12 +711,30 @@ static bool reverse_insert(PhoneForward *pf, const char *key, const char *value,
 }
 
 PhoneForward *phfwdNew(void) {
-  PhoneForward *res = wrap_malloc(sizeof(struct PhoneForward));
+  PhoneForward *res =
+      wrap_malloc(sizeof(struct PhoneForward), MEMORY_TAG_OTHER);
   if (res == NULL) {
     return NULL;
   }
 
   bool memory_error = false;
+  res->forwards = 0;
+  res->recorder = NULL;
+  res->wal = NULL;
+  res->wal_path = NULL;
+  res->checkpoint = NULL;
+  res->snapshot_process = 0;
+  res->snapshot_path = NULL;
+  res->newest_version = NULL;
+  res->base = NULL;
+  res->masks = NULL;
+  res->clone_failed = false;
+  res->deleted = false;
+  res->hybrid = NULL;
+  res->reclaim = NULL;
+  res->reclaim_step = RECLAIM_STEP;
+  res->compaction_threshold = 0;
+  res->reverse_emptied = NULL;
 
   res->database_reverse =
       init_trie(&memory_error, linkedlist_free_wrapper, NULL);
@@ -213,7 +744,7 @@ PhoneForward *phfwdNew(void) {
   }
 
   res->database_forward =
-      init_trie(&memory_error, string_free_wrapper, res->database_reverse);
+      init_trie(&memory_error, string_free_wrapper, res);
   if (memory_error) {
     trie_drop(res->database_reverse);
     wrap_free(res);
@@ -231,280 +762,3781 @@ PhoneForward *phfwdNew(void) {
   return res;
 }
 
+/**
+ * @brief Frees forwards and reverses of deleted structure and the structure.
+ *
+ * @param[in, out] pf : structure to free.
+ */
+static void structure_free(PhoneForward *pf) {
+  // Reverses aren't unlinked one by one, but their lists hold targets of
+  // forwards, so they are dropped last.
+  Trie *reverse = pf->database_reverse;
+  pf->database_reverse = NULL;
+  trie_drop(pf->database_forward);
+  reclaim_step(pf, SIZE_MAX);
+  trie_drop(reverse);
+
+  wrap_free(pf);
+}
+
 void phfwdDelete(PhoneForward *pf) {
   if (pf == NULL) {
     return;
   }
 
-  trie_drop(pf->database_forward);
-  trie_drop(pf->database_reverse);
+  phfwdVersionRelease(pf->base);
+  trie_drop(pf->masks);
+  phfwdHybridDisable(pf);
 
   list_drop(pf->fresh_list);
+  operation_log_close(pf->recorder);
+  phfwdWalClose(pf);
+  phfwdSnapshotPoll(pf, true, NULL);
 
-  wrap_free(pf);
+  // Versions read forwards of the structure instead of copying them, so
+  // they are freed with the last version.
+  if (pf->newest_version != NULL) {
+    pf->deleted = true;
+    return;
+  }
+
+  structure_free(pf);
 }
 
-bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
-  if (pf == NULL) {
-    return false;
-  }
+/**
+ * @brief Creates path of file accompanying the log.
+ *
+ * @param[in] path : path of the log.
+ * @param[in] suffix : suffix of the file.
+ * @return char* : created path (NULL if memory error has occured).
+ */
+static char *wal_file_path(const char *path, const char *suffix) {
+  size_t length = strlen(path);
+  size_t suffix_length = strlen(suffix);
+  char *result =
+      wrap_malloc(length + suffix_length + 1, MEMORY_TAG_OTHER);
 
-  if (num1 == NULL || num2 == NULL) {
-    return false;
+  if (result != NULL) {
+    memcpy(result, path, length);
+    memcpy(result + length, suffix, suffix_length + 1);
   }
 
-  if (!verify_number(num1) || !verify_number(num2)) {
-    return false;
-  }
+  return result;
+}
 
-  if (strlen(num1) == 0 || strlen(num2) == 0) {
-    return false;
+/**
+ * @brief Ends checkpoint in progress without finishing it. Its unfinished
+ * image is deleted.
+ *
+ * @param[in, out] pf : structure to abort checkpoint of.
+ */
+static void checkpoint_abort(PhoneForward *pf) {
+  struct Checkpoint *checkpoint = pf->checkpoint;
+  if (checkpoint == NULL) {
+    return;
   }
 
-  if (strcmp(num1, num2) == 0) {
-    return false;
+  char *temporary = wal_file_path(pf->wal_path, ".ckpt.tmp");
+  wal_close(checkpoint->image);
+  if (temporary != NULL) {
+    unlink(temporary);
   }
 
-  char *inserted_value = wrap_malloc(sizeof(char) * (strlen(num2) + 1));
-  if (inserted_value == NULL) {
+  wrap_free(temporary);
+  wrap_free(checkpoint->cursor);
+  wrap_free(checkpoint->next);
+  wrap_free(checkpoint);
+  pf->checkpoint = NULL;
+}
+
+/**
+ * @brief Starts checkpoint: moves the log behind it and creates empty image.
+ *
+ * Modifications logged from now on are kept in the log until the checkpoint
+ * is finished, so image taken in many steps (possibly seeing some of them)
+ * together with them describes the structure.
+ *
+ * @param[in, out] pf : structure to checkpoint.
+ * @return true : if checkpoint was started.
+ * @return false : if any operation on files has failed or memory error has
+ * occured.
+ */
+static bool checkpoint_start(PhoneForward *pf) {
+  struct Checkpoint *checkpoint =
+      wrap_calloc(1u, sizeof(struct Checkpoint), MEMORY_TAG_OTHER);
+  char *previous = wal_file_path(pf->wal_path, ".prev");
+  char *temporary = wal_file_path(pf->wal_path, ".ckpt.tmp");
+
+  bool success = checkpoint != NULL && previous != NULL &&
+                 temporary != NULL &&
+                 wal_rotate(pf->wal, pf->wal_path, previous);
+
+  if (success) {
+    unlink(temporary);
+    checkpoint->image =
+        wal_open(temporary, WAL_BUFFERED, UINT64_MAX, 1u << 16);
+    checkpoint->cursor = wrap_calloc(1u, 1u, MEMORY_TAG_OTHER);
+    checkpoint->cursor_capacity = 1;
+    success = checkpoint->image != NULL && checkpoint->cursor != NULL;
+  }
+
+  if (success) {
+    pf->checkpoint = checkpoint;
+  } else if (checkpoint != NULL) {
+    wal_close(checkpoint->image);
+    wrap_free(checkpoint->cursor);
+    wrap_free(checkpoint);
+  }
+
+  wrap_free(previous);
+  wrap_free(temporary);
+  return success;
+}
+
+/**
+ * @brief Visitor of checkpoint_step(), which writes forward to the image.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to struct Checkpoint.
+ */
+static void checkpoint_visitor(const char *key, void *value,
+                               void *configuration) {
+  struct Checkpoint *checkpoint = configuration;
+  size_t length = strlen(key) + 1;
+
+  if (checkpoint->failed) {
+    return;
+  }
+
+  if (checkpoint->next_capacity < length) {
+    char *next = checkpoint->next == NULL
+                     ? wrap_malloc(length, MEMORY_TAG_OTHER)
+                     : wrap_realloc(checkpoint->next, length);
+    if (next == NULL) {
+      checkpoint->failed = true;
+      return;
+    }
+
+    checkpoint->next = next;
+    checkpoint->next_capacity = length;
+  }
+  memcpy(checkpoint->next, key, length);
+
+  checkpoint->failed = !wal_append(checkpoint->image, WAL_ADD, key,
+                                   ((ForwardRecord *)value)->forwarding) ||
+                       !wal_poll(checkpoint->image);
+}
+
+/**
+ * @brief Writes next forwards to the image of checkpoint in progress and
+ * finishes the checkpoint if all forwards were written. Finished image
+ * replaces the previous one and the log behind it is deleted. Failed
+ * checkpoint is aborted.
+ *
+ * @param[in, out] pf : structure with checkpoint in progress.
+ * @param limit : maximal number of written forwards.
+ * @return true : if forwards were written.
+ * @return false : if any operation on files has failed or memory error has
+ * occured.
+ */
+static bool checkpoint_step(PhoneForward *pf, size_t limit) {
+  struct Checkpoint *checkpoint = pf->checkpoint;
+  bool memory_error = false;
+
+  size_t written =
+      trie_iterate(pf->database_forward, checkpoint->cursor, limit,
+                   checkpoint_visitor, checkpoint, &memory_error);
+  if (memory_error || checkpoint->failed) {
+    checkpoint_abort(pf);
+    return false;
+  }
+
+  if (written > 0) {
+    char *cursor = checkpoint->cursor;
+    size_t capacity = checkpoint->cursor_capacity;
+
+    checkpoint->cursor = checkpoint->next;
+    checkpoint->cursor_capacity = checkpoint->next_capacity;
+    checkpoint->next = cursor;
+    checkpoint->next_capacity = capacity;
+  }
+
+  if (written == limit) {
+    return true;
+  }
+
+  char *temporary = wal_file_path(pf->wal_path, ".ckpt.tmp");
+  char *image = wal_file_path(pf->wal_path, ".ckpt");
+  char *previous = wal_file_path(pf->wal_path, ".prev");
+  bool success = false;
+
+  if (temporary != NULL && image != NULL && previous != NULL) {
+    success = wal_finish(checkpoint->image, temporary, image);
+    checkpoint->image = NULL;
+  }
+
+  if (success) {
+    unlink(previous);
+  }
+  checkpoint_abort(pf);
+
+  wrap_free(temporary);
+  wrap_free(image);
+  wrap_free(previous);
+  return success;
+}
+
+/**
+ * @brief Advances checkpointing after logged modification: starts checkpoint
+ * if the log is big enough or advances checkpoint in progress.
+ *
+ * @param[in, out] pf : structure with the log.
+ */
+static void checkpoint_tick(PhoneForward *pf) {
+  if (pf->checkpoint != NULL) {
+    if (pf->checkpoint_step > 0) {
+      checkpoint_step(pf, pf->checkpoint_step);
+    }
+  } else if (pf->checkpoint_bytes > 0 &&
+             wal_size(pf->wal) >= pf->checkpoint_bytes) {
+    checkpoint_start(pf);
+  }
+}
+
+/**
+ * @brief Visitor of forwards of the structure, which appends them to the base
+ * being built.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to struct Hybrid.
+ */
+static void hybrid_base_visitor(const char *key, void *value,
+                                void *configuration) {
+  struct Hybrid *hybrid = configuration;
+
+  if (!hybrid->failed &&
+      !flat_trie_push(hybrid->base, key,
+                      ((ForwardRecord *)value)->forwarding)) {
+    hybrid->failed = true;
+  }
+}
+
+/**
+ * @brief Frees hybrid layout.
+ *
+ * @param[in] hybrid : layout to free (may be NULL).
+ */
+static void hybrid_drop(struct Hybrid *hybrid) {
+  if (hybrid == NULL) {
+    return;
+  }
+
+  flat_trie_drop(hybrid->base);
+  flat_trie_drop(hybrid->next);
+  flat_trie_drop(hybrid->changes);
+  trie_drop(hybrid->delta);
+  trie_drop(hybrid->delta_masks);
+  trie_drop(hybrid->merged);
+  trie_drop(hybrid->merged_masks);
+  wrap_free(hybrid);
+}
+
+/**
+ * @brief Creates hybrid layout with base built from current forwards of the
+ * structure.
+ *
+ * @param[in] pf : structure to create layout of.
+ * @param[in] options : parameters of the layout.
+ * @return struct Hybrid* : created layout (NULL if memory error has occured).
+ */
+static struct Hybrid *hybrid_new(const PhoneForward *pf,
+                                 const PhoneForwardHybridOptions *options) {
+  bool memory_error = false;
+  bool done = false;
+  struct Hybrid *hybrid =
+      wrap_calloc(1u, sizeof(struct Hybrid), MEMORY_TAG_OTHER);
+  if (hybrid == NULL) {
+    return NULL;
+  }
+
+  hybrid->delta_limit = options->delta_limit;
+  hybrid->merge_step = options->merge_step;
+  hybrid->phase = HYBRID_IDLE;
+  hybrid->base = flat_trie_new();
+  hybrid->delta = init_trie(&memory_error, version_value_free, NULL);
+  hybrid->delta_masks = init_trie(&memory_error, version_value_free, NULL);
+
+  if (hybrid->base != NULL && !memory_error) {
+    trie_iterate(pf->database_forward, "", SIZE_MAX, hybrid_base_visitor,
+                 hybrid, &memory_error);
+  }
+
+  if (hybrid->base == NULL || memory_error || hybrid->failed ||
+      !flat_trie_build(hybrid->base, SIZE_MAX, &done)) {
+    hybrid_drop(hybrid);
+    return NULL;
+  }
+
+  return hybrid;
+}
+
+/**
+ * @brief Starts merging of changes into the next base. Changes made so far
+ * are frozen and new ones are collected in empty tries.
+ *
+ * @param[in, out] hybrid : layout to merge.
+ * @return true : if merging was started.
+ * @return false : if memory error has occured.
+ */
+static bool hybrid_merge_start(struct Hybrid *hybrid) {
+  bool memory_error = false;
+  Trie *delta = init_trie(&memory_error, version_value_free, NULL);
+  Trie *delta_masks = init_trie(&memory_error, version_value_free, NULL);
+  FlatTrie *next = flat_trie_new();
+  FlatTrie *changes = flat_trie_new();
+
+  if (memory_error || next == NULL || changes == NULL) {
+    trie_drop(delta);
+    trie_drop(delta_masks);
+    flat_trie_drop(next);
+    flat_trie_drop(changes);
+    return false;
+  }
+
+  hybrid->merged = hybrid->delta;
+  hybrid->merged_masks = hybrid->delta_masks;
+  hybrid->delta = delta;
+  hybrid->delta_masks = delta_masks;
+  hybrid->next = next;
+  hybrid->changes = changes;
+  hybrid->base_index = 0;
+  hybrid->changes_index = 0;
+  hybrid->phase = HYBRID_COLLECT;
+  return true;
+}
+
+/**
+ * @brief Visitor of frozen changes, which appends them to sorted changes.
+ *
+ * @param[in] key : changed key.
+ * @param[in] value : its new target.
+ * @param[in, out] configuration : pointer to struct Hybrid.
+ */
+static void hybrid_collect_visitor(const char *key, void *value,
+                                   void *configuration) {
+  struct Hybrid *hybrid = configuration;
+
+  if (!hybrid->failed && !flat_trie_push(hybrid->changes, key, value)) {
+    hybrid->failed = true;
+  }
+}
+
+/**
+ * @brief Appends next pair of the base or of sorted changes to the next base.
+ * Pairs of the base which were changed or removed are skipped.
+ *
+ * @param[in, out] hybrid : layout being merged.
+ * @return true : if any pair was left.
+ * @return false : if both sequences are merged.
+ */
+static bool hybrid_merge_pair(struct Hybrid *hybrid) {
+  const char *base_key = NULL;
+  const char *base_value = NULL;
+  const char *change_key = NULL;
+  const char *change_value = NULL;
+  size_t length = 0;
+
+  if (hybrid->base_index < flat_trie_size(hybrid->base)) {
+    flat_trie_entry(hybrid->base, hybrid->base_index, &base_key,
+                    &base_value);
+  }
+  if (hybrid->changes_index < flat_trie_size(hybrid->changes)) {
+    flat_trie_entry(hybrid->changes, hybrid->changes_index, &change_key,
+                    &change_value);
+  }
+
+  if (base_key == NULL && change_key == NULL) {
+    return false;
+  }
+
+  int comparison = base_key == NULL || change_key == NULL
+                       ? (base_key == NULL ? 1 : -1)
+                       : string_compare_numbers(base_key, change_key);
+
+  if (comparison >= 0) {
+    hybrid->base_index += comparison == 0;
+    hybrid->changes_index++;
+    hybrid->failed = !flat_trie_push(hybrid->next, change_key, change_value);
+  } else {
+    hybrid->base_index++;
+    if (trie_match_longest_prefix(hybrid->merged_masks, base_key, &length) ==
+        NULL) {
+      hybrid->failed = !flat_trie_push(hybrid->next, base_key, base_value);
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Makes bounded step of merging: collects sorted changes, merges them
+ * with the base or lays out the next base. Built base replaces the current
+ * one.
+ *
+ * @param[in, out] hybrid : layout being merged.
+ * @param budget : maximal number of collected or merged pairs or laid out
+ * nodes.
+ */
+static void hybrid_merge_step(struct Hybrid *hybrid, size_t budget) {
+  bool memory_error = false;
+  bool done = false;
+
+  if (hybrid->phase == HYBRID_COLLECT) {
+    const char *key = "";
+    const char *value = NULL;
+    size_t collected = flat_trie_size(hybrid->changes);
+
+    if (collected > 0) {
+      flat_trie_entry(hybrid->changes, collected - 1, &key, &value);
+    }
+
+    // Pushed pairs may move text of the changes, so the cursor is copied.
+    char *cursor = string_clone(key);
+    if (cursor == NULL) {
+      hybrid->failed = true;
+      return;
+    }
+
+    collected = trie_iterate(hybrid->merged, cursor, budget,
+                             hybrid_collect_visitor, hybrid, &memory_error);
+    wrap_free(cursor);
+
+    hybrid->failed = hybrid->failed || memory_error;
+    if (collected < budget) {
+      hybrid->phase = HYBRID_MERGE;
+    }
+  } else if (hybrid->phase == HYBRID_MERGE) {
+    for (; budget > 0 && !hybrid->failed; budget--) {
+      if (!hybrid_merge_pair(hybrid)) {
+        hybrid->phase = HYBRID_BUILD;
+        break;
+      }
+    }
+  } else if (hybrid->phase == HYBRID_BUILD) {
+    hybrid->failed = !flat_trie_build(hybrid->next, budget, &done);
+  }
+
+  if (done) {
+    flat_trie_drop(hybrid->base);
+    flat_trie_drop(hybrid->changes);
+    trie_drop(hybrid->merged);
+    trie_drop(hybrid->merged_masks);
+
+    hybrid->base = hybrid->next;
+    hybrid->next = NULL;
+    hybrid->changes = NULL;
+    hybrid->merged = NULL;
+    hybrid->merged_masks = NULL;
+    hybrid->phase = HYBRID_IDLE;
+  }
+}
+
+/**
+ * @brief Counts change of hybrid layout: starts merging if enough changes
+ * were made or advances merging in progress.
+ *
+ * @param[in, out] hybrid : changed layout.
+ */
+static void hybrid_tick(struct Hybrid *hybrid) {
+  hybrid->changes_count++;
+
+  if (hybrid->phase != HYBRID_IDLE) {
+    if (hybrid->merge_step > 0) {
+      hybrid_merge_step(hybrid, hybrid->merge_step);
+    }
+  } else if (hybrid->delta_limit > 0 &&
+             hybrid->changes_count >= hybrid->delta_limit) {
+    hybrid->changes_count = 0;
+    hybrid->failed = !hybrid_merge_start(hybrid);
+  }
+}
+
+/**
+ * @brief Saves added forward in hybrid layout of the structure.
+ *
+ * @param[in, out] pf : modified structure.
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : target of the forward.
+ */
+static void hybrid_add(PhoneForward *pf, const char *key, const char *value) {
+  struct Hybrid *hybrid = pf->hybrid;
+  if (hybrid == NULL || hybrid->failed) {
+    return;
+  }
+
+  char *copy = string_clone(value);
+  if (copy == NULL || trie_insert(hybrid->delta, key, copy) == NULL) {
+    wrap_free(copy);
+    hybrid->failed = true;
+    return;
+  }
+
+  hybrid_tick(hybrid);
+}
+
+/**
+ * @brief Saves removal of all forwards of keys starting with the prefix in
+ * hybrid layout of the structure.
+ *
+ * Masks never contain one another, so at most one of them is a prefix of
+ * a number.
+ *
+ * @param[in, out] pf : modified structure.
+ * @param[in] prefix : removed prefix.
+ */
+static void hybrid_remove(PhoneForward *pf, const char *prefix) {
+  struct Hybrid *hybrid = pf->hybrid;
+  size_t length = 0;
+  if (hybrid == NULL || hybrid->failed) {
+    return;
+  }
+
+  trie_remove_subtree(hybrid->delta, prefix);
+
+  if (trie_match_longest_prefix(hybrid->delta_masks, prefix, &length) ==
+      NULL) {
+    trie_remove_subtree(hybrid->delta_masks, prefix);
+    hybrid->failed =
+        trie_insert(hybrid->delta_masks, prefix, version_tombstone) == NULL;
+  }
+
+  if (!hybrid->failed) {
+    hybrid_tick(hybrid);
+  }
+}
+
+/**
+ * @brief Visitor of forwards of the structure, which saves them as added in
+ * hybrid layout.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to struct Hybrid.
+ */
+static void hybrid_readd_visitor(const char *key, void *value,
+                                 void *configuration) {
+  struct Hybrid *hybrid = configuration;
+  if (hybrid->failed) {
+    return;
+  }
+
+  char *copy = string_clone(((ForwardRecord *)value)->forwarding);
+  if (copy == NULL || trie_insert(hybrid->delta, key, copy) == NULL) {
+    wrap_free(copy);
+    hybrid->failed = true;
+  }
+}
+
+/**
+ * @brief Saves removal of forward of exactly given key in hybrid layout of
+ * the structure.
+ *
+ * Masks can't hide one key only, so unless the key is already masked, it is
+ * masked and forwards of longer keys are saved as added again.
+ *
+ * @param[in, out] pf : modified structure, which doesn't have the forward
+ * anymore.
+ * @param[in] key : prefix of removed forward.
+ */
+static void hybrid_delete(PhoneForward *pf, const char *key) {
+  struct Hybrid *hybrid = pf->hybrid;
+  bool memory_error = false;
+  size_t length = 0;
+  if (hybrid == NULL || hybrid->failed) {
+    return;
+  }
+
+  if (trie_match_longest_prefix(hybrid->delta_masks, key, &length) != NULL) {
+    if (trie_find(hybrid->delta, key) != NULL) {
+      trie_remove(hybrid->delta, key);
+    }
+  } else {
+    trie_remove_subtree(hybrid->delta, key);
+    trie_remove_subtree(hybrid->delta_masks, key);
+    hybrid->failed =
+        trie_insert(hybrid->delta_masks, key, version_tombstone) == NULL;
+
+    if (!hybrid->failed) {
+      trie_iterate_prefix(pf->database_forward, key, hybrid_readd_visitor,
+                          hybrid, &memory_error);
+      hybrid->failed = hybrid->failed || memory_error;
+    }
+  }
+
+  if (!hybrid->failed) {
+    hybrid_tick(hybrid);
+  }
+}
+
+/**
+ * @brief Searches for forward of the longest prefix of the number in hybrid
+ * layout. Newer changes hide older changes and the base: forward of the same
+ * prefix replaces older one and removed prefix hides older forwards of
+ * prefixes at least as long.
+ *
+ * @param[in] hybrid : layout to search in.
+ * @param[in] num : forwarded number.
+ * @param[out] prefix_length : place to save length of forwarded prefix.
+ * @return const char* : target of the forward (NULL if number isn't
+ * forwarded).
+ */
+static const char *hybrid_match(const struct Hybrid *hybrid, const char *num,
+                                size_t *prefix_length) {
+  const Trie *layers[] = {hybrid->delta, hybrid->merged};
+  const Trie *masks[] = {hybrid->delta_masks, hybrid->merged_masks};
+  const char *result = NULL;
+  const char *found = NULL;
+  size_t limit = SIZE_MAX;
+  size_t length = 0;
+
+  for (size_t layer = 0; layer < 2 && layers[layer] != NULL; layer++) {
+    found = trie_match_bounded_prefix(layers[layer], num, limit, &length);
+    if (found != NULL && (result == NULL || length > *prefix_length)) {
+      result = found;
+      *prefix_length = length;
+    }
+
+    if (trie_match_longest_prefix(masks[layer], num, &length) != NULL &&
+        length < limit) {
+      limit = length;
+    }
+  }
+
+  found = flat_trie_match(hybrid->base, num, limit, &length);
+  if (found != NULL && (result == NULL || length > *prefix_length)) {
+    result = found;
+    *prefix_length = length;
+  }
+
+  return result;
+}
+
+/**
+ * @brief Creates forward record without reverse. Its target is set by
+ * reverse_insert().
+ *
+ * @return ForwardRecord* : created record (NULL if memory error has occured).
+ */
+static ForwardRecord *forward_record_new(void) {
+  ForwardRecord *record =
+      wrap_malloc(sizeof(struct ForwardRecord), MEMORY_TAG_FORWARD_RECORD);
+  if (record == NULL) {
+    return NULL;
+  }
+
+  record->reverse_record = NULL;
+  record->forwarding = NULL;
+
+  return record;
+}
+
+/**
+ * @brief Checks if arguments of phfwdAdd describe valid forward.
+ *
+ * @param[in] num1 : prefix of forwarded numbers.
+ * @param[in] num2 : prefix which @p num1 is replaced with.
+ * @return true : if forward is valid.
+ * @return false : if any argument is NULL, isn't a number or both are equal.
+ */
+static bool forward_valid(char const *num1, char const *num2) {
+  if (num1 == NULL || num2 == NULL) {
+    return false;
+  }
+
+  if (!verify_number(num1) || !verify_number(num2)) {
+    return false;
+  }
+
+  if (strlen(num1) == 0 || strlen(num2) == 0) {
+    return false;
+  }
+
+  return strcmp(num1, num2) != 0;
+}
+
+/**
+ * @brief Function implements phfwdAdd.
+ *
+ * Reverse is inserted first, so if any step fails, structure stays as it
+ * was.
+ *
+ * @param[in, out] pf : structure to add forward to.
+ * @param[in] num1 : prefix of forwarded numbers.
+ * @param[in] num2 : prefix which @p num1 is replaced with.
+ * @return true : if forward was added.
+ * @return false : if arguments are invalid or memory error has occured.
+ */
+static bool add_forward(PhoneForward *pf, char const *num1, char const *num2) {
+  if (pf == NULL || !forward_valid(num1, num2)) {
+    return false;
+  }
+
+  ForwardRecord *record = forward_record_new();
+  if (record == NULL) {
+    return false;
+  }
+
+  if (!reverse_insert(pf, num1, num2, record)) {
+    wrap_free(record);
+    return false;
+  }
+
+  if (pf->newest_version != NULL) {
+    // Replaced value is saved by string_free_wrapper, but a new key too has
+    // to be marked as missing in versions.
+    version_preserve(pf, num1, trie_find(pf->database_forward, num1));
+  }
+
+  if (trie_insert(pf->database_forward, num1, record) == NULL) {
+    reverse_unlink(pf, record->reverse_record, num1);
+    wrap_free(record);
+    return false;
+  }
+
+  pf->forwards++;
+
+  hybrid_add(pf, num1, num2);
+  return true;
+}
+
+bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2) {
+  if (pf != NULL && pf->recorder != NULL && num1 != NULL && num2 != NULL) {
+    operation_log_append(pf->recorder, LOG_ADD, num1, num2);
+  }
+
+  // Forward is logged before it is applied and dropped from the log if it
+  // couldn't be applied.
+  bool logged = pf != NULL && pf->wal != NULL && forward_valid(num1, num2) &&
+                wal_append(pf->wal, WAL_ADD, num1, num2);
+
+  LATENCY_START(start)
+  bool result = add_forward(pf, num1, num2);
+  LATENCY_STOP(LATENCY_ADD, start)
+
+  if (logged && !result) {
+    wal_cancel(pf->wal);
+  }
+  if (pf != NULL && pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+  if (result) {
+    reclaim_step(pf, pf->reclaim_step);
+    compaction_step(pf);
+  }
+
+  return result;
+}
+
+/**
+ * @brief Hides forwards of the prefix in base of the clone. Does nothing if
+ * structure isn't a clone.
+ *
+ * @param[in, out] pf : structure to remove forwards from.
+ * @param[in] prefix : prefix of removed forwards.
+ */
+static void clone_mask(PhoneForward *pf, const char *prefix) {
+  // Masks are kept free of prefixes of each other, so the only mask
+  // matching a number is also the shortest one.
+  size_t matched_length = 0;
+  if (pf->masks != NULL &&
+      trie_match_longest_prefix(pf->masks, prefix, &matched_length) == NULL) {
+    trie_remove_subtree(pf->masks, prefix);
+
+    if (trie_insert(pf->masks, prefix, version_tombstone) == NULL) {
+      // Base forwards stay visible, as phfwdRemove can't report failure.
+      pf->clone_failed = true;
+    }
+  }
+}
+
+/**
+ * @brief Saves forwards of detached trie in the newest version. Does nothing
+ * if there are no versions.
+ *
+ * @param[in, out] pf : structure the forwards were detached from.
+ * @param[in] detached : trie of detached forwards.
+ */
+static void forwards_preserve(PhoneForward *pf, const Trie *detached) {
+  bool memory_error = false;
+
+  if (pf->newest_version != NULL) {
+    trie_iterate(detached, "", SIZE_MAX, version_preserve_visitor, pf,
+                 &memory_error);
+    if (memory_error) {
+      version_fail(pf->newest_version);
+    }
+  }
+}
+
+/**
+ * @brief Detaches forwards of the prefix from forward trie, leaving them to
+ * be freed in steps. Their values are saved in versions from the detached
+ * trie, as reclaim_free_wrapper() doesn't save them.
+ *
+ * @param[in, out] pf : structure to remove forwards from.
+ * @param[in] prefix : prefix of removed forwards.
+ * @return true : if forwards were detached.
+ * @return false : if memory error has occured (nothing changes).
+ */
+static bool forwards_detach(PhoneForward *pf, const char *prefix) {
+  bool memory_error = false;
+  Trie *detached = init_trie_sibling(&memory_error, reclaim_free_wrapper, pf,
+                                     pf->database_forward);
+  if (memory_error) {
+    return false;
+  }
+
+  struct Reclaim *reclaim =
+      wrap_malloc(sizeof(struct Reclaim), MEMORY_TAG_OTHER);
+  if (reclaim == NULL ||
+      !trie_swap_subtree(pf->database_forward, detached, prefix)) {
+    wrap_free(reclaim);
+    trie_drop(detached);
+    return false;
+  }
+
+  if (trie_is_empty(detached)) {
+    wrap_free(reclaim);
+    trie_drop(detached);
+    return true;
+  }
+
+  forwards_preserve(pf, detached);
+  reclaim->forwards = detached;
+  reclaim->next = pf->reclaim;
+  pf->reclaim = reclaim;
+  return true;
+}
+
+/**
+ * @brief Function implements phfwdRemove.
+ *
+ * @param[in, out] pf : structure to remove forwards from.
+ * @param[in] num : prefix of removed forwards.
+ * @return true : if arguments are valid.
+ * @return false : if arguments are invalid (nothing was removed).
+ */
+static bool remove_forwards(PhoneForward *pf, char const *num) {
+  if (num == NULL || pf == NULL) {
+    return false;
+  }
+
+  if (!verify_number(num) || strlen(num) == 0) {
+    return false;
+  }
+
+  if (!forwards_detach(pf, num)) {
+    reverse_batch_start(pf);
+    trie_remove_subtree(pf->database_forward, num);
+    reverse_batch_finish(pf);
+  }
+  hybrid_remove(pf, num);
+  clone_mask(pf, num);
+
+  return true;
+}
+
+void phfwdRemove(PhoneForward *pf, char const *num) {
+  if (pf != NULL && pf->recorder != NULL && num != NULL) {
+    operation_log_append(pf->recorder, LOG_REMOVE, num, NULL);
+  }
+
+  if (pf != NULL && pf->wal != NULL && num != NULL && verify_number(num) &&
+      num[0] != '\0') {
+    wal_append(pf->wal, WAL_REMOVE, num, NULL);
+  }
+
+  LATENCY_START(start)
+  bool valid = remove_forwards(pf, num);
+  LATENCY_STOP(LATENCY_REMOVE, start)
+
+  if (pf != NULL && pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+  if (valid) {
+    reclaim_step(pf, pf->reclaim_step);
+    compaction_step(pf);
+  }
+}
+
+/**
+ * @brief Compares prefixes in key order.
+ *
+ * @param[in] first : pointer to the first prefix.
+ * @param[in] second : pointer to the second prefix.
+ * @return int : negative, zero or positive if the first prefix is smaller,
+ * equal or bigger.
+ */
+static int prefix_compare(const void *first, const void *second) {
+  return string_compare_numbers(*(const char *const *)first,
+                                *(const char *const *)second);
+}
+
+/**
+ * @brief Prepares prefixes for phfwdRemoveBatch.
+ *
+ * @param[in] prefixes : prefixes of removed forwards.
+ * @param count : number of prefixes.
+ * @param[out] kept_count : place to save number of kept prefixes.
+ * @return const char** : prefixes in key order, without ones starting with
+ * other prefix (NULL if some prefix is invalid or memory error has occured).
+ */
+static const char **remove_batch_prepare(char const *const *prefixes,
+                                         size_t count, size_t *kept_count) {
+  for (size_t index = 0; index < count; index++) {
+    if (!verify_number(prefixes[index]) || strlen(prefixes[index]) == 0) {
+      return NULL;
+    }
+  }
+
+  const char **sorted =
+      wrap_malloc(sizeof(char *) * (count + 1), MEMORY_TAG_OTHER);
+  if (sorted == NULL) {
+    return NULL;
+  }
+
+  memcpy(sorted, prefixes, sizeof(char *) * count);
+  qsort(sorted, count, sizeof(char *), prefix_compare);
+
+  // Prefix is sorted before all numbers starting with it.
+  size_t kept = 0;
+  for (size_t index = 0; index < count; index++) {
+    if (kept == 0 || strncmp(sorted[index], sorted[kept - 1],
+                             strlen(sorted[kept - 1])) != 0) {
+      sorted[kept++] = sorted[index];
+    }
+  }
+
+  *kept_count = kept;
+  return sorted;
+}
+
+/**
+ * @brief Removes forwards of prepared prefixes. Removed subtrees are grafted
+ * into one detached trie and freed in steps. If it can't be allocated, they
+ * are dropped in place.
+ *
+ * @param[in, out] pf : structure to remove forwards from.
+ * @param[in] prefixes : prefixes from remove_batch_prepare().
+ * @param count : number of prefixes.
+ */
+static void remove_batch(PhoneForward *pf, const char *const *prefixes,
+                         size_t count) {
+  bool memory_error = false;
+  Trie *detached = NULL;
+  struct Reclaim *reclaim =
+      wrap_malloc(sizeof(struct Reclaim), MEMORY_TAG_OTHER);
+  if (reclaim != NULL) {
+    detached = init_trie_sibling(&memory_error, reclaim_free_wrapper, pf,
+                                 pf->database_forward);
+  }
+
+  reverse_batch_start(pf);
+  trie_remove_subtrees(pf->database_forward, detached, prefixes, count);
+  reverse_batch_finish(pf);
+
+  if (detached != NULL && !trie_is_empty(detached)) {
+    forwards_preserve(pf, detached);
+    reclaim->forwards = detached;
+    reclaim->next = pf->reclaim;
+    pf->reclaim = reclaim;
+  } else {
+    trie_drop(detached);
+    wrap_free(reclaim);
+  }
+
+  for (size_t index = 0; index < count; index++) {
+    hybrid_remove(pf, prefixes[index]);
+    clone_mask(pf, prefixes[index]);
+  }
+}
+
+bool phfwdRemoveBatch(PhoneForward *pf, char const *const *prefixes,
+                      size_t count) {
+  if (pf == NULL || prefixes == NULL) {
+    return false;
+  }
+
+  if (pf->recorder != NULL) {
+    for (size_t index = 0; index < count; index++) {
+      if (prefixes[index] != NULL) {
+        operation_log_append(pf->recorder, LOG_REMOVE, prefixes[index], NULL);
+      }
+    }
+  }
+
+  size_t kept = 0;
+  const char **sorted = remove_batch_prepare(prefixes, count, &kept);
+  if (sorted == NULL) {
+    return false;
+  }
+
+  // Removal can't fail once prefixes are prepared, so they are logged first.
+  if (pf->wal != NULL) {
+    for (size_t index = 0; index < kept; index++) {
+      wal_append(pf->wal, WAL_REMOVE, sorted[index], NULL);
+    }
+  }
+
+  LATENCY_START(start)
+  remove_batch(pf, sorted, kept);
+  LATENCY_STOP(LATENCY_REMOVE, start)
+
+  if (pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+  reclaim_step(pf, pf->reclaim_step);
+  compaction_step(pf);
+
+  wrap_free(sorted);
+  return true;
+}
+
+/**
+ * @brief Searches for forward of exactly given key in base of the clone.
+ *
+ * @param[in] pf : clone to search in.
+ * @param[in] key : searched key.
+ * @return const char* : target of the forward (NULL if key has no forward in
+ * base or it is hidden by clone's forward or removal).
+ */
+static const char *clone_base_find(const PhoneForward *pf, const char *key) {
+  size_t matched_length = 0;
+
+  if (trie_find(pf->database_forward, key) != NULL ||
+      trie_match_longest_prefix(pf->masks, key, &matched_length) != NULL) {
+    return NULL;
+  }
+
+  return version_find(pf->base, key);
+}
+
+/**
+ * @brief Searches for forward of longer prefix of the number in base of the
+ * clone than the forward found in the clone itself.
+ *
+ * Every trie of the base (values saved in versions and forwards of the
+ * source) is walked once for its longest match shorter than the limit. The
+ * longest of these matches is decided by the oldest version which saved it.
+ * Only if it was hidden (the key had no forward then), the search is
+ * repeated below it.
+ *
+ * @param[in] pf : clone to search in.
+ * @param[in] num : forwarded number.
+ * @param[in, out] forwarding : target of forward found so far (replaced if
+ * longer one is found).
+ * @param[in, out] prefix_length : length of prefix forwarded so far.
+ */
+static void clone_match(const PhoneForward *pf, const char *num,
+                        const char **forwarding, size_t *prefix_length) {
+  // Base forwards of masked prefixes and their extensions are hidden.
+  size_t masked = 0;
+  size_t limit = trie_match_longest_prefix(pf->masks, num, &masked) == NULL
+                     ? SIZE_MAX
+                     : masked;
+
+  while (limit > *prefix_length + 1) {
+    size_t longest = 0;
+    const char *found = NULL;
+
+    for (const PhoneForwardVersion *version = pf->base; version != NULL;
+         version = version->newer) {
+      size_t length = 0;
+      const char *value =
+          trie_match_bounded_prefix(version->before, num, limit, &length);
+
+      if (value != NULL && length > longest) {
+        longest = length;
+        found = value;
+      }
+    }
+
+    size_t length = 0;
+    const ForwardRecord *record = trie_match_bounded_prefix(
+        pf->base->pf->database_forward, num, limit, &length);
+    if (record != NULL && length > longest) {
+      longest = length;
+      found = record->forwarding;
+    }
+
+    if (found == NULL || longest <= *prefix_length) {
+      return;
+    } else if (found != version_tombstone) {
+      *forwarding = found;
+      *prefix_length = longest;
+      return;
+    }
+
+    limit = longest;
+  }
+}
+
+/**
+ * @brief State of search for reverses in base of the clone.
+ */
+struct CloneReverses {
+  const PhoneForward *pf;      ///< Searched clone.
+  const char *num;             ///< Number to find reverses of.
+  const char *forwarding;      ///< Prefix of @p num forwarded to.
+  DynamicArray *array;         ///< Array to push found reverses to.
+  bool memory_error;           ///< True if memory error has occured.
+};
+
+/**
+ * @brief Pushes reverse to the array if forward belongs to base of the
+ * clone.
+ *
+ * @param[in, out] search : state of the search.
+ * @param[in] key : forwarded prefix.
+ * @param[in] forwarding : target of the forward, which is prefix of searched
+ * number.
+ */
+static void clone_push_reverse(struct CloneReverses *search, const char *key,
+                               const char *forwarding) {
+  const char *visible = clone_base_find(search->pf, key);
+  if (search->memory_error || visible == NULL ||
+      strcmp(visible, forwarding) != 0) {
+    return;
+  }
+
+  size_t key_length = strlen(key);
+  const char *suffix = search->num + strlen(forwarding);
+  char *element = wrap_malloc(key_length + strlen(suffix) + 1,
+                              MEMORY_TAG_RESULTS);
+  if (element == NULL) {
+    search->memory_error = true;
+    return;
+  }
+
+  memcpy(element, key, key_length);
+  strcpy(element + key_length, suffix);
+
+  darray_push(search->array, element, &search->memory_error);
+  if (search->memory_error) {
+    wrap_free(element);
+  }
+}
+
+/**
+ * @brief Visitor of keys saved in versions with searched forwarding, which
+ * pushes their reverses.
+ *
+ * @param[in] key : saved key.
+ * @param[in] value : unused.
+ * @param[in, out] configuration : pointer to struct CloneReverses.
+ */
+static void clone_reverse_visitor(const char *key, void *value,
+                                  void *configuration) {
+  struct CloneReverses *search = configuration;
+  UNUSED(value)
+
+  clone_push_reverse(search, key, search->forwarding);
+}
+
+/**
+ * @brief Pushes reverses of the number, which come from base of the clone.
+ *
+ * Forwards of base are current forwards of the source structure, checked
+ * against the version, and values saved in versions, found by their
+ * forwardings.
+ *
+ * @param[in] pf : clone to search in.
+ * @param[in] num : number to find reverses of.
+ * @param[in, out] array : array to push reverses to.
+ * @return true : if reverses were pushed.
+ * @return false : if memory error has occured.
+ */
+static bool clone_reverses(const PhoneForward *pf, const char *num,
+                           DynamicArray *array) {
+  const PhoneForward *source = pf->base->pf;
+  size_t length = strlen(num);
+
+  char *prefix = wrap_malloc(length + 1, MEMORY_TAG_RESULTS);
+  if (prefix == NULL) {
+    return false;
+  }
+  struct CloneReverses search = {pf, num, prefix, array, false};
+
+  for (size_t prefix_length = 1;
+       prefix_length <= length && !search.memory_error; prefix_length++) {
+    memcpy(prefix, num, prefix_length);
+    prefix[prefix_length] = '\0';
+
+    const List *keys = trie_find(source->database_reverse, prefix);
+    if (keys != NULL) {
+      ListIterator *iterator = list_iterator(keys, &search.memory_error);
+      while (!search.memory_error && listiterator_has_next(iterator)) {
+        clone_push_reverse(&search, listiterator_next(iterator), prefix);
+      }
+      listiterator_drop(iterator);
+    }
+
+    for (const PhoneForwardVersion *version = pf->base;
+         version != NULL && !search.memory_error; version = version->newer) {
+      const Trie *saved = trie_find(version->targets, prefix);
+
+      if (saved != NULL) {
+        trie_iterate(saved, "", SIZE_MAX, clone_reverse_visitor, &search,
+                     &search.memory_error);
+      }
+    }
+  }
+  wrap_free(prefix);
+
+  return !search.memory_error;
+}
+
+/**
+ * @brief Creates result of forwarding number by forward of its prefix.
+ *
+ * @param[in] forwarding : target of the forward (NULL if number isn't
+ * forwarded).
+ * @param[in] num : forwarded number (NULL if result should be empty).
+ * @param prefix_length : length of forwarded prefix of @p num.
+ * @return PhoneNumbers* : result of forwarding (NULL if memory error has
+ * occured).
+ */
+static PhoneNumbers *forward_result(const char *forwarding, char const *num,
+                                    size_t prefix_length) {
+  PhoneNumbers *result =
+      wrap_malloc(sizeof(struct PhoneNumbers), MEMORY_TAG_RESULTS);
+  if (result == NULL) {
+    return NULL;
+  }
+
+  if (num == NULL) {
+    result->amount_of_numbers = 0;
+    result->numbers = NULL;
+    return result;
+  }
+
+  result->numbers = wrap_malloc(sizeof(char *) * 1, MEMORY_TAG_RESULTS);
+  if (result->numbers == NULL) {
+    wrap_free(result);
+    return NULL;
+  }
+
+  if (forwarding == NULL) {
+    result->numbers[0] =
+        wrap_malloc(sizeof(char) * (strlen(num) + 1), MEMORY_TAG_RESULTS);
+    if (result->numbers[0] == NULL) {
+      wrap_free(result->numbers);
+      wrap_free(result);
+      return NULL;
+    }
+
+    strcpy(result->numbers[0], num);
+  } else {
+    size_t forward_len = strlen(forwarding);
+    size_t res_len = forward_len + (strlen(num) - prefix_length);
+
+    result->numbers[0] =
+        wrap_malloc(sizeof(char) * (res_len + 1), MEMORY_TAG_RESULTS);
+    if (result->numbers[0] == NULL) {
+      wrap_free(result->numbers);
+      wrap_free(result);
+      return NULL;
+    }
+
+    memcpy(result->numbers[0], forwarding, forward_len * sizeof(char));
+    strcpy(result->numbers[0] + forward_len, num + prefix_length);
+  }
+  result->amount_of_numbers = 1;
+
+  return result;
+}
+
+/**
+ * @brief Removes forward of exactly given prefix, leaving forwards of longer
+ * prefixes.
+ *
+ * @param[in, out] pf : structure to remove forward from.
+ * @param[in] key : prefix of removed forward.
+ */
+static void delete_forward(PhoneForward *pf, char const *key) {
+  if (trie_find(pf->database_forward, key) != NULL) {
+    trie_remove(pf->database_forward, key);
+    hybrid_delete(pf, key);
+  }
+}
+
+/**
+ * @brief Function implements phfwdGet.
+ *
+ * @param[in] pf : structure to search forward in.
+ * @param[in] num : number to forward.
+ * @return PhoneNumbers* : result of forwarding (NULL if memory error has
+ * occured).
+ */
+static PhoneNumbers *get_forward(PhoneForward const *pf, char const *num) {
+  if (pf == NULL) {
+    return NULL;
+  }
+
+  if (num == NULL || !verify_number(num) || strlen(num) == 0) {
+    return forward_result(NULL, NULL, 0);
+  }
+
+  size_t prefix_length = 0;
+  if (pf->hybrid != NULL && !pf->hybrid->failed) {
+    const char *forwarding = hybrid_match(pf->hybrid, num, &prefix_length);
+    return forward_result(forwarding, num, prefix_length);
+  }
+
+  ForwardRecord *record =
+      trie_match_longest_prefix(pf->database_forward, num, &prefix_length);
+  const char *forwarding = record == NULL ? NULL : record->forwarding;
+
+  if (pf->base != NULL) {
+    if (pf->clone_failed) {
+      return NULL;
+    }
+    clone_match(pf, num, &forwarding, &prefix_length);
+  }
+
+  return forward_result(forwarding, num, prefix_length);
+}
+
+PhoneNumbers *phfwdGet(PhoneForward const *pf, char const *num) {
+  if (pf != NULL && pf->recorder != NULL && num != NULL) {
+    operation_log_append(pf->recorder, LOG_GET, num, NULL);
+  }
+
+  LATENCY_START(start)
+  PhoneNumbers *result = get_forward(pf, num);
+  LATENCY_STOP(LATENCY_GET, start)
+
+  // Lets open group of the log reach the disk while there are no updates.
+  if (pf != NULL && pf->wal != NULL) {
+    wal_poll(pf->wal);
+  }
+
+  return result;
+}
+
+void phnumDelete(PhoneNumbers *pnum) {
+  if (pnum == NULL) {
+    return;
+  }
+
+  for (size_t index = 0; index < pnum->amount_of_numbers; index++) {
+    wrap_free(pnum->numbers[index]);
+  }
+
+  wrap_free(pnum->numbers);
+  wrap_free(pnum);
+}
+
+char const *phnumGet(PhoneNumbers const *pnum, size_t idx) {
+  if (pnum == NULL) {
+    return NULL;
+  }
+
+  if (idx >= pnum->amount_of_numbers) {
+    return NULL;
+  }
+
+  return pnum->numbers[idx];
+}
+
+/**
+ * @brief Function sorts elements from @p to_prepare lexicographiclly and
+ *  removes multiple values from it.
+ *
+ * @param[in] to_prepare : dynamic array to take values from.
+ * @param[in] res_num : string to insert into results array.
+ * @return DynamicArray* : prepared array.
+ */
+static DynamicArray *prepare_reverses(DynamicArray *to_prepare,
+                                      const char *res_num) {
+  bool memory_error = false;
+
+  size_t rev_size = darray_size(to_prepare);
+  char **rev_results = (char **)darray_convert(to_prepare);
+
+  BRTree *new_results = init_tree(&memory_error);
+  if (memory_error) {
+    for (size_t ind = 0; ind < rev_size; ind++) {
+      wrap_free(rev_results[ind]);
+    }
+
+    wrap_free(rev_results);
+    return NULL;
+  }
+
+  for (size_t ind = 0; ind < rev_size; ind++) {
+    if (!brtree_insert(new_results, rev_results[ind])) {
+      brtree_drop(new_results);
+      for (size_t ind_new = 0; ind_new < rev_size; ind_new++) {
+        wrap_free(rev_results[ind_new]);
+      }
+
+      wrap_free(rev_results);
+      return NULL;
+    }
+  }
+
+  char *cpy =
+      wrap_malloc(sizeof(char) * (strlen(res_num) + 1), MEMORY_TAG_RESULTS);
+  if (cpy == NULL) {
+    wrap_free(rev_results);
+    brtree_drop(new_results);
+
+    return NULL;
+  }
+
+  strcpy(cpy, res_num);
+
+  if (!brtree_insert(new_results, cpy)) {
+    wrap_free(rev_results);
+    wrap_free(cpy);
+    brtree_drop(new_results);
+
+    return NULL;
+  }
+
+  wrap_free(rev_results);
+
+  DynamicArray *da = brtree_conversion(new_results, &memory_error);
+  if (memory_error) {
+    return NULL;
+  }
+
+  return da;
+}
+
+/**
+ * @brief Function implements phfwdReverse.
+ *
+ * @param[in] pf : structure to search reverses in.
+ * @param[in] num : number to find reverses of.
+ * @return PhoneNumbers* : sorted reverses (NULL if memory error has occured).
+ */
+static PhoneNumbers *get_reverses(PhoneForward const *pf, char const *num) {
+  if (pf == NULL) {
+    return NULL;
+  }
+
+  if (pf == NULL || num == NULL || !verify_number(num) || strlen(num) == 0) {
+    PhoneNumbers *result =
+        wrap_malloc(sizeof(struct PhoneNumbers), MEMORY_TAG_RESULTS);
+    if (result == NULL) {
+      return NULL;
+    }
+
+    result->amount_of_numbers = 0;
+    result->numbers = NULL;
+    return result;
+  }
+
+  if (pf->clone_failed) {
+    return NULL;
+  }
+
+  DynamicArray *array = trie_traverse_down(
+      pf->database_reverse, num, pf->reclaim == NULL ? NULL : reclaim_filter,
+      (void *)pf);
+  if (array == NULL) {
+    return NULL;
+  }
+
+  if (pf->base != NULL && !clone_reverses(pf, num, array)) {
+    size_t size = darray_size(array);
+    char **elements = (char **)darray_convert(array);
+
+    for (size_t index = 0; index < size; index++) {
+      wrap_free(elements[index]);
+    }
+    wrap_free(elements);
+    return NULL;
+  }
+
+  DynamicArray *checked_array = prepare_reverses(array, num);
+  if (checked_array == NULL) {
+    return NULL;
+  }
+
+  size_t res_size = darray_size(checked_array);
+  char **res_array = (char **)darray_convert(checked_array);
+
+  /*debugx(res_array, res_size);
+  qsort(res_array, res_size, sizeof(char *), comparator);
+  debugx(res_array, res_size);*/
+
+  PhoneNumbers *res =
+      wrap_malloc(sizeof(struct PhoneNumbers), MEMORY_TAG_RESULTS);
+  if (res == NULL) {
+    for (size_t ind = 0; ind < res_size; ind++) {
+      wrap_free(res_array[ind]);
+    }
+
+    wrap_free(res_array);
+    return NULL;
+  }
+
+  res->amount_of_numbers = res_size;
+  res->numbers = res_array;
+
+  return res;
+}
+
+PhoneNumbers *phfwdReverse(PhoneForward const *pf, char const *num) {
+  if (pf != NULL && pf->recorder != NULL && num != NULL) {
+    operation_log_append(pf->recorder, LOG_REVERSE, num, NULL);
+  }
+
+  LATENCY_START(start)
+  PhoneNumbers *result = get_reverses(pf, num);
+  LATENCY_STOP(LATENCY_REVERSE, start)
+
+  if (pf != NULL && pf->wal != NULL) {
+    wal_poll(pf->wal);
+  }
+
+  return result;
+}
+
+bool phfwdMemoryStats(PhoneForward const *pf, PhoneForwardMemoryStats *stats) {
+  if (pf == NULL || stats == NULL) {
+    return false;
+  }
+
+  MemoryCounters per_tag[MEMORY_TAG_COUNT];
+  MemoryCounters total;
+  bool enabled = memory_counters_read(per_tag, &total);
+
+  for (size_t tag = 0; tag < PHFWD_MEMORY_TAGS; tag++) {
+    stats->tags[tag].live_bytes = per_tag[tag].live_bytes;
+    stats->tags[tag].peak_bytes = per_tag[tag].peak_bytes;
+    stats->tags[tag].allocations = per_tag[tag].allocations;
+    stats->tags[tag].releases = per_tag[tag].releases;
+  }
+
+  stats->total.live_bytes = total.live_bytes;
+  stats->total.peak_bytes = total.peak_bytes;
+  stats->total.allocations = total.allocations;
+  stats->total.releases = total.releases;
+  stats->forwards = pf->forwards;
+
+  return enabled;
+}
+
+/**
+ * @brief Copies statistics of the Trie to the structure visible to the user.
+ *
+ * @param[out] shape : structure to fill.
+ * @param[in] stats : statistics gathered from the Trie.
+ */
+static void copy_trie_shape(PhoneForwardTrieShape *shape,
+                            const TrieStatistics *stats) {
+  shape->nodes = stats->nodes;
+  shape->values = stats->values;
+  shape->longest_key = stats->longest_key;
+  shape->deepest_key = stats->deepest_key;
+  shape->scattered_nodes = stats->scattered_nodes;
+  shape->scattered_labels = stats->scattered_labels;
+
+  for (size_t bucket = 0; bucket < PHFWD_STATS_BUCKETS; bucket++) {
+    shape->depth_histogram[bucket] = stats->depth_histogram[bucket];
+    shape->label_length_histogram[bucket] =
+        stats->label_length_histogram[bucket];
+    shape->values_per_depth[bucket] = stats->values_per_depth[bucket];
+  }
+
+  for (size_t bucket = 0; bucket < PHFWD_STATS_FANOUTS; bucket++) {
+    shape->fanout_histogram[bucket] = stats->fanout_histogram[bucket];
+  }
+}
+
+/**
+ * @brief Function serves as value visitor of reverse Trie statistics. Adds
+ * length of the visited list to the histogram.
+ *
+ * @param[in] value : visited list.
+ * @param[out] configuration : pointer to filled PhoneForwardTrieStats.
+ */
+static void reverse_list_visitor(const void *value, void *configuration) {
+  PhoneForwardTrieStats *stats = (PhoneForwardTrieStats *)configuration;
+  size_t length = list_size((const List *)value);
+  size_t bucket = 0;
+
+  while (bucket + 1 < PHFWD_STATS_BUCKETS && (length >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+
+  stats->reverse_entries += length;
+  stats->reverse_list_lengths[bucket]++;
+}
+
+bool phfwdTrieStats(PhoneForward const *pf, PhoneForwardTrieStats *stats) {
+  if (pf == NULL || stats == NULL) {
+    return false;
+  }
+
+  TrieStatistics trie_stats;
+
+  stats->reverse_entries = 0;
+  for (size_t bucket = 0; bucket < PHFWD_STATS_BUCKETS; bucket++) {
+    stats->reverse_list_lengths[bucket] = 0;
+  }
+
+  trie_statistics(pf->database_forward, &trie_stats, NULL, NULL);
+  copy_trie_shape(&stats->forward, &trie_stats);
+
+  trie_statistics(pf->database_reverse, &trie_stats, reverse_list_visitor,
+                  stats);
+  copy_trie_shape(&stats->reverse, &trie_stats);
+
+  return true;
+}
+
+/**
+ * @brief Function serves as callback of reverse Trie relayout. Connects moved
+ * list to its new node.
+ *
+ * @param[in, out] value : moved list.
+ * @param[in] node : new node of the list.
+ * @param[in] configuration : unused.
+ */
+static void reverse_moved(void *value, TrieNode *node, void *configuration) {
+  UNUSED(configuration)
+
+  list_set_node((List *)value, node);
+}
+
+bool phfwdRelayout(PhoneForward *pf) {
+  if (pf == NULL) {
+    return false;
+  }
+
+  return trie_relayout(pf->database_forward, NULL, NULL) &&
+         trie_relayout(pf->database_reverse, reverse_moved, NULL);
+}
+
+void phfwdHotSampling(PhoneForward *pf, bool enabled) {
+  if (pf != NULL) {
+    trie_sample_visits(pf->database_forward, enabled);
+  }
+}
+
+bool phfwdRelayoutHot(PhoneForward *pf, size_t hot_nodes) {
+  if (pf == NULL) {
+    return false;
+  }
+
+  return trie_relayout_hot(pf->database_forward, hot_nodes, NULL, NULL);
+}
+
+bool phfwdLatencySnapshot(PhoneForwardLatencySnapshot *snapshot) {
+  if (snapshot == NULL) {
+    return false;
+  }
+
+  LatencyHistogram histograms[LATENCY_OPERATIONS];
+  bool enabled = latency_snapshot(histograms);
+
+  for (size_t operation = 0; operation < PHFWD_OPERATIONS; operation++) {
+    PhoneForwardLatency *latency = &snapshot->operations[operation];
+
+    latency->count = histograms[operation].count;
+    latency->total = histograms[operation].total;
+    latency->min = histograms[operation].count == 0
+                       ? 0
+                       : histograms[operation].min;
+    latency->max = histograms[operation].max;
+    memcpy(latency->buckets, histograms[operation].buckets,
+           sizeof(uint64_t) * PHFWD_LATENCY_BUCKETS);
+  }
+
+  return enabled;
+}
+
+uint64_t phfwdLatencyBucketValue(size_t bucket) {
+  if (bucket >= PHFWD_LATENCY_BUCKETS) {
+    return UINT64_MAX;
+  }
+
+  return latency_bucket_value(bucket);
+}
+
+uint64_t phfwdLatencyPercentile(PhoneForwardLatency const *latency,
+                                double percentile) {
+  if (latency == NULL) {
+    return 0;
+  }
+
+  LatencyHistogram histogram;
+
+  histogram.count = latency->count;
+  histogram.total = latency->total;
+  histogram.min = latency->min;
+  histogram.max = latency->max;
+  memcpy(histogram.buckets, latency->buckets,
+         sizeof(uint64_t) * LATENCY_BUCKETS);
+
+  return latency_histogram_percentile(&histogram, percentile);
+}
+
+bool phfwdRecordStart(PhoneForward *pf, char const *path) {
+  if (pf == NULL || path == NULL) {
+    return false;
+  }
+
+  OperationLog *recorder = operation_log_open(path);
+  if (recorder == NULL) {
+    return false;
+  }
+
+  operation_log_close(pf->recorder);
+  pf->recorder = recorder;
+
+  return true;
+}
+
+bool phfwdRecordStop(PhoneForward *pf) {
+  if (pf == NULL || pf->recorder == NULL) {
+    return false;
+  }
+
+  bool success = operation_log_close(pf->recorder);
+  pf->recorder = NULL;
+
+  return success;
+}
+
+bool phfwdWalOpen(PhoneForward *pf, char const *path,
+                  PhoneForwardWalOptions const *options) {
+  if (pf == NULL || path == NULL || pf->base != NULL) {
+    return false;
+  }
+
+  PhoneForwardWalOptions defaults = {PHFWD_DURABILITY_GROUP, 2000, 1u << 16,
+                                     1u << 26, 64};
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  size_t length = strlen(path);
+  char *wal_path = wrap_malloc(length + 1, MEMORY_TAG_OTHER);
+  if (wal_path == NULL) {
+    return false;
+  }
+  memcpy(wal_path, path, length + 1);
+
+  WriteAheadLog *wal =
+      wal_open(path, (WalDurability)options->durability,
+               options->group_time_us * 1000u, options->group_bytes);
+  if (wal == NULL) {
+    wrap_free(wal_path);
+    return false;
+  }
+
+  bool success = pf->wal == NULL || phfwdWalClose(pf);
+  pf->wal = wal;
+  pf->wal_path = wal_path;
+  pf->checkpoint_bytes = options->checkpoint_bytes;
+  pf->checkpoint_step = options->checkpoint_step;
+
+  return success;
+}
+
+bool phfwdWalSync(PhoneForward *pf) {
+  if (pf == NULL || pf->wal == NULL) {
+    return false;
+  }
+
+  return wal_commit(pf->wal);
+}
+
+bool phfwdWalPoll(PhoneForward *pf) {
+  if (pf == NULL || pf->wal == NULL) {
+    return false;
+  }
+
+  return wal_poll(pf->wal);
+}
+
+bool phfwdWalFailed(PhoneForward const *pf) {
+  return pf != NULL && pf->wal != NULL && wal_failed(pf->wal);
+}
+
+bool phfwdWalClose(PhoneForward *pf) {
+  if (pf == NULL || pf->wal == NULL) {
+    return false;
+  }
+
+  checkpoint_abort(pf);
+
+  bool success = wal_close(pf->wal);
+  wrap_free(pf->wal_path);
+  pf->wal = NULL;
+  pf->wal_path = NULL;
+
+  return success;
+}
+
+bool phfwdCheckpoint(PhoneForward *pf) {
+  if (pf == NULL || pf->wal == NULL) {
+    return false;
+  }
+
+  if (pf->checkpoint == NULL && !checkpoint_start(pf)) {
+    return false;
+  }
+
+  return checkpoint_step(pf, SIZE_MAX);
+}
+
+bool phfwdCheckpointStep(PhoneForward *pf, size_t forwards) {
+  if (pf == NULL || pf->checkpoint == NULL) {
+    return false;
+  }
+
+  return checkpoint_step(pf, forwards);
+}
+
+bool phfwdReclaimStep(PhoneForward *pf, size_t forwards) {
+  if (pf == NULL) {
+    return false;
+  }
+
+  reclaim_step(pf, forwards);
+  return pf->reclaim != NULL;
+}
+
+void phfwdReclaimSetStep(PhoneForward *pf, size_t forwards) {
+  if (pf != NULL) {
+    pf->reclaim_step = forwards;
+  }
+}
+
+void phfwdCompactionDefer(PhoneForward *pf, bool deferred, size_t threshold) {
+  if (pf == NULL) {
+    return;
+  }
+
+  trie_defer_compaction(pf->database_forward, deferred);
+  trie_defer_compaction(pf->database_reverse, deferred);
+  pf->compaction_threshold = deferred ? threshold : 0;
+
+  if (!deferred) {
+    phfwdCompact(pf);
+  }
+}
+
+size_t phfwdCompact(PhoneForward *pf) {
+  if (pf == NULL) {
+    return 0;
+  }
+
+  return trie_compact(pf->database_forward) +
+         trie_compact(pf->database_reverse);
+}
+
+/**
+ * @brief Addition read from the log, which is applied during recovery.
+ */
+struct LoggedForward {
+  const char *key;       ///< Prefix of forwarded numbers.
+  const char *value;     ///< Target of the forward.
+  ForwardRecord *record; ///< Inserted record (NULL before insertion).
+};
+
+/**
+ * @brief Free function of tries used by recovery, which don't own their
+ * values.
+ *
+ * @param[in] value : unused.
+ * @param[in] key : unused.
+ * @param[in] configuration : unused.
+ */
+static void logged_entry_free(void *value, const char *key,
+                              void *configuration) {
+  (void)value;
+  (void)key;
+  (void)configuration;
+}
+
+/**
+ * @brief Orders logged additions by key.
+ *
+ * @param[in] first : pointer to first LoggedForward.
+ * @param[in] second : pointer to second LoggedForward.
+ * @return int : result of comparison (as required by qsort).
+ */
+static int logged_forward_compare(const void *first, const void *second) {
+  const struct LoggedForward *left = first;
+  const struct LoggedForward *right = second;
+
+  return strcmp(left->key, right->key);
+}
+
+/**
+ * @brief Orders logged additions by target, and by key within one target.
+ *
+ * @param[in] first : pointer to first LoggedForward.
+ * @param[in] second : pointer to second LoggedForward.
+ * @return int : result of comparison (as required by qsort).
+ */
+static int logged_target_compare(const void *first, const void *second) {
+  const struct LoggedForward *left = first;
+  const struct LoggedForward *right = second;
+  int result = strcmp(left->value, right->value);
+
+  return result != 0 ? result : strcmp(left->key, right->key);
+}
+
+/**
+ * @brief Selects additions which determine final state of the log.
+ *
+ * Log is walked from the end, so addition is selected if it is the last one
+ * of its key (not followed by deletion) and no later removal covers it.
+ *
+ * @param[in] contents : loaded log.
+ * @param[out] forwards : place to save selected additions (contents->count
+ * elements).
+ * @param[out] count : place to save number of selected additions.
+ * @return true : if additions were selected.
+ * @return false : if memory error has occured.
+ */
+static bool select_logged_forwards(const WalContents *contents,
+                                   struct LoggedForward *forwards,
+                                   size_t *count) {
+  bool memory_error = false;
+  Trie *removals = init_trie(&memory_error, logged_entry_free, NULL);
+  if (memory_error) {
+    return false;
+  }
+
+  Trie *decided = init_trie(&memory_error, logged_entry_free, NULL);
+  if (memory_error) {
+    trie_drop(removals);
+    return false;
+  }
+
+  size_t matched_length;
+  *count = 0;
+
+  for (size_t index = contents->count; index > 0 && !memory_error; index--) {
+    WalEntry *entry = &contents->entries[index - 1];
+    const char *key = contents->text + entry->key;
+
+    // Records were valid when logged, but the log comes from outside.
+    if (!verify_number(key) || key[0] == '\0' ||
+        (entry->operation == WAL_ADD &&
+         !verify_number(contents->text + entry->value))) {
+      continue;
+    }
+
+    if (entry->operation == WAL_REMOVE) {
+      memory_error = trie_insert(removals, key, entry) == NULL;
+    } else if (entry->operation == WAL_DELETE) {
+      if (trie_find(decided, key) == NULL) {
+        memory_error = trie_insert(decided, key, entry) == NULL;
+      }
+    } else if (trie_find(decided, key) == NULL) {
+      memory_error = trie_insert(decided, key, entry) == NULL;
+
+      if (trie_match_longest_prefix(removals, key, &matched_length) == NULL) {
+        forwards[*count].key = key;
+        forwards[*count].value = contents->text + entry->value;
+        forwards[*count].record = NULL;
+        (*count)++;
+      }
+    }
+  }
+
+  trie_drop(decided);
+  trie_drop(removals);
+
+  return !memory_error;
+}
+
+/**
+ * @brief Inserts forwards of distinct keys at once.
+ *
+ * Forwards are inserted in key order without reverses first. Then they are
+ * sorted by target, so every reverse list is located once for all its new
+ * keys. Validation, recording and logging of phfwdAdd are skipped. If memory
+ * error occurs, forwards which didn't get their reverse are removed again.
+ *
+ * @param[in, out] pf : structure to insert forwards into.
+ * @param[in, out] forwards : forwards sorted by key (reordered by the
+ * function).
+ * @param count : number of forwards.
+ * @return true : if all forwards were inserted.
+ * @return false : if memory error has occured.
+ */
+static bool insert_logged_forwards(PhoneForward *pf,
+                                   struct LoggedForward *forwards,
+                                   size_t count) {
+  size_t inserted = 0;
+  bool success = true;
+
+  for (size_t index = 0; index < count && success; index++) {
+    struct LoggedForward *forward = &forwards[inserted];
+
+    *forward = forwards[index];
+    if (inserted > 0 && strcmp(forward->key, forward[-1].key) == 0) {
+      continue;
+    }
+
+    // Record gets its target with its reverse. Its key is already saved in
+    // versions, so the target isn't read if it is removed before.
+    ForwardRecord *record = forward_record_new();
+
+    success = record != NULL;
+    if (success && pf->newest_version != NULL) {
+      version_preserve(pf, forward->key,
+                       trie_find(pf->database_forward, forward->key));
+    }
+    if (success) {
+      success = trie_insert(pf->database_forward, forward->key, record) !=
+                NULL;
+    }
+
+    if (!success) {
+      wrap_free(record);
+      break;
+    }
+
+    forward->record = record;
+    pf->forwards++;
+    inserted++;
+  }
+
+  qsort(forwards, inserted, sizeof(struct LoggedForward),
+        logged_target_compare);
+
+  size_t index = 0;
+  while (index < inserted && success) {
+    TrieNode *located_node;
+    List *reverse_list = reverse_locate(pf, forwards[index].value,
+                                        &located_node);
+    const char *target = forwards[index].value;
+
+    success = reverse_list != NULL &&
+              (list_get_target(reverse_list) != NULL ||
+               list_set_target(reverse_list, target));
+    for (; success && index < inserted &&
+           strcmp(forwards[index].value, target) == 0;
+         index++) {
+      ListElement *element = list_insert(reverse_list, forwards[index].key);
+
+      success = element != NULL;
+      forwards[index].record->reverse_record = element;
+      forwards[index].record->forwarding = list_get_target(reverse_list);
+    }
+
+    if (!success && reverse_list != NULL && list_isempty(reverse_list)) {
+      trie_remove_from_ptr(pf->database_reverse, located_node, target);
+    }
+  }
+
+  for (index = 0; index < inserted && !success; index++) {
+    if (forwards[index].record->reverse_record == NULL) {
+      trie_remove(pf->database_forward, forwards[index].key);
+    }
+  }
+
+  for (index = 0; index < inserted && success; index++) {
+    hybrid_add(pf, forwards[index].key, forwards[index].value);
+  }
+
+  return success;
+}
+
+/**
+ * @brief Applies loaded log to the structure at once.
+ *
+ * Only the final effect of the log is applied: removals and deletions are
+ * applied to forwards which existed before, and of all additions of a key only
+ * the last one is inserted (in bulk, see insert_logged_forwards()), unless it
+ * was removed later.
+ *
+ * @param[in, out] pf : structure to apply log to.
+ * @param[in] contents : loaded log.
+ * @return true : if log was applied.
+ * @return false : if memory error has occured.
+ */
+static bool apply_wal(PhoneForward *pf, const WalContents *contents) {
+  struct LoggedForward *forwards = wrap_malloc(
+      (contents->count + 1) * sizeof(struct LoggedForward), MEMORY_TAG_OTHER);
+  if (forwards == NULL) {
+    return false;
+  }
+
+  size_t count;
+  if (!select_logged_forwards(contents, forwards, &count)) {
+    wrap_free(forwards);
+    return false;
+  }
+
+  for (size_t index = 0;
+       index < contents->count && (pf->forwards > 0 || pf->base != NULL);
+       index++) {
+    const WalEntry *entry = &contents->entries[index];
+
+    if (entry->operation == WAL_REMOVE) {
+      remove_forwards(pf, contents->text + entry->key);
+    } else if (entry->operation == WAL_DELETE) {
+      delete_forward(pf, contents->text + entry->key);
+    }
+  }
+
+  qsort(forwards, count, sizeof(struct LoggedForward), logged_forward_compare);
+
+  bool success = insert_logged_forwards(pf, forwards, count);
+
+  wrap_free(forwards);
+  return success;
+}
+
+/**
+ * @brief Loads the log and applies it to the structure.
+ *
+ * @param[in, out] pf : structure to apply log to.
+ * @param[in] path : path of the log.
+ * @return true : if log was applied (missing log is empty).
+ * @return false : if log can't be read or memory error has occured.
+ */
+static bool recover_log(PhoneForward *pf, const char *path) {
+  WalContents contents;
+  if (!wal_load(path, &contents)) {
+    return false;
+  }
+
+  bool success = apply_wal(pf, &contents);
+  wal_contents_drop(&contents);
+
+  return success;
+}
+
+/**
+ * @brief Forwards of checkpoint image collected to be inserted at once.
+ */
+struct ImageBatch {
+  PhoneForward *pf;               ///< Structure to insert forwards to.
+  struct LoggedForward *forwards; ///< Collected forwards (RECOVERY_BATCH).
+  size_t count;                   ///< Number of collected forwards.
+  char *text;                     ///< Keys and targets of the forwards.
+  size_t text_length;             ///< Number of used bytes of @p text.
+  size_t text_capacity;           ///< Capacity of @p text.
+};
+
+/**
+ * @brief Inserts collected forwards and empties the batch.
+ *
+ * @param[in, out] batch : batch to insert.
+ * @return true : if forwards were inserted.
+ * @return false : if memory error has occured.
+ */
+static bool image_batch_flush(struct ImageBatch *batch) {
+  // Images are written in key order, so sorting is only a safeguard.
+  qsort(batch->forwards, batch->count, sizeof(struct LoggedForward),
+        logged_forward_compare);
+
+  bool success =
+      insert_logged_forwards(batch->pf, batch->forwards, batch->count);
+  batch->count = 0;
+  batch->text_length = 0;
+
+  return success;
+}
+
+/**
+ * @brief Visitor of replayed checkpoint image, which collects its forwards
+ * into a batch.
+ *
+ * @param operation : logged modification (WAL_ADD in images).
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : target of the forward.
+ * @param[in, out] configuration : pointer to struct ImageBatch.
+ * @return true : if forward was collected or is invalid.
+ * @return false : if memory error has occured.
+ */
+static bool recover_image_visitor(WalOperation operation, const char *key,
+                                  const char *value, void *configuration) {
+  struct ImageBatch *batch = configuration;
+
+  // Records were valid when written, but the image comes from outside.
+  if (operation != WAL_ADD || !verify_number(key) || !verify_number(value) ||
+      key[0] == '\0' || value[0] == '\0' || strcmp(key, value) == 0) {
+    return true;
+  }
+
+  size_t key_length = strlen(key) + 1;
+  size_t length = key_length + strlen(value) + 1;
+
+  if (batch->count == RECOVERY_BATCH ||
+      batch->text_capacity - batch->text_length < length) {
+    if (!image_batch_flush(batch)) {
+      return false;
+    }
+  }
+
+  // Collected forwards point into the text, so it grows only when empty.
+  if (batch->text_capacity < length) {
+    char *text = wrap_realloc(batch->text, length);
+    if (text == NULL) {
+      return false;
+    }
+
+    batch->text = text;
+    batch->text_capacity = length;
+  }
+
+  char *copy = batch->text + batch->text_length;
+  memcpy(copy, key, key_length);
+  memcpy(copy + key_length, value, length - key_length);
+  batch->text_length += length;
+
+  batch->forwards[batch->count].key = copy;
+  batch->forwards[batch->count].value = copy + key_length;
+  batch->forwards[batch->count].record = NULL;
+  batch->count++;
+
+  return true;
+}
+
+/**
+ * @brief Inserts forwards of checkpoint image in batches.
+ *
+ * @param[in, out] pf : structure to insert forwards to.
+ * @param[in] path : path of the image.
+ * @param[in] missing_ok : whether missing image is inserted as empty.
+ * @return true : if image was inserted.
+ * @return false : if image can't be read (or is missing and @p missing_ok is
+ * false) or memory error has occured.
+ */
+static bool recover_image(PhoneForward *pf, const char *path,
+                          bool missing_ok) {
+  struct ImageBatch batch = {pf, NULL, 0, NULL, 0, RECOVERY_TEXT};
+
+  batch.forwards = wrap_malloc(RECOVERY_BATCH * sizeof(struct LoggedForward),
+                               MEMORY_TAG_OTHER);
+  batch.text = wrap_malloc(RECOVERY_TEXT, MEMORY_TAG_OTHER);
+
+  bool success = batch.forwards != NULL && batch.text != NULL &&
+                 wal_replay(path, missing_ok, recover_image_visitor, &batch) &&
+                 image_batch_flush(&batch);
+
+  wrap_free(batch.forwards);
+  wrap_free(batch.text);
+  return success;
+}
+
+bool phfwdWalRecover(PhoneForward *pf, char const *path) {
+  if (pf == NULL || path == NULL) {
+    return false;
+  }
+
+  char *image = wal_file_path(path, ".ckpt");
+  char *previous = wal_file_path(path, ".prev");
+
+  bool success = image != NULL && previous != NULL &&
+                 recover_image(pf, image, true) && recover_log(pf, previous) &&
+                 recover_log(pf, path);
+
+  wrap_free(image);
+  wrap_free(previous);
+  return success;
+}
+
+/**
+ * @brief Writes image of all forwards, in format of checkpoint images.
+ *
+ * Image is written to temporary file, which is renamed to @p path when it is
+ * complete.
+ *
+ * @param[in] pf : structure to write image of.
+ * @param[in] path : path of the image.
+ * @return true : if image was written.
+ * @return false : if any operation on files has failed or memory error has
+ * occured.
+ */
+static bool write_image(const PhoneForward *pf, const char *path) {
+  struct Checkpoint writer;
+  memset(&writer, 0, sizeof(struct Checkpoint));
+
+  char *temporary = wal_file_path(path, ".tmp");
+  if (temporary == NULL) {
+    return false;
+  }
+
+  unlink(temporary);
+  writer.image = wal_open(temporary, WAL_BUFFERED, UINT64_MAX, 1u << 20);
+  bool success = writer.image != NULL;
+
+  if (success) {
+    bool memory_error = false;
+
+    trie_iterate(pf->database_forward, "", SIZE_MAX, checkpoint_visitor,
+                 &writer, &memory_error);
+    if (memory_error || writer.failed) {
+      wal_close(writer.image);
+      success = false;
+    } else {
+      success = wal_finish(writer.image, temporary, path);
+    }
+  }
+
+  if (!success) {
+    unlink(temporary);
+  }
+
+  wrap_free(writer.next);
+  wrap_free(temporary);
+  return success;
+}
+
+bool phfwdSnapshotAsync(PhoneForward *pf, char const *path) {
+  if (pf == NULL || path == NULL || pf->snapshot_process != 0 ||
+      pf->base != NULL) {
+    return false;
+  }
+
+  size_t length = strlen(path);
+  char *snapshot_path = wrap_malloc(length + 1, MEMORY_TAG_OTHER);
+  if (snapshot_path == NULL) {
+    return false;
+  }
+  memcpy(snapshot_path, path, length + 1);
+
+  pid_t process = fork();
+  if (process < 0) {
+    wrap_free(snapshot_path);
+    return false;
+  }
+
+  if (process == 0) {
+    // Child sees memory of the parent from the moment of fork (shared
+    // copy-on-write), so the image is consistent.
+    wrap_free(snapshot_path);
+    _exit(write_image(pf, path) ? 0 : 1);
+  }
+
+  pf->snapshot_process = process;
+  pf->snapshot_path = snapshot_path;
+
+  return true;
+}
+
+PhoneForwardSnapshotStatus phfwdSnapshotPoll(PhoneForward *pf, bool wait,
+                                             uint64_t *size) {
+  if (pf == NULL || pf->snapshot_process == 0) {
+    return PHFWD_SNAPSHOT_NONE;
+  }
+
+  int status = 0;
+  pid_t result;
+  do {
+    result = waitpid(pf->snapshot_process, &status, wait ? 0 : WNOHANG);
+  } while (result < 0 && errno == EINTR);
+
+  if (result == 0) {
+    return PHFWD_SNAPSHOT_RUNNING;
+  }
+
+  struct stat file_status;
+  bool success = result > 0 && WIFEXITED(status) &&
+                 WEXITSTATUS(status) == 0 &&
+                 stat(pf->snapshot_path, &file_status) == 0;
+
+  if (success && size != NULL) {
+    *size = (uint64_t)file_status.st_size;
+  }
+
+  wrap_free(pf->snapshot_path);
+  pf->snapshot_process = 0;
+  pf->snapshot_path = NULL;
+
+  return success ? PHFWD_SNAPSHOT_DONE : PHFWD_SNAPSHOT_FAILED;
+}
+
+bool phfwdSnapshotLoad(PhoneForward *pf, char const *path) {
+  if (pf == NULL || path == NULL) {
+    return false;
+  }
+
+  return recover_image(pf, path, false);
+}
+
+PhoneForwardVersion *phfwdSnapshot(PhoneForward *pf) {
+  if (pf == NULL || pf->base != NULL) {
+    return NULL;
+  }
+
+  // Versions created with no modification between them are the same.
+  PhoneForwardVersion *newest = pf->newest_version;
+  if (newest != NULL && !newest->failed && trie_is_empty(newest->before)) {
+    newest->references++;
+    return newest;
+  }
+
+  PhoneForwardVersion *version =
+      wrap_malloc(sizeof(struct PhoneForwardVersion), MEMORY_TAG_OTHER);
+  if (version == NULL) {
+    return NULL;
+  }
+
+  bool memory_error = false;
+  version->before = init_trie(&memory_error, version_value_free, NULL);
+  if (memory_error) {
+    wrap_free(version);
+    return NULL;
+  }
+
+  version->targets = init_trie(&memory_error, version_keys_free, NULL);
+  if (memory_error) {
+    trie_drop(version->before);
+    wrap_free(version);
+    return NULL;
+  }
+
+  version->pf = pf;
+  version->older = pf->newest_version;
+  version->newer = NULL;
+  version->references = 1;
+  version->failed = false;
+
+  if (version->older != NULL) {
+    version->older->newer = version;
+  }
+  pf->newest_version = version;
+
+  return version;
+}
+
+PhoneNumbers *phfwdVersionGet(PhoneForwardVersion const *version,
+                              char const *num) {
+  if (version == NULL || version->failed) {
+    return NULL;
+  }
+
+  if (num == NULL || !verify_number(num) || strlen(num) == 0) {
+    return forward_result(NULL, NULL, 0);
+  }
+
+  size_t length = strlen(num);
+  char *prefix = wrap_malloc(length + 1, MEMORY_TAG_RESULTS);
+  if (prefix == NULL) {
+    return NULL;
+  }
+  memcpy(prefix, num, length + 1);
+
+  // Prefixes are checked one by one, as keys of the version are scattered
+  // over many tries.
+  const char *forwarding = NULL;
+  for (; length > 0 && forwarding == NULL; length--) {
+    prefix[length] = '\0';
+    forwarding = version_find(version, prefix);
+  }
+  wrap_free(prefix);
+
+  return forward_result(forwarding, num, forwarding == NULL ? 0 : length + 1);
+}
+
+/**
+ * @brief State of phfwdVersionForEach().
+ */
+struct VersionIteration {
+  const PhoneForwardVersion *version; ///< Iterated version.
+  const PhoneForwardVersion *source;  ///< Version whose saved values are
+                                      ///< visited (NULL for the structure).
+  void (*visitor)(char const *num1, char const *num2,
+                  void *configuration); ///< Function called on forwards.
+  void *configuration;                  ///< Pointer passed to visitor.
+};
+
+/**
+ * @brief Visitor of values of the structure and versions, which passes
+ * forward to user's visitor if the value belongs to the iterated version.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord or value saved in version.
+ * @param[in] configuration : pointer to struct VersionIteration.
+ */
+static void version_visitor(const char *key, void *value,
+                            void *configuration) {
+  const struct VersionIteration *iteration = configuration;
+
+  // Value belongs to the version if no version between them saved the key.
+  for (const PhoneForwardVersion *version = iteration->version;
+       version != iteration->source; version = version->newer) {
+    if (trie_find(version->before, key) != NULL) {
+      return;
+    }
+  }
+
+  const char *forwarding = iteration->source == NULL
+                               ? ((const ForwardRecord *)value)->forwarding
+                               : value;
+  if (forwarding != version_tombstone) {
+    iteration->visitor(key, forwarding, iteration->configuration);
+  }
+}
+
+bool phfwdVersionForEach(PhoneForwardVersion const *version,
+                         void (*visitor)(char const *num1, char const *num2,
+                                         void *configuration),
+                         void *configuration) {
+  if (version == NULL || visitor == NULL || version->failed) {
+    return false;
+  }
+
+  struct VersionIteration iteration = {version, version, visitor,
+                                       configuration};
+  bool memory_error = false;
+
+  for (; iteration.source != NULL && !memory_error;
+       iteration.source = iteration.source->newer) {
+    trie_iterate(iteration.source->before, "", SIZE_MAX, version_visitor,
+                 &iteration, &memory_error);
+  }
+
+  if (!memory_error) {
+    trie_iterate(version->pf->database_forward, "", SIZE_MAX,
+                 version_visitor, &iteration, &memory_error);
+  }
+
+  return !memory_error;
+}
+
+/**
+ * @brief Visitor of values saved in released version, which moves them to
+ * the older version unless it has saved them itself.
+ *
+ * @param[in] key : saved key.
+ * @param[in] value : saved value.
+ * @param[in, out] configuration : older version.
+ */
+static void version_merge_visitor(const char *key, void *value,
+                                  void *configuration) {
+  PhoneForwardVersion *older = configuration;
+
+  if (older->failed || trie_find(older->before, key) != NULL) {
+    return;
+  }
+
+  version_save(older, key, value == version_tombstone ? NULL : value);
+}
+
+void phfwdVersionRelease(PhoneForwardVersion *version) {
+  if (version == NULL || --version->references > 0) {
+    return;
+  }
+
+  PhoneForwardVersion *older = version->older;
+  if (older != NULL && !older->failed) {
+    bool memory_error = false;
+
+    trie_iterate(version->before, "", SIZE_MAX, version_merge_visitor, older,
+                 &memory_error);
+    if (memory_error) {
+      version_fail(older);
+    }
+  }
+
+  PhoneForward *pf = version->pf;
+  if (older != NULL) {
+    older->newer = version->newer;
+  }
+  if (version->newer != NULL) {
+    version->newer->older = older;
+  } else {
+    pf->newest_version = older;
+  }
+
+  trie_drop(version->before);
+  trie_drop(version->targets);
+  wrap_free(version);
+
+  if (pf->deleted && pf->newest_version == NULL) {
+    structure_free(pf);
+  }
+}
+
+PhoneForward *phfwdClone(PhoneForward *pf) {
+  if (pf == NULL || pf->base != NULL) {
+    return NULL;
+  }
+
+  PhoneForward *clone = phfwdNew();
+  if (clone == NULL) {
+    return NULL;
+  }
+
+  bool memory_error = false;
+  clone->masks = init_trie(&memory_error, version_value_free, NULL);
+  if (memory_error) {
+    phfwdDelete(clone);
+    return NULL;
+  }
+
+  clone->base = phfwdSnapshot(pf);
+  if (clone->base == NULL) {
+    phfwdDelete(clone);
+    return NULL;
+  }
+
+  return clone;
+}
+
+/**
+ * @brief Searches for forward of exactly given key.
+ *
+ * @param[in] pf : structure (or clone) to search in.
+ * @param[in] key : searched key.
+ * @return const char* : target of the forward (NULL if key has no forward).
+ */
+static const char *forward_find(const PhoneForward *pf, const char *key) {
+  const ForwardRecord *record = trie_find(pf->database_forward, key);
+
+  if (record != NULL) {
+    return record->forwarding;
+  }
+
+  return pf->base == NULL ? NULL : clone_base_find(pf, key);
+}
+
+/**
+ * @brief State of phfwdDiff().
+ */
+struct DiffState {
+  const PhoneForward *from;  ///< Structure before changes.
+  const PhoneForward *to;    ///< Structure after changes.
+  const PhoneForward *clone; ///< Clone whose removed prefixes are visited.
+  Trie *keys;                ///< Keys which may differ.
+  void (*callback)(char const *num, char const *from, char const *to,
+                   void *configuration); ///< Function called on changes.
+  void *configuration;                   ///< Pointer passed to callback.
+  bool memory_error;                     ///< True if memory error occured.
+};
+
+/**
+ * @brief Visitor which adds visited key to keys which may differ.
+ *
+ * @param[in] key : visited key.
+ * @param[in] value : unused.
+ * @param[in, out] configuration : pointer to struct DiffState.
+ */
+static void diff_collect_visitor(const char *key, void *value,
+                                 void *configuration) {
+  struct DiffState *state = configuration;
+  UNUSED(value)
+
+  if (!state->memory_error &&
+      trie_insert(state->keys, key, version_tombstone) == NULL) {
+    state->memory_error = true;
+  }
+}
+
+/**
+ * @brief Adds keys saved in versions from @p version to @p until (exclusive)
+ * to keys which may differ.
+ *
+ * @param[in] version : first version.
+ * @param[in] until : version to stop at (NULL to visit all newer versions).
+ * @param[in, out] state : state of the diff.
+ */
+static void diff_collect_versions(const PhoneForwardVersion *version,
+                                  const PhoneForwardVersion *until,
+                                  struct DiffState *state) {
+  for (; version != until && !state->memory_error;
+       version = version->newer) {
+    trie_iterate(version->before, "", SIZE_MAX, diff_collect_visitor, state,
+                 &state->memory_error);
+  }
+}
+
+/**
+ * @brief Visitor of prefixes removed from base of the clone, which adds keys
+ * of base starting with them to keys which may differ.
+ *
+ * @param[in] key : removed prefix.
+ * @param[in] value : unused.
+ * @param[in, out] configuration : pointer to struct DiffState.
+ */
+static void diff_mask_visitor(const char *key, void *value,
+                              void *configuration) {
+  struct DiffState *state = configuration;
+  const PhoneForwardVersion *version = state->clone->base;
+  UNUSED(value)
+
+  if (!state->memory_error) {
+    trie_iterate_prefix(version->pf->database_forward, key,
+                        diff_collect_visitor, state, &state->memory_error);
+  }
+
+  for (; version != NULL && !state->memory_error; version = version->newer) {
+    trie_iterate_prefix(version->before, key, diff_collect_visitor, state,
+                        &state->memory_error);
+  }
+}
+
+/**
+ * @brief Adds keys which may differ between the clone and its base.
+ *
+ * @param[in] clone : clone to visit changes of.
+ * @param[in, out] state : state of the diff.
+ */
+static void diff_collect_clone(const PhoneForward *clone,
+                               struct DiffState *state) {
+  state->clone = clone;
+
+  trie_iterate(clone->database_forward, "", SIZE_MAX, diff_collect_visitor,
+               state, &state->memory_error);
+  if (!state->memory_error) {
+    trie_iterate(clone->masks, "", SIZE_MAX, diff_mask_visitor, state,
+                 &state->memory_error);
+  }
+}
+
+/**
+ * @brief Adds all keys of the structure (or clone and its base).
+ *
+ * @param[in] pf : structure to visit keys of.
+ * @param[in, out] state : state of the diff.
+ */
+static void diff_collect_all(const PhoneForward *pf, struct DiffState *state) {
+  trie_iterate(pf->database_forward, "", SIZE_MAX, diff_collect_visitor,
+               state, &state->memory_error);
+
+  if (pf->base != NULL && !state->memory_error) {
+    trie_iterate(pf->base->pf->database_forward, "", SIZE_MAX,
+                 diff_collect_visitor, state, &state->memory_error);
+  }
+  if (pf->base != NULL) {
+    diff_collect_versions(pf->base, NULL, state);
+  }
+}
+
+/**
+ * @brief Checks if version is older than the other one.
+ *
+ * @param[in] version : first version.
+ * @param[in] other : second version.
+ * @return true : if @p other is newer version of the same structure.
+ * @return false : otherwise.
+ */
+static bool version_precedes(const PhoneForwardVersion *version,
+                             const PhoneForwardVersion *other) {
+  for (version = version->newer; version != NULL; version = version->newer) {
+    if (version == other) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief Adds keys which may differ between structures sharing forwards:
+ * a clone and its source or two clones of one structure. Only changes made
+ * since the clones were created are visited.
+ *
+ * @param[in, out] state : state of the diff.
+ * @return true : if structures share forwards.
+ * @return false : if they don't (nothing is added then).
+ */
+static bool diff_collect_related(struct DiffState *state) {
+  const PhoneForwardVersion *from = state->from->base;
+  const PhoneForwardVersion *to = state->to->base;
+
+  // Source structure is at the end of its versions.
+  if ((from == NULL && to->pf != state->from) ||
+      (to == NULL && from->pf != state->to) ||
+      (from != NULL && to != NULL && from != to &&
+       !version_precedes(from, to) && !version_precedes(to, from))) {
+    return false;
+  }
+
+  if (from == NULL || (to != NULL && version_precedes(to, from))) {
+    diff_collect_versions(to, from, state);
+  } else if (from != to) {
+    diff_collect_versions(from, to, state);
+  }
+
+  if (state->from->base != NULL) {
+    diff_collect_clone(state->from, state);
+  }
+  if (state->to->base != NULL) {
+    diff_collect_clone(state->to, state);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Reports change of the key if its forwards differ.
+ *
+ * @param[in] state : state of the diff.
+ * @param[in] key : checked key.
+ * @param[in] from : forward before changes (or NULL).
+ * @param[in] to : forward after changes (or NULL).
+ */
+static void diff_report(const struct DiffState *state, const char *key,
+                        const char *from, const char *to) {
+  if (from == NULL && to == NULL) {
+    return;
+  }
+
+  if (from == NULL || to == NULL || strcmp(from, to) != 0) {
+    state->callback(key, from, to, state->configuration);
+  }
+}
+
+/**
+ * @brief Visitor of keys which may differ, which reports changed ones.
+ *
+ * @param[in] key : visited key.
+ * @param[in] value : unused.
+ * @param[in] configuration : pointer to struct DiffState.
+ */
+static void diff_keys_visitor(const char *key, void *value,
+                              void *configuration) {
+  const struct DiffState *state = configuration;
+  UNUSED(value)
+
+  diff_report(state, key, forward_find(state->from, key),
+              forward_find(state->to, key));
+}
+
+/**
+ * @brief Visitor of forwards of structure before changes, which reports
+ * removed and changed ones.
+ *
+ * @param[in] key : visited key.
+ * @param[in] value : ForwardRecord of the key.
+ * @param[in] configuration : pointer to struct DiffState.
+ */
+static void diff_from_visitor(const char *key, void *value,
+                              void *configuration) {
+  const struct DiffState *state = configuration;
+
+  diff_report(state, key, ((const ForwardRecord *)value)->forwarding,
+              forward_find(state->to, key));
+}
+
+/**
+ * @brief Visitor of forwards of structure after changes, which reports added
+ * ones.
+ *
+ * @param[in] key : visited key.
+ * @param[in] value : ForwardRecord of the key.
+ * @param[in] configuration : pointer to struct DiffState.
+ */
+static void diff_to_visitor(const char *key, void *value,
+                            void *configuration) {
+  const struct DiffState *state = configuration;
+
+  if (forward_find(state->from, key) == NULL) {
+    diff_report(state, key, NULL, ((const ForwardRecord *)value)->forwarding);
+  }
+}
+
+bool phfwdDiff(PhoneForward const *from, PhoneForward const *to,
+               void (*callback)(char const *num, char const *from,
+                                char const *to, void *configuration),
+               void *configuration) {
+  if (from == NULL || to == NULL || callback == NULL || from->clone_failed ||
+      to->clone_failed) {
+    return false;
+  }
+
+  struct DiffState state = {from, to, NULL, NULL, callback, configuration,
+                            false};
+  if (from == to) {
+    return true;
+  }
+
+  if (from->base == NULL && to->base == NULL) {
+    trie_iterate(from->database_forward, "", SIZE_MAX, diff_from_visitor,
+                 &state, &state.memory_error);
+    if (!state.memory_error) {
+      trie_iterate(to->database_forward, "", SIZE_MAX, diff_to_visitor,
+                   &state, &state.memory_error);
+    }
+
+    return !state.memory_error;
+  }
+
+  state.keys = init_trie(&state.memory_error, version_value_free, NULL);
+  if (state.memory_error) {
+    return false;
+  }
+
+  if (!diff_collect_related(&state)) {
+    diff_collect_all(from, &state);
+    if (!state.memory_error) {
+      diff_collect_all(to, &state);
+    }
+  }
+
+  if (!state.memory_error) {
+    trie_iterate(state.keys, "", SIZE_MAX, diff_keys_visitor, &state,
+                 &state.memory_error);
+  }
+
+  trie_drop(state.keys);
+  return !state.memory_error;
+}
+
+/**
+ * @brief State of phfwdApplyDiff().
+ */
+struct DiffChanges {
+  PhoneForward *pf; ///< Structure to apply changes to.
+  Trie *changes;    ///< New forwards of changed keys (version_tombstone for
+                    ///< removed ones).
+  bool failed;      ///< True if memory error has occured.
+};
+
+/**
+ * @brief Callback of phfwdDiff(), which saves the change.
+ *
+ * @param[in] num : changed prefix.
+ * @param[in] from : unused.
+ * @param[in] to : new forward of @p num (NULL if it was removed).
+ * @param[in, out] configuration : pointer to struct DiffChanges.
+ */
+static void diff_save_change(char const *num, char const *from,
+                             char const *to, void *configuration) {
+  struct DiffChanges *changes = configuration;
+  UNUSED(from)
+
+  char *value = version_tombstone;
+  if (to != NULL) {
+    size_t length = strlen(to) + 1;
+
+    value = wrap_malloc(length, MEMORY_TAG_OTHER);
+    if (value == NULL) {
+      changes->failed = true;
+      return;
+    }
+    memcpy(value, to, length);
+  }
+
+  if (trie_insert(changes->changes, num, value) == NULL) {
+    version_value_free(value, NULL, NULL);
+    changes->failed = true;
+  }
+}
+
+/**
+ * @brief Visitor of saved changes, which applies them to the structure.
+ *
+ * @param[in] key : changed prefix.
+ * @param[in] value : new forward (version_tombstone if it was removed).
+ * @param[in, out] configuration : pointer to struct DiffChanges.
+ */
+static void diff_apply_visitor(const char *key, void *value,
+                               void *configuration) {
+  struct DiffChanges *changes = configuration;
+  PhoneForward *pf = changes->pf;
+
+  if (changes->failed) {
+    return;
+  }
+
+  // Change is logged before it is applied, as in phfwdAdd().
+  bool logged =
+      pf->wal != NULL &&
+      wal_append(pf->wal, value == version_tombstone ? WAL_DELETE : WAL_ADD,
+                 key, value);
+
+  if (value == version_tombstone) {
+    delete_forward(pf, key);
+  } else if (!add_forward(pf, key, value)) {
+    if (logged) {
+      wal_cancel(pf->wal);
+    }
+    changes->failed = true;
+  }
+}
+
+bool phfwdApplyDiff(PhoneForward *pf, PhoneForward const *from,
+                    PhoneForward const *to) {
+  if (pf == NULL || pf->base != NULL) {
+    return false;
+  }
+
+  bool memory_error = false;
+  struct DiffChanges changes = {pf, NULL, false};
+
+  changes.changes = init_trie(&memory_error, version_value_free, NULL);
+  if (memory_error) {
+    return false;
+  }
+
+  // Changes are saved first, as @p pf may be one of compared structures.
+  if (!phfwdDiff(from, to, diff_save_change, &changes)) {
+    changes.failed = true;
+  }
+
+  if (!changes.failed) {
+    trie_iterate(changes.changes, "", SIZE_MAX, diff_apply_visitor, &changes,
+                 &memory_error);
+  }
+
+  if (pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+
+  trie_drop(changes.changes);
+  return !changes.failed && !memory_error;
+}
+
+bool phfwdHybridEnable(PhoneForward *pf,
+                       PhoneForwardHybridOptions const *options) {
+  static const PhoneForwardHybridOptions defaults = {1u << 12, 64};
+
+  if (pf == NULL || pf->base != NULL) {
+    return false;
+  }
+
+  if (options == NULL) {
+    options = &defaults;
+  }
+
+  struct Hybrid *hybrid = hybrid_new(pf, options);
+  if (hybrid == NULL) {
+    return false;
+  }
+
+  hybrid_drop(pf->hybrid);
+  pf->hybrid = hybrid;
+  return true;
+}
+
+bool phfwdHybridMerge(PhoneForward *pf) {
+  if (pf == NULL || pf->hybrid == NULL) {
+    return false;
+  }
+
+  PhoneForwardHybridOptions options = {pf->hybrid->delta_limit,
+                                       pf->hybrid->merge_step};
+  return phfwdHybridEnable(pf, &options);
+}
+
+void phfwdHybridDisable(PhoneForward *pf) {
+  if (pf == NULL) {
+    return;
+  }
+
+  hybrid_drop(pf->hybrid);
+  pf->hybrid = NULL;
+}
+
+/**
+ * @brief State of phfwdReplacePrefix().
+ */
+struct Replacement {
+  PhoneForward *pf;       ///< Structure whose subtree is replaced.
+  const char *prefix;     ///< Prefix of the replaced subtree.
+  ForwardRecord **records; ///< Records of new forwards.
+  ForwardRecord *links;    ///< Reverses of new forwards inserted to @p pf.
+  size_t count;           ///< Number of inserted reverses.
+  bool failed;            ///< True if some reverse couldn't be inserted.
+};
+
+/**
+ * @brief Visitor of staged forwards, which inserts their reverses to the
+ * structure.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to struct Replacement.
+ */
+static void replace_link_visitor(const char *key, void *value,
+                                 void *configuration) {
+  struct Replacement *replacement = configuration;
+  ForwardRecord *record = value;
+  ForwardRecord inserted;
+
+  if (replacement->failed ||
+      strncmp(key, replacement->prefix, strlen(replacement->prefix)) != 0 ||
+      !reverse_insert(replacement->pf, key, record->forwarding, &inserted)) {
+    replacement->failed = true;
+    return;
+  }
+
+  replacement->records[replacement->count] = record;
+  replacement->links[replacement->count] = inserted;
+  replacement->count++;
+}
+
+bool phfwdReplacePrefix(PhoneForward *pf, char const *prefix,
+                        PhoneForward *staged) {
+  if (pf == NULL || staged == NULL || pf == staged || prefix == NULL ||
+      !verify_number(prefix) || strlen(prefix) == 0 || pf->base != NULL ||
+      staged->base != NULL || staged->newest_version != NULL) {
+    return false;
+  }
+
+  // Reverses of staged forwards must not point to its detached forwards.
+  reclaim_step(staged, SIZE_MAX);
+
+  size_t count = staged->forwards;
+  struct Replacement replacement = {pf, prefix, NULL, NULL, 0, false};
+  struct Reclaim *reclaim =
+      wrap_malloc(sizeof(struct Reclaim), MEMORY_TAG_OTHER);
+  replacement.records = wrap_calloc(count + 1, sizeof(ForwardRecord *),
+                                    MEMORY_TAG_OTHER);
+  replacement.links =
+      wrap_calloc(count + 1, sizeof(ForwardRecord), MEMORY_TAG_OTHER);
+  bool memory_error = reclaim == NULL || replacement.records == NULL ||
+                      replacement.links == NULL;
+
+  if (!memory_error) {
+    trie_iterate(staged->database_forward, "", SIZE_MAX,
+                 replace_link_visitor, &replacement, &memory_error);
+  }
+
+  if (!memory_error && !replacement.failed && pf->newest_version != NULL) {
+    trie_iterate_prefix(pf->database_forward, prefix, version_preserve_visitor,
+                        pf, &memory_error);
+    for (size_t index = 0; index < replacement.count && !memory_error;
+         index++) {
+      const char *key =
+          listelement_get_value(replacement.links[index].reverse_record);
+      version_preserve(pf, key, trie_find(pf->database_forward, key));
+    }
+
+    if (memory_error) {
+      version_fail(pf->newest_version);
+      memory_error = false;
+    }
+  }
+
+  // Replacement is logged before it is applied, as in phfwdAdd().
+  size_t mark = 0;
+  if (!memory_error && !replacement.failed && pf->wal != NULL) {
+    mark = wal_mark(pf->wal);
+    wal_append(pf->wal, WAL_REMOVE, prefix, NULL);
+    for (size_t index = 0; index < count; index++) {
+      wal_append(pf->wal, WAL_ADD,
+                 listelement_get_value(replacement.links[index].reverse_record),
+                 replacement.records[index]->forwarding);
+    }
+  }
+
+  if (memory_error || replacement.failed ||
+      !trie_swap_subtree(pf->database_forward, staged->database_forward,
+                         prefix)) {
+    if (pf->wal != NULL) {
+      wal_rewind(pf->wal, mark);
+    }
+    for (size_t index = 0; index < replacement.count; index++) {
+      ListElement *element = replacement.links[index].reverse_record;
+      reverse_unlink(pf, element, listelement_get_value(element));
+    }
+
+    wrap_free(reclaim);
+    wrap_free(replacement.records);
+    wrap_free(replacement.links);
+    return false;
+  }
+
+  hybrid_remove(pf, prefix);
+  for (size_t index = 0; index < count; index++) {
+    ForwardRecord *record = replacement.records[index];
+
+    // Target shared in the staged structure is dropped together with it, so
+    // record takes the one shared in pf.
+    *record = replacement.links[index];
+    hybrid_add(pf, listelement_get_value(record->reverse_record),
+               record->forwarding);
+  }
+
+  if (pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+
+  // Replaced forwards are left in trie of staged structure, which is freed
+  // in steps together with their reverses.
+  trie_set_free_function(staged->database_forward, reclaim_free_wrapper, pf);
+  reclaim->forwards = staged->database_forward;
+  reclaim->next = pf->reclaim;
+  pf->reclaim = reclaim;
+  pf->forwards += count;
+
+  staged->database_forward = NULL;
+  phfwdDelete(staged);
+
+  wrap_free(replacement.records);
+  wrap_free(replacement.links);
+  reclaim_step(pf, pf->reclaim_step);
+  compaction_step(pf);
+  return true;
+}
+
+/**
+ * @brief Modifications staged to be applied together.
+ */
+struct PhoneForwardTransaction {
+  PhoneForward *pf; ///< Modified structure.
+  Trie *additions;  ///< Targets of staged additions (copies).
+  Trie *removals;   ///< Staged removed prefixes (version_tombstone values),
+                    ///< none of which is prefix of another one.
+  bool failed;      ///< True if some modification couldn't be staged.
+};
+
+/**
+ * @brief Staged addition being applied.
+ */
+struct StagedAddition {
+  char *key;               ///< Copy of forwarded prefix.
+  const char *target;      ///< Target (owned by the transaction).
+  TrieNode *node;          ///< Node of @p key in forward trie (or NULL).
+  ForwardRecord *record;   ///< New forward (or NULL).
+  ForwardRecord *previous; ///< Replaced forward (or NULL).
+  ListElement *element;    ///< Reverse of new forward (or NULL).
+};
+
+/**
+ * @brief Staged removal being applied.
+ */
+struct StagedRemoval {
+  char *prefix;   ///< Copy of removed prefix.
+  TrieNode *slot; ///< Node of @p prefix in detached trie (or NULL).
+  TrieNode *node; ///< Subtree cut from forward trie (or NULL).
+};
+
+/**
+ * @brief State of phfwdCommit().
+ */
+struct TransactionCommit {
+  PhoneForward *pf;                  ///< Modified structure.
+  struct StagedAddition *additions;  ///< Staged additions in key order.
+  size_t addition_count;             ///< Number of collected additions.
+  struct StagedRemoval *removals;    ///< Staged removals in key order.
+  size_t removal_count;              ///< Number of collected removals.
+  Trie *detached;                    ///< Trie of removed subtrees.
+  struct Reclaim *reclaim;           ///< Queue entry of @p detached.
+  bool failed;                       ///< True if memory error has occured.
+};
+
+/**
+ * @brief Free function of trie of staged additions.
+ *
+ * @param[in] value : copy of target.
+ * @param[in] key : unused.
+ * @param[in] configuration : unused.
+ */
+static void staged_value_free(void *value, const char *key,
+                              void *configuration) {
+  UNUSED(key)
+  UNUSED(configuration)
+
+  wrap_free(value);
+}
+
+PhoneForwardTransaction *phfwdBegin(PhoneForward *pf) {
+  if (pf == NULL) {
+    return NULL;
+  }
+
+  PhoneForwardTransaction *transaction =
+      wrap_malloc(sizeof(struct PhoneForwardTransaction), MEMORY_TAG_OTHER);
+  if (transaction == NULL) {
+    return NULL;
+  }
+
+  bool memory_error = false;
+  transaction->pf = pf;
+  transaction->failed = false;
+  transaction->additions =
+      init_trie(&memory_error, staged_value_free, NULL);
+  transaction->removals = memory_error ? NULL
+                                       : init_trie(&memory_error,
+                                                   version_value_free, NULL);
+  if (memory_error) {
+    trie_drop(transaction->additions);
+    wrap_free(transaction);
+    return NULL;
+  }
+
+  return transaction;
+}
+
+bool phfwdStageAdd(PhoneForwardTransaction *transaction, char const *num1,
+                   char const *num2) {
+  if (transaction == NULL || !verify_number(num1) || !verify_number(num2) ||
+      strlen(num1) == 0 || strlen(num2) == 0 || strcmp(num1, num2) == 0) {
     return false;
   }
-  strcpy(inserted_value, num2);
 
-  ForwardRecord *record = wrap_malloc(sizeof(struct ForwardRecord));
-  if (record == NULL) {
-    wrap_free(inserted_value);
+  size_t length = strlen(num2) + 1;
+  char *target = wrap_malloc(length, MEMORY_TAG_OTHER);
+  if (target == NULL) {
     return false;
   }
+  memcpy(target, num2, length);
 
-  record->forwarding = inserted_value;
-  record->reverse_record = NULL;
+  if (trie_insert(transaction->additions, num1, target) == NULL) {
+    wrap_free(target);
+    return false;
+  }
 
-  TrieNode *inserted_node = trie_insert(pf->database_forward, num1, record);
+  return true;
+}
 
-  if (inserted_node == NULL) {
-    wrap_free(record->forwarding);
-    wrap_free(record);
+bool phfwdStageRemove(PhoneForwardTransaction *transaction, char const *num) {
+  if (transaction == NULL || !verify_number(num) || strlen(num) == 0) {
     return false;
   }
 
-  if (!reverse_insert(pf, num1, num2, record)) {
-    trie_remove_from_ptr(pf->database_forward, inserted_node, num1);
+  // Removal cancels earlier additions, but not later ones.
+  trie_remove_subtree(transaction->additions, num);
 
-    return false;
+  size_t matched_length = 0;
+  if (trie_match_longest_prefix(transaction->removals, num,
+                                &matched_length) == NULL) {
+    trie_remove_subtree(transaction->removals, num);
+    if (trie_insert(transaction->removals, num, version_tombstone) == NULL) {
+      transaction->failed = true;
+      return false;
+    }
   }
 
   return true;
 }
 
-void phfwdRemove(PhoneForward *pf, char const *num) {
-  if (num == NULL || pf == NULL) {
-    return;
+/**
+ * @brief Returns copy of the key.
+ *
+ * @param[in] key : copied key.
+ * @return char* : copy of @p key (NULL if memory error has occured).
+ */
+static char *key_copy(const char *key) {
+  size_t length = strlen(key) + 1;
+  char *copy = wrap_malloc(length, MEMORY_TAG_OTHER);
+
+  if (copy != NULL) {
+    memcpy(copy, key, length);
   }
+  return copy;
+}
 
-  if (!verify_number(num) || strlen(num) == 0) {
+/**
+ * @brief Visitor of staged additions, which collects them.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : target.
+ * @param[in, out] configuration : pointer to struct TransactionCommit.
+ */
+static void commit_addition_visitor(const char *key, void *value,
+                                    void *configuration) {
+  struct TransactionCommit *commit = configuration;
+  struct StagedAddition *addition =
+      &commit->additions[commit->addition_count];
+
+  if (commit->failed) {
     return;
   }
 
-  trie_remove_subtree(pf->database_forward, num);
+  char *copy = key_copy(key);
+  if (copy == NULL) {
+    commit->failed = true;
+    return;
+  }
+  *addition = (struct StagedAddition){copy, value, NULL, NULL, NULL, NULL};
+  commit->addition_count++;
 }
 
-PhoneNumbers *phfwdGet(PhoneForward const *pf, char const *num) {
-  if (pf == NULL) {
-    return NULL;
-  }
+/**
+ * @brief Visitor of staged removals, which collects them.
+ *
+ * @param[in] key : removed prefix.
+ * @param[in] value : unused.
+ * @param[in, out] configuration : pointer to struct TransactionCommit.
+ */
+static void commit_removal_visitor(const char *key, void *value,
+                                   void *configuration) {
+  struct TransactionCommit *commit = configuration;
+  struct StagedRemoval *removal = &commit->removals[commit->removal_count];
+  UNUSED(value)
 
-  PhoneNumbers *result = wrap_malloc(sizeof(struct PhoneNumbers));
-  if (result == NULL) {
-    return NULL;
+  if (commit->failed) {
+    return;
   }
 
-  if (pf == NULL || num == NULL || !verify_number(num) || strlen(num) == 0) {
-    result->amount_of_numbers = 0;
-    result->numbers = NULL;
-    return result;
+  char *copy = key_copy(key);
+  if (copy == NULL) {
+    commit->failed = true;
+    return;
   }
+  *removal = (struct StagedRemoval){copy, NULL, NULL};
+  commit->removal_count++;
+}
 
-  bool mem_error = false;
-  size_t prefix_length = 0;
+/**
+ * @brief Visitor which counts values.
+ *
+ * @param[in] key : unused.
+ * @param[in] value : unused.
+ * @param[in] configuration : unused.
+ */
+static void count_visitor(const char *key, void *value, void *configuration) {
+  UNUSED(key)
+  UNUSED(value)
+  UNUSED(configuration)
+}
 
-  ForwardRecord *forwarding =
-      trie_match_longest_prefix(pf->database_forward, num, &prefix_length);
-  if (mem_error) {
-    wrap_free(result);
-    return NULL;
+/**
+ * @brief Collects staged modifications in key order.
+ *
+ * @param[in] transaction : committed transaction.
+ * @param[out] commit : state of commit to fill.
+ * @return true : if modifications were collected.
+ * @return false : if memory error has occured.
+ */
+static bool commit_collect(const PhoneForwardTransaction *transaction,
+                           struct TransactionCommit *commit) {
+  bool memory_error = false;
+  size_t additions = trie_iterate(transaction->additions, "", SIZE_MAX,
+                                  count_visitor, NULL, &memory_error);
+  size_t removals = trie_iterate(transaction->removals, "", SIZE_MAX,
+                                 count_visitor, NULL, &memory_error);
+
+  commit->additions = wrap_calloc(additions + 1,
+                                  sizeof(struct StagedAddition),
+                                  MEMORY_TAG_OTHER);
+  commit->removals = wrap_calloc(removals + 1, sizeof(struct StagedRemoval),
+                                 MEMORY_TAG_OTHER);
+  if (memory_error || commit->additions == NULL ||
+      commit->removals == NULL) {
+    return false;
   }
 
-  result->numbers = wrap_malloc(sizeof(char *) * 1);
-  if (result->numbers == NULL) {
-    wrap_free(result);
-    return NULL;
+  trie_iterate(transaction->additions, "", SIZE_MAX, commit_addition_visitor,
+               commit, &memory_error);
+  trie_iterate(transaction->removals, "", SIZE_MAX, commit_removal_visitor,
+               commit, &memory_error);
+  return !memory_error && !commit->failed;
+}
+
+/**
+ * @brief Applies staged modifications in a way which can be undone without
+ * allocating memory: subtrees of removed prefixes are cut off and new forwards
+ * are put into their nodes and reverse trie. Nodes of forward trie aren't
+ * freed.
+ *
+ * @param[in, out] commit : state of commit.
+ * @return true : if all modifications were applied.
+ * @return false : if memory error has occured (applied modifications are
+ * marked in @p commit).
+ */
+static bool commit_prepare(struct TransactionCommit *commit) {
+  PhoneForward *pf = commit->pf;
+
+  if (!trie_reserve_keys(commit->detached, pf->database_forward)) {
+    return false;
   }
 
-  if (forwarding == NULL) {
-    result->numbers[0] = wrap_malloc(sizeof(char) * (strlen(num) + 1));
-    if (result->numbers[0] == NULL) {
-      wrap_free(result->numbers);
-      wrap_free(result);
-      return NULL;
+  for (size_t index = 0; index < commit->removal_count; index++) {
+    struct StagedRemoval *removal = &commit->removals[index];
+
+    removal->slot = trie_add_node(commit->detached, removal->prefix);
+    if (removal->slot == NULL) {
+      return false;
     }
 
-    strcpy(result->numbers[0], num);
-  } else {
-    size_t forward_len = strlen(forwarding->forwarding);
-    size_t res_len = forward_len + (strlen(num) - prefix_length);
+    removal->node = trie_cut_subtree(pf->database_forward, removal->prefix);
+    if (removal->node == NULL) {
+      return false;
+    }
+  }
 
-    result->numbers[0] = wrap_malloc(sizeof(char) * (res_len + 1));
-    if (result->numbers[0] == NULL) {
-      wrap_free(result->numbers);
-      wrap_free(result);
-      return NULL;
+  for (size_t index = 0; index < commit->addition_count; index++) {
+    struct StagedAddition *addition = &commit->additions[index];
+
+    addition->node = trie_add_node(pf->database_forward, addition->key);
+    if (addition->node == NULL) {
+      return false;
     }
+    addition->previous = trienode_get_value(addition->node);
 
-    memcpy(result->numbers[0], forwarding->forwarding,
-           forward_len * sizeof(char));
-    strcpy(result->numbers[0] + forward_len, num + prefix_length);
+    ForwardRecord *record = forward_record_new();
+    if (record == NULL) {
+      return false;
+    }
+
+    trienode_set_value(addition->node, record);
+    addition->record = record;
+
+    if (!reverse_insert(pf, addition->key, addition->target,
+                        addition->record)) {
+      return false;
+    }
+    addition->element = addition->record->reverse_record;
   }
-  result->amount_of_numbers = 1;
 
-  return result;
+  return true;
 }
 
-void phnumDelete(PhoneNumbers *pnum) {
-  if (pnum == NULL) {
-    return;
-  }
+/**
+ * @brief Undoes modifications applied by commit_prepare() and compacts
+ * forward trie.
+ *
+ * @param[in, out] commit : state of failed commit.
+ */
+static void commit_rollback(struct TransactionCommit *commit) {
+  PhoneForward *pf = commit->pf;
 
-  for (size_t index = 0; index < pnum->amount_of_numbers; index++) {
-    wrap_free(pnum->numbers[index]);
+  for (size_t index = commit->addition_count; index > 0; index--) {
+    struct StagedAddition *addition = &commit->additions[index - 1];
+
+    if (addition->element != NULL) {
+      reverse_unlink(pf, addition->element, addition->key);
+    }
+    if (addition->node != NULL) {
+      trienode_set_value(addition->node, addition->previous);
+    }
   }
 
-  wrap_free(pnum->numbers);
-  wrap_free(pnum);
-}
+  for (size_t index = commit->removal_count; index > 0; index--) {
+    struct StagedRemoval *removal = &commit->removals[index - 1];
 
-char const *phnumGet(PhoneNumbers const *pnum, size_t idx) {
-  if (pnum == NULL) {
-    return NULL;
+    if (removal->node != NULL) {
+      trie_restore_subtree(pf->database_forward, removal->node);
+    }
   }
 
-  if (idx >= pnum->amount_of_numbers) {
-    return NULL;
+  for (size_t index = 0; index < commit->addition_count; index++) {
+    trie_compact_path(pf->database_forward, commit->additions[index].key);
   }
+  for (size_t index = 0; index < commit->removal_count; index++) {
+    trie_compact_path(pf->database_forward, commit->removals[index].prefix);
+  }
+}
 
-  return pnum->numbers[idx];
+/**
+ * @brief Visitor of removed forwards, which saves them in versions.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : ForwardRecord of the prefix.
+ * @param[in, out] configuration : pointer to struct TransactionCommit.
+ */
+static void commit_preserve_visitor(const char *key, void *value,
+                                    void *configuration) {
+  struct TransactionCommit *commit = configuration;
+  version_preserve(commit->pf, key, value);
 }
 
 /**
- * @brief Function sorts elements from @p to_prepare lexicographiclly and
- *  removes multiple values from it.
+ * @brief Finishes modifications applied by commit_prepare(). Nothing here
+ * can fail.
  *
- * @param[in] to_prepare : dynamic array to take values from.
- * @param[in] res_num : string to insert into results array.
- * @return DynamicArray* : prepared array.
+ * @param[in, out] commit : state of commit.
  */
-static DynamicArray *prepare_reverses(DynamicArray *to_prepare,
-                                      const char *res_num) {
+static void commit_finish(struct TransactionCommit *commit) {
+  PhoneForward *pf = commit->pf;
   bool memory_error = false;
 
-  size_t rev_size = darray_size(to_prepare);
-  char **rev_results = (char **)darray_convert(to_prepare);
+  for (size_t index = 0; index < commit->removal_count; index++) {
+    struct StagedRemoval *removal = &commit->removals[index];
 
-  BRTree *new_results = init_tree(&memory_error);
-  if (memory_error) {
-    for (size_t ind = 0; ind < rev_size; ind++) {
-      wrap_free(rev_results[ind]);
+    trie_graft_subtree(commit->detached, removal->slot, removal->node);
+    trie_compact_path(commit->detached, removal->prefix);
+    trie_compact_path(pf->database_forward, removal->prefix);
+    hybrid_remove(pf, removal->prefix);
+    clone_mask(pf, removal->prefix);
+  }
+
+  if (pf->newest_version != NULL) {
+    trie_iterate(commit->detached, "", SIZE_MAX, commit_preserve_visitor,
+                 commit, &memory_error);
+    for (size_t index = 0; index < commit->addition_count; index++) {
+      struct StagedAddition *addition = &commit->additions[index];
+      version_preserve(pf, addition->key, addition->previous);
     }
 
-    wrap_free(rev_results);
-    return NULL;
+    if (memory_error) {
+      version_fail(pf->newest_version);
+    }
   }
 
-  for (size_t ind = 0; ind < rev_size; ind++) {
-    if (!brtree_insert(new_results, rev_results[ind])) {
-      brtree_drop(new_results);
-      for (size_t ind_new = 0; ind_new < rev_size; ind_new++) {
-        wrap_free(rev_results[ind_new]);
-      }
+  reverse_batch_start(pf);
+  for (size_t index = 0; index < commit->addition_count; index++) {
+    struct StagedAddition *addition = &commit->additions[index];
 
-      wrap_free(rev_results);
-      return NULL;
+    pf->forwards++;
+    if (addition->previous != NULL) {
+      reclaim_free_wrapper(addition->previous, addition->key, pf);
+      pf->forwards--;
     }
+    hybrid_add(pf, addition->key, addition->target);
   }
+  reverse_batch_finish(pf);
 
-  char *cpy = wrap_malloc(sizeof(char) * (strlen(res_num) + 1));
-  if (cpy == NULL) {
-    wrap_free(rev_results);
-    brtree_drop(new_results);
-
-    return NULL;
+  // Removed forwards are freed in steps, like after phfwdRemove.
+  if (!trie_is_empty(commit->detached)) {
+    commit->reclaim->forwards = commit->detached;
+    commit->reclaim->next = pf->reclaim;
+    pf->reclaim = commit->reclaim;
+    commit->detached = NULL;
+    commit->reclaim = NULL;
   }
+}
 
-  strcpy(cpy, res_num);
+/**
+ * @brief Frees state of commit.
+ *
+ * @param[in] commit : state to free.
+ * @param success : true if commit succeeded (new forwards belong to the
+ * structure then).
+ */
+static void commit_drop(struct TransactionCommit *commit, bool success) {
+  for (size_t index = 0; index < commit->addition_count; index++) {
+    struct StagedAddition *addition = &commit->additions[index];
 
-  if (!brtree_insert(new_results, cpy)) {
-    wrap_free(rev_results);
-    wrap_free(cpy);
-    brtree_drop(new_results);
+    if (!success && addition->record != NULL) {
+      wrap_free(addition->record);
+    }
+    wrap_free(addition->key);
+  }
 
-    return NULL;
+  for (size_t index = 0; index < commit->removal_count; index++) {
+    wrap_free(commit->removals[index].prefix);
   }
 
-  wrap_free(rev_results);
+  wrap_free(commit->additions);
+  wrap_free(commit->removals);
+  trie_drop(commit->detached);
+  wrap_free(commit->reclaim);
+}
 
-  DynamicArray *da = brtree_conversion(new_results, &memory_error);
-  if (memory_error) {
-    return NULL;
+/**
+ * @brief Function implements phfwdCommit.
+ *
+ * @param[in, out] pf : structure to modify.
+ * @param[in] transaction : committed transaction of @p pf.
+ * @return true : if all modifications were applied.
+ * @return false : if memory error has occured (nothing changes).
+ */
+static bool commit_transaction(PhoneForward *pf,
+                               const PhoneForwardTransaction *transaction) {
+  struct TransactionCommit commit = {pf, NULL, 0, NULL, 0, NULL, NULL, false};
+  bool memory_error = false;
+  bool success = false;
+
+  commit.reclaim = wrap_malloc(sizeof(struct Reclaim), MEMORY_TAG_OTHER);
+  commit.detached = init_trie_sibling(&memory_error, reclaim_free_wrapper,
+                                      pf, pf->database_forward);
+
+  if (!transaction->failed && commit.reclaim != NULL && !memory_error &&
+      commit_collect(transaction, &commit)) {
+    success = commit_prepare(&commit);
+    if (success) {
+      commit_finish(&commit);
+    } else {
+      commit_rollback(&commit);
+    }
   }
 
-  return da;
+  commit_drop(&commit, success);
+  return success;
 }
 
-PhoneNumbers *phfwdReverse(PhoneForward const *pf, char const *num) {
-  if (pf == NULL) {
-    return NULL;
-  }
+/**
+ * @brief Visitor of staged removals, which appends them to write-ahead log.
+ *
+ * @param[in] key : removed prefix.
+ * @param[in] value : unused.
+ * @param[in, out] configuration : log to append to.
+ */
+static void wal_removal_visitor(const char *key, void *value,
+                                void *configuration) {
+  UNUSED(value)
+  wal_append(configuration, WAL_REMOVE, key, NULL);
+}
 
-  if (pf == NULL || num == NULL || !verify_number(num) || strlen(num) == 0) {
-    PhoneNumbers *result = wrap_malloc(sizeof(struct PhoneNumbers));
-    if (result == NULL) {
-      return NULL;
-    }
+/**
+ * @brief Visitor of staged additions, which appends them to write-ahead log.
+ *
+ * @param[in] key : forwarded prefix.
+ * @param[in] value : target.
+ * @param[in, out] configuration : log to append to.
+ */
+static void wal_addition_visitor(const char *key, void *value,
+                                 void *configuration) {
+  wal_append(configuration, WAL_ADD, key, value);
+}
 
-    result->amount_of_numbers = 0;
-    result->numbers = NULL;
-    return result;
-  }
+/**
+ * @brief Appends staged modifications to write-ahead log of the structure.
+ * Removals go first, as they are applied first.
+ *
+ * @param[in, out] pf : structure with open log.
+ * @param[in] transaction : committed transaction.
+ * @return true : if all modifications were passed to the log.
+ * @return false : if memory error has occured (some may be missing).
+ */
+static bool commit_log(PhoneForward *pf,
+                       const PhoneForwardTransaction *transaction) {
+  bool memory_error = false;
 
-  DynamicArray *array = trie_traverse_down(pf->database_reverse, num);
-  if (array == NULL) {
-    return NULL;
-  }
+  trie_iterate(transaction->removals, "", SIZE_MAX, wal_removal_visitor,
+               pf->wal, &memory_error);
+  trie_iterate(transaction->additions, "", SIZE_MAX, wal_addition_visitor,
+               pf->wal, &memory_error);
+  return !memory_error;
+}
 
-  DynamicArray *checked_array = prepare_reverses(array, num);
-  if (checked_array == NULL) {
-    return NULL;
+bool phfwdCommit(PhoneForwardTransaction *transaction) {
+  if (transaction == NULL) {
+    return false;
   }
 
-  size_t res_size = darray_size(checked_array);
-  char **res_array = (char **)darray_convert(checked_array);
-
-  /*debugx(res_array, res_size);
-  qsort(res_array, res_size, sizeof(char *), comparator);
-  debugx(res_array, res_size);*/
+  // Modifications are logged before they are applied and dropped from the
+  // log if the commit fails.
+  PhoneForward *pf = transaction->pf;
+  size_t mark = pf->wal == NULL ? 0 : wal_mark(pf->wal);
+  bool result = (pf->wal == NULL || commit_log(pf, transaction)) &&
+                commit_transaction(pf, transaction);
 
-  PhoneNumbers *res = wrap_malloc(sizeof(struct PhoneNumbers));
-  if (res == NULL) {
-    for (size_t ind = 0; ind < res_size; ind++) {
-      wrap_free(res_array[ind]);
-    }
+  // Nothing is left in the log after a failed commit.
+  if (pf->wal != NULL && !result) {
+    wal_rewind(pf->wal, mark);
+  } else if (pf->wal != NULL) {
+    wal_poll(pf->wal);
+    checkpoint_tick(pf);
+  }
+  phfwdAbort(transaction);
 
-    wrap_free(res_array);
-    return NULL;
+  if (result) {
+    reclaim_step(pf, pf->reclaim_step);
+    compaction_step(pf);
   }
+  return result;
+}
 
-  res->amount_of_numbers = res_size;
-  res->numbers = res_array;
+void phfwdAbort(PhoneForwardTransaction *transaction) {
+  if (transaction == NULL) {
+    return;
+  }
 
-  return res;
+  trie_drop(transaction->additions);
+  trie_drop(transaction->removals);
+  wrap_free(transaction);
 }
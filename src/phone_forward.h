@@ -12,6 +12,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * To jest struktura przechowująca przekierowania numerów telefonów.
@@ -67,13 +68,104 @@ bool phfwdAdd(PhoneForward *pf, char const *num1, char const *num2);
 /** @brief Usuwa przekierowania.
  * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
  * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.
+ * lub napis nie reprezentuje numeru, nic nie robi. Usuwane przekierowania są
+ * odłączane w czasie zależnym od długości prefiksu, a ich pamięć jest
+ * zwalniana stopniowo (zob. @ref phfwdReclaimStep); od razu przestają być
+ * widoczne. Jeśli struktura ma wersje (zob. @ref phfwdSnapshot), usuwane
+ * przekierowania są najpierw w nich zapisywane.
  * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
  *                     numerów;
  * @param[in] num    – wskaźnik na napis reprezentujący prefiks numerów.
  */
 void phfwdRemove(PhoneForward *pf, char const *num);
 
+/** @brief Usuwa przekierowania wielu prefiksów.
+ * Działa jak wywołanie funkcji @ref phfwdRemove dla każdego z prefiksów, ale
+ * prefiksy są sortowane, pomijane są te, które zaczynają się innym prefiksem
+ * z tablicy, a pozostałe są usuwane w jednym przejściu drzewa, więc wspólne
+ * górne poziomy drzewa są odwiedzane raz.
+ * @param[in,out] pf    – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] prefixes  – tablica wskaźników na napisy reprezentujące
+ *                        prefiksy numerów;
+ * @param[in] count     – liczba prefiksów.
+ * @return Wartość @p true, jeśli przekierowania zostały usunięte.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, któryś
+ *         z napisów nie reprezentuje numeru lub nie udało się alokować
+ *         pamięci (nic nie jest wtedy usuwane).
+ */
+bool phfwdRemoveBatch(PhoneForward *pf, char const *const *prefixes,
+                      size_t count);
+
+/**
+ * @brief Struktura przechowująca zmiany przekierowań wprowadzane razem.
+ */
+struct PhoneForwardTransaction;
+/**
+ * @brief Typedef skraca nazwę PhoneForwardTransaction.
+ */
+typedef struct PhoneForwardTransaction PhoneForwardTransaction;
+
+/** @brief Rozpoczyna transakcję.
+ * Tworzy pustą transakcję struktury @p pf. Zmiany dodane funkcjami
+ * @ref phfwdStageAdd i @ref phfwdStageRemove nie są widoczne w strukturze,
+ * dopóki nie zostaną wprowadzone funkcją @ref phfwdCommit. Struktury nie
+ * wolno usunąć przed zakończeniem transakcji.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                 numerów.
+ * @return Wskaźnik na utworzoną transakcję lub NULL, gdy parametr ma wartość
+ *         NULL lub nie udało się alokować pamięci.
+ */
+PhoneForwardTransaction *phfwdBegin(PhoneForward *pf);
+
+/** @brief Dodaje do transakcji przekierowanie.
+ * Działa jak funkcja @ref phfwdAdd wywołana w chwili zatwierdzenia
+ * transakcji, po zmianach dodanych wcześniej.
+ * @param[in,out] transaction – wskaźnik na transakcję;
+ * @param[in] num1            – wskaźnik na napis reprezentujący prefiks
+ *                              numerów przekierowywanych;
+ * @param[in] num2            – wskaźnik na napis reprezentujący prefiks
+ *                              numerów, na które jest wykonywane
+ *                              przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane do transakcji.
+ *         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
+ *         reprezentuje numeru, oba podane numery są identyczne lub nie
+ *         udało się alokować pamięci (transakcja się wtedy nie zmienia).
+ */
+bool phfwdStageAdd(PhoneForwardTransaction *transaction, char const *num1,
+                   char const *num2);
+
+/** @brief Dodaje do transakcji usunięcie przekierowań.
+ * Działa jak funkcja @ref phfwdRemove wywołana w chwili zatwierdzenia
+ * transakcji, po zmianach dodanych wcześniej.
+ * @param[in,out] transaction – wskaźnik na transakcję;
+ * @param[in] num             – wskaźnik na napis reprezentujący prefiks
+ *                              numerów.
+ * @return Wartość @p true, jeśli usunięcie zostało dodane do transakcji.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, napis
+ *         nie reprezentuje numeru lub nie udało się alokować pamięci (wtedy
+ *         transakcja nie może już zostać zatwierdzona).
+ */
+bool phfwdStageRemove(PhoneForwardTransaction *transaction, char const *num);
+
+/** @brief Zatwierdza i zwalnia transakcję.
+ * Wprowadza wszystkie zmiany transakcji albo żadnej. Pamięć jest alokowana
+ * przed wprowadzeniem zmian, a odwrotne przekierowania są porządkowane raz
+ * dla całej transakcji.
+ * @param[in] transaction – wskaźnik na transakcję.
+ * @return Wartość @p true, jeśli zmiany zostały wprowadzone.
+ *         Wartość @p false, jeśli parametr ma wartość NULL lub nie udało się
+ *         alokować pamięci (struktura się wtedy nie zmienia).
+ */
+bool phfwdCommit(PhoneForwardTransaction *transaction);
+
+/** @brief Porzuca i zwalnia transakcję.
+ * Żadna zmiana transakcji nie jest wprowadzana. Nic nie robi, jeśli wskaźnik
+ * ma wartość NULL.
+ * @param[in] transaction – wskaźnik na porzucaną transakcję.
+ */
+void phfwdAbort(PhoneForwardTransaction *transaction);
+
 /** @brief Wyznacza przekierowanie numeru.
  * Wyznacza przekierowanie podanego numeru. Szuka najdłuższego pasującego
  * prefiksu. Wynikiem jest ciąg zawierający co najwyżej jeden numer. Jeśli dany
@@ -120,4 +212,763 @@ void phnumDelete(PhoneNumbers *pnum);
  */
 char const *phnumGet(PhoneNumbers const *pnum, size_t idx);
 
+/**
+ * Podsystemy biblioteki, którym przypisywana jest zaalokowana pamięć.
+ */
+enum PhoneForwardMemoryTag {
+  PHFWD_MEMORY_TRIE_NODE,      ///< Węzły drzew trie.
+  PHFWD_MEMORY_EDGE_LABEL,     ///< Etykiety krawędzi drzew trie.
+  PHFWD_MEMORY_FORWARD_RECORD, ///< Rekordy przekierowań.
+  PHFWD_MEMORY_REVERSE_LIST,   ///< Listy przekierowań odwrotnych.
+  PHFWD_MEMORY_BRTREE,         ///< Drzewa czerwono-czarne.
+  PHFWD_MEMORY_RESULTS,        ///< Wyniki zapytań.
+  PHFWD_MEMORY_OTHER,          ///< Pozostałe alokacje.
+  PHFWD_MEMORY_TAGS            ///< Liczba podsystemów.
+};
+
+/**
+ * To jest struktura przechowująca liczniki alokacji jednego podsystemu.
+ */
+struct PhoneForwardMemoryCounters {
+  size_t live_bytes;  ///< Liczba bajtów zaalokowanych i niezwolnionych.
+  size_t peak_bytes;  ///< Największa osiągnięta wartość @p live_bytes.
+  size_t allocations; ///< Liczba wykonanych alokacji.
+  size_t releases;    ///< Liczba wykonanych zwolnień pamięci.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardMemoryCounters.
+ */
+typedef struct PhoneForwardMemoryCounters PhoneForwardMemoryCounters;
+
+/**
+ * To jest struktura przechowująca statystyki zużycia pamięci.
+ */
+struct PhoneForwardMemoryStats {
+  PhoneForwardMemoryCounters tags[PHFWD_MEMORY_TAGS]; ///< Liczniki podsystemów.
+  PhoneForwardMemoryCounters total; ///< Liczniki zsumowane po podsystemach.
+  size_t forwards; ///< Liczba przekierowań przechowywanych w strukturze
+                   ///< (także zastąpionych, jeszcze niezwolnionych).
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardMemoryStats.
+ */
+typedef struct PhoneForwardMemoryStats PhoneForwardMemoryStats;
+
+/** @brief Odczytuje statystyki zużycia pamięci.
+ * Wypełnia @p stats licznikami alokacji z podziałem na podsystemy. Liczniki
+ * są wspólne dla wszystkich struktur w procesie, a pole @p forwards opisuje
+ * strukturę @p pf, więc koszt jednego przekierowania to iloraz tych wartości.
+ * Liczniki są prowadzone tylko wtedy, gdy biblioteka została skompilowana
+ * z opcją PHFWD_MEMORY_STATS.
+ * @param[in] pf     – wskaźnik na strukturę przechowującą przekierowania
+ *                     numerów;
+ * @param[out] stats – wskaźnik na wypełniane statystyki.
+ * @return Wartość @p true, jeśli liczniki są prowadzone.
+ *         Wartość @p false, jeśli biblioteka nie prowadzi liczników (liczniki
+ *         są wtedy wyzerowane) lub któryś z parametrów ma wartość NULL.
+ */
+bool phfwdMemoryStats(PhoneForward const *pf, PhoneForwardMemoryStats *stats);
+
+/**
+ * Liczba przedziałów histogramów opisujących kształt drzew. Ostatni przedział
+ * zbiera wszystkie większe wartości.
+ */
+#define PHFWD_STATS_BUCKETS 32
+
+/**
+ * Liczba przedziałów histogramu liczby dzieci węzła (od 0 do 12 dzieci).
+ */
+#define PHFWD_STATS_FANOUTS 13
+
+/**
+ * To jest struktura opisująca kształt jednego drzewa trie.
+ */
+struct PhoneForwardTrieShape {
+  size_t nodes;       ///< Liczba węzłów (razem z korzeniem).
+  size_t values;      ///< Liczba węzłów przechowujących wartość.
+  size_t longest_key; ///< Rozmiar bufora na najdłuższy klucz drzewa.
+  size_t deepest_key; ///< Długość najdłuższego klucza w drzewie.
+  size_t depth_histogram[PHFWD_STATS_BUCKETS]; ///< Węzły na danym poziomie.
+  size_t fanout_histogram[PHFWD_STATS_FANOUTS]; ///< Węzły o danej liczbie
+                                                ///< dzieci.
+  size_t label_length_histogram[PHFWD_STATS_BUCKETS]; ///< Krawędzie o danej
+                                                      ///< długości etykiety.
+  size_t values_per_depth[PHFWD_STATS_BUCKETS]; ///< Wartości na danym
+                                                ///< poziomie.
+  size_t scattered_nodes;  ///< Węzły odległe o ponad stronę pamięci (4 KiB)
+                           ///< od węzła poprzedzającego je w kolejności
+                           ///< kluczy.
+  size_t scattered_labels; ///< Etykiety krawędzi odległe o ponad stronę
+                           ///< pamięci od węzła, z którego wychodzą.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardTrieShape.
+ */
+typedef struct PhoneForwardTrieShape PhoneForwardTrieShape;
+
+/**
+ * To jest struktura opisująca kształt drzew przechowujących przekierowania.
+ */
+struct PhoneForwardTrieStats {
+  PhoneForwardTrieShape forward; ///< Kształt drzewa przekierowań.
+  PhoneForwardTrieShape reverse; ///< Kształt drzewa przekierowań odwrotnych.
+  size_t reverse_entries;        ///< Łączna długość list odwrotnych.
+  size_t reverse_list_lengths[PHFWD_STATS_BUCKETS]; ///< Liczba list o długości
+                                                    ///< z przedziału
+                                                    ///< [2^k, 2^(k+1)).
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardTrieStats.
+ */
+typedef struct PhoneForwardTrieStats PhoneForwardTrieStats;
+
+/** @brief Wyznacza statystyki kształtu drzew.
+ * Przechodzi oba drzewa trie struktury @p pf i wypełnia @p stats liczbą
+ * węzłów, histogramami głębokości, liczby dzieci i długości etykiet krawędzi,
+ * liczbą wartości na poziomach, rozkładem długości list przekierowań
+ * odwrotnych oraz liczbą węzłów i etykiet rozproszonych w pamięci (zob.
+ * @ref phfwdRelayout). Poziomy są liczone w krawędziach od korzenia. Czas
+ * działania jest liniowy względem rozmiaru struktury.
+ * @param[in] pf     – wskaźnik na strukturę przechowującą przekierowania
+ *                     numerów;
+ * @param[out] stats – wskaźnik na wypełniane statystyki.
+ * @return Wartość @p true, jeśli statystyki zostały wyznaczone.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL.
+ */
+bool phfwdTrieStats(PhoneForward const *pf, PhoneForwardTrieStats *stats);
+
+/** @brief Układa drzewa struktury w pamięci od nowa.
+ * Po wielu modyfikacjach węzły drzew są rozproszone w pamięci, więc prawie
+ * każdy poziom wyszukiwania odwołuje się do innej strony pamięci. Funkcja
+ * kopiuje oba drzewa w kolejności kluczy, alokując etykiety krawędzi zaraz
+ * za węzłem, z którego wychodzą, a stare węzły zwalnia dopiero po
+ * skopiowaniu całego drzewa. Na czas działania pamięć drzew jest zajęta
+ * podwójnie. Efekt pokazują pola @p scattered_nodes i @p scattered_labels
+ * statystyk (zob. @ref phfwdTrieStats) przed i po wywołaniu.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli drzewa zostały ułożone od nowa.
+ *         Wartość @p false, jeśli parametr ma wartość NULL lub nie udało się
+ *         alokować pamięci (drzewo, którego nie udało się skopiować, pozostaje
+ *         bez zmian).
+ */
+bool phfwdRelayout(PhoneForward *pf);
+
+/** @brief Włącza lub wyłącza zliczanie odwiedzin węzłów przez @ref phfwdGet.
+ * Gdy zliczanie jest włączone, wyszukiwanie przekierowania zwiększa
+ * nasycający się licznik każdego węzła drzewa przekierowań, do którego
+ * wchodzi. Liczniki są wykorzystywane przez @ref phfwdRelayoutHot i są
+ * zachowywane po wyłączeniu zliczania. Wyszukiwania obsłużone przez układ
+ * hybrydowy (zob. @ref phfwdHybridEnable) nie są zliczane. Nic nie robi,
+ * jeśli parametr @p pf ma wartość NULL.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] enabled – wartość @p true, jeśli odwiedziny mają być zliczane.
+ */
+void phfwdHotSampling(PhoneForward *pf, bool enabled);
+
+/** @brief Układa drzewo przekierowań od nowa, zaczynając od gorących ścieżek.
+ * Działa jak @ref phfwdRelayout dla drzewa przekierowań, ale najpierw kopiuje
+ * co najwyżej @p hot_nodes najczęściej odwiedzanych węzłów (zob.
+ * @ref phfwdHotSampling) wraz z etykietami ich krawędzi, tak aby ścieżki
+ * najczęstszych wyszukiwań leżały obok siebie w pamięci, a dopiero potem
+ * pozostałe poddrzewa w kolejności kluczy. Następnie liczniki odwiedzin są
+ * dzielone przez dwa, więc kolejne ułożenie faworyzuje niedawne wyszukiwania.
+ * Drzewo przekierowań odwrotnych nie jest zmieniane.
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] hot_nodes – maksymalna liczba węzłów kopiowanych najpierw.
+ * @return Wartość @p true, jeśli drzewo zostało ułożone od nowa.
+ *         Wartość @p false, jeśli parametr @p pf ma wartość NULL lub nie
+ *         udało się alokować pamięci (drzewo pozostaje bez zmian).
+ */
+bool phfwdRelayoutHot(PhoneForward *pf, size_t hot_nodes);
+
+/**
+ * Liczba przedziałów histogramu czasów wykonania operacji.
+ */
+#define PHFWD_LATENCY_BUCKETS 976
+
+/**
+ * Operacje, których czas wykonania jest mierzony.
+ */
+enum PhoneForwardOperation {
+  PHFWD_OPERATION_ADD,     ///< Wywołania @ref phfwdAdd.
+  PHFWD_OPERATION_GET,     ///< Wywołania @ref phfwdGet.
+  PHFWD_OPERATION_REMOVE,  ///< Wywołania @ref phfwdRemove.
+  PHFWD_OPERATION_REVERSE, ///< Wywołania @ref phfwdReverse.
+  PHFWD_OPERATIONS         ///< Liczba mierzonych operacji.
+};
+
+/**
+ * To jest struktura przechowująca histogram czasów wykonania jednej operacji.
+ * Histogram jest logarytmiczno-liniowy: każda potęga dwójki jest podzielona
+ * na 16 równych przedziałów, więc błąd względny nie przekracza 1/16.
+ * Czasy są wyrażone w taktach licznika TSC na procesorach x86, a na pozostałych
+ * w nanosekundach.
+ */
+struct PhoneForwardLatency {
+  uint64_t count; ///< Liczba zmierzonych wywołań.
+  uint64_t total; ///< Suma czasów wywołań.
+  uint64_t min;   ///< Najkrótszy czas wywołania.
+  uint64_t max;   ///< Najdłuższy czas wywołania.
+  uint64_t buckets[PHFWD_LATENCY_BUCKETS]; ///< Liczba wywołań w przedziałach.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardLatency.
+ */
+typedef struct PhoneForwardLatency PhoneForwardLatency;
+
+/**
+ * To jest struktura przechowująca histogramy czasów wszystkich operacji.
+ */
+struct PhoneForwardLatencySnapshot {
+  PhoneForwardLatency operations[PHFWD_OPERATIONS]; ///< Histogramy operacji.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardLatencySnapshot.
+ */
+typedef struct PhoneForwardLatencySnapshot PhoneForwardLatencySnapshot;
+
+/** @brief Odczytuje histogramy czasów wykonania operacji.
+ * Scala histogramy wszystkich wątków, które wywołały funkcje @ref phfwdAdd,
+ * @ref phfwdGet, @ref phfwdRemove lub @ref phfwdReverse. Wątki zapisują
+ * pomiary do własnych histogramów bez blokad, więc odczyt wykonywany w trakcie
+ * pracy innych wątków może pominąć ich najnowsze pomiary. Pomiary są
+ * prowadzone tylko wtedy, gdy biblioteka została skompilowana z opcją
+ * PHFWD_LATENCY_STATS.
+ * @param[out] snapshot – wskaźnik na wypełniane histogramy.
+ * @return Wartość @p true, jeśli pomiary są prowadzone.
+ *         Wartość @p false, jeśli biblioteka nie prowadzi pomiarów (histogramy
+ *         są wtedy wyzerowane) lub parametr ma wartość NULL.
+ */
+bool phfwdLatencySnapshot(PhoneForwardLatencySnapshot *snapshot);
+
+/** @brief Udostępnia dolną granicę przedziału histogramu.
+ * @param[in] bucket – indeks przedziału.
+ * @return Najmniejszy czas należący do przedziału @p bucket. Wartość
+ *         UINT64_MAX, jeśli indeks ma za dużą wartość.
+ */
+uint64_t phfwdLatencyBucketValue(size_t bucket);
+
+/** @brief Wyznacza percentyl czasów wykonania.
+ * @param[in] latency    – wskaźnik na histogram operacji;
+ * @param[in] percentile – żądany percentyl (od 0 do 100).
+ * @return Dolna granica przedziału zawierającego percentyl. Wartość 0, jeśli
+ *         histogram jest pusty lub wskaźnik ma wartość NULL.
+ */
+uint64_t phfwdLatencyPercentile(PhoneForwardLatency const *latency,
+                                double percentile);
+
+/** @brief Rozpoczyna nagrywanie wywołań.
+ * Od tej chwili każde wywołanie funkcji @ref phfwdAdd, @ref phfwdRemove,
+ * @ref phfwdGet i @ref phfwdReverse na strukturze @p pf (z argumentami różnymi
+ * od NULL) jest dopisywane do pliku @p path wraz z czasem, który upłynął od
+ * poprzedniego wywołania. Zapis jest buforowany. Plik można odtworzyć
+ * programem phfwd_replay. Jeśli nagrywanie już trwa, poprzedni plik jest
+ * zamykany i nagrywanie jest kontynuowane w nowym pliku.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] path    – ścieżka pliku, który zostanie utworzony lub nadpisany.
+ * @return Wartość @p true, jeśli nagrywanie się rozpoczęło.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, nie
+ *         udało się utworzyć pliku lub alokować pamięci.
+ */
+bool phfwdRecordStart(PhoneForward *pf, char const *path);
+
+/** @brief Kończy nagrywanie wywołań.
+ * Opróżnia bufor i zamyka plik otwarty przez @ref phfwdRecordStart.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli wszystkie wywołania zostały zapisane.
+ *         Wartość @p false, jeśli nagrywanie nie trwało, parametr ma wartość
+ *         NULL lub zapis się nie powiódł.
+ */
+bool phfwdRecordStop(PhoneForward *pf);
+
+/**
+ * @brief Poziomy trwałości dziennika modyfikacji.
+ */
+enum PhoneForwardDurability {
+  PHFWD_DURABILITY_BUFFERED, ///< Grupy są zapisywane bez synchronizacji z
+                             ///< dyskiem (przetrwają awarię procesu).
+  PHFWD_DURABILITY_GROUP,    ///< Grupy są zapisywane i synchronizowane z
+                             ///< dyskiem.
+  PHFWD_DURABILITY_SYNC,     ///< Każda modyfikacja jest synchronizowana z
+                             ///< dyskiem przed powrotem z funkcji.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardDurability.
+ */
+typedef enum PhoneForwardDurability PhoneForwardDurability;
+
+/**
+ * @brief Parametry dziennika modyfikacji.
+ */
+struct PhoneForwardWalOptions {
+  PhoneForwardDurability durability; ///< Poziom trwałości.
+  uint64_t group_time_us; ///< Maksymalny wiek grupy w mikrosekundach.
+  size_t group_bytes;     ///< Maksymalny rozmiar grupy w bajtach.
+  size_t checkpoint_bytes; ///< Rozmiar dziennika, przy którym rozpoczyna się
+                           ///< punkt kontrolny (0 – tylko na żądanie).
+  size_t checkpoint_step;  ///< Liczba przekierowań zapisywanych do obrazu
+                           ///< przy każdej modyfikacji (0 – tylko przez
+                           ///< @ref phfwdCheckpointStep).
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardWalOptions.
+ */
+typedef struct PhoneForwardWalOptions PhoneForwardWalOptions;
+
+/** @brief Rozpoczyna prowadzenie dziennika modyfikacji.
+ * Od tej chwili każde udane wywołanie funkcji @ref phfwdAdd i każde wywołanie
+ * funkcji @ref phfwdRemove z poprawnym numerem na strukturze @p pf jest
+ * dopisywane na koniec pliku @p path. Modyfikacje są zbierane w grupy, które
+ * są zapisywane jednym wywołaniem systemowym (i synchronizowane z dyskiem
+ * jednym wywołaniem fdatasync), gdy grupa przekroczy rozmiar
+ * @p group_bytes lub gdy przy kolejnym wywołaniu funkcji @ref phfwdAdd,
+ * @ref phfwdRemove, @ref phfwdGet, @ref phfwdReverse lub @ref phfwdWalPoll
+ * okaże się starsza niż @p group_time_us. Niezapisaną grupę można zapisać
+ * funkcją @ref phfwdWalSync. Modyfikacja trafia do grupy przed zmianą
+ * struktury, a jeśli się nie powiedzie, jest z grupy usuwana. Jeśli zapis
+ * się nie powiedzie lub modyfikacji nie uda się dopisać do grupy, dziennik
+ * przestaje być prowadzony, a modyfikacje są wykonywane tylko w pamięci
+ * (sprawdza to funkcja @ref phfwdWalFailed).
+ * Istniejący plik jest kontynuowany, a jego uszkodzona końcówka (niepełna
+ * grupa zapisana w chwili awarii) jest usuwana. Jeśli dziennik był już
+ * prowadzony, poprzedni plik jest zamykany. Dziennik jest skracany przez
+ * punkty kontrolne (zob. @ref phfwdCheckpoint).
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] path      – ścieżka pliku dziennika;
+ * @param[in] options   – parametry dziennika lub NULL (poziom
+ *                        @ref PHFWD_DURABILITY_GROUP, grupy do 2 ms i 64 KiB).
+ * @return Wartość @p true, jeśli dziennik jest prowadzony.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, pliku
+ *         nie udało się otworzyć, nie jest on dziennikiem lub nie udało się
+ *         alokować pamięci.
+ */
+bool phfwdWalOpen(PhoneForward *pf, char const *path,
+                  PhoneForwardWalOptions const *options);
+
+/** @brief Wykonuje punkt kontrolny dziennika.
+ * Zapisuje obraz wszystkich przekierowań do pliku @p path.ckpt (gdzie @p path
+ * to ścieżka dziennika) i usuwa dziennik modyfikacji sprzed rozpoczęcia
+ * punktu kontrolnego, więc odtwarzanie wczytuje obraz i tylko modyfikacje
+ * wykonane później. Punkt kontrolny rozpoczyna się sam, gdy dziennik
+ * przekroczy @p checkpoint_bytes bajtów: dziennik jest wtedy przenoszony do
+ * pliku @p path.prev, a obraz jest zapisywany do pliku @p path.ckpt.tmp po
+ * @p checkpoint_step przekierowań przy każdej kolejnej modyfikacji, więc
+ * żadna modyfikacja nie czeka na zapis całego obrazu. Funkcja kończy trwający
+ * punkt kontrolny albo wykonuje cały nowy.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli obraz został zapisany.
+ *         Wartość @p false, jeśli dziennik nie jest prowadzony, parametr ma
+ *         wartość NULL, któraś operacja na plikach się nie powiodła lub nie
+ *         udało się alokować pamięci (punkt kontrolny jest wtedy przerywany).
+ */
+bool phfwdCheckpoint(PhoneForward *pf);
+
+/** @brief Posuwa trwający punkt kontrolny.
+ * Zapisuje do obrazu co najwyżej @p forwards kolejnych przekierowań i kończy
+ * punkt kontrolny, jeśli zapisano już wszystkie.
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] forwards  – maksymalna liczba zapisanych przekierowań.
+ * @return Wartość @p true, jeśli przekierowania zostały zapisane.
+ *         Wartość @p false, jeśli punkt kontrolny nie trwa, parametr @p pf ma
+ *         wartość NULL, któraś operacja na plikach się nie powiodła lub nie
+ *         udało się alokować pamięci (punkt kontrolny jest wtedy przerywany).
+ */
+bool phfwdCheckpointStep(PhoneForward *pf, size_t forwards);
+
+/** @brief Zapisuje bieżącą grupę dziennika.
+ * Zapisuje niezapisane modyfikacje i synchronizuje plik z dyskiem, niezależnie
+ * od poziomu trwałości.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli wszystkie modyfikacje są trwałe.
+ *         Wartość @p false, jeśli dziennik nie jest prowadzony, parametr ma
+ *         wartość NULL lub dziennik przestał być prowadzony.
+ */
+bool phfwdWalSync(PhoneForward *pf);
+
+/** @brief Zapisuje bieżącą grupę dziennika, jeśli minął jej czas.
+ * Pozwala zapisać grupę w czasie, gdy struktura nie jest używana, tak by
+ * modyfikacje nie czekały na zapis dłużej niż @p group_time_us.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli dziennik jest prowadzony.
+ *         Wartość @p false, jeśli dziennik nie jest prowadzony, parametr ma
+ *         wartość NULL lub dziennik przestał być prowadzony.
+ */
+bool phfwdWalPoll(PhoneForward *pf);
+
+/** @brief Sprawdza, czy dziennik przestał być prowadzony.
+ * Dziennik przestaje być prowadzony po pierwszym nieudanym zapisie lub
+ * nieudanym dopisaniu modyfikacji do grupy. Modyfikacje wykonane od tej
+ * chwili (i te z niezapisanej grupy) nie są trwałe.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                 numerów.
+ * @return Wartość @p true, jeśli dziennik był otwarty i przestał być
+ *         prowadzony.
+ *         Wartość @p false, jeśli dziennik jest prowadzony, nie był otwarty
+ *         lub parametr ma wartość NULL.
+ */
+bool phfwdWalFailed(PhoneForward const *pf);
+
+/** @brief Kończy prowadzenie dziennika modyfikacji.
+ * Zapisuje bieżącą grupę zgodnie z poziomem trwałości i zamyka plik.
+ * Trwający punkt kontrolny jest przerywany.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli wszystkie modyfikacje zostały zapisane.
+ *         Wartość @p false, jeśli dziennik nie był prowadzony, parametr ma
+ *         wartość NULL lub któryś zapis się nie powiódł.
+ */
+bool phfwdWalClose(PhoneForward *pf);
+
+/** @brief Odtwarza stan zapisany w dzienniku modyfikacji.
+ * Wstawia przekierowania z obrazu ostatniego punktu kontrolnego
+ * (@p path.ckpt), a następnie kolejno z dziennika przerwanego punktu
+ * kontrolnego (@p path.prev) i z dziennika @p path wczytuje wszystkie pełne
+ * grupy i nanosi ich łączny efekt na strukturę @p pf: usuwa przekierowania,
+ * których prefiksy zostały usunięte, i wstawia (w kolejności kluczy) tylko
+ * ostatnie przekierowanie każdego numeru, jeśli nie zostało później usunięte.
+ * Odtwarzanie nie jest zapisywane w dzienniku prowadzonym dla @p pf. Brak
+ * pliku oznacza pusty obraz lub dziennik.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] path    – ścieżka pliku dziennika.
+ * @return Wartość @p true, jeśli stan został odtworzony.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, pliku
+ *         nie udało się odczytać, nie jest on dziennikiem lub nie udało się
+ *         alokować pamięci (struktura może być wtedy odtworzona częściowo).
+ */
+bool phfwdWalRecover(PhoneForward *pf, char const *path);
+
+/**
+ * @brief Struktura przechowująca wersję przekierowań tylko do odczytu.
+ */
+struct PhoneForwardVersion;
+/**
+ * @brief Typedef skraca nazwę PhoneForwardVersion.
+ */
+typedef struct PhoneForwardVersion PhoneForwardVersion;
+
+/** @brief Tworzy wersję przekierowań.
+ * Zwraca w czasie stałym wersję tylko do odczytu, która zawsze widzi
+ * przekierowania struktury @p pf z chwili wywołania, także po jej późniejszych
+ * modyfikacjach i usunięciu. Wersja nie kopiuje przekierowań: przed pierwszą
+ * od utworzenia wersji modyfikacją danego przekierowania jego poprzednia
+ * wartość jest zachowywana, więc pamięć wersji jest proporcjonalna do liczby
+ * zmienionych numerów (przekierowania usuniętej struktury są zwalniane razem
+ * z ostatnią jej wersją). Wersję zwalnia funkcja @ref phfwdVersionRelease.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wskaźnik na utworzoną wersję lub NULL, gdy parametr ma wartość
+ *         NULL, struktura jest kopią (zob. @ref phfwdClone) lub nie udało się
+ *         alokować pamięci.
+ */
+PhoneForwardVersion *phfwdSnapshot(PhoneForward *pf);
+
+/** @brief Wyznacza przekierowanie numeru w wersji.
+ * Działa jak funkcja @ref phfwdGet dla struktury w chwili utworzenia wersji.
+ * @param[in] version – wskaźnik na wersję;
+ * @param[in] num     – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy
+ *         parametr @p version ma wartość NULL lub nie udało się alokować
+ *         pamięci (także przy zachowywaniu wartości dla wersji).
+ */
+PhoneNumbers *phfwdVersionGet(PhoneForwardVersion const *version,
+                              char const *num);
+
+/** @brief Odwiedza wszystkie przekierowania wersji.
+ * Wywołuje funkcję @p visitor dla każdego przekierowania wersji (prefiksu
+ * @p num1 na prefiks @p num2), w nieokreślonej kolejności. Funkcja
+ * @p visitor nie może modyfikować struktury, z której pochodzi wersja.
+ * @param[in] version       – wskaźnik na wersję;
+ * @param[in] visitor       – funkcja wywoływana dla przekierowań;
+ * @param[in] configuration – wskaźnik przekazywany funkcji @p visitor.
+ * @return Wartość @p true, jeśli odwiedzono wszystkie przekierowania.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL lub
+ *         nie udało się alokować pamięci (także przy zachowywaniu wartości
+ *         dla wersji).
+ */
+bool phfwdVersionForEach(PhoneForwardVersion const *version,
+                         void (*visitor)(char const *num1, char const *num2,
+                                         void *configuration),
+                         void *configuration);
+
+/** @brief Zwalnia wersję przekierowań.
+ * Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] version – wskaźnik na zwalnianą wersję.
+ */
+void phfwdVersionRelease(PhoneForwardVersion *version);
+
+/** @brief Tworzy kopię struktury.
+ * Kopia powstaje w czasie stałym i na początku nie zajmuje pamięci na
+ * przekierowania: odczytuje je z wersji struktury @p pf z chwili wywołania
+ * (zob. @ref phfwdSnapshot), a przechowuje tylko własne zmiany – dodane
+ * przekierowania i usunięte prefiksy. Dalsze modyfikacje struktury @p pf nie
+ * są widoczne w kopii, a modyfikacje kopii w strukturze @p pf. Koszt
+ * wyszukiwania przekierowań odwrotnych w kopii rośnie z liczbą wersji
+ * struktury @p pf utworzonych po utworzeniu kopii, ale nie z liczbą jej
+ * modyfikacji. Statystyki kopii dotyczą
+ * tylko jej własnych zmian. Dla kopii nie można prowadzić dziennika
+ * modyfikacji, tworzyć wersji, zrzutów w tle ani kolejnych kopii. Kopię
+ * usuwa się funkcją @ref phfwdDelete, także po usunięciu struktury @p pf.
+ * @param[in, out] pf – wskaźnik na kopiowaną strukturę.
+ * @return Wskaźnik na utworzoną kopię lub NULL, gdy parametr ma wartość NULL,
+ *         struktura @p pf jest kopią lub nie udało się alokować pamięci.
+ *         Funkcje @ref phfwdGet i @ref phfwdReverse zwracają dla kopii NULL
+ *         także wtedy, gdy wcześniej nie udało się alokować pamięci przy
+ *         usuwaniu prefiksu funkcją @ref phfwdRemove.
+ */
+PhoneForward *phfwdClone(PhoneForward *pf);
+
+/** @brief Wyznacza różnicę przekierowań.
+ * Wywołuje funkcję @p callback dla każdego numeru, którego przekierowanie
+ * w strukturze @p from różni się od przekierowania w strukturze @p to
+ * (dokładnie raz dla każdego numeru). Parametr @p from funkcji
+ * @p callback ma wartość NULL dla dodanych przekierowań, a parametr @p to –
+ * dla usuniętych. Jeśli struktury mają wspólne pochodzenie (kopia i jej
+ * źródło lub dwie kopie jednej struktury, zob. @ref phfwdClone), koszt jest
+ * proporcjonalny do liczby zmian wykonanych od utworzenia kopii, w przeciwnym
+ * razie – do liczby przekierowań obu struktur.
+ * @param[in] from          – wskaźnik na strukturę przed zmianami;
+ * @param[in] to            – wskaźnik na strukturę po zmianach;
+ * @param[in] callback      – funkcja wywoływana dla zmienionych numerów;
+ * @param[in] configuration – wskaźnik przekazywany funkcji @p callback.
+ * @return Wartość @p true, jeśli różnica została wyznaczona.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, nie
+ *         udało się alokować pamięci (funkcja @p callback mogła być wtedy
+ *         wywołana dla części zmian) lub przy kopii nie udało się wcześniej
+ *         alokować pamięci przy usuwaniu prefiksu.
+ */
+bool phfwdDiff(PhoneForward const *from, PhoneForward const *to,
+               void (*callback)(char const *num, char const *from,
+                                char const *to, void *configuration),
+               void *configuration);
+
+/** @brief Nanosi różnicę przekierowań.
+ * Zmienia przekierowania struktury @p pf tak, jak różnią się przekierowania
+ * struktury @p to od przekierowań struktury @p from (zob. @ref phfwdDiff).
+ * Usunięcie przekierowania numeru nie usuwa przekierowań numerów, których
+ * jest on prefiksem. Zmiany są zapisywane w dzienniku modyfikacji. Struktura
+ * @p pf może być jedną z porównywanych struktur – w szczególności
+ * @p phfwdApplyDiff(a, a, b) sprawia, że struktura @p a ma przekierowania
+ * struktury @p b.
+ * @param[in, out] pf – wskaźnik na modyfikowaną strukturę;
+ * @param[in] from    – wskaźnik na strukturę przed zmianami;
+ * @param[in] to      – wskaźnik na strukturę po zmianach.
+ * @return Wartość @p true, jeśli zmiany zostały naniesione.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL,
+ *         struktura @p pf jest kopią lub nie udało się alokować pamięci
+ *         (zmiany mogą być wtedy naniesione częściowo).
+ */
+bool phfwdApplyDiff(PhoneForward *pf, PhoneForward const *from,
+                    PhoneForward const *to);
+
+/**
+ * @brief Stany zrzutu wykonywanego w tle.
+ */
+enum PhoneForwardSnapshotStatus {
+  PHFWD_SNAPSHOT_NONE,    ///< Żaden zrzut nie był wykonywany.
+  PHFWD_SNAPSHOT_RUNNING, ///< Zrzut jest wykonywany.
+  PHFWD_SNAPSHOT_DONE,    ///< Zrzut został zapisany.
+  PHFWD_SNAPSHOT_FAILED,  ///< Zapis zrzutu się nie powiódł.
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardSnapshotStatus.
+ */
+typedef enum PhoneForwardSnapshotStatus PhoneForwardSnapshotStatus;
+
+/** @brief Rozpoczyna zrzut przekierowań w tle.
+ * Tworzy funkcją fork proces potomny, który zapisuje do pliku @p path obraz
+ * wszystkich przekierowań struktury @p pf z chwili wywołania (w formacie
+ * obrazów punktów kontrolnych, zob. @ref phfwdCheckpoint). Pamięć jest
+ * współdzielona z procesem potomnym i kopiowana przez system dopiero przy
+ * zapisie, więc struktura może być w tym czasie dowolnie modyfikowana.
+ * Obraz jest zapisywany do pliku @p path.tmp i przenoszony do pliku @p path
+ * po zapisaniu całości. Jednocześnie może być wykonywany jeden zrzut
+ * struktury; jego zakończenie sprawdza funkcja @ref phfwdSnapshotPoll.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] path    – ścieżka pliku zrzutu.
+ * @return Wartość @p true, jeśli zrzut został rozpoczęty.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL,
+ *         poprzedni zrzut nie został odebrany funkcją
+ *         @ref phfwdSnapshotPoll, nie udało się utworzyć procesu lub nie
+ *         udało się alokować pamięci.
+ */
+bool phfwdSnapshotAsync(PhoneForward *pf, char const *path);
+
+/** @brief Sprawdza stan zrzutu wykonywanego w tle.
+ * Zakończony zrzut jest odbierany, więc kolejne wywołania zwracają
+ * @ref PHFWD_SNAPSHOT_NONE. Funkcja @ref phfwdDelete czeka na zakończenie
+ * trwającego zrzutu.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] wait    – czy czekać na zakończenie zrzutu;
+ * @param[out] size   – wskaźnik na miejsce na rozmiar zapisanego pliku w
+ *                      bajtach lub NULL.
+ * @return Stan zrzutu (@ref PHFWD_SNAPSHOT_NONE także wtedy, gdy parametr
+ *         @p pf ma wartość NULL).
+ */
+PhoneForwardSnapshotStatus phfwdSnapshotPoll(PhoneForward *pf, bool wait,
+                                             uint64_t *size);
+
+/** @brief Wczytuje zrzut przekierowań.
+ * Wstawia do struktury @p pf wszystkie przekierowania z obrazu zapisanego
+ * funkcją @ref phfwdSnapshotAsync (lub obrazu punktu kontrolnego).
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] path    – ścieżka pliku zrzutu.
+ * @return Wartość @p true, jeśli zrzut został wczytany.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL, pliku
+ *         nie ma lub nie udało się go odczytać, nie jest on obrazem lub
+ *         nie udało się alokować pamięci (zrzut może być wtedy wczytany
+ *         częściowo).
+ */
+bool phfwdSnapshotLoad(PhoneForward *pf, char const *path);
+
+/** @brief Zastępuje przekierowania o danym prefiksie.
+ * Przenosi do struktury @p pf wszystkie przekierowania struktury @p staged w
+ * miejsce przekierowań numerów, których prefiksem jest @p prefix. Wszystkie
+ * przekierowania struktury @p staged muszą dotyczyć takich numerów. Koszt
+ * zależy od liczby nowych przekierowań, a nie od liczby zastępowanych –
+ * poddrzewo jest podmieniane jedną zmianą wskaźnika, a pamięć zastąpionych
+ * przekierowań jest zwalniana stopniowo przy kolejnych modyfikacjach
+ * struktury. Funkcja @ref phfwdReverse od razu pomija zastąpione
+ * przekierowania. Zmiana jest zapisywana w dzienniku modyfikacji jako
+ * usunięcie prefiksu i dodanie nowych przekierowań. Po powodzeniu struktura
+ * @p staged jest usuwana.
+ * @param[in, out] pf  – wskaźnik na modyfikowaną strukturę;
+ * @param[in] prefix   – wskaźnik na napis reprezentujący prefiks;
+ * @param[in] staged   – wskaźnik na strukturę z nowymi przekierowaniami.
+ * @return Wartość @p true, jeśli przekierowania zostały zastąpione.
+ *         Wartość @p false, jeśli któryś z parametrów ma wartość NULL,
+ *         prefiks nie reprezentuje numeru, parametry wskazują tę samą
+ *         strukturę, któraś ze struktur jest kopią, struktura @p staged ma
+ *         wersje lub przekierowanie spoza prefiksu albo nie udało się alokować
+ *         pamięci (obie struktury pozostają wtedy bez zmian).
+ */
+bool phfwdReplacePrefix(PhoneForward *pf, char const *prefix,
+                        PhoneForward *staged);
+
+/** @brief Zwalnia pamięć usuniętych przekierowań.
+ * Zwalnia co najwyżej @p forwards przekierowań odłączonych przez funkcje
+ * @ref phfwdRemove i @ref phfwdReplacePrefix, wraz z ich wpisami w drzewie
+ * odwrotności. Pozostałe są zwalniane przy kolejnych modyfikacjach (zob.
+ * @ref phfwdReclaimSetStep) i przy usuwaniu struktury.
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] forwards  – maksymalna liczba zwalnianych przekierowań.
+ * @return Wartość @p true, jeśli zostały jeszcze odłączone przekierowania.
+ *         Wartość @p false, jeśli wszystkie zostały zwolnione lub parametr
+ *         @p pf ma wartość NULL.
+ */
+bool phfwdReclaimStep(PhoneForward *pf, size_t forwards);
+
+/** @brief Ustawia tempo zwalniania usuniętych przekierowań.
+ * Po każdej modyfikacji struktury zwalnianych jest co najwyżej @p forwards
+ * odłączonych przekierowań (domyślnie 64). Nic nie robi, jeśli parametr
+ * @p pf ma wartość NULL.
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] forwards  – liczba przekierowań zwalnianych przy modyfikacji (0 –
+ *                        tylko przez @ref phfwdReclaimStep).
+ */
+void phfwdReclaimSetStep(PhoneForward *pf, size_t forwards);
+
+/** @brief Odracza porządkowanie drzew struktury.
+ * Domyślnie każde usunięcie od razu zwalnia zbędne węzły drzew i scala
+ * krawędzie wokół nich, co przy naprzemiennym dodawaniu i usuwaniu tych
+ * samych prefiksów oznacza ciągłe dzielenie i scalanie krawędzi. Po
+ * odroczeniu zbędne węzły pozostają w drzewach i są tylko zliczane, a drzewa
+ * są porządkowane przez funkcję @ref phfwdCompact lub po modyfikacji, po
+ * której liczba odroczeń osiągnęła @p threshold. Wynik operacji się nie
+ * zmienia. Wyłączenie odraczania porządkuje drzewa od razu. Nic nie robi,
+ * jeśli parametr @p pf ma wartość NULL.
+ * @param[in, out] pf   – wskaźnik na strukturę przechowującą przekierowania
+ *                        numerów;
+ * @param[in] deferred  – wartość @p true, jeśli porządkowanie ma być
+ *                        odraczane;
+ * @param[in] threshold – liczba odroczeń, po której drzewa są porządkowane
+ *                        (0 – tylko przez @ref phfwdCompact).
+ */
+void phfwdCompactionDefer(PhoneForward *pf, bool deferred, size_t threshold);
+
+/** @brief Porządkuje drzewa struktury.
+ * Zwalnia w jednym przejściu węzły bez wartości, które mają co najwyżej
+ * jedno dziecko, i scala krawędzie wokół nich. Jeśli nie uda się alokować
+ * pamięci na scalenie krawędzi, część węzłów pozostaje, ale struktura działa
+ * poprawnie.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Liczba zwolnionych węzłów (0, gdy parametr ma wartość NULL).
+ */
+size_t phfwdCompact(PhoneForward *pf);
+
+/**
+ * @brief Parametry układu hybrydowego.
+ */
+struct PhoneForwardHybridOptions {
+  size_t delta_limit; ///< Liczba modyfikacji, po której rozpoczyna się
+                      ///< scalanie (0 – tylko przez @ref phfwdHybridMerge).
+  size_t merge_step;  ///< Liczba przekierowań lub węzłów scalanych przy
+                      ///< każdej modyfikacji (0 – tylko przez
+                      ///< @ref phfwdHybridMerge).
+};
+/**
+ * @brief Typedef skraca nazwę PhoneForwardHybridOptions.
+ */
+typedef struct PhoneForwardHybridOptions PhoneForwardHybridOptions;
+
+/** @brief Włącza układ hybrydowy.
+ * Od tej chwili funkcja @ref phfwdGet odczytuje przekierowania z niezmiennej
+ * bazy zapisanej w spójnych tablicach oraz z małych drzew zmian, do których
+ * funkcje modyfikujące strukturę dopisują dodane przekierowania i usunięte
+ * prefiksy. Dłuższy pasujący prefiks wygrywa, a zmiana zasłania starsze
+ * przekierowania tego samego prefiksu (usunięcie – także dłuższych). Po
+ * @p delta_limit modyfikacjach zmiany są zamrażane i rozpoczyna się scalanie
+ * ich z bazą w nową bazę, wykonywane po @p merge_step kroków przy kolejnych
+ * modyfikacjach. Baza zajmuje pamięć obok zwykłych drzew struktury, które
+ * nadal obsługują pozostałe funkcje. Jeśli przy zapisie zmiany nie udało się
+ * alokować pamięci, funkcja @ref phfwdGet korzysta ze zwykłych drzew aż do
+ * wywołania funkcji @ref phfwdHybridMerge. Ponowne wywołanie buduje bazę od
+ * nowa. Układu nie można włączyć dla kopii (zob. @ref phfwdClone).
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów;
+ * @param[in] options – parametry układu lub NULL (scalanie po 4096
+ *                      modyfikacjach, po 64 kroki).
+ * @return Wartość @p true, jeśli układ został włączony.
+ *         Wartość @p false, jeśli parametr @p pf ma wartość NULL, struktura
+ *         jest kopią lub nie udało się alokować pamięci (poprzedni układ
+ *         pozostaje wtedy bez zmian).
+ */
+bool phfwdHybridEnable(PhoneForward *pf,
+                       PhoneForwardHybridOptions const *options);
+
+/** @brief Scala zmiany układu hybrydowego.
+ * Buduje od razu nową bazę z bieżących przekierowań struktury, porzucając
+ * trwające scalanie i zebrane zmiany.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ * @return Wartość @p true, jeśli baza została zbudowana.
+ *         Wartość @p false, jeśli parametr ma wartość NULL, układ nie jest
+ *         włączony lub nie udało się alokować pamięci.
+ */
+bool phfwdHybridMerge(PhoneForward *pf);
+
+/** @brief Wyłącza układ hybrydowy.
+ * Zwalnia bazę i zmiany. Nic nie robi, jeśli parametr ma wartość NULL lub
+ * układ nie jest włączony.
+ * @param[in, out] pf – wskaźnik na strukturę przechowującą przekierowania
+ *                      numerów.
+ */
+void phfwdHybridDisable(PhoneForward *pf);
+
 #endif /* __PHONE_FORWARD_H__ */
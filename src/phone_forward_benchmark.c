@@ -0,0 +1,529 @@
+/**
+ * @file phone_forward_benchmark.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Benchmark of library operations.
+ *
+ * Program generates deterministic random workload and measures phases of
+ * additions, forward lookups, reverse lookups and removals. For every phase
+ * it reports wall-clock time per operation and, if requested and available,
+ * hardware counters per operation.
+ *
+ * With -c program works as a load generator: operations are sent to
+ * phfwd_server listening at given socket in pipelined batches of -w requests
+ * and round-trip time is measured. Server keeps its structure between runs.
+ *
+ * Usage: phone_forward_benchmark [-n forwards] [-q queries] [-r reverses]
+ *        [-d removals] [-s seed] [-p] [-c socket] [-w window]
+ *
+ * @date 2022-06-12
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "latency.h"
+#include "perf_counters.h"
+#include "phfwd_client.h"
+#include "phone_forward.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Maximal length of generated number.
+ */
+#define MAX_NUMBER_LENGTH 20
+
+/**
+ * @brief Size of buffer for one generated number.
+ */
+#define NUMBER_STRIDE (MAX_NUMBER_LENGTH + 1)
+
+/**
+ * @brief Parameters of the benchmark.
+ */
+struct BenchmarkOptions {
+  size_t forwards; ///< Number of added forwards.
+  size_t queries;  ///< Number of phfwdGet calls.
+  size_t reverses; ///< Number of phfwdReverse calls.
+  size_t removals; ///< Number of phfwdRemove calls.
+  uint64_t seed;   ///< Seed of random generator.
+  bool perf;       ///< True if hardware counters should be read.
+  char *socket;    ///< Socket of the server (NULL if library is called).
+  size_t window;   ///< Number of requests sent together to the server.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct BenchmarkOptions BenchmarkOptions;
+
+/**
+ * @brief Generated workload: arrays of numbers with NUMBER_STRIDE stride.
+ */
+struct Workload {
+  char *prefixes; ///< Prefixes of added forwards.
+  char *targets;  ///< Targets of added forwards.
+  char *queries;  ///< Numbers passed to phfwdGet.
+  char *reverses; ///< Numbers passed to phfwdReverse.
+  char *removals; ///< Prefixes passed to phfwdRemove.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct Workload Workload;
+
+/**
+ * @brief Returns next value of xorshift64* generator.
+ *
+ * @param[in, out] state : state of the generator (must not be 0).
+ * @return uint64_t : generated value.
+ */
+static uint64_t random_next(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+
+  return *state * 2685821657736338717ull;
+}
+
+/**
+ * @brief Writes random number of length from [@p min_length, @p max_length]
+ * to @p buffer. Digits '*' and '#' are rare, as in real numbers.
+ *
+ * @param[in, out] state : state of the generator.
+ * @param[out] buffer : place to write number to (NUMBER_STRIDE bytes).
+ * @param min_length : minimal length of the number.
+ * @param max_length : maximal length of the number.
+ */
+static void random_number(uint64_t *state, char *buffer, size_t min_length,
+                          size_t max_length) {
+  size_t length =
+      min_length + random_next(state) % (max_length - min_length + 1);
+
+  for (size_t index = 0; index < length; index++) {
+    uint64_t draw = random_next(state) % 64;
+
+    if (draw == 0) {
+      buffer[index] = '*';
+    } else if (draw == 1) {
+      buffer[index] = '#';
+    } else {
+      buffer[index] = (char)('0' + draw % 10);
+    }
+  }
+
+  buffer[length] = '\0';
+}
+
+/**
+ * @brief Returns pointer to @p index -th number of the array.
+ *
+ * @param[in] array : array of numbers.
+ * @param index : index of the number.
+ * @return char* : pointer to the number.
+ */
+static inline char *number_at(char *array, size_t index) {
+  return array + index * NUMBER_STRIDE;
+}
+
+/**
+ * @brief Generates workload described by @p options.
+ *
+ * Half of queries extend added prefixes, so they hit forwards. Reverses ask
+ * for numbers which extend targets of added forwards.
+ *
+ * @param[in] options : parameters of the benchmark.
+ * @param[out] workload : place to save generated workload.
+ * @return true : if workload was generated.
+ * @return false : if memory error has occured.
+ */
+static bool generate_workload(const BenchmarkOptions *options,
+                              Workload *workload) {
+  uint64_t state = options->seed == 0 ? 1 : options->seed;
+
+  workload->prefixes = malloc(NUMBER_STRIDE * (options->forwards + 1));
+  workload->targets = malloc(NUMBER_STRIDE * (options->forwards + 1));
+  workload->queries = malloc(NUMBER_STRIDE * (options->queries + 1));
+  workload->reverses = malloc(NUMBER_STRIDE * (options->reverses + 1));
+  workload->removals = malloc(NUMBER_STRIDE * (options->removals + 1));
+
+  if (workload->prefixes == NULL || workload->targets == NULL ||
+      workload->queries == NULL || workload->reverses == NULL ||
+      workload->removals == NULL) {
+    return false;
+  }
+
+  for (size_t index = 0; index < options->forwards; index++) {
+    random_number(&state, number_at(workload->prefixes, index), 2, 12);
+    random_number(&state, number_at(workload->targets, index), 2, 12);
+  }
+
+  for (size_t index = 0; index < options->queries; index++) {
+    char *query = number_at(workload->queries, index);
+
+    if (options->forwards > 0 && random_next(&state) % 2 == 0) {
+      const char *prefix = number_at(
+          workload->prefixes, random_next(&state) % options->forwards);
+      size_t length = strlen(prefix);
+
+      memcpy(query, prefix, length);
+      random_number(&state, query + length, 0, MAX_NUMBER_LENGTH - length);
+    } else {
+      random_number(&state, query, 2, MAX_NUMBER_LENGTH);
+    }
+  }
+
+  for (size_t index = 0; index < options->reverses; index++) {
+    char *reverse = number_at(workload->reverses, index);
+
+    if (options->forwards > 0) {
+      const char *target = number_at(workload->targets,
+                                     random_next(&state) % options->forwards);
+      size_t length = strlen(target);
+
+      memcpy(reverse, target, length);
+      random_number(&state, reverse + length, 0, MAX_NUMBER_LENGTH - length);
+    } else {
+      random_number(&state, reverse, 2, MAX_NUMBER_LENGTH);
+    }
+  }
+
+  for (size_t index = 0; index < options->removals; index++) {
+    random_number(&state, number_at(workload->removals, index), 3, 8);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Frees generated workload.
+ *
+ * @param[in] workload : workload to free.
+ */
+static void workload_drop(Workload *workload) {
+  free(workload->prefixes);
+  free(workload->targets);
+  free(workload->queries);
+  free(workload->reverses);
+  free(workload->removals);
+}
+
+/**
+ * @brief Measured phases of the benchmark.
+ */
+enum BenchmarkPhase {
+  PHASE_ADD,     ///< Additions of forwards.
+  PHASE_GET,     ///< Forward lookups.
+  PHASE_REVERSE, ///< Reverse lookups.
+  PHASE_REMOVE,  ///< Removals of forwards.
+  PHASES         ///< Number of phases.
+};
+
+/**
+ * @brief Names of phases, in order of BenchmarkPhase.
+ */
+static const char *const phase_names[PHASES] = {"add", "get", "reverse",
+                                                "remove"};
+
+/**
+ * @brief Structure or server which operations are performed at.
+ */
+struct BenchmarkTarget {
+  PhoneForward *pf;    ///< Structure called directly (NULL if server is used).
+  PhfwdClient *client; ///< Connection to the server (NULL if pf is used).
+  size_t window;       ///< Number of requests sent together to the server.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct BenchmarkTarget BenchmarkTarget;
+
+/**
+ * @brief Performs one operation of a phase.
+ *
+ * @param[in, out] pf : structure to perform operation at.
+ * @param[in] workload : generated workload.
+ * @param phase : phase of the operation.
+ * @param index : index of the operation.
+ */
+static void run_operation(PhoneForward *pf, Workload *workload,
+                          enum BenchmarkPhase phase, size_t index) {
+  switch (phase) {
+  case PHASE_ADD:
+    phfwdAdd(pf, number_at(workload->prefixes, index),
+             number_at(workload->targets, index));
+    break;
+  case PHASE_GET:
+    phnumDelete(phfwdGet(pf, number_at(workload->queries, index)));
+    break;
+  case PHASE_REVERSE:
+    phnumDelete(phfwdReverse(pf, number_at(workload->reverses, index)));
+    break;
+  case PHASE_REMOVE:
+    phfwdRemove(pf, number_at(workload->removals, index));
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief Queues one operation of a phase at the server connection.
+ *
+ * @param[in, out] client : connection to the server.
+ * @param[in] workload : generated workload.
+ * @param phase : phase of the operation.
+ * @param index : index of the operation.
+ * @return true : if request was queued.
+ * @return false : if memory error has occured.
+ */
+static bool queue_operation(PhfwdClient *client, Workload *workload,
+                            enum BenchmarkPhase phase, size_t index) {
+  switch (phase) {
+  case PHASE_ADD:
+    return phfwd_client_add(client, number_at(workload->prefixes, index),
+                            number_at(workload->targets, index));
+  case PHASE_GET:
+    return phfwd_client_get(client, number_at(workload->queries, index));
+  case PHASE_REVERSE:
+    return phfwd_client_reverse(client,
+                                number_at(workload->reverses, index));
+  case PHASE_REMOVE:
+    return phfwd_client_remove(client, number_at(workload->removals, index));
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Performs operations of one phase.
+ *
+ * Requests to the server are sent in batches of target->window requests and
+ * every batch is answered before the next one is sent.
+ *
+ * @param[in, out] target : structure or server to perform operations at.
+ * @param[in] workload : generated workload.
+ * @param phase : phase to perform.
+ * @param operations : number of operations to perform.
+ * @return true : if all operations were performed.
+ * @return false : if connection to the server has failed.
+ */
+static bool run_phase(const BenchmarkTarget *target, Workload *workload,
+                      enum BenchmarkPhase phase, size_t operations) {
+  PhfwdResponse response;
+
+  for (size_t index = 0; index < operations; index++) {
+    if (target->client == NULL) {
+      run_operation(target->pf, workload, phase, index);
+      continue;
+    }
+
+    if (!queue_operation(target->client, workload, phase, index)) {
+      return false;
+    }
+
+    if (phfwd_client_pending(target->client) >= target->window ||
+        index + 1 == operations) {
+      while (phfwd_client_pending(target->client) > 0) {
+        if (!phfwd_client_receive(target->client, &response)) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Prints header of the results table.
+ *
+ * @param[in] counters : hardware counters (NULL if they are not read).
+ */
+static void print_header(const PerfCounters *counters) {
+  printf("%-8s %10s %10s", "phase", "ops", "ns/op");
+
+  if (counters != NULL) {
+    for (size_t event = 0; event < PERF_EVENTS; event++) {
+      printf(" %14s", perf_event_name((PerfEvent)event));
+    }
+  }
+
+  printf("\n");
+}
+
+/**
+ * @brief Measures one phase and prints its row of the results table.
+ *
+ * @param[in, out] target : structure or server to perform operations at.
+ * @param[in] workload : generated workload.
+ * @param phase : phase to measure.
+ * @param operations : number of operations to perform.
+ * @param[in, out] counters : hardware counters (NULL if they are not read).
+ * @return true : if phase was measured.
+ * @return false : if connection to the server has failed.
+ */
+static bool measure_phase(const BenchmarkTarget *target, Workload *workload,
+                          enum BenchmarkPhase phase, size_t operations,
+                          PerfCounters *counters) {
+  uint64_t values[PERF_EVENTS];
+
+  if (counters != NULL) {
+    perf_counters_start(counters);
+  }
+
+  uint64_t start = latency_clock_ns();
+  bool success = run_phase(target, workload, phase, operations);
+  uint64_t elapsed = latency_clock_ns() - start;
+
+  if (counters != NULL) {
+    perf_counters_stop(counters, values);
+  }
+
+  if (!success) {
+    return false;
+  }
+
+  double divisor = operations == 0 ? 1.0 : (double)operations;
+  printf("%-8s %10zu %10.1f", phase_names[phase], operations,
+         (double)elapsed / divisor);
+
+  if (counters != NULL) {
+    for (size_t event = 0; event < PERF_EVENTS; event++) {
+      if (perf_counters_available(counters, (PerfEvent)event)) {
+        printf(" %14.2f", (double)values[event] / divisor);
+      } else {
+        printf(" %14s", "-");
+      }
+    }
+  }
+
+  printf("\n");
+  return true;
+}
+
+/**
+ * @brief Parses command line arguments.
+ *
+ * @param argc : number of arguments.
+ * @param[in] argv : arguments.
+ * @param[out] options : place to save parsed parameters.
+ * @return true : if arguments are correct.
+ * @return false : if arguments are incorrect.
+ */
+static bool parse_options(int argc, char **argv, BenchmarkOptions *options) {
+  int option;
+
+  options->forwards = 100000;
+  options->queries = 1000000;
+  options->reverses = 10000;
+  options->removals = 1000;
+  options->seed = 42;
+  options->perf = false;
+  options->socket = NULL;
+  options->window = 64;
+
+  while ((option = getopt(argc, argv, "n:q:r:d:s:pc:w:")) != -1) {
+    switch (option) {
+    case 'n':
+      options->forwards = strtoull(optarg, NULL, 10);
+      break;
+    case 'q':
+      options->queries = strtoull(optarg, NULL, 10);
+      break;
+    case 'r':
+      options->reverses = strtoull(optarg, NULL, 10);
+      break;
+    case 'd':
+      options->removals = strtoull(optarg, NULL, 10);
+      break;
+    case 's':
+      options->seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'p':
+      options->perf = true;
+      break;
+    case 'c':
+      options->socket = optarg;
+      break;
+    case 'w':
+      options->window = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return options->window > 0;
+}
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options;
+  Workload workload;
+
+  if (!parse_options(argc, argv, &options)) {
+    fprintf(stderr,
+            "Usage: %s [-n forwards] [-q queries] [-r reverses] "
+            "[-d removals] [-s seed] [-p] [-c socket] [-w window]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (!generate_workload(&options, &workload)) {
+    workload_drop(&workload);
+    fprintf(stderr, "Memory error while generating workload.\n");
+    return 1;
+  }
+
+  PerfCounters *counters = NULL;
+  if (options.perf) {
+    bool memory_error = false;
+
+    counters = init_perf_counters(&memory_error);
+    if (counters != NULL && !perf_counters_any_available(counters)) {
+      fprintf(stderr, "Hardware counters are unavailable, reporting "
+                      "wall-clock time only.\n");
+      perf_counters_drop(counters);
+      counters = NULL;
+    }
+  }
+
+  BenchmarkTarget target = {NULL, NULL, options.window};
+  if (options.socket != NULL) {
+    target.client = phfwd_client_connect(options.socket);
+  } else {
+    target.pf = phfwdNew();
+  }
+
+  if (target.pf == NULL && target.client == NULL) {
+    perf_counters_drop(counters);
+    workload_drop(&workload);
+    fprintf(stderr, options.socket != NULL
+                        ? "Can't connect to the server.\n"
+                        : "Memory error while creating structure.\n");
+    return 1;
+  }
+
+  size_t operations[PHASES] = {options.forwards, options.queries,
+                               options.reverses, options.removals};
+
+  bool success = true;
+
+  print_header(counters);
+  for (size_t phase = 0; phase < PHASES && success; phase++) {
+    success = measure_phase(&target, &workload, (enum BenchmarkPhase)phase,
+                            operations[phase], counters);
+  }
+
+  if (!success) {
+    fprintf(stderr, "Connection to the server has failed.\n");
+  }
+
+  phfwdDelete(target.pf);
+  phfwd_client_close(target.client);
+  perf_counters_drop(counters);
+  workload_drop(&workload);
+
+  return success ? 0 : 1;
+}
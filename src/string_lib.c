@@ -11,7 +11,8 @@
 char *string_clone(const char *to_clone) {
   size_t to_clone_len = strlen(to_clone);
 
-  char *result = wrap_malloc(sizeof(char) * (to_clone_len + 1));
+  char *result =
+      wrap_malloc(sizeof(char) * (to_clone_len + 1), MEMORY_TAG_EDGE_LABEL);
   if (result == NULL) {
     return NULL;
   }
@@ -24,7 +25,8 @@ char *string_clone(const char *to_clone) {
 char *string_clone_from_index(const char *to_clone, size_t start_index) {
   size_t to_clone_len = strlen(to_clone);
 
-  char *result = wrap_malloc(sizeof(char) * (to_clone_len - start_index + 1));
+  char *result = wrap_malloc(sizeof(char) * (to_clone_len - start_index + 1),
+                             MEMORY_TAG_EDGE_LABEL);
   if (result == NULL) {
     return NULL;
   }
@@ -73,4 +75,21 @@ bool string_check_prefixes(const char *s1, size_t start_char, const char *s2,
 
   *pref_len = length;
   return (*s2 == '\0');
+}
+
+int string_compare_numbers(const char *s1, const char *s2) {
+  while (*s1 != '\0' && *s1 == *s2) {
+    s1++;
+    s2++;
+  }
+
+  if (*s1 == *s2) {
+    return 0;
+  } else if (*s1 == '\0') {
+    return -1;
+  } else if (*s2 == '\0') {
+    return 1;
+  }
+
+  return char_digitize(*s1) < char_digitize(*s2) ? -1 : 1;
 }
\ No newline at end of file
@@ -27,6 +27,25 @@ static inline size_t char_digitize(char c) {
   }
 }
 
+/**
+ * @brief Returns ASCI code of digit of value @p digit (inverse of
+ * char_digitize()).
+ *
+ * eg digit = 10 -> returns '*'.
+ *
+ * @param digit : value of digit (from 0 to 11).
+ * @return char : ASCI code of the digit.
+ */
+static inline char char_undigitize(size_t digit) {
+  if (digit == 10u) {
+    return '*';
+  } else if (digit == 11u) {
+    return '#';
+  } else {
+    return (char)('0' + digit);
+  }
+}
+
 /** @brief Allocates memory and copies string content to it.
  *
  * Provided string must end with '\0'.
@@ -88,4 +107,14 @@ bool string_concat(char **to_extend, const char *to_append);
 bool string_check_prefixes(const char *s1, size_t start_char, const char *s2,
                            size_t *pref_len);
 
+/** @brief Function compares numbers in order of keys of tries (digits by
+ * char_digitize() value, prefix before longer strings).
+ *
+ * @param[in] s1 : first number.
+ * @param[in] s2 : second number.
+ * @return int : negative, zero or positive if @p s1 is smaller, equal or
+ * bigger than @p s2.
+ */
+int string_compare_numbers(const char *s1, const char *s2);
+
 #endif /* __STRING_LIB_H__ */
\ No newline at end of file
@@ -0,0 +1,688 @@
+/**
+ * @file write_ahead_log.c
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Module implements interface presented in write_ahead_log.h.
+ * @date 2022-06-21
+ */
+#define _POSIX_C_SOURCE 200809L
+#include "write_ahead_log.h"
+#include "latency.h"
+#include "memory.h"
+#include "number_codec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of log header (magic and version).
+ */
+#define HEADER_SIZE (sizeof(WAL_MAGIC) - 1 + 1)
+
+/**
+ * @brief Size of frame header (length and checksum).
+ */
+#define FRAME_HEADER 8
+
+/**
+ * @brief Struct to manage log opened for appending.
+ */
+struct WriteAheadLog {
+  int descriptor;           ///< Descriptor of the log file.
+  uint8_t *group;           ///< Frame of current group (with header space).
+  size_t length;            ///< Number of used bytes of @p group.
+  size_t last;              ///< Offset of the last record (0 if none).
+  size_t capacity;          ///< Capacity of @p group.
+  uint64_t group_start;     ///< Time of first record of current group.
+  WalDurability durability; ///< When groups are made durable.
+  uint64_t group_time;      ///< Maximal age of group in nanoseconds.
+  size_t group_bytes;       ///< Maximal size of group in bytes.
+  size_t size;              ///< Number of bytes written to the file.
+  bool failed;              ///< True if any write has failed.
+};
+
+/**
+ * @brief Writes whole buffer to the descriptor.
+ *
+ * @param descriptor : descriptor to write to.
+ * @param[in] data : bytes to write.
+ * @param size : number of bytes.
+ * @return true : if all bytes were written.
+ * @return false : if writing has failed.
+ */
+static bool write_all(int descriptor, const uint8_t *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(descriptor, data, size);
+
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    data += written;
+    size -= (size_t)written;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Writes log header and synchronizes it with the disk.
+ *
+ * @param descriptor : descriptor of empty log file.
+ * @return true : if header was written.
+ * @return false : if writing has failed.
+ */
+static bool write_header(int descriptor) {
+  uint8_t header[HEADER_SIZE];
+
+  memcpy(header, WAL_MAGIC, HEADER_SIZE - 1);
+  header[HEADER_SIZE - 1] = WAL_VERSION;
+
+  return write_all(descriptor, header, HEADER_SIZE) &&
+         fdatasync(descriptor) == 0;
+}
+
+/**
+ * @brief Synchronizes directory containing given file, so that its creation
+ * or renaming is durable.
+ *
+ * @param[in] path : path of the file.
+ * @return true : if directory was synchronized.
+ * @return false : if it has failed or memory error has occured.
+ */
+static bool sync_directory(const char *path) {
+  size_t length = strlen(path);
+  char *copy = wrap_malloc(length + 1, MEMORY_TAG_OTHER);
+  if (copy == NULL) {
+    return false;
+  }
+  memcpy(copy, path, length + 1);
+
+  int descriptor = open(dirname(copy), O_RDONLY);
+  wrap_free(copy);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  bool success = fsync(descriptor) == 0;
+  close(descriptor);
+
+  return success;
+}
+
+/**
+ * @brief Reads whole file to memory.
+ *
+ * @param descriptor : descriptor of the file.
+ * @param[out] size : place to save size of the file.
+ * @param[out] failed : set to true if reading has failed or memory error has
+ * occured.
+ * @return uint8_t* : contents of the file (NULL if file is empty or @p failed
+ * was set).
+ */
+static uint8_t *read_all(int descriptor, size_t *size, bool *failed) {
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    *failed = true;
+    return NULL;
+  }
+
+  *size = (size_t)status.st_size;
+  if (*size == 0) {
+    return NULL;
+  }
+
+  uint8_t *data = wrap_malloc(*size, MEMORY_TAG_OTHER);
+  if (data == NULL) {
+    *failed = true;
+    return NULL;
+  }
+
+  size_t read_bytes = 0;
+  while (read_bytes < *size) {
+    ssize_t result = read(descriptor, data + read_bytes, *size - read_bytes);
+
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      wrap_free(data);
+      *failed = true;
+      return NULL;
+    }
+
+    read_bytes += (size_t)result;
+  }
+
+  return data;
+}
+
+/**
+ * @brief Appends decoded argument to text of the contents.
+ *
+ * @param[in, out] contents : contents to append to.
+ * @param[in] argument : decoded argument.
+ * @param[out] offset : place to save offset of the argument.
+ * @return true : if argument was appended.
+ * @return false : if memory error has occured.
+ */
+static bool append_text(WalContents *contents, const char *argument,
+                        size_t *offset) {
+  size_t length = strlen(argument) + 1;
+
+  if (contents->text_capacity - contents->text_length < length) {
+    size_t capacity =
+        contents->text_capacity == 0 ? 4096 : 2 * contents->text_capacity;
+    while (capacity - contents->text_length < length) {
+      capacity *= 2;
+    }
+
+    char *text = contents->text == NULL
+                     ? wrap_malloc(capacity, MEMORY_TAG_OTHER)
+                     : wrap_realloc(contents->text, capacity);
+    if (text == NULL) {
+      return false;
+    }
+
+    contents->text = text;
+    contents->text_capacity = capacity;
+  }
+
+  memcpy(contents->text + contents->text_length, argument, length);
+  *offset = contents->text_length;
+  contents->text_length += length;
+
+  return true;
+}
+
+/**
+ * @brief Visitor of wal_load(), which appends record to the contents.
+ *
+ * @param operation : logged modification.
+ * @param[in] key : first argument.
+ * @param[in] value : second argument (NULL if @p operation isn't WAL_ADD).
+ * @param[in, out] configuration : pointer to WalContents.
+ * @return true : if record was appended.
+ * @return false : if memory error has occured.
+ */
+static bool append_entry(WalOperation operation, const char *key,
+                         const char *value, void *configuration) {
+  WalContents *contents = configuration;
+
+  if (contents->count == contents->capacity) {
+    size_t capacity = contents->capacity == 0 ? 256 : 2 * contents->capacity;
+    WalEntry *entries =
+        contents->entries == NULL
+            ? wrap_malloc(capacity * sizeof(WalEntry), MEMORY_TAG_OTHER)
+            : wrap_realloc(contents->entries, capacity * sizeof(WalEntry));
+    if (entries == NULL) {
+      return false;
+    }
+
+    contents->entries = entries;
+    contents->capacity = capacity;
+  }
+
+  WalEntry *entry = &contents->entries[contents->count];
+  entry->operation = operation;
+  entry->value = 0;
+
+  if (!append_text(contents, key, &entry->key) ||
+      (value != NULL && !append_text(contents, value, &entry->value))) {
+    return false;
+  }
+
+  contents->count++;
+  return true;
+}
+
+/**
+ * @brief Decodes records of one frame and passes them to the visitor.
+ *
+ * @param[in] payload : payload of the frame.
+ * @param size : size of the payload.
+ * @param[in] visitor : function called on every record.
+ * @param[in, out] configuration : pointer passed to @p visitor.
+ * @param[in, out] buffers : addresses of two buffers for decoding arguments.
+ * @param[in, out] sizes : capacities of @p buffers.
+ * @return true : if frame was decoded.
+ * @return false : if frame is malformed, memory error has occured or
+ * @p visitor has failed.
+ */
+static bool decode_frame(const uint8_t *payload, size_t size,
+                         WalVisitor visitor, void *configuration,
+                         char **buffers, size_t *sizes) {
+  size_t position = 0;
+
+  while (position < size) {
+    uint8_t operation = payload[position++];
+    if (operation != WAL_ADD && operation != WAL_REMOVE &&
+        operation != WAL_DELETE) {
+      return false;
+    }
+
+    size_t read = codec_get_number(payload + position, size - position,
+                                   &buffers[0], &sizes[0]);
+    if (read == 0) {
+      return false;
+    }
+    position += read;
+
+    if (operation == WAL_ADD) {
+      read = codec_get_number(payload + position, size - position,
+                              &buffers[1], &sizes[1]);
+      if (read == 0) {
+        return false;
+      }
+      position += read;
+    }
+
+    if (!visitor((WalOperation)operation, buffers[0],
+                 operation == WAL_ADD ? buffers[1] : NULL, configuration)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Walks frames of the log and optionally decodes them.
+ *
+ * @param[in] data : contents of the log file.
+ * @param size : size of @p data.
+ * @param[in] visitor : function called on every record (NULL if frames are
+ * only checked).
+ * @param[in, out] configuration : pointer passed to @p visitor.
+ * @param[out] failed : set to true if decoding has failed.
+ * @return size_t : length of the log without torn frame at the end (0 if
+ * header is invalid).
+ */
+static size_t scan_frames(const uint8_t *data, size_t size,
+                          WalVisitor visitor, void *configuration,
+                          bool *failed) {
+  if (size < HEADER_SIZE ||
+      memcmp(data, WAL_MAGIC, HEADER_SIZE - 1) != 0 ||
+      data[HEADER_SIZE - 1] != WAL_VERSION) {
+    return 0;
+  }
+
+  char *buffers[2] = {NULL, NULL};
+  size_t sizes[2] = {0, 0};
+  size_t position = HEADER_SIZE;
+
+  while (size - position >= FRAME_HEADER) {
+    size_t length = codec_get_u32(data + position);
+    uint32_t checksum = codec_get_u32(data + position + 4);
+    const uint8_t *payload = data + position + FRAME_HEADER;
+
+    if (size - position - FRAME_HEADER < length ||
+        codec_crc32(0, payload, length) != checksum) {
+      break;
+    }
+
+    if (visitor != NULL && !decode_frame(payload, length, visitor,
+                                         configuration, buffers, sizes)) {
+      *failed = true;
+      break;
+    }
+
+    position += FRAME_HEADER + length;
+  }
+
+  wrap_free(buffers[0]);
+  wrap_free(buffers[1]);
+  return position;
+}
+
+/**
+ * @brief Writes current group as one frame.
+ *
+ * @param[in, out] log : log to write group of.
+ * @param sync : true if frame should be synchronized with the disk.
+ * @return true : if group was written.
+ * @return false : if writing has failed.
+ */
+static bool commit_group(WriteAheadLog *log, bool sync) {
+  if (log->failed) {
+    return false;
+  }
+
+  if (log->length > FRAME_HEADER) {
+    size_t payload = log->length - FRAME_HEADER;
+
+    codec_put_u32(log->group, (uint32_t)payload);
+    codec_put_u32(log->group + 4,
+                  codec_crc32(0, log->group + FRAME_HEADER, payload));
+
+    if (!write_all(log->descriptor, log->group, log->length)) {
+      log->failed = true;
+      return false;
+    }
+
+    log->size += log->length;
+    log->length = FRAME_HEADER;
+    log->last = 0;
+  }
+
+  if (sync && fdatasync(log->descriptor) != 0) {
+    log->failed = true;
+    return false;
+  }
+
+  return true;
+}
+
+WriteAheadLog *wal_open(const char *path, WalDurability durability,
+                        uint64_t group_time, size_t group_bytes) {
+  WriteAheadLog *log =
+      wrap_calloc(1u, sizeof(struct WriteAheadLog), MEMORY_TAG_OTHER);
+  if (log == NULL) {
+    return NULL;
+  }
+
+  log->descriptor = open(path, O_RDWR | O_CREAT, 0644);
+  if (log->descriptor < 0) {
+    wrap_free(log);
+    return NULL;
+  }
+
+  bool failed = false;
+  size_t size = 0;
+  uint8_t *data = read_all(log->descriptor, &size, &failed);
+  size_t valid = 0;
+
+  if (!failed && size > 0) {
+    valid = scan_frames(data, size, NULL, NULL, &failed);
+    failed = failed || valid == 0;
+  }
+  wrap_free(data);
+
+  if (!failed && size == 0) {
+    failed = !write_header(log->descriptor);
+  } else if (!failed && valid < size) {
+    failed = ftruncate(log->descriptor, (off_t)valid) != 0;
+  }
+
+  if (failed || lseek(log->descriptor, 0, SEEK_END) < 0) {
+    close(log->descriptor);
+    wrap_free(log);
+    return NULL;
+  }
+
+  log->durability = durability;
+  log->group_time = group_time;
+  log->group_bytes = group_bytes;
+  log->size = size == 0 ? HEADER_SIZE : valid;
+  log->length = FRAME_HEADER;
+
+  return log;
+}
+
+bool wal_append(WriteAheadLog *log, WalOperation operation, const char *key,
+                const char *value) {
+  if (log->failed) {
+    return false;
+  }
+
+  size_t size = 1 + codec_number_size(key);
+  if (operation == WAL_ADD) {
+    size += codec_number_size(value);
+  }
+
+  if (log->capacity < log->length + size) {
+    size_t capacity = log->capacity == 0 ? 4096 : 2 * log->capacity;
+    while (capacity < log->length + size) {
+      capacity *= 2;
+    }
+
+    uint8_t *group = log->group == NULL
+                         ? wrap_malloc(capacity, MEMORY_TAG_OTHER)
+                         : wrap_realloc(log->group, capacity);
+    if (group == NULL) {
+      // The log would silently miss the record.
+      log->failed = true;
+      return false;
+    }
+
+    log->group = group;
+    log->capacity = capacity;
+  }
+
+  if (log->length == FRAME_HEADER) {
+    log->group_start = latency_clock_ns();
+  }
+
+  uint8_t *output = log->group + log->length;
+  *output++ = (uint8_t)operation;
+  output += codec_put_number(output, key);
+  if (operation == WAL_ADD) {
+    codec_put_number(output, value);
+  }
+  log->last = log->length;
+  log->length += size;
+
+  return true;
+}
+
+void wal_cancel(WriteAheadLog *log) {
+  if (log->last != 0) {
+    log->length = log->last;
+    log->last = 0;
+  }
+}
+
+size_t wal_mark(const WriteAheadLog *log) {
+  return log->length;
+}
+
+void wal_rewind(WriteAheadLog *log, size_t mark) {
+  if (mark >= FRAME_HEADER && mark <= log->length) {
+    log->length = mark;
+    log->last = 0;
+  }
+}
+
+bool wal_poll(WriteAheadLog *log) {
+  if (log->failed) {
+    return false;
+  }
+
+  log->last = 0;
+  if (log->length > FRAME_HEADER &&
+      (log->durability == WAL_SYNC ||
+       log->length - FRAME_HEADER >= log->group_bytes ||
+       latency_clock_ns() - log->group_start >= log->group_time)) {
+    return commit_group(log, log->durability != WAL_BUFFERED);
+  }
+
+  return true;
+}
+
+bool wal_failed(const WriteAheadLog *log) {
+  return log->failed;
+}
+
+bool wal_commit(WriteAheadLog *log) {
+  return commit_group(log, true);
+}
+
+bool wal_close(WriteAheadLog *log) {
+  if (log == NULL) {
+    return true;
+  }
+
+  bool success = commit_group(log, log->durability != WAL_BUFFERED);
+  if (close(log->descriptor) != 0) {
+    success = false;
+  }
+
+  wrap_free(log->group);
+  wrap_free(log);
+
+  return success;
+}
+
+size_t wal_size(const WriteAheadLog *log) {
+  return log->size + log->length - FRAME_HEADER;
+}
+
+/**
+ * @brief Appends all frames of the log to another log.
+ *
+ * @param[in] log : log to copy frames of (with committed group).
+ * @param[in] path : path of log to append to.
+ * @return true : if frames were appended and synchronized with the disk.
+ * @return false : if reading or writing has failed or memory error has
+ * occured.
+ */
+static bool append_frames(const WriteAheadLog *log, const char *path) {
+  WriteAheadLog *target = wal_open(path, WAL_BUFFERED, UINT64_MAX, SIZE_MAX);
+  if (target == NULL) {
+    return false;
+  }
+
+  bool failed = lseek(log->descriptor, 0, SEEK_SET) != 0;
+  size_t size = 0;
+  uint8_t *data = failed ? NULL : read_all(log->descriptor, &size, &failed);
+
+  failed = failed || size < log->size ||
+           !write_all(target->descriptor, data + HEADER_SIZE,
+                      log->size - HEADER_SIZE) ||
+           fdatasync(target->descriptor) != 0;
+
+  wrap_free(data);
+  return wal_close(target) && !failed;
+}
+
+bool wal_rotate(WriteAheadLog *log, const char *path,
+                const char *previous_path) {
+  if (!commit_group(log, true)) {
+    return false;
+  }
+
+  // From now on the log is either rotated or stops working.
+  struct stat status;
+  if (stat(previous_path, &status) == 0) {
+    log->failed = !append_frames(log, previous_path);
+  } else {
+    log->failed = errno != ENOENT || rename(path, previous_path) != 0;
+  }
+
+  size_t length = strlen(path);
+  char *temporary = wrap_malloc(length + sizeof(".tmp"), MEMORY_TAG_OTHER);
+  if (log->failed || temporary == NULL) {
+    wrap_free(temporary);
+    log->failed = true;
+    return false;
+  }
+  memcpy(temporary, path, length);
+  memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+
+  int descriptor = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (descriptor < 0 || !write_header(descriptor) ||
+      rename(temporary, path) != 0 || !sync_directory(path)) {
+    if (descriptor >= 0) {
+      close(descriptor);
+    }
+    wrap_free(temporary);
+    log->failed = true;
+    return false;
+  }
+  wrap_free(temporary);
+
+  close(log->descriptor);
+  log->descriptor = descriptor;
+  log->size = HEADER_SIZE;
+
+  return true;
+}
+
+bool wal_finish(WriteAheadLog *log, const char *path, const char *final_path) {
+  bool success = commit_group(log, true);
+
+  if (close(log->descriptor) != 0) {
+    success = false;
+  }
+  wrap_free(log->group);
+  wrap_free(log);
+
+  return success && rename(path, final_path) == 0 &&
+         sync_directory(final_path);
+}
+
+bool wal_replay(const char *path, bool missing_ok, WalVisitor visitor,
+                void *configuration) {
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return missing_ok && errno == ENOENT;
+  }
+
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    close(descriptor);
+    return false;
+  }
+
+  size_t size = (size_t)status.st_size;
+  if (size == 0) {
+    close(descriptor);
+    return true;
+  }
+
+  // Images can be big, so they are mapped instead of being copied.
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+  bool failed = false;
+  if (scan_frames(data, size, visitor, configuration, &failed) == 0) {
+    failed = true;
+  }
+  munmap(data, size);
+
+  return !failed;
+}
+
+bool wal_load(const char *path, WalContents *contents) {
+  memset(contents, 0, sizeof(WalContents));
+
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return errno == ENOENT;
+  }
+
+  bool failed = false;
+  size_t size = 0;
+  uint8_t *data = read_all(descriptor, &size, &failed);
+  close(descriptor);
+
+  if (!failed && size > 0 &&
+      scan_frames(data, size, append_entry, contents, &failed) == 0) {
+    failed = true;
+  }
+  wrap_free(data);
+
+  if (failed) {
+    wal_contents_drop(contents);
+    return false;
+  }
+
+  return true;
+}
+
+void wal_contents_drop(WalContents *contents) {
+  wrap_free(contents->entries);
+  wrap_free(contents->text);
+  memset(contents, 0, sizeof(WalContents));
+}
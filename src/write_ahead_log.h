@@ -0,0 +1,285 @@
+/**
+ * @file write_ahead_log.h
+ * @author Przemysław Fuchs (pf438429@students.mimuw.edu.pl)
+ * @brief Interface of append-only log of modifications with group commit.
+ *
+ * Log starts with WAL_MAGIC and version byte, followed by frames. Frame is
+ * 4 byte length of payload, 4 byte CRC-32 of payload and payload: records of
+ * one group, every record being operation byte and its arguments encoded by
+ * number_codec.h. Frame is written with one write, so after a crash log ends
+ * with complete frames, possibly followed by a torn one, which is ignored by
+ * readers and cut off by writers.
+ *
+ * @date 2022-06-21
+ */
+#ifndef __WRITE_AHEAD_LOG_H__
+#define __WRITE_AHEAD_LOG_H__
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Magic bytes at the beggining of every log.
+ */
+#define WAL_MAGIC "PHFWDWAL"
+
+/**
+ * @brief Version of log format.
+ */
+#define WAL_VERSION 1
+
+/**
+ * @brief Logged modifications.
+ */
+enum WalOperation {
+  WAL_ADD = 1,    ///< Addition of forward.
+  WAL_REMOVE = 2, ///< Removal of forwards.
+  WAL_DELETE = 3, ///< Removal of one forward (without longer ones).
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum WalOperation WalOperation;
+
+/**
+ * @brief When groups of records are made durable.
+ */
+enum WalDurability {
+  WAL_BUFFERED, ///< Groups are written, but not synchronized with the disk.
+  WAL_GROUP,    ///< Groups are written and synchronized with the disk.
+  WAL_SYNC,     ///< Every record is written and synchronized at once.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef enum WalDurability WalDurability;
+
+/**
+ * @brief Function called on every record of replayed log.
+ *
+ * @param operation : logged modification.
+ * @param[in] key : first argument.
+ * @param[in] value : second argument (NULL if @p operation isn't WAL_ADD).
+ * @param[in, out] configuration : pointer passed to wal_replay().
+ * @return true : if replay should continue.
+ * @return false : if replay should fail.
+ */
+typedef bool (*WalVisitor)(WalOperation operation, const char *key,
+                           const char *value, void *configuration);
+
+/**
+ * @brief Structure representing log opened for appending.
+ */
+struct WriteAheadLog;
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct WriteAheadLog WriteAheadLog;
+
+/**
+ * @brief One record of loaded log. Arguments are offsets in text of
+ * WalContents.
+ */
+struct WalEntry {
+  WalOperation operation; ///< Logged modification.
+  size_t key;             ///< Offset of first argument.
+  size_t value;           ///< Offset of second argument (WAL_ADD only).
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct WalEntry WalEntry;
+
+/**
+ * @brief All records of the log, in order of writing.
+ */
+struct WalContents {
+  WalEntry *entries;    ///< Loaded records.
+  size_t count;         ///< Number of records.
+  size_t capacity;      ///< Capacity of @p entries.
+  char *text;           ///< Arguments of records, separated by '\0'.
+  size_t text_length;   ///< Number of used bytes of @p text.
+  size_t text_capacity; ///< Capacity of @p text.
+};
+
+/**
+ * @brief Typedef to keep code clean and more readable.
+ */
+typedef struct WalContents WalContents;
+
+/**
+ * @brief Opens log for appending, creating it if it doesn't exist.
+ *
+ * Torn frame at the end of existing log is cut off.
+ *
+ * @param[in] path : path of the log.
+ * @param durability : when groups are made durable.
+ * @param group_time : maximal age of group in nanoseconds.
+ * @param group_bytes : maximal size of group in bytes.
+ * @return WriteAheadLog* : opened log (NULL if file can't be opened, isn't a
+ * log or memory error has occured).
+ */
+WriteAheadLog *wal_open(const char *path, WalDurability durability,
+                        uint64_t group_time, size_t group_bytes);
+
+/**
+ * @brief Appends record to the current group. Nothing is written until the
+ * group is committed by wal_poll() or wal_commit().
+ *
+ * Log stops working after first failed write or if the record can't be
+ * buffered, so it never misses a record silently. Later calls return false.
+ *
+ * @param[in, out] log : log to append to.
+ * @param operation : logged modification.
+ * @param[in] key : first argument.
+ * @param[in] value : second argument (used only by WAL_ADD).
+ * @return true : if record was appended.
+ * @return false : if log has failed or memory error has occured.
+ */
+bool wal_append(WriteAheadLog *log, WalOperation operation, const char *key,
+                const char *value);
+
+/**
+ * @brief Drops record appended last, if no wal_poll() or commit happened
+ * since. Used when logged modification turns out to have failed.
+ *
+ * @param[in, out] log : log to drop record from.
+ */
+void wal_cancel(WriteAheadLog *log);
+
+/**
+ * @brief Returns position in the open group, to which wal_rewind() can drop
+ * records appended later.
+ *
+ * @param[in] log : log to mark.
+ * @return size_t : current position.
+ */
+size_t wal_mark(const WriteAheadLog *log);
+
+/**
+ * @brief Drops records appended after the mark, if no wal_poll() or commit
+ * happened since it was taken. Used when modification logged as several
+ * records turns out to have failed.
+ *
+ * @param[in, out] log : log to drop records from.
+ * @param mark : position returned by wal_mark().
+ */
+void wal_rewind(WriteAheadLog *log, size_t mark);
+
+/**
+ * @brief Commits current group if it is old or big enough (or at once with
+ * WAL_SYNC durability).
+ *
+ * Called after every logged modification, and by idle callers so that open
+ * group doesn't wait for the next modification longer than its time limit.
+ *
+ * @param[in, out] log : log to poll.
+ * @return true : if log works.
+ * @return false : if log has failed.
+ */
+bool wal_poll(WriteAheadLog *log);
+
+/**
+ * @brief Checks if log has stopped working.
+ *
+ * @param[in] log : log to check.
+ * @return true : if any write has failed or a record couldn't be appended.
+ * @return false : otherwise.
+ */
+bool wal_failed(const WriteAheadLog *log);
+
+/**
+ * @brief Writes current group and synchronizes it according to durability
+ * (WAL_BUFFERED groups are synchronized too).
+ *
+ * @param[in, out] log : log to commit.
+ * @return true : if all records are durable.
+ * @return false : if writing has failed.
+ */
+bool wal_commit(WriteAheadLog *log);
+
+/**
+ * @brief Commits current group and closes the log.
+ *
+ * @param[in] log : log to close (may be NULL).
+ * @return true : if all records were written.
+ * @return false : if any write has failed.
+ */
+bool wal_close(WriteAheadLog *log);
+
+/**
+ * @brief Returns size of the log, including current group.
+ *
+ * @param[in] log : checked log.
+ * @return size_t : size of the log in bytes.
+ */
+size_t wal_size(const WriteAheadLog *log);
+
+/**
+ * @brief Moves records of the log to @p previous_path and continues with
+ * empty log at @p path.
+ *
+ * Current group is committed first. If @p previous_path exists, frames of the
+ * log are appended to it, otherwise the log is renamed. Empty log replaces
+ * @p path atomically, so after a crash each record is in one of the files
+ * (or in both, if the crash happened before the replacement).
+ *
+ * @param[in, out] log : log to rotate, opened at @p path.
+ * @param[in] path : path of the log.
+ * @param[in] previous_path : path of log of older records.
+ * @return true : if log was rotated.
+ * @return false : if any operation on files has failed or memory error has
+ * occured (later appends fail then).
+ */
+bool wal_rotate(WriteAheadLog *log, const char *path,
+                const char *previous_path);
+
+/**
+ * @brief Commits current group, closes the log and renames it.
+ *
+ * @param[in] log : log to finish, opened at @p path (freed by the function).
+ * @param[in] path : path of the log.
+ * @param[in] final_path : new path of the log.
+ * @return true : if all records are durable at @p final_path.
+ * @return false : if any operation on files has failed.
+ */
+bool wal_finish(WriteAheadLog *log, const char *path, const char *final_path);
+
+/**
+ * @brief Passes all records of complete frames of the log to the visitor,
+ * without keeping them in memory.
+ *
+ * @param[in] path : path of the log.
+ * @param[in] missing_ok : whether missing log is replayed as empty.
+ * @param[in] visitor : function called on every record.
+ * @param[in, out] configuration : pointer passed to @p visitor.
+ * @return true : if log was replayed.
+ * @return false : if file can't be read (or is missing and @p missing_ok is
+ * false), isn't a log, memory error has occured or @p visitor has failed.
+ */
+bool wal_replay(const char *path, bool missing_ok, WalVisitor visitor,
+                void *configuration);
+
+/**
+ * @brief Loads all complete frames of the log.
+ *
+ * @param[in] path : path of the log.
+ * @param[out] contents : place to save records (cleared by the function).
+ * @return true : if log was loaded (missing log is loaded as empty).
+ * @return false : if file can't be read, isn't a log or memory error has
+ * occured.
+ */
+bool wal_load(const char *path, WalContents *contents);
+
+/**
+ * @brief Frees loaded records.
+ *
+ * @param[in, out] contents : records to free.
+ */
+void wal_contents_drop(WalContents *contents);
+
+#endif /* __WRITE_AHEAD_LOG_H__ */
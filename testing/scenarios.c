@@ -0,0 +1,844 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../src/phfwd_client.h"
+#include "../src/phfwd_protocol.h"
+#include "../src/phone_forward.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Liczba struktur, między którymi przełącza polecenie USE.
+ */
+#define SLOTS 4
+
+/**
+ * Liczba wersji, do których odwołują się polecenia VERSION*.
+ */
+#define VERSIONS 4
+
+/**
+ * Rozmiar bufora na jedno słowo scenariusza.
+ */
+#define BUFFER_SIZE 100001
+
+static unsigned long command = 1;
+static char *scenario = "";
+
+/**
+ * Numery występujące w scenariuszu (porównywane przez SAME i *_FAILING).
+ */
+static char **numbers = NULL;
+static size_t numbers_count = 0;
+static size_t numbers_capacity = 0;
+
+/**
+ * Numer alokacji (licząc od 1), która się nie powiedzie (0 – żadna).
+ */
+static size_t failing_allocation = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+static bool allocation_fails(void) {
+  return failing_allocation > 0 && --failing_allocation == 0;
+}
+
+void *__wrap_malloc(size_t size) {
+  return allocation_fails() ? NULL : __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  return allocation_fails() ? NULL : __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  return allocation_fails() ? NULL : __real_realloc(pointer, size);
+}
+
+static void failure(const char *message, const char *argument) {
+  printf("%s: ASSERTION FAILED AT COMMAND %lu: %s %s\n", scenario, command,
+         message, argument);
+  fflush(stdout);
+
+  assert(false);
+  exit(1);
+}
+
+static void check(bool condition, const char *message, const char *argument) {
+  if (!condition) {
+    failure(message, argument);
+  }
+}
+
+static void read_word(char *buffer) {
+  check(scanf("%100000s", buffer) == 1, "UNEXPECTED END OF SCENARIO", "");
+}
+
+static size_t read_size(char *buffer) {
+  read_word(buffer);
+  return strtoull(buffer, NULL, 10);
+}
+
+static size_t read_operation(char *buffer) {
+  const char *names[PHFWD_OPERATIONS] = {"ADD", "GET", "REMOVE", "REVERSE"};
+
+  read_word(buffer);
+  for (size_t i = 0; i < PHFWD_OPERATIONS; i++) {
+    if (strcmp(buffer, names[i]) == 0) {
+      return i;
+    }
+  }
+
+  failure("UNKNOWN OPERATION", buffer);
+  return 0;
+}
+
+/**
+ * Zapamiętuje numer scenariusza. Alokacje sterownika nie są liczone przez
+ * FAIL.
+ */
+static void remember(const char *number) {
+  if (numbers_count == numbers_capacity) {
+    numbers_capacity = numbers_capacity == 0 ? 64 : 2 * numbers_capacity;
+    numbers = __real_realloc(numbers, numbers_capacity * sizeof(char *));
+    assert(numbers != NULL);
+  }
+
+  size_t length = strlen(number) + 1;
+  numbers[numbers_count] = __real_malloc(length);
+  assert(numbers[numbers_count] != NULL);
+  memcpy(numbers[numbers_count], number, length);
+  numbers_count++;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *string) {
+  for (; *string != '\0'; string++) {
+    hash = (hash ^ (unsigned char)*string) * 1099511628211u;
+  }
+
+  return (hash ^ ' ') * 1099511628211u;
+}
+
+/**
+ * Skrót przekierowań i przekierowań odwrotnych numerów scenariusza.
+ */
+static uint64_t fingerprint(PhoneForward *pf) {
+  uint64_t hash = 14695981039346656037u;
+
+  for (size_t i = 0; i < numbers_count; i++) {
+    PhoneNumbers *ph = phfwdGet(pf, numbers[i]);
+    check(ph != NULL, "GET FAILED FOR", numbers[i]);
+    // Niepoprawne numery nie mają przekierowania.
+    const char *forward = phnumGet(ph, 0);
+    hash = hash_string(hash, forward == NULL ? "" : forward);
+    phnumDelete(ph);
+
+    ph = phfwdReverse(pf, numbers[i]);
+    check(ph != NULL, "REVERSE FAILED FOR", numbers[i]);
+    for (size_t k = 0; phnumGet(ph, k) != NULL; k++) {
+      hash = hash_string(hash, phnumGet(ph, k));
+    }
+    hash = hash_string(hash, "|");
+    phnumDelete(ph);
+  }
+
+  return hash;
+}
+
+static void count_forward(char const *num1, char const *num2,
+                          void *configuration) {
+  (void)num1;
+  (void)num2;
+  (*(size_t *)configuration)++;
+}
+
+static void count_change(char const *num, char const *from, char const *to,
+                         void *configuration) {
+  (void)num;
+  (void)from;
+  (void)to;
+  (*(size_t *)configuration)++;
+}
+
+static void remove_log(const char *path, char *buffer) {
+  const char *suffixes[] = {"", ".tmp", ".prev", ".ckpt", ".ckpt.tmp"};
+
+  for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+    snprintf(buffer, BUFFER_SIZE, "%s%s", path, suffixes[i]);
+    unlink(buffer);
+  }
+}
+
+/**
+ * Dodaje przekierowanie przy coraz późniejszym błędzie alokacji, aż do
+ * udanego dodania. Po każdym nieudanym dodaniu struktura musi pozostać bez
+ * zmian.
+ */
+static void add_failing(PhoneForward *pf, const char *num1, const char *num2) {
+  uint64_t before = fingerprint(pf);
+
+  for (size_t failing = 1;; failing++) {
+    failing_allocation = failing;
+    bool added = phfwdAdd(pf, num1, num2);
+    bool failed = failing_allocation == 0;
+    failing_allocation = 0;
+
+    if (added) {
+      return;
+    }
+
+    check(failed, "ADD FAILED WITHOUT ALLOCATION ERROR", num1);
+    check(fingerprint(pf) == before, "ADD CHANGED STRUCTURE", num1);
+  }
+}
+
+/**
+ * Odtwarza dziennik w nowych strukturach przy coraz późniejszym błędzie
+ * alokacji, aż do udanego odtworzenia. Częściowo odtworzona struktura musi
+ * dać się odczytać i usunąć.
+ */
+static PhoneForward *recover_failing(const char *path) {
+  for (size_t failing = 1;; failing++) {
+    PhoneForward *pf = phfwdNew();
+    check(pf != NULL, "STRUCTURE NOT CREATED", "");
+
+    failing_allocation = failing;
+    bool recovered = phfwdWalRecover(pf, path);
+    bool failed = failing_allocation == 0;
+    failing_allocation = 0;
+
+    if (recovered) {
+      return pf;
+    }
+
+    check(failed, "RECOVER FAILED WITHOUT ALLOCATION ERROR", path);
+    fingerprint(pf);
+    phfwdDelete(pf);
+  }
+}
+
+/**
+ * Zastępuje przekierowania pod prefiksem przy coraz późniejszym błędzie
+ * alokacji, aż do udanego zastąpienia. Po każdym nieudanym zastąpieniu obie
+ * struktury muszą pozostać bez zmian.
+ */
+static void replace_failing(PhoneForward *pf, const char *prefix,
+                            PhoneForward *staged) {
+  uint64_t before = fingerprint(pf);
+  uint64_t staged_before = fingerprint(staged);
+
+  for (size_t failing = 1;; failing++) {
+    failing_allocation = failing;
+    bool replaced = phfwdReplacePrefix(pf, prefix, staged);
+    bool failed = failing_allocation == 0;
+    failing_allocation = 0;
+
+    if (replaced) {
+      return;
+    }
+
+    check(failed, "REPLACE FAILED WITHOUT ALLOCATION ERROR", prefix);
+    check(fingerprint(pf) == before && fingerprint(staged) == staged_before,
+          "REPLACE CHANGED STRUCTURE", prefix);
+  }
+}
+
+/**
+ * Transakcja z powtórzonymi zmianami, zatwierdzana przy coraz późniejszym
+ * błędzie alokacji, aż do udanego zatwierdzenia. Po każdym nieudanym
+ * zatwierdzeniu struktura musi pozostać bez zmian, a po udanym zmiany
+ * sprawdza dalsza część scenariusza.
+ */
+static void commit_failing(PhoneForward *pf, char **staged, size_t count) {
+  uint64_t before = fingerprint(pf);
+
+  for (size_t failing = 1;; failing++) {
+    PhoneForwardTransaction *transaction = phfwdBegin(pf);
+    check(transaction != NULL, "BEGIN FAILED", "");
+
+    for (size_t i = 0; i < count; i++) {
+      bool staged_ok = staged[i][0] == '+'
+                           ? phfwdStageAdd(transaction, staged[i] + 1,
+                                           staged[i] + strlen(staged[i]) + 1)
+                           : phfwdStageRemove(transaction, staged[i] + 1);
+      check(staged_ok, "STAGE FAILED", staged[i] + 1);
+    }
+
+    failing_allocation = failing;
+    bool committed = phfwdCommit(transaction);
+    bool failed = failing_allocation == 0;
+    failing_allocation = 0;
+
+    if (committed) {
+      return;
+    }
+
+    check(failed, "COMMIT FAILED WITHOUT ALLOCATION ERROR", "");
+    check(fingerprint(pf) == before, "COMMIT WASN'T ROLLED BACK", "");
+  }
+}
+
+/**
+ * Sprawdza liczbę pomiarów operacji i spójność jej histogramu.
+ */
+static void check_latency(size_t operation, uint64_t expected) {
+  PhoneForwardLatencySnapshot snapshot;
+  check(phfwdLatencySnapshot(&snapshot), "LATENCY STATS DISABLED", "");
+
+  PhoneForwardLatency *latency = &snapshot.operations[operation];
+  check(latency->count == expected, "WRONG NUMBER OF MEASUREMENTS", "");
+
+  uint64_t counted = 0;
+  for (size_t i = 0; i < PHFWD_LATENCY_BUCKETS; i++) {
+    counted += latency->buckets[i];
+    check(phfwdLatencyBucketValue(i) < phfwdLatencyBucketValue(i + 1),
+          "BUCKETS NOT INCREASING", "");
+  }
+  check(counted == latency->count, "BUCKETS DON'T SUM UP", "");
+  check(phfwdLatencyBucketValue(PHFWD_LATENCY_BUCKETS) == UINT64_MAX,
+        "WRONG BOUND OF LAST BUCKET", "");
+
+  if (latency->count > 0) {
+    uint64_t median = phfwdLatencyPercentile(latency, 50);
+    check(latency->min <= latency->max && latency->total >= latency->max,
+          "WRONG EXTREMES", "");
+    check(phfwdLatencyPercentile(latency, 0) <= latency->min &&
+              median <= latency->max &&
+              median <= phfwdLatencyPercentile(latency, 100),
+          "WRONG PERCENTILES", "");
+  } else {
+    check(phfwdLatencyPercentile(latency, 50) == 0, "WRONG EMPTY PERCENTILE",
+          "");
+  }
+}
+
+/**
+ * Wątek dodający i odczytujący przekierowania we własnej strukturze.
+ */
+static void *worker(void *argument) {
+  size_t count = *(size_t *)argument;
+  PhoneForward *pf = phfwdNew();
+  char number[32];
+
+  for (size_t i = 0; pf != NULL && i < count; i++) {
+    snprintf(number, sizeof(number), "1%zu", i);
+    phfwdAdd(pf, number, "2");
+    phnumDelete(phfwdGet(pf, number));
+  }
+
+  phfwdDelete(pf);
+  return NULL;
+}
+
+static void run_threads(size_t threads, size_t count) {
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+  assert(ids != NULL);
+
+  for (size_t i = 0; i < threads; i++) {
+    check(pthread_create(&ids[i], NULL, worker, &count) == 0,
+          "THREAD NOT CREATED", "");
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(ids[i], NULL);
+  }
+
+  free(ids);
+}
+
+/**
+ * Kolejkuje żądanie do serwera, np. ADD 1 2 albo GET 12.
+ */
+static bool send_request(PhfwdClient *client, char *BUFOR1, char *BUFOR2) {
+  read_word(BUFOR1);
+
+  if (strcmp(BUFOR1, "ADD") == 0) {
+    read_word(BUFOR1);
+    read_word(BUFOR2);
+    return phfwd_client_add(client, BUFOR1, BUFOR2);
+  }
+
+  bool (*operations[])(PhfwdClient *, const char *) = {
+      phfwd_client_remove, phfwd_client_get, phfwd_client_reverse};
+  const char *names[] = {"REMOVE", "GET", "REVERSE"};
+
+  for (size_t i = 0; i < 3; i++) {
+    if (strcmp(BUFOR1, names[i]) == 0) {
+      read_word(BUFOR1);
+      return operations[i](client, BUFOR1);
+    }
+  }
+
+  failure("UNKNOWN REQUEST", BUFOR1);
+  return false;
+}
+
+/**
+ * Wysyła do serwera początek żądania z numerem dłuższym niż
+ * PROTOCOL_MAX_NUMBER i sprawdza, czy serwer zamknął połączenie.
+ */
+static void send_too_long(const char *path) {
+  int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  struct timeval timeout = {.tv_sec = 10};
+  check(descriptor >= 0 && strlen(path) < sizeof(address.sun_path),
+        "SOCKET NOT CREATED", path);
+
+  strcpy(address.sun_path, path);
+  setsockopt(descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  check(connect(descriptor, (struct sockaddr *)&address, sizeof(address)) ==
+            0,
+        "CONNECT FAILED", path);
+
+  // Nagłówek numeru to varint długości pomnożonej przez 2.
+  size_t header = 2 * (PROTOCOL_MAX_NUMBER + 1);
+  unsigned char request[] = {PROTOCOL_GET, 0x80 | (header & 0x7F),
+                             header >> 7};
+  check(write(descriptor, request, sizeof(request)) == sizeof(request),
+        "WRITE FAILED", path);
+
+  char byte;
+  check(read(descriptor, &byte, 1) == 0, "CONNECTION NOT CLOSED", path);
+  close(descriptor);
+}
+
+int main(int argc, char **argv) {
+  /**
+   * SCENARIUSZE TESTOWE (JĘZYK PARSERA Z parser.c I DODATKOWE POLECENIA)
+   * ADD (NUMER1) (NUMER2) -> phfwdAdd(pf, num1, num2)
+   * REMOVE (NUMER1) -> phfwdRemove(pf, num)
+   * REMOVE_BATCH (LICZBA) (PREFIKS)... (0/1) -> phfwdRemoveBatch i oczekiwany
+   * wynik
+   * GET (NUMER) (WYNIK)
+   * REVERSE (NUMER), GETREVERSE (WYNIK)..., REVERSE_END
+   * // -> komentarz do końca linii
+   * NODES (LICZBA) -> liczba węzłów drzewa przekierowań
+   * HYBRID (LIMIT ZMIAN) (KROK), HYBRID_MERGE, HYBRID_OFF -> układ
+   * hybrydowy
+   * LATENCY (OPERACJA) (LICZBA) -> liczba pomiarów operacji we wszystkich
+   * wątkach, np. LATENCY GET 3
+   * THREADS (WĄTKI) (LICZBA) -> wątki wykonujące po LICZBA wywołań phfwdAdd
+   * i phfwdGet na własnych strukturach
+   * RECORD (ŚCIEŻKA), RECORD_STOP -> nagrywanie wywołań do pliku
+   * CONNECT (ŚCIEŻKA), DISCONNECT -> połączenie z phfwd_server
+   * SEND (ŻĄDANIE) -> kolejkuje żądanie, np. SEND ADD 1 2
+   * SEND_REJECTED (ŻĄDANIE) -> żądanie odrzucone przez klienta
+   * RECEIVE (0/1) (LICZBA) (WYNIK)... -> powodzenie i wyniki odpowiedzi
+   * TOO_LONG (ŚCIEŻKA) -> serwer zamyka połączenie ze zbyt długim numerem
+   * USE (STRUKTURA), NEW (STRUKTURA), DELETE (STRUKTURA)
+   * CLONE (STRUKTURA) -> phfwdClone bieżącej struktury
+   * SAME (STRUKTURA) -> te same przekierowania numerów scenariusza
+   * DIFF (STRUKTURA1) (STRUKTURA2) (LICZBA) -> liczba różnic phfwdDiff
+   * APPLY_DIFF (STRUKTURA1) (STRUKTURA2) -> phfwdApplyDiff na bieżącej
+   * FAIL (N) -> N-ta alokacja następnego polecenia się nie powiedzie
+   * ADD_FAILS (NUMER1) (NUMER2) -> phfwdAdd zwraca false
+   * ADD_FAILING (NUMER1) (NUMER2) -> jak ADD, ale najpierw przy kolejnych
+   * błędach alokacji
+   * WAL_OPEN (ŚCIEŻKA) (CZAS GRUPY) (ROZMIAR GRUPY) (PUNKT KONTROLNY)
+   * (KROK), WAL_SYNC, CHECKPOINT, WAL_POLL (0/1), WAL_FAILED (0/1),
+   * WAL_CLOSE (0/1), CLEAN (ŚCIEŻKA) -> usuwa dziennik i jego pliki,
+   * SLEEP (MILISEKUNDY)
+   * SNAPSHOT (ŚCIEŻKA), SNAPSHOT_WAIT -> zrzut w tle i czekanie na zapis
+   * LOAD (ŚCIEŻKA) (0/1) -> phfwdSnapshotLoad i oczekiwany wynik
+   * RECOVER (STRUKTURA) (ŚCIEŻKA) -> odtworzenie dziennika (w nowej
+   * strukturze, jeśli STRUKTURA nie istnieje)
+   * VERSION (WERSJA), RELEASE (WERSJA) -> phfwdSnapshot, phfwdVersionRelease
+   * VERSION_GET (WERSJA) (NUMER) (WYNIK), VERSION_COUNT (WERSJA) (LICZBA)
+   * RECOVER_FAILING (STRUKTURA) (ŚCIEŻKA) -> nowa struktura odtworzona
+   * z dziennika, najpierw przy kolejnych błędach alokacji
+   * REPLACE (PREFIKS) (STRUKTURA) (0/1) -> phfwdReplacePrefix i oczekiwany
+   * wynik (po powodzeniu STRUKTURA nie istnieje)
+   * REPLACE_FAILING (PREFIKS) (STRUKTURA) -> jak REPLACE, ale najpierw przy
+   * kolejnych błędach alokacji
+   * RECLAIM_STEP (LICZBA), RECLAIM -> tempo i dokończenie zwalniania
+   * odłączonych przekierowań
+   * FORWARDS (LICZBA) -> liczba przekierowań według phfwdMemoryStats
+   * RELAYOUT (0/1) -> phfwdRelayout i oczekiwany wynik
+   * SAMPLE (0/1) -> phfwdHotSampling
+   * RELAYOUT_HOT (LICZBA) (0/1) -> phfwdRelayoutHot i oczekiwany wynik
+   * DEFER (PRÓG), DEFER_OFF -> phfwdCompactionDefer
+   * COMPACT (LICZBA) -> liczba węzłów zwolnionych przez phfwdCompact
+   * BEGIN, STAGE_ADD (NUMER1) (NUMER2), STAGE_REMOVE (NUMER), COMMIT, ABORT,
+   * COMMIT_FAILING -> jak COMMIT, ale najpierw przy kolejnych błędach alokacji
+   */
+  if (argc > 1) {
+    scenario = argv[1];
+  }
+
+  PhoneForward *slots[SLOTS] = {NULL};
+  size_t current = 0;
+  slots[current] = phfwdNew();
+
+  PhoneForwardVersion *versions[VERSIONS] = {NULL};
+  PhfwdClient *client = NULL;
+  PhoneForwardTransaction *transaction = NULL;
+  char **staged = NULL;
+  size_t staged_count = 0;
+  char *BUFOR1 = malloc(sizeof(char) * BUFFER_SIZE);
+  char *BUFOR2 = malloc(sizeof(char) * BUFFER_SIZE);
+  char *BUFOR3 = malloc(sizeof(char) * BUFFER_SIZE);
+  assert(slots[current] != NULL && BUFOR1 != NULL && BUFOR2 != NULL &&
+         BUFOR3 != NULL);
+
+  // FAIL dotyczy tylko następnego polecenia.
+  size_t failing_next = 0;
+
+  while (scanf("%100000s", BUFOR1) == 1) {
+    PhoneForward *pf = slots[current];
+    failing_allocation = failing_next;
+    failing_next = 0;
+
+    if (strcmp(BUFOR1, "//") == 0) {
+      scanf("%*[^\n]");
+    } else if (strcmp(BUFOR1, "ADD") == 0 ||
+               strcmp(BUFOR1, "ADD_FAILS") == 0) {
+      bool fails = strcmp(BUFOR1, "ADD_FAILS") == 0;
+      read_word(BUFOR1);
+      read_word(BUFOR2);
+      remember(BUFOR1);
+      remember(BUFOR2);
+      check(phfwdAdd(pf, BUFOR1, BUFOR2) ==
+                (!fails && strcmp(BUFOR1, BUFOR2) != 0),
+            "WRONG RESULT OF ADD", BUFOR1);
+    } else if (strcmp(BUFOR1, "ADD_FAILING") == 0) {
+      read_word(BUFOR1);
+      read_word(BUFOR2);
+      remember(BUFOR1);
+      remember(BUFOR2);
+      add_failing(pf, BUFOR1, BUFOR2);
+    } else if (strcmp(BUFOR1, "REMOVE") == 0) {
+      read_word(BUFOR1);
+      remember(BUFOR1);
+      phfwdRemove(pf, BUFOR1);
+    } else if (strcmp(BUFOR1, "REMOVE_BATCH") == 0) {
+      size_t count = read_size(BUFOR1);
+      for (size_t i = 0; i < count; i++) {
+        read_word(BUFOR1);
+        remember(BUFOR1);
+      }
+      // Zapamiętane numery są ostatnimi elementami tablicy numbers.
+      char const *const *prefixes =
+          (char const *const *)numbers + numbers_count - count;
+      bool success = read_size(BUFOR1) != 0;
+      check(phfwdRemoveBatch(pf, prefixes, count) == success,
+            "WRONG RESULT OF REMOVE_BATCH", BUFOR1);
+    } else if (strcmp(BUFOR1, "GET") == 0) {
+      read_word(BUFOR1);
+      read_word(BUFOR2);
+      remember(BUFOR1);
+      PhoneNumbers *ph = phfwdGet(pf, BUFOR1);
+      check(ph != NULL && strcmp(phnumGet(ph, 0), BUFOR2) == 0,
+            "WRONG RESULT OF GET", BUFOR1);
+      phnumDelete(ph);
+    } else if (strcmp(BUFOR1, "REVERSE") == 0) {
+      read_word(BUFOR3);
+      remember(BUFOR3);
+      PhoneNumbers *ph = phfwdReverse(pf, BUFOR3);
+      check(ph != NULL, "REVERSE FAILED FOR", BUFOR3);
+
+      size_t index = 0;
+      for (read_word(BUFOR1); strcmp(BUFOR1, "GETREVERSE") == 0;
+           read_word(BUFOR1)) {
+        read_word(BUFOR2);
+        const char *result = phnumGet(ph, index++);
+        check(result != NULL && strcmp(result, BUFOR2) == 0,
+              "WRONG RESULT OF REVERSE", BUFOR3);
+      }
+      check(phnumGet(ph, index) == NULL, "TOO MANY RESULTS OF REVERSE",
+            BUFOR3);
+      phnumDelete(ph);
+    } else if (strcmp(BUFOR1, "NODES") == 0) {
+      size_t expected = read_size(BUFOR1);
+      PhoneForwardTrieStats stats;
+      check(phfwdTrieStats(pf, &stats), "TRIE STATS FAILED", "");
+      check(stats.forward.nodes == expected, "WRONG NUMBER OF NODES", BUFOR1);
+    } else if (strcmp(BUFOR1, "LATENCY") == 0) {
+      size_t operation = read_operation(BUFOR1);
+      check_latency(operation, read_size(BUFOR1));
+    } else if (strcmp(BUFOR1, "THREADS") == 0) {
+      size_t threads = read_size(BUFOR1);
+      run_threads(threads, read_size(BUFOR1));
+    } else if (strcmp(BUFOR1, "RECORD") == 0) {
+      read_word(BUFOR1);
+      check(phfwdRecordStart(pf, BUFOR1), "RECORD FAILED", BUFOR1);
+    } else if (strcmp(BUFOR1, "RECORD_STOP") == 0) {
+      check(phfwdRecordStop(pf), "RECORD STOP FAILED", "");
+    } else if (strcmp(BUFOR1, "CONNECT") == 0) {
+      read_word(BUFOR1);
+      check(client == NULL, "ALREADY CONNECTED", "");
+      client = phfwd_client_connect(BUFOR1);
+      check(client != NULL, "CONNECT FAILED", BUFOR1);
+    } else if (strcmp(BUFOR1, "DISCONNECT") == 0) {
+      check(phfwd_client_pending(client) == 0, "RESPONSES NOT RECEIVED", "");
+      phfwd_client_close(client);
+      client = NULL;
+    } else if (strcmp(BUFOR1, "SEND") == 0 ||
+               strcmp(BUFOR1, "SEND_REJECTED") == 0) {
+      bool expected = strcmp(BUFOR1, "SEND") == 0;
+      check(send_request(client, BUFOR1, BUFOR2) == expected,
+            "WRONG RESULT OF SEND", BUFOR1);
+    } else if (strcmp(BUFOR1, "RECEIVE") == 0) {
+      bool success = read_size(BUFOR1) != 0;
+      size_t count = read_size(BUFOR1);
+      PhfwdResponse response;
+      check(phfwd_client_receive(client, &response), "RECEIVE FAILED", "");
+      check(response.success == success && response.count == count,
+            "WRONG RESPONSE", "");
+      for (size_t i = 0; i < count; i++) {
+        read_word(BUFOR1);
+        check(strcmp(response.numbers[i], BUFOR1) == 0,
+              "WRONG NUMBER IN RESPONSE", BUFOR1);
+      }
+    } else if (strcmp(BUFOR1, "TOO_LONG") == 0) {
+      read_word(BUFOR1);
+      send_too_long(BUFOR1);
+    } else if (strcmp(BUFOR1, "USE") == 0) {
+      current = read_size(BUFOR1) % SLOTS;
+      check(slots[current] != NULL, "NO STRUCTURE", BUFOR1);
+    } else if (strcmp(BUFOR1, "NEW") == 0 || strcmp(BUFOR1, "CLONE") == 0) {
+      bool clone = strcmp(BUFOR1, "CLONE") == 0;
+      size_t slot = read_size(BUFOR1) % SLOTS;
+      check(slots[slot] == NULL, "STRUCTURE ALREADY EXISTS", BUFOR1);
+      slots[slot] = clone ? phfwdClone(pf) : phfwdNew();
+      check(slots[slot] != NULL, "STRUCTURE NOT CREATED", BUFOR1);
+    } else if (strcmp(BUFOR1, "DELETE") == 0) {
+      size_t slot = read_size(BUFOR1) % SLOTS;
+      check(slot != current, "DELETING USED STRUCTURE", BUFOR1);
+      phfwdDelete(slots[slot]);
+      slots[slot] = NULL;
+    } else if (strcmp(BUFOR1, "SAME") == 0) {
+      size_t slot = read_size(BUFOR1) % SLOTS;
+      check(slots[slot] != NULL, "NO STRUCTURE", BUFOR1);
+      check(fingerprint(pf) == fingerprint(slots[slot]),
+            "STRUCTURES DIFFER", BUFOR1);
+    } else if (strcmp(BUFOR1, "DIFF") == 0) {
+      PhoneForward *from = slots[read_size(BUFOR1) % SLOTS];
+      PhoneForward *to = slots[read_size(BUFOR1) % SLOTS];
+      size_t expected = read_size(BUFOR1);
+      size_t changes = 0;
+      check(phfwdDiff(from, to, count_change, &changes), "DIFF FAILED", "");
+      check(changes == expected, "WRONG NUMBER OF CHANGES", BUFOR1);
+    } else if (strcmp(BUFOR1, "APPLY_DIFF") == 0) {
+      PhoneForward *from = slots[read_size(BUFOR1) % SLOTS];
+      PhoneForward *to = slots[read_size(BUFOR1) % SLOTS];
+      check(phfwdApplyDiff(pf, from, to), "APPLY DIFF FAILED", "");
+    } else if (strcmp(BUFOR1, "HYBRID") == 0) {
+      PhoneForwardHybridOptions options;
+      options.delta_limit = read_size(BUFOR1);
+      options.merge_step = read_size(BUFOR1);
+      check(phfwdHybridEnable(pf, &options), "HYBRID NOT ENABLED", "");
+    } else if (strcmp(BUFOR1, "HYBRID_MERGE") == 0) {
+      check(phfwdHybridMerge(pf), "HYBRID MERGE FAILED", "");
+    } else if (strcmp(BUFOR1, "HYBRID_OFF") == 0) {
+      phfwdHybridDisable(pf);
+    } else if (strcmp(BUFOR1, "REPLACE") == 0 ||
+               strcmp(BUFOR1, "REPLACE_FAILING") == 0) {
+      bool failing = strcmp(BUFOR1, "REPLACE_FAILING") == 0;
+      read_word(BUFOR2);
+      remember(BUFOR2);
+      size_t slot = read_size(BUFOR1) % SLOTS;
+      check(slot != current && slots[slot] != NULL, "NO STRUCTURE", BUFOR1);
+      bool replaced = true;
+      if (failing) {
+        replace_failing(pf, BUFOR2, slots[slot]);
+      } else {
+        replaced = phfwdReplacePrefix(pf, BUFOR2, slots[slot]);
+        check(replaced == (read_size(BUFOR1) != 0),
+              "WRONG RESULT OF REPLACE", BUFOR2);
+      }
+      if (replaced) {
+        slots[slot] = NULL;
+      }
+    } else if (strcmp(BUFOR1, "RECLAIM_STEP") == 0) {
+      phfwdReclaimSetStep(pf, read_size(BUFOR1));
+    } else if (strcmp(BUFOR1, "RECLAIM") == 0) {
+      check(!phfwdReclaimStep(pf, SIZE_MAX), "RECLAIM LEFT FORWARDS", "");
+    } else if (strcmp(BUFOR1, "RELAYOUT") == 0) {
+      check(phfwdRelayout(pf) == (read_size(BUFOR1) != 0),
+            "WRONG RESULT OF RELAYOUT", "");
+    } else if (strcmp(BUFOR1, "SAMPLE") == 0) {
+      phfwdHotSampling(pf, read_size(BUFOR1) != 0);
+    } else if (strcmp(BUFOR1, "RELAYOUT_HOT") == 0) {
+      size_t hot_nodes = read_size(BUFOR1);
+      check(phfwdRelayoutHot(pf, hot_nodes) == (read_size(BUFOR1) != 0),
+            "WRONG RESULT OF RELAYOUT HOT", "");
+    } else if (strcmp(BUFOR1, "DEFER") == 0) {
+      phfwdCompactionDefer(pf, true, read_size(BUFOR1));
+    } else if (strcmp(BUFOR1, "DEFER_OFF") == 0) {
+      phfwdCompactionDefer(pf, false, 0);
+    } else if (strcmp(BUFOR1, "COMPACT") == 0) {
+      size_t expected = read_size(BUFOR1);
+      check(phfwdCompact(pf) == expected, "WRONG NUMBER OF COMPACTED NODES",
+            BUFOR1);
+    } else if (strcmp(BUFOR1, "BEGIN") == 0) {
+      check(transaction == NULL, "TRANSACTION ALREADY STARTED", "");
+      transaction = phfwdBegin(pf);
+      check(transaction != NULL, "BEGIN FAILED", "");
+    } else if (strcmp(BUFOR1, "STAGE_ADD") == 0) {
+      read_word(BUFOR1);
+      read_word(BUFOR2);
+      remember(BUFOR1);
+      remember(BUFOR2);
+      check(phfwdStageAdd(transaction, BUFOR1, BUFOR2), "STAGE FAILED",
+            BUFOR1);
+
+      size_t length = strlen(BUFOR1);
+      staged = realloc(staged, (staged_count + 1) * sizeof(char *));
+      assert(staged != NULL);
+      staged[staged_count] = malloc(length + strlen(BUFOR2) + 3);
+      assert(staged[staged_count] != NULL);
+      sprintf(staged[staged_count], "+%s", BUFOR1);
+      strcpy(staged[staged_count] + length + 2, BUFOR2);
+      staged_count++;
+    } else if (strcmp(BUFOR1, "STAGE_REMOVE") == 0) {
+      read_word(BUFOR1);
+      remember(BUFOR1);
+      check(phfwdStageRemove(transaction, BUFOR1), "STAGE FAILED", BUFOR1);
+
+      staged = realloc(staged, (staged_count + 1) * sizeof(char *));
+      assert(staged != NULL);
+      staged[staged_count] = malloc(strlen(BUFOR1) + 2);
+      assert(staged[staged_count] != NULL);
+      sprintf(staged[staged_count], "-%s", BUFOR1);
+      staged_count++;
+    } else if (strcmp(BUFOR1, "COMMIT") == 0 ||
+               strcmp(BUFOR1, "COMMIT_FAILING") == 0 ||
+               strcmp(BUFOR1, "ABORT") == 0) {
+      check(transaction != NULL, "NO TRANSACTION", "");
+      if (strcmp(BUFOR1, "COMMIT") == 0) {
+        check(phfwdCommit(transaction), "COMMIT FAILED", "");
+      } else if (strcmp(BUFOR1, "COMMIT_FAILING") == 0) {
+        phfwdAbort(transaction);
+        commit_failing(pf, staged, staged_count);
+      } else {
+        phfwdAbort(transaction);
+      }
+      transaction = NULL;
+
+      for (size_t i = 0; i < staged_count; i++) {
+        free(staged[i]);
+      }
+      staged_count = 0;
+    } else if (strcmp(BUFOR1, "FORWARDS") == 0) {
+      size_t expected = read_size(BUFOR1);
+      PhoneForwardMemoryStats stats;
+      check(phfwdMemoryStats(pf, &stats), "MEMORY STATS FAILED", "");
+      check(stats.forwards == expected, "WRONG NUMBER OF FORWARDS", BUFOR1);
+    } else if (strcmp(BUFOR1, "FAIL") == 0) {
+      failing_next = read_size(BUFOR1);
+    } else if (strcmp(BUFOR1, "WAL_OPEN") == 0) {
+      read_word(BUFOR1);
+      PhoneForwardWalOptions options = {PHFWD_DURABILITY_BUFFERED, 0, 0, 0,
+                                        0};
+      options.group_time_us = read_size(BUFOR2);
+      options.group_bytes = read_size(BUFOR2);
+      options.checkpoint_bytes = read_size(BUFOR2);
+      options.checkpoint_step = read_size(BUFOR2);
+      check(phfwdWalOpen(pf, BUFOR1, &options), "WAL OPEN FAILED", BUFOR1);
+    } else if (strcmp(BUFOR1, "WAL_SYNC") == 0) {
+      check(phfwdWalSync(pf), "WAL SYNC FAILED", "");
+    } else if (strcmp(BUFOR1, "CHECKPOINT") == 0) {
+      check(phfwdCheckpoint(pf), "CHECKPOINT FAILED", "");
+    } else if (strcmp(BUFOR1, "SNAPSHOT") == 0) {
+      read_word(BUFOR1);
+      check(phfwdSnapshotAsync(pf, BUFOR1), "SNAPSHOT FAILED", BUFOR1);
+    } else if (strcmp(BUFOR1, "SNAPSHOT_WAIT") == 0) {
+      check(phfwdSnapshotPoll(pf, true, NULL) == PHFWD_SNAPSHOT_DONE,
+            "SNAPSHOT NOT WRITTEN", "");
+    } else if (strcmp(BUFOR1, "LOAD") == 0) {
+      read_word(BUFOR1);
+      bool expected = read_size(BUFOR2) != 0;
+      check(phfwdSnapshotLoad(pf, BUFOR1) == expected,
+            "WRONG RESULT OF LOAD", BUFOR1);
+    } else if (strcmp(BUFOR1, "WAL_POLL") == 0) {
+      bool expected = read_size(BUFOR1) != 0;
+      check(phfwdWalPoll(pf) == expected, "WRONG RESULT OF WAL POLL", "");
+    } else if (strcmp(BUFOR1, "WAL_FAILED") == 0) {
+      bool expected = read_size(BUFOR1) != 0;
+      check(phfwdWalFailed(pf) == expected, "WRONG STATE OF WAL", "");
+    } else if (strcmp(BUFOR1, "WAL_CLOSE") == 0) {
+      bool expected = read_size(BUFOR1) != 0;
+      check(phfwdWalClose(pf) == expected, "WRONG RESULT OF WAL CLOSE", "");
+    } else if (strcmp(BUFOR1, "CLEAN") == 0) {
+      read_word(BUFOR1);
+      remove_log(BUFOR1, BUFOR2);
+    } else if (strcmp(BUFOR1, "SLEEP") == 0) {
+      size_t milliseconds = read_size(BUFOR1);
+      struct timespec pause = {(time_t)(milliseconds / 1000),
+                               (long)(milliseconds % 1000) * 1000000};
+      nanosleep(&pause, NULL);
+    } else if (strcmp(BUFOR1, "VERSION") == 0) {
+      size_t version = read_size(BUFOR1) % VERSIONS;
+      check(versions[version] == NULL, "VERSION ALREADY EXISTS", BUFOR1);
+      versions[version] = phfwdSnapshot(pf);
+      check(versions[version] != NULL, "VERSION NOT CREATED", BUFOR1);
+    } else if (strcmp(BUFOR1, "RELEASE") == 0) {
+      size_t version = read_size(BUFOR1) % VERSIONS;
+      phfwdVersionRelease(versions[version]);
+      versions[version] = NULL;
+    } else if (strcmp(BUFOR1, "VERSION_GET") == 0) {
+      PhoneForwardVersion *version = versions[read_size(BUFOR1) % VERSIONS];
+      read_word(BUFOR1);
+      read_word(BUFOR2);
+      PhoneNumbers *ph = phfwdVersionGet(version, BUFOR1);
+      check(ph != NULL && strcmp(phnumGet(ph, 0), BUFOR2) == 0,
+            "WRONG RESULT OF VERSION GET", BUFOR1);
+      phnumDelete(ph);
+    } else if (strcmp(BUFOR1, "VERSION_COUNT") == 0) {
+      PhoneForwardVersion *version = versions[read_size(BUFOR1) % VERSIONS];
+      size_t expected = read_size(BUFOR1);
+      size_t count = 0;
+      check(phfwdVersionForEach(version, count_forward, &count),
+            "VERSION FOR EACH FAILED", "");
+      check(count == expected, "WRONG NUMBER OF FORWARDS IN VERSION", BUFOR1);
+    } else if (strcmp(BUFOR1, "RECOVER") == 0 ||
+               strcmp(BUFOR1, "RECOVER_FAILING") == 0) {
+      bool failing = strcmp(BUFOR1, "RECOVER_FAILING") == 0;
+      size_t slot = read_size(BUFOR1) % SLOTS;
+      read_word(BUFOR1);
+      if (failing) {
+        check(slots[slot] == NULL, "STRUCTURE ALREADY EXISTS", BUFOR1);
+        slots[slot] = recover_failing(BUFOR1);
+      } else {
+        if (slots[slot] == NULL) {
+          slots[slot] = phfwdNew();
+        }
+        check(phfwdWalRecover(slots[slot], BUFOR1), "RECOVER FAILED",
+              BUFOR1);
+      }
+    } else {
+      failure("UNKNOWN COMMAND", BUFOR1);
+    }
+
+    failing_allocation = 0;
+    command++;
+  }
+
+  check(client == NULL, "CONNECTION NOT CLOSED", "");
+  check(transaction == NULL, "TRANSACTION NOT FINISHED", "");
+  printf("%s: POMYŚLNIE PRZESZŁO TESTY.\n", scenario);
+
+  for (size_t i = 0; i < VERSIONS; i++) {
+    phfwdVersionRelease(versions[i]);
+  }
+  for (size_t i = 0; i < SLOTS; i++) {
+    phfwdDelete(slots[i]);
+  }
+  for (size_t i = 0; i < numbers_count; i++) {
+    free(numbers[i]);
+  }
+  free(numbers);
+  free(staged);
+  free(BUFOR1);
+  free(BUFOR2);
+  free(BUFOR3);
+  return 0;
+}
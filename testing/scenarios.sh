@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Kompiluje sterownik scenariuszy i programy z plikami biblioteki, a następnie
+# uruchamia pod valgrindem każdy scenariusz z katalogu scenarios: pliki .in
+# są wejściem sterownika, a skrypty .sh wywołują sterownik i programy
+# poleceniem z RUN. Zmienne CFLAGS i RUN pozwalają np. użyć sanitizerów:
+# CFLAGS=-fsanitize=address RUN= ./scenarios.sh
+cd "$(dirname "$0")"
+
+LIBRARY="phone_forward compressed_trie memory latency number_codec
+operation_log string_lib double_linked_list dynamic_array blackred_tree
+phfwd_protocol phfwd_client write_ahead_log flat_trie"
+PROGRAMS="phfwd_replay phfwd_batch phfwd_server"
+export RUN="${RUN-valgrind -q --leak-check=full --error-exitcode=99}"
+
+build() {
+  gcc -std=c17 -g -Wall -Wextra -Wno-implicit-fallthrough -pthread \
+    -DPHFWD_MEMORY_STATS -DPHFWD_LATENCY_STATS $CFLAGS -o "$@" \
+    $(for file in $LIBRARY; do echo "../src/$file.c"; done)
+}
+
+# Sterownik podmienia funkcje alokacji, by polecenie FAIL mogło je psuć.
+build scenario scenarios.c \
+  -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc || exit 1
+for program in $PROGRAMS; do
+  build "$program" "../src/$program.c" || exit 1
+done
+
+for scenario in scenarios/*.in; do
+  $RUN ./scenario "$scenario" <"$scenario" || exit 1
+done
+
+for scenario in scenarios/*.sh; do
+  bash "$scenario" || { echo "$scenario: NIE PRZESZŁO TESTÓW."; exit 1; }
+done
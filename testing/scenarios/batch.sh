@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Wykonuje polecenia programem phfwd_batch z pliku (odwzorowanego w pamięci)
+# i ze strumienia. Ostatnia linia nie kończy się znakiem nowej linii.
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+printf 'ADD 123 9\nADD 12 8\n\nGET 1234\n\tREVERSE  9\r\nREMOVE 12\nGET 1234' \
+  >"$DIR/commands"
+printf '94\n123 9\n1234\n' >"$DIR/expected"
+
+$RUN ./phfwd_batch "$DIR/commands" >"$DIR/out" || exit 1
+cmp -s "$DIR/out" "$DIR/expected" || exit 1
+
+$RUN ./phfwd_batch <"$DIR/commands" >"$DIR/out" || exit 1
+cmp -s "$DIR/out" "$DIR/expected" || exit 1
+cat "$DIR/commands" | $RUN ./phfwd_batch - >"$DIR/out" || exit 1
+cmp -s "$DIR/out" "$DIR/expected" || exit 1
+
+# Linie, których nie da się wykonać, są zgłaszane, a pozostałe wykonywane.
+printf 'ADD 1\nGET 12 3\nSET 1 2\nADD 1 2\nGET 15\n' >"$DIR/malformed"
+$RUN ./phfwd_batch "$DIR/malformed" >"$DIR/out" 2>"$DIR/err"
+[ $? -eq 1 ] || exit 1
+[ "$(cat "$DIR/out")" = "25" ] || exit 1
+[ "$(grep -c "Malformed command" "$DIR/err")" -eq 3 ] || exit 1
+grep -q "line 3\." "$DIR/err" || exit 1
+
+echo "batch.sh: POMYŚLNIE PRZESZŁO TESTY."
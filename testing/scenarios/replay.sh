@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Nagrywa wywołania i odtwarza je programem phfwd_replay. Ucięty lub
+# uszkodzony zapis musi zakończyć program błędem, a nie wyglądać na koniec.
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+$RUN ./scenario replay.sh >/dev/null <<END || exit 1
+RECORD $DIR/calls.log
+ADD 123 9
+ADD 12 8
+GET 1234 94
+REVERSE 9
+GETREVERSE 123
+GETREVERSE 9
+REVERSE_END
+REMOVE 12
+GET 1234 1234
+RECORD_STOP
+END
+
+$RUN ./phfwd_replay "$DIR/calls.log" >"$DIR/out" || exit 1
+grep -q "^replayed 6 calls" "$DIR/out" || exit 1
+grep -q "^add  *2 " "$DIR/out" || exit 1
+grep -q "^get  *2 " "$DIR/out" || exit 1
+
+SIZE=$(stat -c %s "$DIR/calls.log")
+head -c $((SIZE - 1)) "$DIR/calls.log" >"$DIR/truncated.log"
+$RUN ./phfwd_replay "$DIR/truncated.log" >/dev/null 2>"$DIR/err"
+[ $? -eq 1 ] && grep -q "truncated or corrupted after 5 calls" "$DIR/err" ||
+  exit 1
+
+cp "$DIR/calls.log" "$DIR/corrupted.log"
+printf '\x09' >>"$DIR/corrupted.log"
+$RUN ./phfwd_replay "$DIR/corrupted.log" >/dev/null 2>"$DIR/err"
+[ $? -eq 1 ] && grep -q "after 6 calls" "$DIR/err" || exit 1
+
+head -c 9 "$DIR/calls.log" >"$DIR/empty.log"
+$RUN ./phfwd_replay "$DIR/empty.log" >"$DIR/out" || exit 1
+grep -q "^replayed 0 calls" "$DIR/out" || exit 1
+
+echo "replay.sh: POMYŚLNIE PRZESZŁO TESTY."
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Uruchamia phfwd_server i wysyła do niego żądania dwoma kolejnymi
+# połączeniami. Struktura serwera jest wspólna dla połączeń.
+DIR=$(mktemp -d)
+SOCKET="$DIR/socket"
+trap 'kill $SERVER 2>/dev/null; rm -rf "$DIR"' EXIT
+
+$RUN ./phfwd_server "$SOCKET" &
+SERVER=$!
+for i in $(seq 100); do
+  [ -S "$SOCKET" ] && break
+  sleep 0.1
+done
+
+LONG=$(printf '1%.0s' $(seq 513))
+MAX=$(printf '1%.0s' $(seq 512))
+
+$RUN ./scenario server.sh >/dev/null <<END || exit 1
+CONNECT $SOCKET
+SEND ADD 123 9
+SEND ADD 12 8
+SEND ADD 5 5
+SEND GET 1234
+SEND REVERSE 9
+SEND_REJECTED GET $LONG
+SEND_REJECTED ADD 1 $LONG
+SEND GET $MAX
+RECEIVE 1 0
+RECEIVE 1 0
+RECEIVE 0 0
+RECEIVE 1 1 94
+RECEIVE 1 2 123 9
+RECEIVE 1 1 $MAX
+DISCONNECT
+TOO_LONG $SOCKET
+CONNECT $SOCKET
+SEND REMOVE 12
+SEND GET 1234
+SEND GET 12a
+RECEIVE 1 0
+RECEIVE 1 1 1234
+RECEIVE 1 0
+DISCONNECT
+END
+
+kill -TERM $SERVER
+wait $SERVER || exit 1
+[ ! -e "$SOCKET" ] || exit 1
+
+echo "server.sh: POMYŚLNIE PRZESZŁO TESTY."